@@ -603,6 +603,11 @@ struct tegra_dc_win {
 	unsigned		bandwidth;
 	unsigned		new_bandwidth;
 	struct tegra_dc_lut	lut;
+
+	/* screen rows the next update of this window changes, valid with
+	 * TEGRA_WIN_FLAG_DAMAGE. without it the whole frame is refreshed. */
+	unsigned		damage_y;
+	unsigned		damage_h;
 };
 
 #define TEGRA_WIN_PPFLAG_CP_ENABLE	(1 << 0) /* enable RGB color lut */
@@ -617,6 +622,7 @@ struct tegra_dc_win {
 #define TEGRA_WIN_FLAG_H_FILTER		(1 << 6)
 #define TEGRA_WIN_FLAG_V_FILTER		(1 << 7)
 #define TEGRA_WIN_FLAG_SCAN_COLUMN	(1 << 9)
+#define TEGRA_WIN_FLAG_DAMAGE		(1 << 10)
 
 
 #define TEGRA_WIN_BLEND_FLAGS_MASK \
@@ -42,6 +42,7 @@ struct tegra_iovmm_device {
 	const char			*name;
 	struct list_head		list;
 	int				pgsize_bits;
+	int				large_pgsize_bits; /* 0: none */
 };
 
 /*
@@ -122,6 +123,24 @@ struct tegra_iovmm_device_ops {
 	void (*map_pfn)(struct tegra_iovmm_domain *domain,
 		struct tegra_iovmm_area *io_vma,
 		unsigned long offs, unsigned long pfn);
+	/*
+	 * optional; maps one naturally aligned large page (1 <<
+	 * large_pgsize_bits bytes) of physically contiguous memory
+	 * starting at pfn with a single page directory entry
+	 */
+	void (*map_large_pfn)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma,
+		unsigned long offs, unsigned long pfn);
+	/*
+	 * optional; map or unmap count pages starting at offs with a single
+	 * page table cache clean per table and a single TLB flush
+	 */
+	int (*map_range)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma, unsigned long offs,
+		struct page **pages, unsigned long count);
+	void (*unmap_range)(struct tegra_iovmm_domain *domain,
+		struct tegra_iovmm_area *io_vma, unsigned long offs,
+		unsigned long count, bool decommit);
 	/*
 	 * ensures that a domain is resident in the hardware's mapping region
 	 * so that it may be used by a client
@@ -223,6 +242,20 @@ size_t tegra_iovmm_get_max_free(struct tegra_iovmm_client *client);
 void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *area,
 	tegra_iovmm_addr_t vaddr, unsigned long pfn);
 
+/*
+ * maps nr pages to consecutive page-aligned I/O addresses starting at vaddr,
+ * using the device's range operation (and large pages) if it has one. the
+ * area should have been created with a NULL tegra_iovmm_area_ops structure.
+ */
+int tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *area,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned int nr);
+
+/*
+ * returns the size of the large pages the client's I/O VMM device can map
+ * with a single directory entry, or 0 if it has none.
+ */
+size_t tegra_iovmm_get_large_page_size(struct tegra_iovmm_client *client);
+
 /*
  * called by clients to return the iovmm_area containing addr, or NULL if
  * addr has not been allocated. caller should call tegra_iovmm_area_put when
@@ -306,6 +339,18 @@ static inline void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *area,
 {
 }
 
+static inline int tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *area,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned int nr)
+{
+	return 0;
+}
+
+static inline size_t tegra_iovmm_get_large_page_size(
+	struct tegra_iovmm_client *client)
+{
+	return 0;
+}
+
 static inline struct tegra_iovmm_area *tegra_iovmm_find_area_get(
 	struct tegra_iovmm_client *client, tegra_iovmm_addr_t addr)
 {
@@ -377,6 +422,18 @@ static inline void tegra_iovmm_resume(void)
 				 PAGE_SIZE, 0, 0, &attrs);		\
 	} while (0)
 
+static inline int __tegra_iommu_vm_map_pages(struct tegra_iovmm_area *area,
+	dma_addr_t vaddr, struct page **pages, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++, vaddr += PAGE_SIZE)
+		tegra_iovmm_vm_insert_pfn(area, vaddr, page_to_pfn(pages[i]));
+	return 0;
+}
+#define tegra_iovmm_vm_map_pages(area, vaddr, pages, nr)		\
+	__tegra_iommu_vm_map_pages(area, vaddr, pages, nr)
+
 struct tegra_iovmm_area *tegra_iommu_create_vm(struct device *dev,
 		       dma_addr_t req, size_t size, pgprot_t prot);
 
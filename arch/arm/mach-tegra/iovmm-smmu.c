@@ -211,6 +211,9 @@
 #define SMMU_PAGE_SHIFT 12
 #define SMMU_PAGE_SIZE	(1 << SMMU_PAGE_SHIFT)
 
+#define SMMU_LARGE_PAGE_SHIFT	22	/* one PDE maps 4MB without a PTBL */
+#define SMMU_LARGE_PAGE_SIZE	(1 << SMMU_LARGE_PAGE_SHIFT)
+
 #define SMMU_PDIR_COUNT	1024
 #define SMMU_PDIR_SIZE	(sizeof(unsigned long) * SMMU_PDIR_COUNT)
 #define SMMU_PTBL_COUNT	1024
@@ -248,6 +251,12 @@
 #define SMMU_EX_PTBL_PAGE(pde)		\
 		pfn_to_page((unsigned long)(pde) & SMMU_PFN_MASK)
 #define SMMU_PFN_TO_PTE(pfn, attr)	(unsigned long)((pfn) | (attr))
+/*
+ * A PDE without _PDE_NEXT maps a 4MB large page directly; note that a
+ * vacant PDE is simply an identity-mapped large page.
+ */
+#define SMMU_PFN_TO_LARGE_PDE(pfn, attr)	\
+	(unsigned long)((SMMU_ADDR_TO_PDN(__pfn_to_phys(pfn)) << 10) | (attr))
 
 #define SMMU_ASID_ENABLE(asid)	((asid) | (1 << 31))
 #define SMMU_ASID_DISABLE	0
@@ -432,6 +441,8 @@ struct smmu_device {
 
 	struct device *dev;
 	struct dentry *debugfs_root;
+
+	u64 range_flushes_saved;	/* per-page flushes avoided by ranges */
 };
 
 #define VA_PAGE_TO_PA(va, page)	\
@@ -570,6 +581,27 @@ static void flush_ptc_and_tlb(struct smmu_device *smmu,
 	flush_smmu_regs(smmu);
 }
 
+/*
+ * Flush the whole PTC and all TLB entries of the AS; issued once at the end
+ * of a range operation instead of one flush_ptc_and_tlb() per entry.
+ */
+static void flush_ptc_and_tlb_as(struct smmu_device *smmu,
+		struct smmu_as *as, unsigned long entries)
+{
+	writel(MC_SMMU_PTC_FLUSH_0_PTC_FLUSH_TYPE_ALL,
+		smmu->regs_mc + MC_SMMU_PTC_FLUSH_0);
+	flush_smmu_regs(smmu);
+	writel(MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_VA_MATCH_ALL |
+		MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_ASID_MATCH__ENABLE |
+		(as->asid << MC_SMMU_TLB_FLUSH_0_TLB_FLUSH_ASID_SHIFT),
+		smmu->regs_mc + MC_SMMU_TLB_FLUSH_0);
+	flush_smmu_regs(smmu);
+
+	spin_lock(&smmu->lock);
+	smmu->range_flushes_saved += entries - 1;
+	spin_unlock(&smmu->lock);
+}
+
 static void free_ptbl(struct smmu_as *as, unsigned long iova)
 {
 	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
@@ -578,8 +610,10 @@ static void free_ptbl(struct smmu_as *as, unsigned long iova)
 	if (pdir[pdn] != _PDE_VACANT(pdn)) {
 		pr_debug("%s:%d pdn=%lx\n", __func__, __LINE__, pdn);
 
-		ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
-		__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+		if (pdir[pdn] & _PDE_NEXT) {
+			ClearPageReserved(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+			__free_page(SMMU_EX_PTBL_PAGE(pdir[pdn]));
+		}
 		pdir[pdn] = _PDE_VACANT(pdn);
 		flush_cpu_dcache(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
 		flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn],
@@ -752,6 +786,10 @@ static void smmu_debugfs_create(struct smmu_device *smmu)
 		goto err_out;
 	smmu->debugfs_root = root;
 
+	if (!debugfs_create_u64("range_flushes_saved", S_IRUGO, root,
+				&smmu->range_flushes_saved))
+		goto err_out;
+
 	for (i = 0; i < ARRAY_SIZE(smmu_debugfs_mc); i++) {
 		int j;
 		struct dentry *mc;
@@ -834,7 +872,7 @@ static unsigned long *locate_pte(struct smmu_as *as,
 	unsigned long *pdir = kmap(as->pdir_page);
 	unsigned long *ptbl;
 
-	if (pdir[pdn] != _PDE_VACANT(pdn)) {
+	if (pdir[pdn] & _PDE_NEXT) {
 		/* Mapped entry table already exists */
 		*ptbl_page_p = SMMU_EX_PTBL_PAGE(pdir[pdn]);
 		ptbl = kmap(*ptbl_page_p);
@@ -842,7 +880,11 @@ static unsigned long *locate_pte(struct smmu_as *as,
 		kunmap(as->pdir_page);
 		return NULL;
 	} else {
-		/* Vacant - allocate a new page table */
+		/*
+		 * Vacant or a large page - allocate a new page table. The
+		 * large page is simply replaced: the area being mapped owns
+		 * the whole 4MB range.
+		 */
 		pr_debug("%s:%d new PTBL pdn=%lx\n", __func__, __LINE__, pdn);
 
 		*ptbl_page_p = alloc_page(GFP_KERNEL | __GFP_DMA);
@@ -890,6 +932,30 @@ static void put_signature(struct smmu_as *as,
 	}
 }
 
+/*
+ * Clears the PDE for iova if it maps a large page; returns true if so.
+ * PTC/TLB are left to the caller unless flush is set.
+ * Caller must lock as
+ */
+static bool unmap_large_page(struct smmu_as *as, unsigned long iova,
+		bool flush)
+{
+	unsigned long pdn = SMMU_ADDR_TO_PDN(iova);
+	unsigned long *pdir = kmap(as->pdir_page);
+	bool large = false;
+
+	if (!(pdir[pdn] & _PDE_NEXT) && pdir[pdn] != _PDE_VACANT(pdn)) {
+		pdir[pdn] = _PDE_VACANT(pdn);
+		flush_cpu_dcache(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+		if (flush)
+			flush_ptc_and_tlb(as->smmu, as, iova, &pdir[pdn],
+					as->pdir_page, 1);
+		large = true;
+	}
+	kunmap(as->pdir_page);
+	return large;
+}
+
 static int smmu_map(struct tegra_iovmm_domain *domain,
 		struct tegra_iovmm_area *iovma)
 {
@@ -963,44 +1029,81 @@ fail2:
 	return -ENOMEM;
 }
 
-static void smmu_unmap(struct tegra_iovmm_domain *domain,
-	struct tegra_iovmm_area *iovma, bool decommit)
+/*
+ * Unmaps count pages starting at addr, one page table run at a time, with
+ * a single PTC/TLB flush for the whole range.
+ */
+static void smmu_unmap_range(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, unsigned long addr,
+	unsigned long count, bool decommit)
 {
 	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
-	unsigned long addr = iovma->iovm_start;
-	unsigned int pcount = iovma->iovm_length >> SMMU_PAGE_SHIFT;
-	unsigned int i, *pte_counter;
+	const unsigned long large_count =
+		SMMU_LARGE_PAGE_SIZE >> SMMU_PAGE_SHIFT;
+	unsigned long entries = 0;
 
-	pr_debug("%s:%d iova=%lx asid=%d\n", __func__, __LINE__,
-		 addr, as - as->smmu->as);
+	pr_debug("%s:%d iova=%lx count=%lx asid=%d\n", __func__, __LINE__,
+		 addr, count, as - as->smmu->as);
 
 	mutex_lock(&as->lock);
-	for (i = 0; i < pcount; i++) {
+	while (count) {
 		unsigned long *pte;
+		unsigned int *pte_counter;
 		struct page *page;
+		unsigned long n, j, changed = 0;
+
+		if (!(addr & (SMMU_LARGE_PAGE_SIZE - 1)) &&
+		    count >= large_count &&
+		    unmap_large_page(as, addr, false)) {
+			entries++;
+			addr += SMMU_LARGE_PAGE_SIZE;
+			count -= large_count;
+			continue;
+		}
+
+		n = SMMU_PTBL_COUNT - (SMMU_ADDR_TO_PFN(addr) % SMMU_PTBL_COUNT);
+		n = min(n, count);
 
 		if (iovma->ops && iovma->ops->release)
-			iovma->ops->release(iovma, i << PAGE_SHIFT);
+			for (j = 0; j < n; j++)
+				iovma->ops->release(iovma, addr - iovma->iovm_start
+						    + (j << SMMU_PAGE_SHIFT));
 
 		pte = locate_pte(as, addr, false, &page, &pte_counter);
 		if (pte) {
-			if (*pte != _PTE_VACANT(addr)) {
-				*pte = _PTE_VACANT(addr);
-				flush_cpu_dcache(pte, page, sizeof *pte);
-				flush_ptc_and_tlb(as->smmu, as, addr, pte,
-						page, 0);
-				kunmap(page);
-				if (!--(*pte_counter) && decommit) {
-					free_ptbl(as, addr);
-					smmu_flush_regs(as->smmu, 0);
+			for (j = 0; j < n; j++) {
+				unsigned long va = addr + (j << SMMU_PAGE_SHIFT);
+
+				if (pte[j] != _PTE_VACANT(va)) {
+					pte[j] = _PTE_VACANT(va);
+					(*pte_counter)--;
+					changed++;
 				}
 			}
+			if (changed)
+				flush_cpu_dcache(pte, page, n * sizeof(*pte));
+			kunmap(page);
+			entries += changed;
+			/* the PTC lines of the freed table are dropped by
+			 * the flush below */
+			if (changed && !*pte_counter && decommit)
+				free_ptbl(as, addr);
 		}
-		addr += SMMU_PAGE_SIZE;
+		addr += n << SMMU_PAGE_SHIFT;
+		count -= n;
 	}
+	if (entries)
+		flush_ptc_and_tlb_as(as->smmu, as, entries);
 	mutex_unlock(&as->lock);
 }
 
+static void smmu_unmap(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, bool decommit)
+{
+	smmu_unmap_range(domain, iovma, iovma->iovm_start,
+			 iovma->iovm_length >> SMMU_PAGE_SHIFT, decommit);
+}
+
 static void smmu_map_pfn(struct tegra_iovmm_domain *domain,
 	struct tegra_iovmm_area *iovma, unsigned long addr,
 	unsigned long pfn)
@@ -1031,6 +1134,140 @@ static void smmu_map_pfn(struct tegra_iovmm_domain *domain,
 	mutex_unlock(&as->lock);
 }
 
+/*
+ * Points the PDE for addr at the large page starting at pfn. PTC/TLB are
+ * left to the caller unless flush is set, or a stale PTBL had to be freed.
+ * Caller must lock as
+ */
+static void map_large_page(struct smmu_as *as, unsigned long addr,
+		unsigned long pfn, bool flush)
+{
+	unsigned long pdn = SMMU_ADDR_TO_PDN(addr);
+	struct page *ptpage = NULL;
+	unsigned long *pdir;
+
+	BUG_ON(!pfn_valid(pfn));
+	pdir = kmap(as->pdir_page);
+	/* a stale PTBL can only hold entries of this area; drop it */
+	if (pdir[pdn] & _PDE_NEXT) {
+		ptpage = SMMU_EX_PTBL_PAGE(pdir[pdn]);
+		as->pte_count[pdn] = 0;
+	}
+	pdir[pdn] = SMMU_PFN_TO_LARGE_PDE(pfn, as->pde_attr);
+	flush_cpu_dcache(&pdir[pdn], as->pdir_page, sizeof pdir[pdn]);
+	if (flush || ptpage)
+		flush_ptc_and_tlb(as->smmu, as, addr, &pdir[pdn],
+				as->pdir_page, 1);
+	kunmap(as->pdir_page);
+	if (ptpage) {
+		ClearPageReserved(ptpage);
+		__free_page(ptpage);
+	}
+	put_signature(as, addr, pfn);
+}
+
+static void smmu_map_large_pfn(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, unsigned long addr,
+	unsigned long pfn)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+
+	pr_debug("%s:%d iova=%lx pfn=%lx asid=%d\n", __func__, __LINE__,
+		 addr, pfn, as - as->smmu->as);
+
+	mutex_lock(&as->lock);
+	map_large_page(as, addr, pfn, true);
+	mutex_unlock(&as->lock);
+}
+
+/* true if pages[0..count) are physically contiguous and naturally aligned */
+static bool is_large_page_run(struct page **pages, unsigned long count)
+{
+	unsigned long pfn = page_to_pfn(pages[0]);
+	unsigned long i;
+
+	if (pfn & (count - 1))
+		return false;
+	for (i = 1; i < count; i++)
+		if (page_to_pfn(pages[i]) != pfn + i)
+			return false;
+	return true;
+}
+
+/*
+ * Maps count pages starting at addr. PTEs are filled a page table run at
+ * a time with one cache clean per run, aligned contiguous 4MB runs use a
+ * large page PDE, and PTC/TLB are flushed once for the whole range.
+ */
+static int smmu_map_range(struct tegra_iovmm_domain *domain,
+	struct tegra_iovmm_area *iovma, unsigned long addr,
+	struct page **pages, unsigned long count)
+{
+	struct smmu_as *as = container_of(domain, struct smmu_as, domain);
+	const unsigned long large_count =
+		SMMU_LARGE_PAGE_SIZE >> SMMU_PAGE_SHIFT;
+	const unsigned long start = addr, total = count;
+	unsigned long entries = 0;
+	int err = 0;
+
+	pr_debug("%s:%d iova=%lx count=%lx asid=%d\n", __func__, __LINE__,
+		 addr, count, as - as->smmu->as);
+
+	mutex_lock(&as->lock);
+	while (count) {
+		unsigned long *pte;
+		unsigned int *pte_counter;
+		struct page *ptpage;
+		unsigned long n, j;
+
+		if (!(addr & (SMMU_LARGE_PAGE_SIZE - 1)) &&
+		    count >= large_count &&
+		    is_large_page_run(pages, large_count)) {
+			map_large_page(as, addr, page_to_pfn(pages[0]), false);
+			entries++;
+			addr += SMMU_LARGE_PAGE_SIZE;
+			pages += large_count;
+			count -= large_count;
+			continue;
+		}
+
+		n = SMMU_PTBL_COUNT - (SMMU_ADDR_TO_PFN(addr) % SMMU_PTBL_COUNT);
+		n = min(n, count);
+
+		pte = locate_pte(as, addr, true, &ptpage, &pte_counter);
+		if (!pte) {
+			err = -ENOMEM;
+			break;
+		}
+		for (j = 0; j < n; j++) {
+			unsigned long pfn = page_to_pfn(pages[j]);
+			unsigned long va = addr + (j << SMMU_PAGE_SHIFT);
+
+			BUG_ON(!pfn_valid(pfn));
+			if (pte[j] == _PTE_VACANT(va))
+				(*pte_counter)++;
+			pte[j] = SMMU_PFN_TO_PTE(pfn, as->pte_attr);
+			if (unlikely(pte[j] == _PTE_VACANT(va)))
+				(*pte_counter)--;
+			put_signature(as, va, pfn);
+		}
+		flush_cpu_dcache(pte, ptpage, n * sizeof(*pte));
+		kunmap(ptpage);
+		entries += n;
+		addr += n << SMMU_PAGE_SHIFT;
+		pages += n;
+		count -= n;
+	}
+	if (entries)
+		flush_ptc_and_tlb_as(as->smmu, as, entries);
+	mutex_unlock(&as->lock);
+
+	/* leave nothing of a failed range mapped */
+	if (err && total != count)
+		smmu_unmap_range(domain, iovma, start, total - count, true);
+	return err;
+}
+
 /*
  * Caller must lock/unlock as
  */
@@ -1224,6 +1461,9 @@ static struct tegra_iovmm_device_ops tegra_iovmm_smmu_ops = {
 	.map = smmu_map,
 	.unmap = smmu_unmap,
 	.map_pfn = smmu_map_pfn,
+	.map_large_pfn = smmu_map_large_pfn,
+	.map_range = smmu_map_range,
+	.unmap_range = smmu_unmap_range,
 	.alloc_domain = smmu_alloc_domain,
 	.free_domain = smmu_free_domain,
 	.suspend = smmu_suspend,
@@ -1270,6 +1510,7 @@ static int smmu_probe(struct platform_device *pdev)
 	smmu->iovmm_dev.name = VMM_NAME;
 	smmu->iovmm_dev.ops = &tegra_iovmm_smmu_ops;
 	smmu->iovmm_dev.pgsize_bits = SMMU_PAGE_SHIFT;
+	smmu->iovmm_dev.large_pgsize_bits = SMMU_LARGE_PAGE_SHIFT;
 
 	e = tegra_iovmm_register(&smmu->iovmm_dev);
 	if (e)
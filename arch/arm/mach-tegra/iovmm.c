@@ -534,6 +534,59 @@ void tegra_iovmm_vm_insert_pfn(struct tegra_iovmm_area *vm,
 	domain->dev->ops->map_pfn(domain, vm, vaddr, pfn);
 }
 
+int tegra_iovmm_vm_map_pages(struct tegra_iovmm_area *vm,
+	tegra_iovmm_addr_t vaddr, struct page **pages, unsigned int nr)
+{
+	struct tegra_iovmm_domain *domain = vm->domain;
+	struct tegra_iovmm_device_ops *ops = domain->dev->ops;
+	unsigned long large = 0;
+	unsigned int i = 0;
+
+	BUG_ON(vaddr & ((1 << domain->dev->pgsize_bits) - 1));
+	BUG_ON(vaddr + nr * PAGE_SIZE > vm->iovm_start + vm->iovm_length);
+	BUG_ON(vaddr < vm->iovm_start);
+	BUG_ON(vm->ops);
+
+	if (ops->map_range)
+		return ops->map_range(domain, vm, vaddr, pages, nr);
+
+	if (ops->map_large_pfn && domain->dev->large_pgsize_bits)
+		large = 1 << domain->dev->large_pgsize_bits;
+
+	while (i < nr) {
+		unsigned long pfn = page_to_pfn(pages[i]);
+		unsigned long n = large >> PAGE_SHIFT, j = 1;
+
+		if (large && !(vaddr & (large - 1)) && !(pfn & (n - 1)) &&
+		    i + n <= nr) {
+			while (j < n && page_to_pfn(pages[i + j]) == pfn + j)
+				j++;
+		}
+		if (large && j == n) {
+			ops->map_large_pfn(domain, vm, vaddr, pfn);
+		} else {
+			ops->map_pfn(domain, vm, vaddr, pfn);
+			n = 1;
+		}
+		i += n;
+		vaddr += n << PAGE_SHIFT;
+	}
+	return 0;
+}
+
+size_t tegra_iovmm_get_large_page_size(struct tegra_iovmm_client *client)
+{
+	struct tegra_iovmm_device *dev;
+
+	if (!client || !client->domain)
+		return 0;
+
+	dev = client->domain->dev;
+	if (!dev->ops->map_large_pfn || !dev->large_pgsize_bits)
+		return 0;
+	return 1 << dev->large_pgsize_bits;
+}
+
 void tegra_iovmm_zap_vm(struct tegra_iovmm_area *vm)
 {
 	struct tegra_iovmm_block *b;
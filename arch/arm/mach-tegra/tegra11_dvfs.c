@@ -28,6 +28,7 @@
 #include "board.h"
 #include "tegra_cl_dvfs.h"
 #include "tegra_core_sysfs_limits.h"
+#include "tegra_core_coord.h"
 
 static bool tegra_dvfs_cpu_disabled;
 static bool tegra_dvfs_core_disabled;
@@ -821,10 +822,44 @@ static struct core_bus_floor_table tegra11_bus_floor_table[] = {
 	},
 };
 
+/*
+ * emc enters through the display, isochronous and avp requests only: the
+ * gr3d request follows the 3d clock and would feed the cbus floors back
+ * into the voltage they are derived from. Only 3d races: it is power gated
+ * between frames, so finishing sooner at no extra voltage saves power. The
+ * video engines and avp are paced by the stream and keep their own rates.
+ */
+static struct core_coord_engine tegra11_core_coord_table[] = {
+#ifdef CONFIG_TEGRA_DUAL_CBUS
+	{ .name = "3d",    .user_name = "3d.cbus",    .coord_name = "coord.c2bus",
+	  .race = true },
+	{ .name = "2d",    .user_name = "2d.cbus",    .coord_name = "coord.c2bus" },
+	{ .name = "vde",   .user_name = "vde.cbus",   .coord_name = "coord.c3bus" },
+	{ .name = "msenc", .user_name = "msenc.cbus", .coord_name = "coord.c3bus" },
+#else
+	{ .name = "3d",    .user_name = "3d.cbus",    .coord_name = "coord.cbus",
+	  .race = true },
+	{ .name = "2d",    .user_name = "2d.cbus",    .coord_name = "coord.cbus" },
+	{ .name = "vde",   .user_name = "vde.cbus",   .coord_name = "coord.cbus" },
+	{ .name = "msenc", .user_name = "msenc.cbus", .coord_name = "coord.cbus" },
+#endif
+	{ .name = "disp1.emc", .user_name = "disp1.emc" },
+	{ .name = "disp2.emc", .user_name = "disp2.emc" },
+	{ .name = "iso.emc",   .user_name = "iso.emc" },
+	{ .name = "avp",       .user_name = "avp.sclk" },
+	{ .name = "avp.emc",   .user_name = "avp.emc" },
+};
+
 static int __init tegra11_dvfs_init_core_limits(void)
 {
 	int ret;
 
+	ret = tegra_init_core_coord(tegra11_core_coord_table,
+		ARRAY_SIZE(tegra11_core_coord_table));
+	if (ret)
+		pr_err("tegra11_dvfs: failed to init core coordinator (%d)\n",
+		       ret);
+
 	cap_kobj = kobject_create_and_add("tegra_cap", kernel_kobj);
 	if (!cap_kobj) {
 		pr_err("tegra11_dvfs: failed to create sysfs cap object\n");
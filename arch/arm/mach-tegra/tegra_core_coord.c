@@ -0,0 +1,559 @@
+/*
+ * arch/arm/mach-tegra/tegra_core_coord.c
+ *
+ * Copyright (c) 2013, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/clk.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/err.h>
+
+#include "clock.h"
+#include "dvfs.h"
+#include "tegra_core_coord.h"
+
+/*
+ * Core rail operating point coordinator
+ *
+ * The graphics, video and memory engines scale independently, and each
+ * rate change moves the core rail on its own. The coordinator samples the
+ * demand of every engine on a periodic tick, finds the lowest core voltage
+ * that runs all of them at their demand. Engines that ask for it (race)
+ * are floored to the highest rate that voltage allows: once the rail is at
+ * that level, running faster costs no extra voltage and lets them go idle
+ * sooner. Every other engine is left at its own rate. All floors are
+ * applied together, in the order that moves the rail once.
+ *
+ * Demands recorded on each tick are kept in debugfs ("demand"), and the
+ * same format written to "simulate" is run through the solver without
+ * touching any clock.
+ */
+
+#define CORE_COORD_MAX_ENGINES	12
+#define CORE_COORD_LOG_SIZE	128
+
+static DEFINE_MUTEX(coord_lock);
+/* serializes enable/disable, held across cancel_delayed_work_sync() */
+static DEFINE_MUTEX(coord_enable_lock);
+
+static struct core_coord_engine *coord_engines;
+static int coord_num;
+
+static struct delayed_work coord_work;
+static u32 coord_enable;
+static u32 coord_tick_ms = 50;
+static u32 coord_cap_mv;	/* 0 for the rail maximum */
+
+static int coord_mv;
+static unsigned long coord_demand[CORE_COORD_MAX_ENGINES];
+static unsigned long coord_floor[CORE_COORD_MAX_ENGINES];
+static unsigned long coord_applied[CORE_COORD_MAX_ENGINES];
+
+/* demand recorded on the last ticks, kHz, oldest at coord_log_pos */
+static u32 coord_log[CORE_COORD_LOG_SIZE][CORE_COORD_MAX_ENGINES];
+static int coord_log_pos;
+static int coord_log_count;
+
+struct coord_sim_result {
+	int mv;
+	u32 floor[CORE_COORD_MAX_ENGINES];
+};
+
+static struct coord_sim_result coord_sim[CORE_COORD_LOG_SIZE];
+static int coord_sim_count;
+static char coord_sim_carry[128];
+static int coord_sim_carry_len;
+
+/* Voltage the engine's bus needs to run at rate */
+static int coord_rate_mv(const struct core_coord_engine *e, unsigned long rate)
+{
+	int i;
+
+	if (!rate || !e->num_freqs)
+		return 0;
+
+	for (i = 0; i < e->num_freqs - 1; i++)
+		if (rate <= e->freqs[i])
+			break;
+
+	return e->millivolts[i];
+}
+
+/* Highest rate of the engine's bus at mv */
+static unsigned long coord_mv_rate(const struct core_coord_engine *e, int mv)
+{
+	unsigned long rate = 0;
+	int i;
+
+	for (i = 0; i < e->num_freqs; i++) {
+		if (e->millivolts[i] > mv)
+			break;
+		rate = e->freqs[i];
+	}
+
+	return rate;
+}
+
+/*
+ * The joint operating point for demand[]: the lowest voltage that runs
+ * every engine at its demand, limited to cap_mv, and the floor for each
+ * engine at that voltage. Only busy engines that race get a floor, and
+ * only when it is above their own demand; the voltage comes from demand
+ * alone, so the floor never raises it. Depends on nothing but its
+ * arguments.
+ */
+static int coord_solve(const struct core_coord_engine *engines, int n,
+	const unsigned long *demand, int cap_mv, unsigned long *floor)
+{
+	int i, mv = 0;
+
+	for (i = 0; i < n; i++)
+		mv = max(mv, coord_rate_mv(&engines[i], demand[i]));
+	if (cap_mv)
+		mv = min(mv, cap_mv);
+
+	for (i = 0; i < n; i++) {
+		const struct core_coord_engine *e = &engines[i];
+		unsigned long rate = 0;
+
+		if (e->coord_name && e->race && demand[i])
+			rate = coord_mv_rate(e, mv);
+		floor[i] = rate > demand[i] ? rate : 0;
+	}
+
+	return mv;
+}
+
+/* The first engine floored through e->coord sets it for all of them */
+static bool coord_is_owner(int i)
+{
+	int j;
+
+	if (!coord_engines[i].coord)
+		return false;
+
+	for (j = 0; j < i; j++)
+		if (coord_engines[j].coord == coord_engines[i].coord)
+			return false;
+
+	return true;
+}
+
+/*
+ * Raising floors first when the voltage goes up and lowering them first
+ * when it goes down keeps every intermediate step within the new voltage.
+ */
+static void coord_apply(const unsigned long *floor, bool raise_first)
+{
+	int pass, i, j;
+
+	for (pass = 0; pass < 2; pass++) {
+		bool raise = raise_first == (pass == 0);
+
+		for (i = 0; i < coord_num; i++) {
+			unsigned long rate = 0;
+
+			if (!coord_is_owner(i))
+				continue;
+
+			for (j = i; j < coord_num; j++)
+				if (coord_engines[j].coord ==
+				    coord_engines[i].coord)
+					rate = max(rate, floor[j]);
+
+			if (rate == coord_applied[i] ||
+			    (rate > coord_applied[i]) != raise)
+				continue;
+
+			if (!clk_set_rate(coord_engines[i].coord, rate))
+				coord_applied[i] = rate;
+		}
+	}
+}
+
+static unsigned long coord_read_demand(struct core_coord_engine *e)
+{
+	struct clk *c = e->user;
+
+	if (!c || !c->u.shared_bus_user.enabled)
+		return 0;
+
+	return ACCESS_ONCE(c->u.shared_bus_user.rate);
+}
+
+static int coord_cap(void)
+{
+	int cap = tegra_core_rail ? tegra_core_rail->max_millivolts : 0;
+
+	if (coord_cap_mv && (!cap || coord_cap_mv < cap))
+		cap = coord_cap_mv;
+
+	return cap;
+}
+
+static void coord_tick(struct work_struct *work)
+{
+	int i, mv;
+
+	mutex_lock(&coord_lock);
+
+	if (!coord_enable) {
+		mutex_unlock(&coord_lock);
+		return;
+	}
+
+	for (i = 0; i < coord_num; i++) {
+		coord_demand[i] = coord_read_demand(&coord_engines[i]);
+		coord_log[coord_log_pos][i] = coord_demand[i] / 1000;
+	}
+	coord_log_pos = (coord_log_pos + 1) % CORE_COORD_LOG_SIZE;
+	coord_log_count = min(coord_log_count + 1, CORE_COORD_LOG_SIZE);
+
+	mv = coord_solve(coord_engines, coord_num, coord_demand, coord_cap(),
+		coord_floor);
+	coord_apply(coord_floor, mv >= coord_mv);
+	coord_mv = mv;
+
+	schedule_delayed_work(&coord_work,
+		msecs_to_jiffies(max_t(u32, coord_tick_ms, 1)));
+
+	mutex_unlock(&coord_lock);
+}
+
+static void coord_start(void)
+{
+	int i;
+
+	for (i = 0; i < coord_num; i++)
+		if (coord_is_owner(i))
+			clk_prepare_enable(coord_engines[i].coord);
+
+	coord_mv = 0;
+	schedule_delayed_work(&coord_work, 0);
+}
+
+static void coord_stop(void)
+{
+	unsigned long floor[CORE_COORD_MAX_ENGINES] = { 0 };
+	int i;
+
+	coord_apply(floor, false);
+
+	for (i = 0; i < coord_num; i++)
+		if (coord_is_owner(i))
+			clk_disable_unprepare(coord_engines[i].coord);
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+static int coord_enable_get(void *data, u64 *val)
+{
+	*val = coord_enable;
+	return 0;
+}
+
+/*
+ * coord_tick() takes coord_lock, so it cannot be held across the cancel;
+ * coord_enable_lock keeps a concurrent enable from starting the work
+ * between the cancel and coord_stop().
+ */
+static int coord_enable_set(void *data, u64 val)
+{
+	mutex_lock(&coord_enable_lock);
+
+	mutex_lock(&coord_lock);
+	if (!val == !coord_enable) {
+		mutex_unlock(&coord_lock);
+		goto out;
+	}
+	coord_enable = !!val;
+	if (coord_enable)
+		coord_start();
+	mutex_unlock(&coord_lock);
+
+	if (!coord_enable) {
+		cancel_delayed_work_sync(&coord_work);
+
+		mutex_lock(&coord_lock);
+		coord_stop();
+		mutex_unlock(&coord_lock);
+	}
+out:
+	mutex_unlock(&coord_enable_lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(coord_enable_fops,
+	coord_enable_get, coord_enable_set, "%llu\n");
+
+static int coord_state_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	mutex_lock(&coord_lock);
+	seq_printf(s, "core %d mV\n", coord_mv);
+	for (i = 0; i < coord_num; i++) {
+		struct core_coord_engine *e = &coord_engines[i];
+
+		seq_printf(s, "%-10s demand %9lu kHz %4d mV  floor %9lu kHz\n",
+			e->name, coord_demand[i] / 1000,
+			coord_rate_mv(e, coord_demand[i]),
+			coord_floor[i] / 1000);
+	}
+	mutex_unlock(&coord_lock);
+
+	return 0;
+}
+
+static int coord_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, coord_state_show, inode->i_private);
+}
+
+static const struct file_operations coord_state_fops = {
+	.open		= coord_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void coord_show_names(struct seq_file *s, const char *first)
+{
+	int i;
+
+	seq_printf(s, "# %s", first);
+	for (i = 0; i < coord_num; i++)
+		seq_printf(s, " %s", coord_engines[i].name);
+	seq_printf(s, "\n");
+}
+
+static int coord_demand_show(struct seq_file *s, void *data)
+{
+	int i, j;
+
+	mutex_lock(&coord_lock);
+	coord_show_names(s, "kHz:");
+	for (i = 0; i < coord_log_count; i++) {
+		int pos = (coord_log_pos - coord_log_count + i +
+			   CORE_COORD_LOG_SIZE) % CORE_COORD_LOG_SIZE;
+
+		for (j = 0; j < coord_num; j++)
+			seq_printf(s, j ? " %u" : "%u", coord_log[pos][j]);
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&coord_lock);
+
+	return 0;
+}
+
+static int coord_demand_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, coord_demand_show, inode->i_private);
+}
+
+static const struct file_operations coord_demand_fops = {
+	.open		= coord_demand_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int coord_sim_show(struct seq_file *s, void *data)
+{
+	int i, j;
+
+	mutex_lock(&coord_lock);
+	coord_show_names(s, "mV, floor kHz:");
+	for (i = 0; i < coord_sim_count; i++) {
+		seq_printf(s, "%d", coord_sim[i].mv);
+		for (j = 0; j < coord_num; j++)
+			seq_printf(s, " %u", coord_sim[i].floor[j]);
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&coord_lock);
+
+	return 0;
+}
+
+static int coord_sim_open(struct inode *inode, struct file *file)
+{
+	if ((file->f_mode & FMODE_WRITE) && (file->f_flags & O_TRUNC)) {
+		mutex_lock(&coord_lock);
+		coord_sim_count = 0;
+		coord_sim_carry_len = 0;
+		mutex_unlock(&coord_lock);
+	}
+
+	return single_open(file, coord_sim_show, inode->i_private);
+}
+
+/* Run one line of recorded demand, in kHz per engine, through the solver */
+static void coord_sim_line(char *line)
+{
+	unsigned long demand[CORE_COORD_MAX_ENGINES] = { 0 };
+	unsigned long floor[CORE_COORD_MAX_ENGINES];
+	struct coord_sim_result *r;
+	char *p = skip_spaces(line);
+	int i;
+
+	if (!*p || *p == '#' || coord_sim_count == CORE_COORD_LOG_SIZE)
+		return;
+
+	for (i = 0; i < coord_num && *p; i++) {
+		demand[i] = simple_strtoul(p, &p, 10) * 1000;
+		p = skip_spaces(p);
+	}
+
+	r = &coord_sim[coord_sim_count++];
+	r->mv = coord_solve(coord_engines, coord_num, demand, coord_cap(),
+		floor);
+	for (i = 0; i < coord_num; i++)
+		r->floor[i] = floor[i] / 1000;
+}
+
+static ssize_t coord_sim_write(struct file *file, const char __user *userbuf,
+	size_t count, loff_t *ppos)
+{
+	char buf[256];
+	size_t done = 0;
+
+	mutex_lock(&coord_lock);
+	while (done < count) {
+		size_t len = min(count - done,
+			sizeof(buf) - 1 - coord_sim_carry_len);
+		char *line, *nl;
+
+		memcpy(buf, coord_sim_carry, coord_sim_carry_len);
+		if (copy_from_user(buf + coord_sim_carry_len,
+				   userbuf + done, len)) {
+			mutex_unlock(&coord_lock);
+			return -EFAULT;
+		}
+		done += len;
+		len += coord_sim_carry_len;
+		buf[len] = '\0';
+
+		line = buf;
+		while ((nl = strchr(line, '\n'))) {
+			*nl = '\0';
+			coord_sim_line(line);
+			line = nl + 1;
+		}
+
+		/* keep a partial line for the next write */
+		coord_sim_carry_len = min_t(size_t, strlen(line),
+			sizeof(coord_sim_carry) - 1);
+		memcpy(coord_sim_carry, line, coord_sim_carry_len);
+	}
+	mutex_unlock(&coord_lock);
+
+	return count;
+}
+
+static const struct file_operations coord_sim_fops = {
+	.open		= coord_sim_open,
+	.read		= seq_read,
+	.write		= coord_sim_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init coord_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tegra_core_coord", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("enable", S_IRUGO | S_IWUSR, dir, NULL,
+				 &coord_enable_fops) ||
+	    !debugfs_create_u32("tick_ms", S_IRUGO | S_IWUSR, dir,
+				&coord_tick_ms) ||
+	    !debugfs_create_u32("cap_mv", S_IRUGO | S_IWUSR, dir,
+				&coord_cap_mv) ||
+	    !debugfs_create_file("state", S_IRUGO, dir, NULL,
+				 &coord_state_fops) ||
+	    !debugfs_create_file("demand", S_IRUGO, dir, NULL,
+				 &coord_demand_fops) ||
+	    !debugfs_create_file("simulate", S_IRUGO | S_IWUSR, dir, NULL,
+				 &coord_sim_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+#else
+static inline int coord_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+static void __init init_core_coord_one(struct core_coord_engine *e)
+{
+	struct clk *bus;
+	struct dvfs *d;
+	int i;
+
+	e->user = tegra_get_clock_by_name(e->user_name);
+	if (!e->user || !e->user->parent) {
+		pr_err("%s: no %s clock\n", __func__, e->user_name);
+		e->user = NULL;
+		return;
+	}
+
+	bus = e->user->parent;
+	d = bus->dvfs;
+	if (!d || d->alt_freqs || !d->millivolts) {
+		pr_err("%s: no dvfs table for %s\n", __func__, bus->name);
+		return;
+	}
+
+	for (i = 0; i < d->num_freqs; i++) {
+		e->freqs[i] = d->freqs[i];
+		e->millivolts[i] = d->millivolts[i];
+	}
+	e->num_freqs = d->num_freqs;
+
+	if (e->coord_name) {
+		e->coord = tegra_get_clock_by_name(e->coord_name);
+		if (!e->coord)
+			pr_err("%s: no %s clock\n", __func__, e->coord_name);
+	}
+}
+
+int __init tegra_init_core_coord(struct core_coord_engine *table,
+	int table_size)
+{
+	int i;
+
+	if (!table || !table_size || table_size > CORE_COORD_MAX_ENGINES)
+		return -EINVAL;
+
+	for (i = 0; i < table_size; i++)
+		init_core_coord_one(&table[i]);
+
+	INIT_DELAYED_WORK(&coord_work, coord_tick);
+	coord_engines = table;
+	coord_num = table_size;
+
+	return coord_debugfs_init();
+}
@@ -0,0 +1,49 @@
+/*
+ * arch/arm/mach-tegra/tegra_core_coord.h
+ *
+ * Copyright (c) 2013, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _MACH_TEGRA_CORE_COORD_H_
+#define _MACH_TEGRA_CORE_COORD_H_
+
+/*
+ * An engine on the core rail. Its demand is the rate requested through
+ * its shared bus user clock, and every engine adds to the joint core
+ * voltage. Engines with race set and a coordinator user on their bus are
+ * floored to the highest rate that voltage allows while busy; the others
+ * stay at their own rate.
+ */
+struct core_coord_engine {
+	const char *name;
+	const char *user_name;
+	const char *coord_name;
+	bool race;
+
+	/* filled in by tegra_init_core_coord() */
+	struct clk *user;
+	struct clk *coord;
+	int num_freqs;
+	unsigned long freqs[MAX_DVFS_FREQS];
+	int millivolts[MAX_DVFS_FREQS];
+};
+
+#ifdef CONFIG_TEGRA_CORE_COORD
+int tegra_init_core_coord(struct core_coord_engine *table, int table_size);
+#else
+static inline int tegra_init_core_coord(struct core_coord_engine *table,
+					int table_size)
+{ return 0; }
+#endif
+
+#endif /* _MACH_TEGRA_CORE_COORD_H_ */
@@ -28,6 +28,11 @@
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/math64.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_interactive.h>
 
 #include <asm/cputime.h>
 
@@ -46,8 +51,16 @@ struct cpufreq_interactive_cpuinfo {
 	u64 last_high_freq_time;
 	struct cpufreq_policy *policy;
 	struct cpufreq_frequency_table *freq_table;
+	spinlock_t target_freq_lock; /* protects target_freq */
 	unsigned int target_freq;
+	/* held for writing while policy and freq_table change */
+	struct rw_semaphore enable_sem;
 	int governor_enabled;
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+	atomic_t hint_freq; /* highest hint since the last speed change */
+	int hint_pending; /* hint raised target_freq, speed not set yet */
+	u64 hint_clock;
+#endif
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -113,6 +126,11 @@ static unsigned long midrange_freq;
 static unsigned long midrange_go_maxspeed_load;
 static unsigned long midrange_max_boost;
 
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+/* Honour the frequency hints of waking tasks */
+static unsigned long task_hints = 1;
+#endif
+
 /*
  * gov_state_lock protects interactive node creation in governor start/stop.
  */
@@ -276,8 +294,11 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	new_freq = pcpu->freq_table[index].frequency;
 
-	if (pcpu->target_freq == new_freq)
+	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
+	if (pcpu->target_freq == new_freq) {
+		spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
 		goto rearm_if_notmax;
+	}
 
 	/*
 	 * Do not scale down unless we have been at this frequency for the
@@ -285,8 +306,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 */
 	if (new_freq < pcpu->target_freq) {
 		if (pcpu->timer_run_time - pcpu->freq_change_time
-		    < min_sample_time)
+		    < min_sample_time) {
+			spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
+			goto rearm;
+		}
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+		/* nor before a hinted raise has even been applied */
+		if (pcpu->hint_pending) {
+			spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
 			goto rearm;
+		}
+#endif
 	}
 
 	/*
@@ -304,6 +334,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	}
 
 	pcpu->target_freq = new_freq;
+	spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
 	cpumask_set_cpu(data, &speedchange_cpumask);
 	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
@@ -438,6 +469,98 @@ static void cpufreq_interactive_idle_end(void)
 
 }
 
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+/*
+ * Checks a hint passed to PR_SET_CPUFREQ_HINT: 0, or a rate no CPU's
+ * hardware maximum is below. Thermal and user caps are left to
+ * cpufreq_interactive_apply_hint(), since they change under the task.
+ */
+int cpufreq_interactive_check_hint(unsigned long khz)
+{
+	struct cpufreq_policy *policy;
+	unsigned int max_freq = 0;
+	int cpu;
+
+	if (!khz)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+		max_freq = max(max_freq, policy->cpuinfo.max_freq);
+		cpufreq_cpu_put(policy);
+	}
+
+	return khz <= max_freq ? 0 : -EINVAL;
+}
+
+/*
+ * Called by the scheduler once p has been woken up to run on cpu, with
+ * no scheduler locks held. Only records the task's hint for cpu and kicks
+ * the speed change thread, which applies it under enable_sem; the usual
+ * min_sample_time then holds the raised speed before it may drop.
+ */
+void cpufreq_interactive_task_wakeup(struct task_struct *p, int cpu)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned int hint = ACCESS_ONCE(p->cpufreq_hint);
+	unsigned int old;
+	unsigned long flags;
+
+	if (!task_hints || !pcpu->governor_enabled)
+		return;
+
+	if (hint <= ACCESS_ONCE(pcpu->target_freq))
+		return;
+
+	do {
+		old = atomic_read(&pcpu->hint_freq);
+		if (hint <= old)
+			return;
+	} while (atomic_cmpxchg(&pcpu->hint_freq, old, hint) != old);
+
+	if (!old)
+		pcpu->hint_clock = local_clock();
+
+	trace_cpufreq_interactive_hint(cpu, p->pid,
+				       ACCESS_ONCE(pcpu->target_freq), hint);
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+	wake_up_process(speedchange_task);
+}
+
+/*
+ * Raises target_freq of pcpu to the table step at or above the hint
+ * recorded for it, if any. Called with enable_sem held for reading.
+ */
+static void cpufreq_interactive_apply_hint(
+	struct cpufreq_interactive_cpuinfo *pcpu)
+{
+	unsigned int hint = atomic_xchg(&pcpu->hint_freq, 0);
+	unsigned int index;
+	unsigned long flags;
+
+	if (!hint)
+		return;
+
+	hint = min(hint, pcpu->policy->max);
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   hint, CPUFREQ_RELATION_L, &index))
+		return;
+	hint = pcpu->freq_table[index].frequency;
+
+	spin_lock_irqsave(&pcpu->target_freq_lock, flags);
+	if (hint > pcpu->target_freq) {
+		pcpu->target_freq = hint;
+		pcpu->hint_pending = 1;
+	}
+	spin_unlock_irqrestore(&pcpu->target_freq_lock, flags);
+}
+#endif
+
 static int cpufreq_interactive_speedchange_task(void *data)
 {
 	unsigned int cpu;
@@ -470,10 +593,16 @@ static int cpufreq_interactive_speedchange_task(void *data)
 			unsigned int max_freq = 0;
 
 			pcpu = &per_cpu(cpuinfo, cpu);
-			smp_rmb();
-
-			if (!pcpu->governor_enabled)
+			if (!down_read_trylock(&pcpu->enable_sem))
 				continue;
+			if (!pcpu->governor_enabled) {
+				up_read(&pcpu->enable_sem);
+				continue;
+			}
+
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+			cpufreq_interactive_apply_hint(pcpu);
+#endif
 
 			for_each_cpu(j, pcpu->policy->cpus) {
 				struct cpufreq_interactive_cpuinfo *pjcpu =
@@ -492,6 +621,21 @@ static int cpufreq_interactive_speedchange_task(void *data)
 						     &pcpu->freq_change_time);
 			pcpu->freq_change_time_in_iowait =
 				get_cpu_iowait_time(cpu, NULL);
+
+			trace_cpufreq_interactive_setspeed(cpu, max_freq,
+							   pcpu->policy->cur);
+
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+			if (pcpu->hint_pending) {
+				pcpu->hint_pending = 0;
+				trace_cpufreq_interactive_hint_done(cpu,
+					max_freq, pcpu->policy->cur,
+					div_u64(local_clock() -
+						pcpu->hint_clock,
+						NSEC_PER_USEC));
+			}
+#endif
+			up_read(&pcpu->enable_sem);
 		}
 	}
 
@@ -533,6 +677,9 @@ DECL_CPUFREQ_INTERACTIVE_ATTR(min_sample_time)
 DECL_CPUFREQ_INTERACTIVE_ATTR(timer_rate)
 DECL_CPUFREQ_INTERACTIVE_ATTR(high_freq_min_delay)
 DECL_CPUFREQ_INTERACTIVE_ATTR(max_normal_freq)
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+DECL_CPUFREQ_INTERACTIVE_ATTR(task_hints)
+#endif
 
 #undef DECL_CPUFREQ_INTERACTIVE_ATTR
 
@@ -549,6 +696,9 @@ static struct attribute *interactive_attributes[] = {
 	&timer_rate_attr.attr,
 	&high_freq_min_delay_attr.attr,
 	&max_normal_freq_attr.attr,
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+	&task_hints_attr.attr,
+#endif
 	NULL,
 };
 
@@ -595,6 +745,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
+			down_write(&pcpu->enable_sem);
 			pcpu->policy = policy;
 			pcpu->target_freq = policy->cur;
 			pcpu->freq_table = freq_table;
@@ -609,8 +760,13 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			if (!pcpu->last_high_freq_time)
 				pcpu->last_high_freq_time = pcpu->freq_change_time;
 			pcpu->timer_idlecancel = 1;
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+			atomic_set(&pcpu->hint_freq, 0);
+			pcpu->hint_pending = 0;
+#endif
 			pcpu->governor_enabled = 1;
 			smp_wmb();
+			up_write(&pcpu->enable_sem);
 
 			if (!timer_pending(&pcpu->cpu_timer))
 				mod_timer(&pcpu->cpu_timer, jiffies + 2);
@@ -640,8 +796,10 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 	case CPUFREQ_GOV_STOP:
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
+			down_write(&pcpu->enable_sem);
 			pcpu->governor_enabled = 0;
 			smp_wmb();
+			up_write(&pcpu->enable_sem);
 			del_timer_sync(&pcpu->cpu_timer);
 
 			/*
@@ -705,6 +863,8 @@ static int __init cpufreq_interactive_init(void)
 		init_timer(&pcpu->cpu_timer);
 		pcpu->cpu_timer.function = cpufreq_interactive_timer;
 		pcpu->cpu_timer.data = i;
+		spin_lock_init(&pcpu->target_freq_lock);
+		init_rwsem(&pcpu->enable_sem);
 	}
 
 	spin_lock_init(&speedchange_cpumask_lock);
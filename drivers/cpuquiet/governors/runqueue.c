@@ -0,0 +1,869 @@
+/*
+ * Copyright (c) 2013 NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuquiet.h>
+#include <linux/cpumask.h>
+#include <linux/module.h>
+#include <linux/pm_qos.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/jump_label.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/math64.h>
+
+/*
+ * Runqueue event driven core hotplug
+ *
+ * Every tick on a cpu with a thread waiting on its runqueue is reported
+ * by the scheduler. Such a cpu is busy, so its tick keeps running under
+ * NO_HZ. When there are more runnable threads than online cpus, as many
+ * cores as the threads can use are requested at once. The report is
+ * behind a static key that is only enabled while this governor runs.
+ *
+ * Only the way down is sampled. Every sample_rate ms the average number
+ * of runnable threads and the idle residency of each core are updated.
+ * The most idle core goes down once, for down_delay ms in a row, the
+ * threads fitted on one core less and that core was idle for at least
+ * idle_residency percent of the time.
+ *
+ * Samples and decisions are kept in debugfs ("trace"). Lines starting
+ * with "<msec> <runnable threads>", such as the recorded ones, written to
+ * "replay" are run through models of this governor and of the runnable
+ * and balanced governors; reading "replay" compares the thread time spent
+ * waiting for an offline core, the average number of cores online and the
+ * number of hotplug requests. The models step through every millisecond,
+ * so a replay is limited to RUNQUEUE_REPLAY_SPAN_MS from its first line.
+ *
+ * Changes to the min and max online cpus PM QoS limits re-arm the sampler
+ * and serve any up request right away instead of waiting for the next
+ * tick or sample.
+ */
+
+typedef enum {
+	DISABLED,
+	IDLE,
+	RUNNING,
+} RUNQUEUE_STATE;
+
+#define NR_FSHIFT_EXP	3
+#define NR_FSHIFT	(1 << NR_FSHIFT_EXP)
+
+/* EXP = alpha in the exponential moving average.
+ * Alpha = e ^ (-sample_rate / window_size) * FIXED_1
+ * Calculated for sample_rate of 20ms, window size of 100ms
+ */
+#define EXP    1677
+
+#define RUNQUEUE_LOG_SIZE	256
+#define RUNQUEUE_REPLAY_SIZE	1024
+#define RUNQUEUE_REPLAY_SPAN_MS	(10 * 60 * MSEC_PER_SEC)
+
+static struct work_struct runqueue_work;
+static struct workqueue_struct *runqueue_wq;
+static struct kobject *runqueue_kobject;
+static struct timer_list runqueue_timer;
+
+static RUNQUEUE_STATE runqueue_state;
+static unsigned int runqueue_down_cpu;
+
+/* configurable parameters */
+static unsigned int sample_rate = 20;		/* msec */
+static unsigned int down_delay = 500;		/* msec */
+static unsigned int idle_residency = 50;	/* percent */
+static unsigned int nr_run_slack = 2;		/* 1 / 8 thread */
+
+static DEFINE_MUTEX(runqueue_lock);
+
+struct runqueue_model {
+	unsigned int avg;	/* runnable threads, FSHIFT fixed point */
+	unsigned int down_ms;	/* time a core could have gone down */
+};
+
+static struct runqueue_model runqueue_live;
+
+struct runqueue_sample {
+	bool valid;
+	u64 integral;
+	u64 timestamp;
+	u64 idle;
+	u64 wall;
+};
+
+static DEFINE_PER_CPU(struct runqueue_sample, runqueue_samples);
+
+/* Cores to add with nr_run runnable threads and online cpus up */
+static unsigned int runqueue_up(unsigned int nr_run, unsigned int online,
+	unsigned int min_cpus, unsigned int max_cpus)
+{
+	unsigned int want = max(min(nr_run, max_cpus), min_cpus);
+
+	return want > online ? want - online : 0;
+}
+
+/*
+ * Accounts elapsed_ms with nr_run (FSHIFT fixed point) runnable threads
+ * on average, idle the highest idle residency of a core that may go down.
+ * Returns true when that core should go down.
+ */
+static bool runqueue_down(struct runqueue_model *m, unsigned int nr_run,
+	unsigned int idle, unsigned int online, unsigned int min_cpus,
+	unsigned int max_cpus, unsigned int elapsed_ms)
+{
+	unsigned int fits = ((online - 1) << FSHIFT) +
+		(nr_run_slack << (FSHIFT - NR_FSHIFT_EXP));
+
+	m->avg = (m->avg * EXP + nr_run * (FIXED_1 - EXP)) >> FSHIFT;
+
+	if (online > max_cpus) {
+		m->down_ms = 0;
+		return true;
+	}
+
+	if (online <= max(min_cpus, 1U) || idle < idle_residency ||
+	    m->avg > fits) {
+		m->down_ms = 0;
+		return false;
+	}
+
+	m->down_ms += elapsed_ms;
+	if (m->down_ms < down_delay)
+		return false;
+
+	m->down_ms = 0;
+	return true;
+}
+
+static unsigned int runqueue_max_cpus(void)
+{
+	return pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : num_possible_cpus();
+}
+
+#ifdef CONFIG_DEBUG_FS
+struct runqueue_event {
+	u32 msec;
+	u8 nr_run;
+	u8 online;
+	u8 idle;
+	char action;
+};
+
+static DEFINE_SPINLOCK(runqueue_log_lock);
+static struct runqueue_event runqueue_log[RUNQUEUE_LOG_SIZE];
+static int runqueue_log_pos;
+static int runqueue_log_count;
+
+/* 'u' up request, 'd' down request, 's' sample */
+static void runqueue_log_event(unsigned int nr_run, unsigned int idle,
+	char action)
+{
+	struct runqueue_event *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&runqueue_log_lock, flags);
+	e = &runqueue_log[runqueue_log_pos];
+	e->msec = jiffies_to_msecs(jiffies);
+	e->nr_run = min(nr_run, 255U);
+	e->online = num_online_cpus();
+	e->idle = idle;
+	e->action = action;
+	runqueue_log_pos = (runqueue_log_pos + 1) % RUNQUEUE_LOG_SIZE;
+	if (runqueue_log_count < RUNQUEUE_LOG_SIZE)
+		runqueue_log_count++;
+	spin_unlock_irqrestore(&runqueue_log_lock, flags);
+}
+#else
+static inline void runqueue_log_event(unsigned int nr_run, unsigned int idle,
+	char action)
+{
+}
+#endif
+
+struct static_key cpuquiet_runqueue_enabled = STATIC_KEY_INIT_FALSE;
+
+/* Called from scheduler_tick() with interrupts off, no runqueue lock held */
+void cpuquiet_runqueue_tick(unsigned int cpu, unsigned int nr_queued)
+{
+	unsigned int nr_run;
+
+	rmb();
+	if (runqueue_state != RUNNING)
+		return;
+
+	nr_run = nr_running();
+	if (runqueue_up(nr_run, num_online_cpus(),
+			pm_qos_request(PM_QOS_MIN_ONLINE_CPUS),
+			runqueue_max_cpus())) {
+		runqueue_log_event(nr_run, 0, 'u');
+		queue_work(runqueue_wq, &runqueue_work);
+	}
+}
+
+static void runqueue_sampler(unsigned long data)
+{
+	struct runqueue_sample *s;
+	unsigned int cpu, nr_run = 0, idle = 0, idle_cpu = nr_cpu_ids;
+	unsigned int online = num_online_cpus();
+	unsigned int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
+	unsigned int max_cpus = runqueue_max_cpus();
+	u64 integral, now, idle_us, wall_us;
+
+	rmb();
+	if (runqueue_state != RUNNING)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		s = &per_cpu(runqueue_samples, cpu);
+		if (!cpu_online(cpu)) {
+			s->valid = false;
+			continue;
+		}
+
+		integral = nr_running_integral(cpu);
+		now = ktime_to_ns(ktime_get());
+		idle_us = get_cpu_idle_time_us(cpu, &wall_us);
+
+		if (s->valid && now > s->timestamp) {
+			nr_run += div64_u64(integral - s->integral,
+					    now - s->timestamp);
+			/* cpu0 never goes down */
+			if (cpu > 0 && idle_us != -1ULL &&
+			    wall_us > s->wall) {
+				unsigned int pct = div64_u64(
+					(idle_us - s->idle) * 100,
+					wall_us - s->wall);
+				if (pct >= idle) {
+					idle = pct;
+					idle_cpu = cpu;
+				}
+			}
+		}
+
+		s->valid = true;
+		s->integral = integral;
+		s->timestamp = now;
+		s->idle = idle_us;
+		s->wall = wall_us;
+	}
+
+	if (runqueue_down(&runqueue_live, nr_run, idle, online, min_cpus,
+			  max_cpus, sample_rate) && idle_cpu < nr_cpu_ids) {
+		runqueue_down_cpu = idle_cpu;
+		runqueue_log_event(nr_running(), idle, 'd');
+		queue_work(runqueue_wq, &runqueue_work);
+	} else {
+		runqueue_log_event(nr_running(), idle, 's');
+	}
+
+	/* nothing to take down, the next up request restarts sampling */
+	if (online > max(min_cpus, 1U))
+		mod_timer(&runqueue_timer,
+			  jiffies + msecs_to_jiffies(sample_rate));
+}
+
+static void runqueue_work_func(struct work_struct *work)
+{
+	unsigned int cpu, up;
+
+	if (runqueue_state != RUNNING)
+		return;
+
+	up = runqueue_up(nr_running(), num_online_cpus(),
+			 pm_qos_request(PM_QOS_MIN_ONLINE_CPUS),
+			 runqueue_max_cpus());
+	if (up) {
+		runqueue_down_cpu = nr_cpu_ids;
+		runqueue_live.down_ms = 0;
+
+		for_each_cpu_not(cpu, cpu_online_mask) {
+			if (cpu >= nr_cpu_ids || !up)
+				break;
+			if (!cpuquiet_wake_cpu(cpu, false))
+				up--;
+		}
+
+		if (!timer_pending(&runqueue_timer))
+			mod_timer(&runqueue_timer,
+				  jiffies + msecs_to_jiffies(sample_rate));
+		return;
+	}
+
+	cpu = xchg(&runqueue_down_cpu, nr_cpu_ids);
+	if (cpu < nr_cpu_ids && cpu_online(cpu))
+		cpuquiet_quiesence_cpu(cpu, false);
+}
+
+#ifdef CONFIG_DEBUG_FS
+struct runqueue_replay_line {
+	u32 msec;
+	u32 nr_run;
+};
+
+static struct runqueue_replay_line runqueue_replay[RUNQUEUE_REPLAY_SIZE];
+static int runqueue_replay_count;
+static char runqueue_replay_carry[64];
+static int runqueue_replay_carry_len;
+
+struct runqueue_replay_result {
+	const char *name;
+	unsigned int online;
+	unsigned int changes;
+	u64 wait_ms;		/* thread time waiting for an offline core */
+	u64 core_ms;
+};
+
+static void replay_account(struct runqueue_replay_result *r,
+	unsigned int nr_run, unsigned int max_cpus)
+{
+	unsigned int want = min(nr_run, max_cpus);
+
+	if (want > r->online)
+		r->wait_ms += want - r->online;
+	r->core_ms += r->online;
+}
+
+/* This governor, with the up request served a tick after the event */
+static void replay_runqueue(struct runqueue_replay_result *r,
+	unsigned int max_cpus)
+{
+	struct runqueue_model m = { 0 };
+	unsigned int t, i = 0, nr_run = 0, tick_ms = jiffies_to_msecs(1);
+	unsigned int end = runqueue_replay[runqueue_replay_count - 1].msec;
+	unsigned int up_at = 0, up_pending = 0;
+	unsigned int win_ms = 0, win_sum = 0, win_idle = 0;
+
+	for (t = runqueue_replay[0].msec; t <= end; t++) {
+		/* runs under runqueue_lock for up to the whole span */
+		cond_resched();
+
+		while (i < runqueue_replay_count &&
+		       runqueue_replay[i].msec <= t)
+			nr_run = runqueue_replay[i++].nr_run;
+
+		if (!up_pending && runqueue_up(nr_run, r->online, 1, max_cpus)) {
+			up_pending = 1;
+			up_at = t + tick_ms;
+		}
+		if (up_pending && t >= up_at) {
+			up_pending = 0;
+			if (runqueue_up(nr_run, r->online, 1, max_cpus)) {
+				r->online += runqueue_up(nr_run, r->online, 1,
+							 max_cpus);
+				r->changes++;
+				m.down_ms = 0;
+			}
+		}
+
+		replay_account(r, nr_run, max_cpus);
+
+		win_sum += nr_run;
+		if (nr_run < r->online)
+			win_idle++;
+		if (++win_ms < sample_rate)
+			continue;
+
+		if (runqueue_down(&m, (win_sum << FSHIFT) / win_ms,
+				  win_idle * 100 / win_ms, r->online, 1,
+				  max_cpus, win_ms)) {
+			r->online--;
+			r->changes++;
+		}
+		win_ms = win_sum = win_idle = 0;
+	}
+}
+
+/* The runnable governor: 20 ms samples, one core at a time */
+static void replay_runnable(struct runqueue_replay_result *r,
+	unsigned int max_cpus)
+{
+	static const unsigned int thresholds[] = { 10, 18, 20 };
+	unsigned int t, i = 0, nr_run = 0, avg = 0, nr_run_last = 0, n;
+	unsigned int end = runqueue_replay[runqueue_replay_count - 1].msec;
+	unsigned int win_ms = 0, win_sum = 0;
+
+	for (t = runqueue_replay[0].msec; t <= end; t++) {
+		/* runs under runqueue_lock for up to the whole span */
+		cond_resched();
+
+		while (i < runqueue_replay_count &&
+		       runqueue_replay[i].msec <= t)
+			nr_run = runqueue_replay[i++].nr_run;
+
+		replay_account(r, nr_run, max_cpus);
+
+		win_sum += nr_run;
+		if (++win_ms < 20)
+			continue;
+
+		avg = (avg * EXP + ((win_sum << FSHIFT) / win_ms) *
+			(FIXED_1 - EXP)) >> FSHIFT;
+		win_ms = win_sum = 0;
+
+		for (n = 1; n <= ARRAY_SIZE(thresholds); n++) {
+			unsigned int threshold = thresholds[n - 1];
+			if (nr_run_last <= n)
+				threshold += NR_FSHIFT / 2;
+			if (avg <= (threshold << (FSHIFT - NR_FSHIFT_EXP)))
+				break;
+		}
+		nr_run_last = n;
+
+		if (r->online > max_cpus || (n < r->online && r->online > 1)) {
+			r->online--;
+			r->changes++;
+		} else if (n > r->online) {
+			r->online++;
+			r->changes++;
+		}
+	}
+}
+
+/*
+ * The balanced governor in its UP state, that is with the cpu clock above
+ * idle_top_freq: 100 ms up_delay, 2 s down_delay, default profile.
+ */
+static void replay_balanced(struct runqueue_replay_result *r,
+	unsigned int max_cpus)
+{
+	static const unsigned int thresholds[] = { 5, 9, 10 };
+	unsigned int t, i = 0, nr_run = 0, nr_run_last = 0, n, slow;
+	unsigned int end = runqueue_replay[runqueue_replay_count - 1].msec;
+	unsigned int last_change = runqueue_replay[0].msec;
+	unsigned int win_ms = 0, win_sum = 0, win_idle_cores = 0, avg;
+
+	for (t = runqueue_replay[0].msec; t <= end; t++) {
+		/* runs under runqueue_lock for up to the whole span */
+		cond_resched();
+
+		while (i < runqueue_replay_count &&
+		       runqueue_replay[i].msec <= t)
+			nr_run = runqueue_replay[i++].nr_run;
+
+		replay_account(r, nr_run, max_cpus);
+
+		win_sum += nr_run;
+		if (nr_run < r->online)
+			win_idle_cores += r->online - nr_run;
+		if (++win_ms < 100)
+			continue;
+
+		avg = (win_sum << FSHIFT) / win_ms;
+		slow = win_idle_cores / win_ms;
+		win_ms = win_sum = win_idle_cores = 0;
+
+		for (n = 1; n <= ARRAY_SIZE(thresholds); n++) {
+			unsigned int threshold = thresholds[n - 1];
+			if (nr_run_last <= n)
+				threshold += 2;
+			if (avg <= (threshold << (FSHIFT - 2)))
+				break;
+		}
+		nr_run_last = n;
+
+		if (slow >= 2 || r->online > max_cpus || n < r->online) {
+			if (r->online > 1 && t - last_change >= 2000) {
+				r->online--;
+				r->changes++;
+				last_change = t;
+			}
+		} else if (!slow && r->online < max_cpus && n > r->online) {
+			r->online++;
+			r->changes++;
+			last_change = t;
+		}
+	}
+}
+
+static int runqueue_replay_show(struct seq_file *s, void *data)
+{
+	struct runqueue_replay_result results[] = {
+		{ .name = "runqueue" },
+		{ .name = "runnable" },
+		{ .name = "balanced" },
+	};
+	unsigned int max_cpus = num_possible_cpus();
+	u64 total;
+	int i;
+
+	mutex_lock(&runqueue_lock);
+	if (runqueue_replay_count < 2) {
+		mutex_unlock(&runqueue_lock);
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(results); i++)
+		results[i].online = 1;
+
+	replay_runqueue(&results[0], max_cpus);
+	replay_runnable(&results[1], max_cpus);
+	replay_balanced(&results[2], max_cpus);
+
+	total = runqueue_replay[runqueue_replay_count - 1].msec -
+		runqueue_replay[0].msec + 1;
+
+	seq_printf(s, "%d lines, %llu ms, %u cpus\n", runqueue_replay_count,
+		   total, max_cpus);
+	seq_printf(s, "%-10s %10s %7s %8s\n", "governor", "wait_ms",
+		   "cores", "changes");
+	for (i = 0; i < ARRAY_SIZE(results); i++) {
+		u32 cores = div64_u64(results[i].core_ms * 100, total);
+
+		seq_printf(s, "%-10s %10llu %4u.%02u %8u\n", results[i].name,
+			   results[i].wait_ms, cores / 100, cores % 100,
+			   results[i].changes);
+	}
+	mutex_unlock(&runqueue_lock);
+
+	return 0;
+}
+
+static int runqueue_replay_open(struct inode *inode, struct file *file)
+{
+	if ((file->f_mode & FMODE_WRITE) && (file->f_flags & O_TRUNC)) {
+		mutex_lock(&runqueue_lock);
+		runqueue_replay_count = 0;
+		runqueue_replay_carry_len = 0;
+		mutex_unlock(&runqueue_lock);
+	}
+
+	return single_open(file, runqueue_replay_show, inode->i_private);
+}
+
+/* Takes "<msec> <runnable threads>", anything after is ignored */
+static void runqueue_replay_line(char *line)
+{
+	struct runqueue_replay_line *l;
+	char *p = skip_spaces(line);
+	unsigned long msec;
+
+	if (!*p || *p == '#' || runqueue_replay_count == RUNQUEUE_REPLAY_SIZE)
+		return;
+
+	msec = simple_strtoul(p, &p, 10);
+	if (runqueue_replay_count &&
+	    (msec < runqueue_replay[runqueue_replay_count - 1].msec ||
+	     msec - runqueue_replay[0].msec >= RUNQUEUE_REPLAY_SPAN_MS))
+		return;
+
+	l = &runqueue_replay[runqueue_replay_count++];
+	l->msec = msec;
+	l->nr_run = simple_strtoul(skip_spaces(p), NULL, 10);
+}
+
+static ssize_t runqueue_replay_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	char buf[256];
+	size_t done = 0;
+
+	mutex_lock(&runqueue_lock);
+	while (done < count) {
+		size_t len = min(count - done,
+			sizeof(buf) - 1 - runqueue_replay_carry_len);
+		char *line, *nl;
+
+		memcpy(buf, runqueue_replay_carry, runqueue_replay_carry_len);
+		if (copy_from_user(buf + runqueue_replay_carry_len,
+				   userbuf + done, len)) {
+			mutex_unlock(&runqueue_lock);
+			return -EFAULT;
+		}
+		done += len;
+		len += runqueue_replay_carry_len;
+		buf[len] = '\0';
+
+		line = buf;
+		while ((nl = strchr(line, '\n'))) {
+			*nl = '\0';
+			runqueue_replay_line(line);
+			line = nl + 1;
+		}
+
+		/* keep a partial line for the next write */
+		runqueue_replay_carry_len = min_t(size_t, strlen(line),
+			sizeof(runqueue_replay_carry) - 1);
+		memcpy(runqueue_replay_carry, line, runqueue_replay_carry_len);
+	}
+	mutex_unlock(&runqueue_lock);
+
+	return count;
+}
+
+static const struct file_operations runqueue_replay_fops = {
+	.open		= runqueue_replay_open,
+	.read		= seq_read,
+	.write		= runqueue_replay_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int runqueue_trace_show(struct seq_file *s, void *data)
+{
+	struct runqueue_event *log;
+	unsigned long flags;
+	int i, pos, count;
+
+	log = kmalloc(sizeof(runqueue_log), GFP_KERNEL);
+	if (!log)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&runqueue_log_lock, flags);
+	memcpy(log, runqueue_log, sizeof(runqueue_log));
+	pos = runqueue_log_pos;
+	count = runqueue_log_count;
+	spin_unlock_irqrestore(&runqueue_log_lock, flags);
+
+	seq_printf(s, "# msec nr_run online idle action\n");
+	for (i = 0; i < count; i++) {
+		struct runqueue_event *e =
+			&log[(pos - count + i + RUNQUEUE_LOG_SIZE) %
+			     RUNQUEUE_LOG_SIZE];
+
+		seq_printf(s, "%u %u %u %u %c\n", e->msec, e->nr_run,
+			   e->online, e->idle, e->action);
+	}
+	kfree(log);
+
+	return 0;
+}
+
+static int runqueue_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, runqueue_trace_show, inode->i_private);
+}
+
+static const struct file_operations runqueue_trace_fops = {
+	.open		= runqueue_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init runqueue_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpuquiet_runqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("trace", S_IRUGO, dir, NULL,
+				 &runqueue_trace_fops) ||
+	    !debugfs_create_file("replay", S_IRUGO | S_IWUSR, dir, NULL,
+				 &runqueue_replay_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+#else
+static inline int runqueue_debugfs_init(void)
+{
+	return 0;
+}
+#endif
+
+CPQ_BASIC_ATTRIBUTE(sample_rate, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(down_delay, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(idle_residency, 0644, uint);
+CPQ_BASIC_ATTRIBUTE(nr_run_slack, 0644, uint);
+
+static struct attribute *runqueue_attributes[] = {
+	&sample_rate_attr.attr,
+	&down_delay_attr.attr,
+	&idle_residency_attr.attr,
+	&nr_run_slack_attr.attr,
+	NULL,
+};
+
+static const struct sysfs_ops runqueue_sysfs_ops = {
+	.show = cpuquiet_auto_sysfs_show,
+	.store = cpuquiet_auto_sysfs_store,
+};
+
+static struct kobj_type ktype_runqueue = {
+	.sysfs_ops = &runqueue_sysfs_ops,
+	.default_attrs = runqueue_attributes,
+};
+
+static int runqueue_sysfs(void)
+{
+	int err;
+
+	runqueue_kobject = kzalloc(sizeof(*runqueue_kobject),
+				GFP_KERNEL);
+
+	if (!runqueue_kobject)
+		return -ENOMEM;
+
+	err = cpuquiet_kobject_init(runqueue_kobject, &ktype_runqueue,
+				"runqueue");
+
+	if (err)
+		kfree(runqueue_kobject);
+
+	return err;
+}
+
+static void runqueue_device_busy(void)
+{
+	mutex_lock(&runqueue_lock);
+	if (runqueue_state == RUNNING) {
+		runqueue_state = IDLE;
+		wmb();
+		/* wait for ticks that still saw RUNNING */
+		synchronize_sched();
+		cancel_work_sync(&runqueue_work);
+		del_timer_sync(&runqueue_timer);
+	}
+	mutex_unlock(&runqueue_lock);
+}
+
+static void runqueue_device_free(void)
+{
+	mutex_lock(&runqueue_lock);
+	if (runqueue_state == IDLE) {
+		runqueue_state = RUNNING;
+		mod_timer(&runqueue_timer, jiffies + 1);
+	}
+	mutex_unlock(&runqueue_lock);
+}
+
+/* A raised minimum is served by the up path, a lowered maximum by sampling */
+static int runqueue_qos_notify(struct notifier_block *nb, unsigned long n,
+	void *p)
+{
+	mutex_lock(&runqueue_lock);
+	if (runqueue_state == RUNNING) {
+		queue_work(runqueue_wq, &runqueue_work);
+		mod_timer(&runqueue_timer, jiffies + 1);
+	}
+	mutex_unlock(&runqueue_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block runqueue_min_cpus_notifier = {
+	.notifier_call = runqueue_qos_notify,
+};
+
+static struct notifier_block runqueue_max_cpus_notifier = {
+	.notifier_call = runqueue_qos_notify,
+};
+
+static void runqueue_stop(void)
+{
+	/* outside of runqueue_lock, removal waits for running notifiers */
+	pm_qos_remove_notifier(PM_QOS_MIN_ONLINE_CPUS,
+			       &runqueue_min_cpus_notifier);
+	pm_qos_remove_notifier(PM_QOS_MAX_ONLINE_CPUS,
+			       &runqueue_max_cpus_notifier);
+
+	mutex_lock(&runqueue_lock);
+
+	runqueue_state = DISABLED;
+	wmb();
+	static_key_slow_dec(&cpuquiet_runqueue_enabled);
+	/* wait for ticks that still saw RUNNING */
+	synchronize_sched();
+	del_timer_sync(&runqueue_timer);
+	cancel_work_sync(&runqueue_work);
+	destroy_workqueue(runqueue_wq);
+	kobject_put(runqueue_kobject);
+
+	mutex_unlock(&runqueue_lock);
+}
+
+static int runqueue_start(void)
+{
+	int err;
+
+	err = runqueue_sysfs();
+	if (err)
+		return err;
+
+	runqueue_wq = alloc_workqueue("cpuquiet-runqueue",
+			WQ_HIGHPRI | WQ_FREEZABLE, 1);
+	if (!runqueue_wq) {
+		kobject_put(runqueue_kobject);
+		return -ENOMEM;
+	}
+
+	INIT_WORK(&runqueue_work, runqueue_work_func);
+
+	init_timer(&runqueue_timer);
+	runqueue_timer.function = runqueue_sampler;
+
+	memset(&runqueue_live, 0, sizeof(runqueue_live));
+	runqueue_down_cpu = nr_cpu_ids;
+
+	mutex_lock(&runqueue_lock);
+	runqueue_state = RUNNING;
+	mutex_unlock(&runqueue_lock);
+
+	static_key_slow_inc(&cpuquiet_runqueue_enabled);
+
+	mod_timer(&runqueue_timer, jiffies + 1);
+
+	if (pm_qos_add_notifier(PM_QOS_MIN_ONLINE_CPUS,
+				&runqueue_min_cpus_notifier))
+		pr_err("%s: Failed to register min cpus PM QoS notifier\n",
+			__func__);
+	if (pm_qos_add_notifier(PM_QOS_MAX_ONLINE_CPUS,
+				&runqueue_max_cpus_notifier))
+		pr_err("%s: Failed to register max cpus PM QoS notifier\n",
+			__func__);
+
+	return 0;
+}
+
+struct cpuquiet_governor runqueue_governor = {
+	.name			  = "runqueue",
+	.start			  = runqueue_start,
+	.device_free_notification = runqueue_device_free,
+	.device_busy_notification = runqueue_device_busy,
+	.stop			  = runqueue_stop,
+	.owner			  = THIS_MODULE,
+};
+
+static int __init init_runqueue(void)
+{
+	runqueue_debugfs_init();
+
+	return cpuquiet_register_governor(&runqueue_governor);
+}
+
+static void __exit exit_runqueue(void)
+{
+	cpuquiet_unregister_governor(&runqueue_governor);
+}
+
+MODULE_LICENSE("GPL");
+#ifdef CONFIG_CPUQUIET_DEFAULT_GOV_RUNQUEUE
+fs_initcall(init_runqueue);
+#else
+module_init(init_runqueue);
+#endif
+module_exit(exit_runqueue);
@@ -11,6 +11,7 @@
 #include <linux/uaccess.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
@@ -21,7 +22,9 @@
 #include <linux/ioctl.h>
 #include <linux/irq.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -52,6 +55,7 @@
 #define TEGRA_NVAVP_NAME			"nvavp"
 
 #define NVAVP_PUSHBUFFER_SIZE			4096
+#define NVAVP_PUSHBUFFER_MAX_SIZE		SZ_256K
 
 #define NVAVP_PUSHBUFFER_MIN_UPDATE_SPACE	(sizeof(u32) * 3)
 
@@ -70,6 +74,7 @@
 /* AVP behavior params */
 #define NVAVP_OS_IDLE_TIMEOUT		100 /* milli-seconds */
 #define NVAVP_OUTBOX_WRITE_TIMEOUT	1000 /* milli-seconds */
+#define NVAVP_PUSHBUFFER_WAIT_TIMEOUT	1000 /* milli-seconds */
 
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 /* Two control channels: Audio and Video channels */
@@ -92,14 +97,38 @@
 
 static bool boost_sclk;
 
+/* pushbuffer ring size in bytes, rounded up to a power of two */
+static unsigned int pushbuffer_size = SZ_16K;
+module_param(pushbuffer_size, uint, S_IRUGO);
+MODULE_PARM_DESC(pushbuffer_size, "AVP pushbuffer size in bytes");
+
+struct nvavp_channel_stats {
+	u64				submits;	/* pushbuffer updates */
+	u64				buffers;	/* command buffers */
+	u64				wakeups;	/* put pointer updates */
+	u64				bytes;
+	u64				ring_waits;
+	u64				ring_wait_us;
+	ktime_t				since;
+};
+
 struct nvavp_channel {
 	struct mutex			pushbuffer_lock;
 	struct nvmap_handle_ref		*pushbuf_handle;
 	unsigned long			pushbuf_phys;
 	u8				*pushbuf_data;
+	u32				pushbuf_size;
 	u32				pushbuf_index;
 	u32				pushbuf_fence;
 	struct nv_e276_control		*os_control;
+	struct nvavp_channel_stats	stats;
+};
+
+/* a command buffer to gather from the pushbuffer */
+struct nvavp_gather {
+	u32				phys_addr;
+	u32				words;
+	u32				flags;
 };
 
 struct nvavp_info {
@@ -149,6 +178,9 @@ struct nvavp_info {
 #if defined(CONFIG_TEGRA_NVAVP_AUDIO)
 	struct miscdevice		audio_misc_dev;
 #endif
+#if defined(CONFIG_DEBUG_FS)
+	struct dentry			*debugfs_root;
+#endif
 };
 
 struct nvavp_clientctx {
@@ -237,11 +269,11 @@ static void nvavp_set_channel_control_area(struct nvavp_info *nvavp, int channel
 
 	/* init dma start and end pointers */
 	writel(channel_info->pushbuf_phys, &control->dma_start);
-	writel((channel_info->pushbuf_phys + NVAVP_PUSHBUFFER_SIZE),
+	writel((channel_info->pushbuf_phys + channel_info->pushbuf_size),
 						&control->dma_end);
 
 	writel(0x00, &channel_info->pushbuf_index);
-	temp = NVAVP_PUSHBUFFER_SIZE - NVAVP_PUSHBUFFER_MIN_UPDATE_SPACE;
+	temp = channel_info->pushbuf_size - NVAVP_PUSHBUFFER_MIN_UPDATE_SPACE;
 	writel(temp, &channel_info->pushbuf_fence);
 }
 
@@ -521,8 +553,9 @@ static int nvavp_pushbuffer_alloc(struct nvavp_info *nvavp, int channel_id)
 	struct nvavp_channel *channel_info = nvavp_get_channel_info(
 							nvavp, channel_id);
 
+	channel_info->pushbuf_size = pushbuffer_size;
 	channel_info->pushbuf_handle = nvmap_alloc(nvavp->nvmap,
-						NVAVP_PUSHBUFFER_SIZE,
+						channel_info->pushbuf_size,
 						SZ_1M, NVMAP_HANDLE_UNCACHEABLE,
 						0);
 	if (IS_ERR(channel_info->pushbuf_handle)) {
@@ -549,7 +582,7 @@ static int nvavp_pushbuffer_alloc(struct nvavp_info *nvavp, int channel_id)
 		goto err_pushbuf_pin;
 	}
 
-	memset(channel_info->pushbuf_data, 0, NVAVP_PUSHBUFFER_SIZE);
+	memset(channel_info->pushbuf_data, 0, channel_info->pushbuf_size);
 
 	return 0;
 
@@ -606,77 +639,112 @@ static void nvavp_pushbuffer_deinit(struct nvavp_info *nvavp)
 	nvavp_pushbuffer_free(nvavp);
 }
 
-static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
-			u32 gather_count, struct nvavp_syncpt *syncpt,
-			u32 ext_ucode_flag, int channel_id)
+static inline void nvavp_pushbuffer_write(struct nvavp_channel *channel_info,
+			u32 *index, u32 val)
 {
-	struct nvavp_channel  *channel_info;
-	struct nv_e276_control *control;
-	u32 gather_cmd, setucode_cmd, sync = 0;
-	u32 wordcount = 0;
-	u32 index, value = -1;
-	int ret = 0;
+	writel(val, (channel_info->pushbuf_data + *index));
+	*index += sizeof(u32);
+}
 
-	channel_info = nvavp_get_channel_info(nvavp, channel_id);
+/*
+ * Whether bytes more can go in at index without running into what the
+ * AVP has not fetched yet. get == put means the ring is empty, so it is
+ * never filled up completely.
+ */
+static bool nvavp_pushbuffer_has_space(struct nvavp_channel *channel_info,
+			u32 index, u32 bytes)
+{
+	u32 get = readl(&channel_info->os_control->get);
+	u32 used = (index - get) & (channel_info->pushbuf_size - 1);
 
-	control = channel_info->os_control;
-	pr_debug("nvavp_pushbuffer_update for channel_id (%d):\
-		control->put (0x%x) control->get (0x%x)\n",
-		channel_id, (u32) &control->put, (u32) &control->get);
+	return used + bytes < channel_info->pushbuf_size;
+}
 
-	mutex_lock(&channel_info->pushbuffer_lock);
+/* publish the ring up to index and wake the avp */
+static int nvavp_pushbuffer_kick(struct nvavp_info *nvavp,
+			struct nvavp_channel *channel_info, u32 index,
+			int channel_id)
+{
+	channel_info->pushbuf_index = index;
+	writel(index, &channel_info->os_control->put);
+	wmb();
 
-	/* check for pushbuffer wrapping */
-	if (channel_info->pushbuf_index >= channel_info->pushbuf_fence)
-		channel_info->pushbuf_index = 0;
+	channel_info->stats.wakeups++;
 
-	if (!ext_ucode_flag) {
-		setucode_cmd =
-			NVE26E_CH_OPCODE_INCR(NVE276_SET_MICROCODE_A, 3);
+	if (IS_VIDEO_CHANNEL_ID(channel_id)) {
+		pr_debug("Wake up Video Channel\n");
+		return nvavp_outbox_write(0xA0000001);
+	}
+#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
+	if (IS_AUDIO_CHANNEL_ID(channel_id)) {
+		pr_debug("Wake up Audio Channel\n");
+		return nvavp_outbox_write(0xA0000002);
+	}
+#endif
+	return 0;
+}
 
-		index = wordcount + channel_info->pushbuf_index;
-		writel(setucode_cmd, (channel_info->pushbuf_data + index));
-		wordcount += sizeof(u32);
+static int nvavp_pushbuffer_wait_space(struct nvavp_info *nvavp,
+			struct nvavp_channel *channel_info, u32 index,
+			u32 bytes, int channel_id)
+{
+	unsigned long timeout;
+	ktime_t start;
+	int ret = 0;
 
-		index = wordcount + channel_info->pushbuf_index;
-		writel(0, (channel_info->pushbuf_data + index));
-		wordcount += sizeof(u32);
+	if (nvavp_pushbuffer_has_space(channel_info, index, bytes))
+		return 0;
 
-		index = wordcount + channel_info->pushbuf_index;
-		writel(nvavp->ucode_info.phys,
-			(channel_info->pushbuf_data + index));
-		wordcount += sizeof(u32);
+	/* the avp can only make room by fetching what is staged so far */
+	if (index != channel_info->pushbuf_index) {
+		ret = nvavp_pushbuffer_kick(nvavp, channel_info, index,
+					    channel_id);
+		if (ret < 0)
+			return ret;
+	}
 
-		index = wordcount + channel_info->pushbuf_index;
-		writel(nvavp->ucode_info.size,
-			(channel_info->pushbuf_data + index));
-		wordcount += sizeof(u32);
+	start = ktime_get();
+	timeout = jiffies + msecs_to_jiffies(NVAVP_PUSHBUFFER_WAIT_TIMEOUT);
+	while (!nvavp_pushbuffer_has_space(channel_info, index, bytes)) {
+		if (time_after(jiffies, timeout)) {
+			dev_err(&nvavp->nvhost_dev->dev,
+				"pushbuffer full on channel %d\n", channel_id);
+			ret = -ETIMEDOUT;
+			break;
+		}
+		usleep_range(100, 200);
 	}
 
-	gather_cmd = NVE26E_CH_OPCODE_GATHER(0, 0, 0, gather_count);
+	channel_info->stats.ring_waits++;
+	channel_info->stats.ring_wait_us += ktime_us_delta(ktime_get(), start);
 
-	if (syncpt) {
-		value = ++nvavp->syncpt_value;
-		/* XXX: NvSchedValueWrappingComparison */
-		sync = NVE26E_CH_OPCODE_IMM(NVE26E_HOST1X_INCR_SYNCPT,
-			(NVE26E_HOST1X_INCR_SYNCPT_COND_OP_DONE << 8) |
-			(nvavp->syncpt_id & 0xFF));
-	}
+	return ret;
+}
 
-	/* write commands out */
-	index = wordcount + channel_info->pushbuf_index;
-	writel(gather_cmd, (channel_info->pushbuf_data + index));
-	wordcount += sizeof(u32);
+/*
+ * Queues the gathers in order and wakes the avp once at the end. When
+ * syncpt is given, a single syncpoint increment follows the last gather
+ * and its fence is filled in.
+ */
+static int nvavp_pushbuffer_update(struct nvavp_info *nvavp,
+			struct nvavp_gather *gathers, int num_gathers,
+			struct nvavp_syncpt *syncpt, int channel_id)
+{
+	struct nvavp_channel  *channel_info;
+	struct nv_e276_control *control;
+	u32 gather_cmd, setucode_cmd, sync = 0;
+	u32 index, start, bytes, value = -1;
+	bool last;
+	int ret = 0, i;
 
-	index = wordcount + channel_info->pushbuf_index;
-	writel(phys_addr, (channel_info->pushbuf_data + index));
-	wordcount += sizeof(u32);
+	channel_info = nvavp_get_channel_info(nvavp, channel_id);
 
-	if (syncpt) {
-		index = wordcount + channel_info->pushbuf_index;
-		writel(sync, (channel_info->pushbuf_data + index));
-		wordcount += sizeof(u32);
-	}
+	control = channel_info->os_control;
+	pr_debug("nvavp_pushbuffer_update for channel_id (%d):\
+		control->put (0x%x) control->get (0x%x)\n",
+		channel_id, (u32) &control->put, (u32) &control->get);
+
+	mutex_lock(&channel_info->pushbuffer_lock);
 
 	/* enable clocks to VDE/BSEV */
 	mutex_lock(&nvavp->open_lock);
@@ -686,31 +754,68 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 	}
 	mutex_unlock(&nvavp->open_lock);
 
-	/* update put pointer */
-	channel_info->pushbuf_index = (channel_info->pushbuf_index + wordcount)&
-					(NVAVP_PUSHBUFFER_SIZE - 1);
+	index = channel_info->pushbuf_index;
 
-	writel(channel_info->pushbuf_index, &control->put);
-	wmb();
+	for (i = 0; i < num_gathers; i++) {
+		last = (i == num_gathers - 1);
 
-	/* wake up avp */
+		bytes = sizeof(u32) * 2;
+		if (!(gathers[i].flags & NVAVP_UCODE_EXT))
+			bytes += sizeof(u32) * 4;
+		if (last && syncpt)
+			bytes += sizeof(u32);
 
-	if (IS_VIDEO_CHANNEL_ID(channel_id)) {
-		pr_debug("Wake up Video Channel\n");
-		ret = nvavp_outbox_write(0xA0000001);
+		/* check for pushbuffer wrapping */
+		if (index >= channel_info->pushbuf_fence)
+			index = 0;
+
+		ret = nvavp_pushbuffer_wait_space(nvavp, channel_info, index,
+						  bytes, channel_id);
 		if (ret < 0)
 			goto err_exit;
-	}
-	else {
-#if defined(CONFIG_TEGRA_NVAVP_AUDIO)
-		if (IS_AUDIO_CHANNEL_ID(channel_id)) {
-			pr_debug("Wake up Audio Channel\n");
-			ret = nvavp_outbox_write(0xA0000002);
-			if (ret < 0)
-				goto err_exit;
+
+		start = index;
+
+		if (!(gathers[i].flags & NVAVP_UCODE_EXT)) {
+			setucode_cmd =
+				NVE26E_CH_OPCODE_INCR(NVE276_SET_MICROCODE_A, 3);
+
+			nvavp_pushbuffer_write(channel_info, &index,
+					       setucode_cmd);
+			nvavp_pushbuffer_write(channel_info, &index, 0);
+			nvavp_pushbuffer_write(channel_info, &index,
+					       nvavp->ucode_info.phys);
+			nvavp_pushbuffer_write(channel_info, &index,
+					       nvavp->ucode_info.size);
 		}
-#endif
+
+		gather_cmd = NVE26E_CH_OPCODE_GATHER(0, 0, 0, gathers[i].words);
+
+		/* write commands out */
+		nvavp_pushbuffer_write(channel_info, &index, gather_cmd);
+		nvavp_pushbuffer_write(channel_info, &index,
+				       gathers[i].phys_addr);
+
+		/* only the last gather signals completion */
+		if (last && syncpt) {
+			value = ++nvavp->syncpt_value;
+			/* XXX: NvSchedValueWrappingComparison */
+			sync = NVE26E_CH_OPCODE_IMM(NVE26E_HOST1X_INCR_SYNCPT,
+				(NVE26E_HOST1X_INCR_SYNCPT_COND_OP_DONE << 8) |
+				(nvavp->syncpt_id & 0xFF));
+			nvavp_pushbuffer_write(channel_info, &index, sync);
+		}
+
+		channel_info->stats.bytes += index - start;
+		index &= (channel_info->pushbuf_size - 1);
 	}
+
+	channel_info->stats.submits++;
+	channel_info->stats.buffers += num_gathers;
+
+	/* update put pointer and wake up avp */
+	ret = nvavp_pushbuffer_kick(nvavp, channel_info, index, channel_id);
+
 	/* Fill out fence struct */
 	if (syncpt) {
 		syncpt->id = nvavp->syncpt_id;
@@ -720,7 +825,7 @@ static int nvavp_pushbuffer_update(struct nvavp_info *nvavp, u32 phys_addr,
 err_exit:
 	mutex_unlock(&channel_info->pushbuffer_lock);
 
-	return 0;
+	return ret < 0 ? ret : 0;
 }
 
 static void nvavp_unload_ucode(struct nvavp_info *nvavp)
@@ -1196,50 +1301,43 @@ static int nvavp_set_nvmapfd_ioctl(struct file *filp, unsigned int cmd,
 	return 0;
 }
 
-static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
-							unsigned long arg)
+/*
+ * Pins the command buffer of a submit and patches in its relocations. The
+ * buffer is held through a duplicate handle in the driver's nvmap context
+ * until nvavp_cmdbuf_put(), so it cannot be freed while in use.
+ */
+static int nvavp_cmdbuf_get(struct nvavp_clientctx *clientctx,
+			struct nvavp_pushbuffer_submit_hdr *hdr,
+			struct nvmap_handle_ref **dupe,
+			struct nvavp_gather *gather)
 {
-	struct nvavp_clientctx *clientctx = filp->private_data;
 	struct nvavp_info *nvavp = clientctx->nvavp;
-	struct nvavp_pushbuffer_submit_hdr hdr;
 	u32 *cmdbuf_data;
 	struct nvmap_handle *cmdbuf_handle = NULL;
 	struct nvmap_handle_ref *cmdbuf_dupe;
 	int ret = 0, i;
 	unsigned long phys_addr;
 	unsigned long virt_addr;
-	struct nvavp_pushbuffer_submit_hdr *user_hdr =
-			(struct nvavp_pushbuffer_submit_hdr *) arg;
-	struct nvavp_syncpt syncpt;
 
-	syncpt.id = NVSYNCPT_INVALID;
-	syncpt.value = 0;
-
-	if (_IOC_DIR(cmd) & _IOC_WRITE) {
-		if (copy_from_user(&hdr, (void __user *)arg,
-			sizeof(struct nvavp_pushbuffer_submit_hdr)))
-			return -EFAULT;
-	}
-
-	if (!hdr.cmdbuf.mem)
-		return 0;
+	if (hdr->num_relocs > NVAVP_MAX_RELOCATION_COUNT)
+		return -EINVAL;
 
-	if (copy_from_user(clientctx->relocs, (void __user *)hdr.relocs,
-			sizeof(struct nvavp_reloc) * hdr.num_relocs)) {
+	if (copy_from_user(clientctx->relocs, (void __user *)hdr->relocs,
+			sizeof(struct nvavp_reloc) * hdr->num_relocs)) {
 		return -EFAULT;
 	}
 
-	cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap, hdr.cmdbuf.mem);
+	cmdbuf_handle = nvmap_get_handle_id(clientctx->nvmap, hdr->cmdbuf.mem);
 	if (cmdbuf_handle == NULL) {
 		dev_err(&nvavp->nvhost_dev->dev,
-			"invalid cmd buffer handle %08x\n", hdr.cmdbuf.mem);
+			"invalid cmd buffer handle %08x\n", hdr->cmdbuf.mem);
 		return -EPERM;
 	}
 
 	/* duplicate the new pushbuffer's handle into the nvavp driver's
 	 * nvmap context, to ensure that the handle won't be freed as
 	 * long as it is in-use by the fb driver */
-	cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap, hdr.cmdbuf.mem);
+	cmdbuf_dupe = nvmap_duplicate_handle_id(nvavp->nvmap, hdr->cmdbuf.mem);
 	nvmap_handle_put(cmdbuf_handle);
 
 	if (IS_ERR(cmdbuf_dupe)) {
@@ -1262,12 +1360,12 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 		goto err_cmdbuf_mmap;
 	}
 
-	cmdbuf_data = (u32 *)(virt_addr + hdr.cmdbuf.offset);
+	cmdbuf_data = (u32 *)(virt_addr + hdr->cmdbuf.offset);
 
-	for (i = 0; i < hdr.num_relocs; i++) {
+	for (i = 0; i < hdr->num_relocs; i++) {
 		u32 *reloc_addr, target_phys_addr;
 
-		if (clientctx->relocs[i].cmdbuf_mem != hdr.cmdbuf.mem) {
+		if (clientctx->relocs[i].cmdbuf_mem != hdr->cmdbuf.mem) {
 			dev_err(&nvavp->nvhost_dev->dev,
 				"reloc info does not match target bufferID\n");
 			ret = -EPERM;
@@ -1283,25 +1381,14 @@ static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
 		writel(target_phys_addr, reloc_addr);
 	}
 
-	if (hdr.syncpt) {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
-					      hdr.cmdbuf.words, &syncpt,
-					      (hdr.flags & NVAVP_UCODE_EXT),
-						clientctx->channel_id);
-
-		if (copy_to_user((void __user *)user_hdr->syncpt, &syncpt,
-				sizeof(struct nvavp_syncpt))) {
-			ret = -EFAULT;
-			goto err_reloc_info;
-		}
-	} else {
-		ret = nvavp_pushbuffer_update(nvavp,
-					     (phys_addr + hdr.cmdbuf.offset),
-					      hdr.cmdbuf.words, NULL,
-					      (hdr.flags & NVAVP_UCODE_EXT),
-						clientctx->channel_id);
-	}
+	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
+
+	gather->phys_addr = phys_addr + hdr->cmdbuf.offset;
+	gather->words = hdr->cmdbuf.words;
+	gather->flags = hdr->flags;
+	*dupe = cmdbuf_dupe;
+
+	return 0;
 
 err_reloc_info:
 	nvmap_munmap(cmdbuf_dupe, (void *)virt_addr);
@@ -1311,6 +1398,112 @@ err_cmdbuf_mmap:
 	return ret;
 }
 
+static void nvavp_cmdbuf_put(struct nvavp_info *nvavp,
+			struct nvmap_handle_ref *cmdbuf_dupe)
+{
+	nvmap_unpin(nvavp->nvmap, cmdbuf_dupe);
+	nvmap_free(nvavp->nvmap, cmdbuf_dupe);
+}
+
+static int nvavp_pushbuffer_submit_ioctl(struct file *filp, unsigned int cmd,
+							unsigned long arg)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_pushbuffer_submit_hdr hdr;
+	struct nvmap_handle_ref *cmdbuf_dupe;
+	struct nvavp_gather gather;
+	struct nvavp_syncpt syncpt;
+	int ret = 0;
+
+	syncpt.id = NVSYNCPT_INVALID;
+	syncpt.value = 0;
+
+	if (_IOC_DIR(cmd) & _IOC_WRITE) {
+		if (copy_from_user(&hdr, (void __user *)arg,
+			sizeof(struct nvavp_pushbuffer_submit_hdr)))
+			return -EFAULT;
+	}
+
+	if (!hdr.cmdbuf.mem)
+		return 0;
+
+	ret = nvavp_cmdbuf_get(clientctx, &hdr, &cmdbuf_dupe, &gather);
+	if (ret)
+		return ret;
+
+	if (hdr.syncpt) {
+		ret = nvavp_pushbuffer_update(nvavp, &gather, 1, &syncpt,
+					      clientctx->channel_id);
+
+		if (copy_to_user((void __user *)hdr.syncpt, &syncpt,
+				sizeof(struct nvavp_syncpt)))
+			ret = -EFAULT;
+	} else {
+		ret = nvavp_pushbuffer_update(nvavp, &gather, 1, NULL,
+					      clientctx->channel_id);
+	}
+
+	nvavp_cmdbuf_put(nvavp, cmdbuf_dupe);
+	return ret;
+}
+
+static int nvavp_pushbuffer_submit_multi_ioctl(struct file *filp,
+			unsigned int cmd, unsigned long arg)
+{
+	struct nvavp_clientctx *clientctx = filp->private_data;
+	struct nvavp_info *nvavp = clientctx->nvavp;
+	struct nvavp_pushbuffer_submit_multi_hdr multi;
+	struct nvavp_pushbuffer_submit_hdr hdr;
+	struct nvmap_handle_ref *cmdbuf_dupes[NVAVP_MAX_SUBMIT_COUNT];
+	struct nvavp_gather gathers[NVAVP_MAX_SUBMIT_COUNT];
+	struct nvavp_syncpt syncpt;
+	int ret = 0, i, n = 0;
+
+	syncpt.id = NVSYNCPT_INVALID;
+	syncpt.value = 0;
+
+	if (copy_from_user(&multi, (void __user *)arg,
+			sizeof(struct nvavp_pushbuffer_submit_multi_hdr)))
+		return -EFAULT;
+
+	if (multi.num_hdrs > NVAVP_MAX_SUBMIT_COUNT)
+		return -EINVAL;
+
+	for (i = 0; i < multi.num_hdrs; i++) {
+		if (copy_from_user(&hdr, (void __user *)&multi.hdrs[i],
+				sizeof(struct nvavp_pushbuffer_submit_hdr))) {
+			ret = -EFAULT;
+			goto err_cmdbuf;
+		}
+
+		if (!hdr.cmdbuf.mem)
+			continue;
+
+		ret = nvavp_cmdbuf_get(clientctx, &hdr, &cmdbuf_dupes[n],
+				       &gathers[n]);
+		if (ret)
+			goto err_cmdbuf;
+		n++;
+	}
+
+	if (!n)
+		return 0;
+
+	ret = nvavp_pushbuffer_update(nvavp, gathers, n,
+				      multi.syncpt ? &syncpt : NULL,
+				      clientctx->channel_id);
+
+	if (multi.syncpt && copy_to_user((void __user *)multi.syncpt, &syncpt,
+				sizeof(struct nvavp_syncpt)))
+		ret = -EFAULT;
+
+err_cmdbuf:
+	while (n--)
+		nvavp_cmdbuf_put(nvavp, cmdbuf_dupes[n]);
+	return ret;
+}
+
 static int nvavp_wake_avp_ioctl(struct file *filp, unsigned int cmd,
 							unsigned long arg)
 {
@@ -1512,6 +1705,9 @@ static long tegra_nvavp_ioctl(struct file *filp, unsigned int cmd,
 	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT:
 		ret = nvavp_pushbuffer_submit_ioctl(filp, cmd, arg);
 		break;
+	case NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI:
+		ret = nvavp_pushbuffer_submit_multi_ioctl(filp, cmd, arg);
+		break;
 	case NVAVP_IOCTL_SET_CLOCK:
 		ret = nvavp_set_clock_ioctl(filp, cmd, arg);
 		break;
@@ -1581,6 +1777,102 @@ static ssize_t boost_sclk_store(struct device *dev,
 
 DEVICE_ATTR(boost_sclk, S_IRUGO | S_IWUSR, boost_sclk_show, boost_sclk_store);
 
+#if defined(CONFIG_DEBUG_FS)
+static int nvavp_stats_show(struct seq_file *s, void *unused)
+{
+	struct nvavp_info *nvavp = s->private;
+	struct nvavp_channel *channel_info;
+	struct nvavp_channel_stats stats;
+	u64 ms;
+	int channel_id;
+
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
+		channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+		mutex_lock(&channel_info->pushbuffer_lock);
+		stats = channel_info->stats;
+		mutex_unlock(&channel_info->pushbuffer_lock);
+
+		ms = max_t(s64, 1, ktime_to_ms(ktime_sub(ktime_get(),
+							  stats.since)));
+
+		seq_printf(s, "channel %d, %u byte ring, %llu ms\n",
+			   channel_id, pushbuffer_size, ms);
+		seq_printf(s, "  submits      %10llu %8llu/s\n", stats.submits,
+			   div64_u64(stats.submits * MSEC_PER_SEC, ms));
+		seq_printf(s, "  buffers      %10llu %8llu/s\n", stats.buffers,
+			   div64_u64(stats.buffers * MSEC_PER_SEC, ms));
+		seq_printf(s, "  wakeups      %10llu %8llu/s\n", stats.wakeups,
+			   div64_u64(stats.wakeups * MSEC_PER_SEC, ms));
+		seq_printf(s, "  bytes        %10llu %8llu/s\n", stats.bytes,
+			   div64_u64(stats.bytes * MSEC_PER_SEC, ms));
+		seq_printf(s, "  ring waits   %10llu %8llu/s\n", stats.ring_waits,
+			   div64_u64(stats.ring_waits * MSEC_PER_SEC, ms));
+		seq_printf(s, "  ring wait us %10llu %8llu/s\n",
+			   stats.ring_wait_us,
+			   div64_u64(stats.ring_wait_us * MSEC_PER_SEC, ms));
+	}
+
+	return 0;
+}
+
+static int nvavp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvavp_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t nvavp_stats_write(struct file *file,
+	const char __user *userbuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct nvavp_info *nvavp = s->private;
+	struct nvavp_channel *channel_info;
+	int channel_id;
+
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
+		channel_info = nvavp_get_channel_info(nvavp, channel_id);
+
+		mutex_lock(&channel_info->pushbuffer_lock);
+		memset(&channel_info->stats, 0, sizeof(channel_info->stats));
+		channel_info->stats.since = ktime_get();
+		mutex_unlock(&channel_info->pushbuffer_lock);
+	}
+
+	return count;
+}
+
+static const struct file_operations nvavp_stats_fops = {
+	.open		= nvavp_stats_open,
+	.read		= seq_read,
+	.write		= nvavp_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nvavp_debugfs_init(struct nvavp_info *nvavp)
+{
+	nvavp->debugfs_root = debugfs_create_dir(TEGRA_NVAVP_NAME, NULL);
+	if (IS_ERR_OR_NULL(nvavp->debugfs_root))
+		return;
+
+	if (!debugfs_create_file("pushbuffer_stats", S_IRUGO | S_IWUSR,
+				 nvavp->debugfs_root, nvavp,
+				 &nvavp_stats_fops)) {
+		debugfs_remove_recursive(nvavp->debugfs_root);
+		nvavp->debugfs_root = NULL;
+	}
+}
+
+static void nvavp_debugfs_exit(struct nvavp_info *nvavp)
+{
+	debugfs_remove_recursive(nvavp->debugfs_root);
+}
+#else
+static inline void nvavp_debugfs_init(struct nvavp_info *nvavp) { }
+static inline void nvavp_debugfs_exit(struct nvavp_info *nvavp) { }
+#endif
+
 static int tegra_nvavp_probe(struct platform_device *ndev)
 {
 	struct nvavp_info *nvavp;
@@ -1691,8 +1983,14 @@ static int tegra_nvavp_probe(struct platform_device *ndev)
 	nvavp->mbox_from_avp_pend_irq = irq;
 	mutex_init(&nvavp->open_lock);
 
-	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++)
+	for (channel_id = 0; channel_id < NVAVP_NUM_CHANNELS; channel_id++) {
 		mutex_init(&nvavp->channel_info[channel_id].pushbuffer_lock);
+		nvavp->channel_info[channel_id].stats.since = ktime_get();
+	}
+
+	pushbuffer_size = roundup_pow_of_two(clamp_t(unsigned int,
+				pushbuffer_size, NVAVP_PUSHBUFFER_SIZE,
+				NVAVP_PUSHBUFFER_MAX_SIZE));
 
 	/* TODO DO NOT USE NVAVP DEVICE */
 	nvavp->cop_clk = clk_get(&ndev->dev, "cop");
@@ -1796,6 +2094,8 @@ static int tegra_nvavp_probe(struct platform_device *ndev)
 		goto err_req_irq_pend;
 	}
 
+	nvavp_debugfs_init(nvavp);
+
 	return 0;
 
 err_req_irq_pend:
@@ -1855,6 +2155,7 @@ static int tegra_nvavp_remove(struct platform_device *ndev)
 	nvavp_unload_ucode(nvavp);
 	nvavp_unload_os(nvavp);
 
+	nvavp_debugfs_exit(nvavp);
 	device_remove_file(&ndev->dev, &dev_attr_boost_sclk);
 
 	misc_deregister(&nvavp->video_misc_dev);
@@ -30,6 +30,9 @@
 
 #define DEFAULT_SYNC_RATE 60000 /* 60 Hz */
 
+/* flips not yet reported to the frame governor */
+#define THROUGHPUT_FRAMES 16
+
 static unsigned short target_frame_time;
 static unsigned short last_frame_time;
 static ktime_t last_flip;
@@ -39,10 +42,55 @@ static spinlock_t lock;
 static struct work_struct work;
 static int throughput_hint;
 
+static struct {
+	ktime_t flip;
+	/* not clamped like last_frame_time, which saturates at 65 ms */
+	unsigned int frame_us;
+} frames[THROUGHPUT_FRAMES];
+static unsigned int frames_head;
+static unsigned int frames_count;
+static DEFINE_SPINLOCK(frames_lock);
+
 static void set_throughput_hint(struct work_struct *work)
 {
 	/* notify throughput hint clients here */
 	nvhost_scale3d_set_throughput_hint(throughput_hint);
+
+	/* every frame on its own, even if the work ran late */
+	for (;;) {
+		ktime_t flip;
+		unsigned int frame_us;
+
+		spin_lock(&frames_lock);
+		if (!frames_count) {
+			spin_unlock(&frames_lock);
+			break;
+		}
+		flip = frames[frames_head].flip;
+		frame_us = frames[frames_head].frame_us;
+		frames_head = (frames_head + 1) % THROUGHPUT_FRAMES;
+		frames_count--;
+		spin_unlock(&frames_lock);
+
+		nvhost_scale3d_set_frame_time(flip, frame_us);
+	}
+}
+
+static void queue_frame(ktime_t flip, unsigned int frame_us)
+{
+	unsigned int i;
+
+	spin_lock(&frames_lock);
+	/* drop the oldest if the work is that far behind */
+	if (frames_count == THROUGHPUT_FRAMES) {
+		frames_head = (frames_head + 1) % THROUGHPUT_FRAMES;
+		frames_count--;
+	}
+	i = (frames_head + frames_count) % THROUGHPUT_FRAMES;
+	frames[i].flip = flip;
+	frames[i].frame_us = frame_us;
+	frames_count++;
+	spin_unlock(&frames_lock);
 }
 
 static int throughput_flip_callback(void)
@@ -71,8 +119,8 @@ static int throughput_flip_callback(void)
 		throughput_hint =
 			((int) target_frame_time * 1000) / last_frame_time;
 
-		if (!work_pending(&work))
-			schedule_work(&work);
+		queue_frame(now, (unsigned int) timediff);
+		schedule_work(&work);
 	}
 	last_flip = now;
 
@@ -17,6 +17,11 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/clk.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
 
 #include <mach/clk.h>
 #include <mach/dc.h>
@@ -29,6 +34,7 @@
 #include "dc_reg.h"
 #include "dc_config.h"
 #include "dc_priv.h"
+#include "bandwidth.h"
 
 static int use_dynamic_emc = 1;
 
@@ -64,7 +70,7 @@ static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 	bw = max(w->bandwidth, w->new_bandwidth);
 
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
-	/* tegra_dc_get_bandwidth() treats V filter windows as double
+	/* tegra_dc_bw_model() treats V filter windows as double
 	 * bandwidth, but LA has a seperate client for V filter */
 	if (w->idx == 1 && win_use_v_filter(dc, w))
 		bw /= 2;
@@ -84,148 +90,140 @@ static void tegra_dc_set_latency_allowance(struct tegra_dc *dc,
 #endif
 }
 
-static unsigned int tegra_dc_windows_is_overlapped(struct tegra_dc_win *a,
-						   struct tegra_dc_win *b)
+/*
+ * Peak EMC bandwidth of each window =
+ * pixel_clock * win_bpp * v_taps * H_scale_factor * tiled_multiplier
+ *
+ * A window fetches v_taps lines of in_w source pixels while out_w pixels
+ * are scanned out. Vertical scaling alone does not change that: lines
+ * are picked by the DDA, not read and dropped.
+ *
+ * The display peak is the largest sum over windows sharing a scanline.
+ * Windows side by side on a line still count fully, since the fifos fill
+ * ahead of the beam; windows on different lines never add up. That sum
+ * only grows where a window starts, so evaluating the first line of each
+ * window is exact.
+ *
+ * return:
+ * bandwidth in kBps
+ */
+unsigned long tegra_dc_bw_model(const struct tegra_dc_bw_win *wins, int n,
+	unsigned long pclk, unsigned v_active, unsigned long *kbps)
 {
-	if (!WIN_IS_ENABLED(a) || !WIN_IS_ENABLED(b))
-		return 0;
+	unsigned long max_bw = 0;
+	int i, j;
 
-	/* because memory access to load the fifo can overlap, only care
-	 * if windows overlap vertically */
-	return ((a->out_y + a->out_h > b->out_y) && (a->out_y <= b->out_y)) ||
-		((b->out_y + b->out_h > a->out_y) && (b->out_y <= a->out_y));
-}
+	for (i = 0; i < n; i++) {
+		const struct tegra_dc_bw_win *w = &wins[i];
+		u64 bw;
+
+		kbps[i] = 0;
+		if (!w->in_w || !w->out_w || !w->out_h)
+			continue;
+		if (v_active && w->out_y >= v_active)
+			continue;
+
+		bw = (u64)pclk * w->bpp * w->in_w * w->v_taps * w->tiled_mult;
+		bw = div_u64(bw, 8 * 1000 * w->out_w);
+#ifdef CONFIG_ARCH_TEGRA_2x_SOC
+		/*
+		 * Assuming 60% efficiency: i.e. if we calculate we need 70MBps,
+		 * we will request 117MBps from EMC.
+		 */
+		bw = bw + div_u64(17 * bw, 25);
+#endif
+		kbps[i] = min_t(u64, bw, ULONG_MAX);
+	}
 
-static unsigned long tegra_dc_find_max_bandwidth(struct tegra_dc_win *wins[],
-						 int n)
-{
-	unsigned i;
-	unsigned j;
-	unsigned overlap_count;
-	unsigned max_bw = 0;
-
-	WARN_ONCE(n > 3, "Code assumes at most 3 windows, bandwidth is likely"
-			 "inaccurate.\n");
-
-	/* If we had a large number of windows, we would compute adjacency
-	 * graph representing 2 window overlaps, find all cliques in the graph,
-	 * assign bandwidth to each clique, and then select the clique with
-	 * maximum bandwidth. But because we have at most 3 windows,
-	 * implementing proper Bron-Kerbosh algorithm would be an overkill,
-	 * brute force will suffice.
-	 *
-	 * Thus: find maximum bandwidth for either single or a pair of windows
-	 * and count number of window pair overlaps. If there are three
-	 * pairs, all 3 window overlap.
-	 */
-
-	overlap_count = 0;
 	for (i = 0; i < n; i++) {
-		unsigned int bw1;
+		unsigned y = wins[i].out_y;
+		unsigned long sum = 0;
 
-		if (wins[i] == NULL)
+		if (!kbps[i])
 			continue;
-		bw1 = wins[i]->new_bandwidth;
-		if (bw1 > max_bw)
-			/* Single window */
-			max_bw = bw1;
-
-		for (j = i + 1; j < n; j++) {
-			if (wins[j] == NULL)
-				continue;
-			if (tegra_dc_windows_is_overlapped(wins[i], wins[j])) {
-				unsigned int bw2 = wins[j]->new_bandwidth;
-				if (bw1 + bw2 > max_bw)
-					/* Window pair overlaps */
-					max_bw = bw1 + bw2;
-				overlap_count++;
-			}
+
+		for (j = 0; j < n; j++) {
+			const struct tegra_dc_bw_win *w = &wins[j];
+
+			if (kbps[j] && w->out_y <= y && y - w->out_y < w->out_h)
+				sum += kbps[j];
 		}
+		max_bw = max(max_bw, sum);
 	}
 
-	if (overlap_count == 3)
-		/* All three windows overlap */
-		max_bw = wins[0]->new_bandwidth + wins[1]->new_bandwidth +
-			 wins[2]->new_bandwidth;
-
 	return max_bw;
 }
 
-/*
- * Calculate peak EMC bandwidth for each enabled window =
- * pixel_clock * win_bpp * (use_v_filter ? 2 : 1)) * H_scale_factor *
- * (windows_tiling ? 2 : 1)
- *
- * note:
- * (*) We use 2 tap V filter on T2x/T3x, so need double BW if use V filter
- * (*) Tiling mode on T30 and DDR3 requires double BW
- *
- * return:
- * bandwidth in kBps
- */
-static unsigned long tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
-	struct tegra_dc_win *w)
+static void tegra_dc_bw_win_init(struct tegra_dc *dc,
+	struct tegra_dc_win *w, struct tegra_dc_bw_win *bw)
 {
-	unsigned long ret;
-	int tiled_windows_bw_multiplier;
-	unsigned long bpp;
-	unsigned in_w;
+	memset(bw, 0, sizeof(*bw));
 
 	if (!WIN_IS_ENABLED(w))
-		return 0;
+		return;
 
 	if (dfixed_trunc(w->w) == 0 || dfixed_trunc(w->h) == 0 ||
 	    w->out_w == 0 || w->out_h == 0)
-		return 0;
+		return;
 	if (w->flags & TEGRA_WIN_FLAG_SCAN_COLUMN)
 		/* rotated: PRESCALE_SIZE swapped, but WIN_SIZE is unchanged */
-		in_w = dfixed_trunc(w->h);
+		bw->in_w = dfixed_trunc(w->h);
 	else
-		in_w = dfixed_trunc(w->w); /* normal output, not rotated */
-
-	tiled_windows_bw_multiplier =
-		tegra_mc_get_tiled_memory_bandwidth_multiplier();
+		bw->in_w = dfixed_trunc(w->w); /* normal output, not rotated */
 
 	/* all of tegra's YUV formats(420 and 422) fetch 2 bytes per pixel,
 	 * but the size reported by tegra_dc_fmt_bpp for the planar version
 	 * is of the luma plane's size only. */
-	bpp = tegra_dc_is_yuv_planar(w->fmt) ?
+	bw->bpp = tegra_dc_is_yuv_planar(w->fmt) ?
 		2 * tegra_dc_fmt_bpp(w->fmt) : tegra_dc_fmt_bpp(w->fmt);
-	ret = dc->mode.pclk / 1000UL * bpp / 8 *
+	bw->out_y = w->out_y;
+	bw->out_w = w->out_w;
+	bw->out_h = w->out_h;
+
+	/* We use 2 tap V filter on T2x/T3x, so need double BW */
+	bw->v_taps = 1;
 #if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
-		(win_use_v_filter(dc, w) ? 2 : 1) *
+	if (win_use_v_filter(dc, w))
+		bw->v_taps = 2;
 #endif
-		in_w / w->out_w * (WIN_IS_TILED(w) ?
-		tiled_windows_bw_multiplier : 1);
 
-#ifdef CONFIG_ARCH_TEGRA_2x_SOC
-	/*
-	 * Assuming 60% efficiency: i.e. if we calculate we need 70MBps, we
-	 * will request 117MBps from EMC.
-	 */
-	ret = ret + (17 * ret / 25);
-#endif
-	return ret;
+	/* Tiling mode on T30 and DDR3 requires double BW */
+	bw->tiled_mult = WIN_IS_TILED(w) ?
+		tegra_mc_get_tiled_memory_bandwidth_multiplier() : 1;
 }
 
-static unsigned long tegra_dc_get_bandwidth(
-	struct tegra_dc_win *windows[], int n)
+/* evaluates the model for the windows of dc as they are now */
+static unsigned long tegra_dc_calc_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_bw_win *bw, unsigned long *kbps)
 {
 	int i;
 
-	BUG_ON(n > DC_N_WINDOWS);
+	for (i = 0; i < DC_N_WINDOWS; i++)
+		tegra_dc_bw_win_init(dc, &dc->windows[i], &bw[i]);
+
+	return tegra_dc_bw_model(bw, DC_N_WINDOWS, dc->mode.pclk,
+		dc->mode.v_active, kbps);
+}
+
+/*
+ * Bandwidth of the composition the next frame will scan out: the windows
+ * being updated with their new state, the others as they are.
+ */
+static unsigned long tegra_dc_get_bandwidth(struct tegra_dc *dc)
+{
+	struct tegra_dc_bw_win bw[DC_N_WINDOWS];
+	unsigned long kbps[DC_N_WINDOWS];
+	unsigned long max_bw;
+	int i;
+
+	max_bw = tegra_dc_calc_bandwidth(dc, bw, kbps);
 
 	/* emc rate and latency allowance both need to know per window
 	 * bandwidths */
-	for (i = 0; i < n; i++) {
-		struct tegra_dc_win *w = windows[i];
+	for (i = 0; i < DC_N_WINDOWS; i++)
+		dc->windows[i].new_bandwidth = kbps[i];
 
-		if (w)
-			w->new_bandwidth =
-				tegra_dc_calc_win_bandwidth(w->dc, w);
-	}
-
-	return tegra_dc_find_max_bandwidth(windows, n);
+	return max_bw;
 }
 
 /* to save power, call when display memory clients would be idle */
@@ -282,6 +280,9 @@ static inline unsigned long tegra_dc_kbps_to_emc(unsigned long bw)
 	return tegra_emc_bw_to_freq_req(bw) * 1000;
 }
 
+/* computes the EMC floor of the next frame into dc->new_emc_clk_rate.
+ * windows[] are the windows being updated, all of them on one dc; the
+ * floor covers every window of that dc. */
 int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n)
 {
 	unsigned long new_rate;
@@ -295,11 +296,172 @@ int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n)
 	if (tegra_dc_has_multiple_dc())
 		new_rate = ULONG_MAX;
 	else
-		new_rate = tegra_dc_kbps_to_emc(
-			tegra_dc_get_bandwidth(windows, n));
+		new_rate = tegra_dc_kbps_to_emc(tegra_dc_get_bandwidth(dc));
 
 	dc->new_emc_clk_rate = new_rate;
 	trace_set_dynamic_emc(dc);
 
 	return 0;
 }
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * debugfs "bandwidth": write window configurations, one per line as
+ *	bpp in_w out_y out_w out_h v_taps tiled_mult
+ * optionally preceded by a line "pclk v_active" (the current mode is used
+ * otherwise). Reading evaluates tegra_dc_bw_model() for them and prints it
+ * next to what tegra_dc_get_bandwidth() computes for the windows on screen.
+ */
+struct tegra_dc_bw_debug {
+	struct tegra_dc		*dc;
+	int			n;
+	unsigned long		pclk;
+	unsigned		v_active;
+	struct tegra_dc_bw_win	wins[DC_N_WINDOWS];
+};
+
+static void dbg_bw_show_wins(struct seq_file *s,
+	const struct tegra_dc_bw_win *wins, int n, const unsigned long *kbps)
+{
+	int i;
+
+	seq_printf(s, "win bpp  in_w out_y out_w out_h taps tiled kBps\n");
+	for (i = 0; i < n; i++) {
+		const struct tegra_dc_bw_win *w = &wins[i];
+
+		seq_printf(s, "%3d %3u %5u %5u %5u %5u %4u %5u %lu\n",
+			i, w->bpp, w->in_w, w->out_y, w->out_w, w->out_h,
+			w->v_taps, w->tiled_mult, kbps[i]);
+	}
+}
+
+static int dbg_bw_show(struct seq_file *s, void *unused)
+{
+	struct tegra_dc_bw_debug *dbg = s->private;
+	struct tegra_dc *dc = dbg->dc;
+	struct tegra_dc_bw_win cur[DC_N_WINDOWS];
+	unsigned long cur_kbps[DC_N_WINDOWS];
+	unsigned long kbps[DC_N_WINDOWS];
+	unsigned long cur_bw, bw = 0;
+	unsigned long pclk;
+	unsigned v_active;
+
+	mutex_lock(&dc->lock);
+	cur_bw = tegra_dc_calc_bandwidth(dc, cur, cur_kbps);
+	pclk = dbg->pclk ? dbg->pclk : dc->mode.pclk;
+	v_active = dbg->pclk ? dbg->v_active : dc->mode.v_active;
+	if (dbg->n)
+		bw = tegra_dc_bw_model(dbg->wins, dbg->n, pclk, v_active,
+			kbps);
+
+	seq_printf(s, "current (pclk %lu, v_active %u, emc %d Hz):\n",
+		(unsigned long)dc->mode.pclk, (unsigned)dc->mode.v_active,
+		dc->emc_clk_rate);
+	dbg_bw_show_wins(s, cur, DC_N_WINDOWS, cur_kbps);
+	seq_printf(s, "peak: %lu kBps\n", cur_bw);
+
+	if (dbg->n) {
+		seq_printf(s, "\nmodel (pclk %lu, v_active %u):\n",
+			pclk, v_active);
+		dbg_bw_show_wins(s, dbg->wins, dbg->n, kbps);
+		seq_printf(s, "peak: %lu kBps (%+ld vs current)\n",
+			bw, (long)(bw - cur_bw));
+	}
+	mutex_unlock(&dc->lock);
+
+	return 0;
+}
+
+static int dbg_bw_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_bw_show, inode->i_private);
+}
+
+static ssize_t dbg_bw_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct tegra_dc_bw_debug *dbg = s->private;
+	struct tegra_dc_bw_win wins[DC_N_WINDOWS];
+	unsigned long pclk = 0;
+	unsigned v_active = 0;
+	char *kbuf, *p, *line;
+	int n = 0;
+
+	if (count >= PAGE_SIZE)
+		return -EINVAL;
+
+	kbuf = kzalloc(count + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	if (copy_from_user(kbuf, buf, count)) {
+		kfree(kbuf);
+		return -EFAULT;
+	}
+
+	memset(wins, 0, sizeof(wins));
+	p = kbuf;
+	while ((line = strsep(&p, "\n")) != NULL) {
+		struct tegra_dc_bw_win *w = &wins[n];
+		int fields;
+
+		line = strim(line);
+		if (!*line)
+			continue;
+
+		if (n == DC_N_WINDOWS)
+			goto inval;
+
+		fields = sscanf(line, "%u %u %u %u %u %u %u",
+			&w->bpp, &w->in_w, &w->out_y, &w->out_w, &w->out_h,
+			&w->v_taps, &w->tiled_mult);
+		if (fields == 2 && !n && !pclk) {
+			pclk = w->bpp;
+			v_active = w->in_w;
+			memset(w, 0, sizeof(*w));
+			if (!pclk)
+				goto inval;
+			continue;
+		}
+		if (fields != 7)
+			goto inval;
+		n++;
+	}
+	kfree(kbuf);
+
+	mutex_lock(&dbg->dc->lock);
+	memcpy(dbg->wins, wins, sizeof(wins));
+	dbg->n = n;
+	dbg->pclk = pclk;
+	dbg->v_active = v_active;
+	mutex_unlock(&dbg->dc->lock);
+
+	return count;
+
+inval:
+	kfree(kbuf);
+	return -EINVAL;
+}
+
+static const struct file_operations bw_fops = {
+	.open		= dbg_bw_open,
+	.read		= seq_read,
+	.write		= dbg_bw_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+struct dentry *tegra_dc_bw_create_debugfs(struct tegra_dc *dc,
+	struct dentry *dir)
+{
+	struct tegra_dc_bw_debug *dbg;
+
+	dbg = devm_kzalloc(&dc->ndev->dev, sizeof(*dbg), GFP_KERNEL);
+	if (!dbg)
+		return NULL;
+	dbg->dc = dc;
+
+	return debugfs_create_file("bandwidth", S_IRUGO | S_IWUSR, dir, dbg,
+		&bw_fops);
+}
+#endif
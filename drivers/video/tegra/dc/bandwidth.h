@@ -0,0 +1,46 @@
+/*
+ * drivers/video/tegra/dc/bandwidth.h
+ *
+ * Copyright (c) 2010-2013, NVIDIA CORPORATION, All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __DRIVERS_VIDEO_TEGRA_DC_BANDWIDTH_H
+#define __DRIVERS_VIDEO_TEGRA_DC_BANDWIDTH_H
+
+#include <linux/types.h>
+
+/*
+ * What the display memory bandwidth model needs to know about one window.
+ * It is filled from a struct tegra_dc_win, but holds no pointers so that
+ * captured window configurations can be fed to the model directly.
+ * A window with a zero size is disabled.
+ */
+struct tegra_dc_bw_win {
+	unsigned	bpp;		/* bits fetched per source pixel */
+	unsigned	in_w;		/* source pixels fetched per line */
+	unsigned	out_y;
+	unsigned	out_w;
+	unsigned	out_h;
+	unsigned	v_taps;		/* source lines fetched per line */
+	unsigned	tiled_mult;	/* 1 for pitch linear surfaces */
+};
+
+/*
+ * Peak bandwidth in kBps of a display scanning out wins[0..n-1] at pclk Hz
+ * with v_active lines. Per window bandwidths are returned in kbps[].
+ * Depends on nothing but its arguments.
+ */
+unsigned long tegra_dc_bw_model(const struct tegra_dc_bw_win *wins, int n,
+	unsigned long pclk, unsigned v_active, unsigned long *kbps);
+
+#endif
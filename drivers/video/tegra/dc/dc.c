@@ -811,6 +811,10 @@ static void tegra_dc_create_debugfs(struct tegra_dc *dc)
 	if (!retval)
 		goto remove_out;
 
+	retval = tegra_dc_bw_create_debugfs(dc, dc->debugdir);
+	if (!retval)
+		goto remove_out;
+
 	return;
 remove_out:
 	dev_err(&dc->ndev->dev, "could not create debugfs\n");
@@ -1471,6 +1475,112 @@ static void tegra_dc_prism_update_backlight(struct tegra_dc *dc)
 	}
 }
 
+/* Write a pending cursor move to the assembly registers; the caller's
+ * next GENERAL_ACT_REQ latches it at the following vblank. */
+void tegra_dc_cursor_flush_locked(struct tegra_dc *dc)
+{
+	unsigned long flags;
+	bool visible;
+	u32 position;
+	u32 win_options;
+
+	spin_lock_irqsave(&dc->cursor.lock, flags);
+	if (!dc->cursor.dirty) {
+		spin_unlock_irqrestore(&dc->cursor.lock, flags);
+		return;
+	}
+	dc->cursor.dirty = false;
+	visible = dc->cursor.visible;
+	position = dc->cursor.position;
+	spin_unlock_irqrestore(&dc->cursor.lock, flags);
+
+	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
+	if (!!(win_options & CURSOR_ENABLE) != visible) {
+		win_options &= ~CURSOR_ENABLE;
+		if (visible)
+			win_options |= CURSOR_ENABLE;
+		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
+	}
+
+	tegra_dc_writel(dc, position, DC_DISP_CURSOR_POSITION);
+}
+
+/* One-shot panels only scan out when triggered, so the cursor sends a
+ * frame of its own there. */
+static void tegra_dc_cursor_program_locked(struct tegra_dc *dc)
+{
+	bool one_shot = dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE;
+
+	if (!dc->enabled)
+		return;
+
+	/* a clipped frame would cut the cursor, leave it to the next flip */
+	if (one_shot && dc->partial_h)
+		return;
+
+	tegra_dc_io_start(dc);
+	tegra_dc_hold_dc_out(dc);
+
+	tegra_dc_cursor_flush_locked(dc);
+	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
+	if (one_shot) {
+		tegra_dc_program_bandwidth(dc, false);
+		tegra_dc_writel(dc, GENERAL_ACT_REQ | NC_HOST_TRIG,
+				DC_CMD_STATE_CONTROL);
+	} else {
+		tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
+	}
+
+	tegra_dc_release_dc_out(dc);
+	tegra_dc_io_end(dc);
+}
+
+static void tegra_dc_cursor_worker(struct work_struct *work)
+{
+	struct tegra_dc *dc = container_of(work, struct tegra_dc, cursor.work);
+	bool one_shot = dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE;
+
+	/* same ordering as tegra_dc_update_windows() */
+	if (one_shot) {
+		mutex_lock(&dc->one_shot_lock);
+		cancel_delayed_work_sync(&dc->one_shot_work);
+	}
+	mutex_lock(&dc->lock);
+	tegra_dc_cursor_program_locked(dc);
+	if (one_shot && dc->enabled)
+		schedule_delayed_work(&dc->one_shot_work,
+				msecs_to_jiffies(dc->one_shot_delay_ms));
+	mutex_unlock(&dc->lock);
+	if (one_shot)
+		mutex_unlock(&dc->one_shot_lock);
+}
+
+/*
+ * Move the hardware cursor at the next vblank without waiting for queued
+ * flips. If the dc lock is busy the move is left pending for its holder,
+ * tegra_dc_update_windows() or the cursor worker, and a later move
+ * replaces it. One-shot panels always go through the worker, which has to
+ * take one_shot_lock before the dc lock.
+ */
+void tegra_dc_cursor_move(struct tegra_dc *dc, int x, int y, bool visible)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dc->cursor.lock, flags);
+	dc->cursor.position = CURSOR_POSITION(x, y);
+	dc->cursor.visible = visible;
+	dc->cursor.dirty = true;
+	spin_unlock_irqrestore(&dc->cursor.lock, flags);
+
+	if (!(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) &&
+	    mutex_trylock(&dc->lock)) {
+		tegra_dc_cursor_program_locked(dc);
+		mutex_unlock(&dc->lock);
+	} else {
+		queue_work(system_freezable_wq, &dc->cursor.work);
+	}
+}
+
 static void tegra_dc_vblank(struct work_struct *work)
 {
 	struct tegra_dc *dc = container_of(work, struct tegra_dc, vblank_work);
@@ -1485,9 +1595,11 @@ static void tegra_dc_vblank(struct work_struct *work)
 
 	tegra_dc_io_start(dc);
 	tegra_dc_hold_dc_out(dc);
-	/* use the new frame's bandwidth setting instead of max(current, new),
-	 * skip this if we're using tegra_dc_one_shot_worker() */
-	if (!(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE))
+	/* use the new frame's bandwidth setting instead of max(current, new)
+	 * once the flip has latched; until then the old frame may still be
+	 * scanning out. skip this if we're using tegra_dc_one_shot_worker() */
+	if (!(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) &&
+	    !tegra_dc_windows_are_dirty(dc))
 		tegra_dc_program_bandwidth(dc, true);
 
 	/* Clear the V_BLANK_FLIP bit of vblank ref-count if update is clean. */
@@ -2035,8 +2147,9 @@ static bool _tegra_dc_controller_enable(struct tegra_dc *dc)
 	if (dc->out_ops && dc->out_ops->enable)
 		dc->out_ops->enable(dc);
 
-	/* force a full blending update */
+	/* force a full blending and window update */
 	dc->blend.z[0] = -1;
+	memset(dc->win_shadow, 0, sizeof(dc->win_shadow));
 
 	tegra_dc_ext_enable(dc->ext);
 
@@ -2107,8 +2220,9 @@ static bool _tegra_dc_controller_reset_enable(struct tegra_dc *dc)
 	if (dc->out->postpoweron)
 		dc->out->postpoweron();
 
-	/* force a full blending update */
+	/* force a full blending and window update */
 	dc->blend.z[0] = -1;
+	memset(dc->win_shadow, 0, sizeof(dc->win_shadow));
 
 	tegra_dc_ext_enable(dc->ext);
 
@@ -2595,6 +2709,8 @@ static int tegra_dc_probe(struct platform_device *ndev)
 #endif
 	INIT_WORK(&dc->vblank_work, tegra_dc_vblank);
 	dc->vblank_ref_count = 0;
+	spin_lock_init(&dc->cursor.lock);
+	INIT_WORK(&dc->cursor.work, tegra_dc_cursor_worker);
 #if !defined(CONFIG_ARCH_TEGRA_2x_SOC) && !defined(CONFIG_ARCH_TEGRA_3x_SOC)
 	INIT_WORK(&dc->vpulse2_work, tegra_dc_vpulse2);
 #endif
@@ -2759,6 +2875,8 @@ static int __devexit tegra_dc_remove(struct platform_device *ndev)
 	if (dc->ext)
 		tegra_dc_ext_unregister(dc->ext);
 
+	cancel_work_sync(&dc->cursor.work);
+
 	mutex_lock(&dc->lock);
 	if (dc->enabled)
 		_tegra_dc_disable(dc);
@@ -259,10 +259,18 @@ void tegra_dc_clk_disable(struct tegra_dc *dc);
 void tegra_dc_hold_dc_out(struct tegra_dc *dc);
 void tegra_dc_release_dc_out(struct tegra_dc *dc);
 
+/* defined in dc.c, used in window.c and ext/cursor.c */
+void tegra_dc_cursor_flush_locked(struct tegra_dc *dc);
+void tegra_dc_cursor_move(struct tegra_dc *dc, int x, int y, bool visible);
+
 /* defined in bandwidth.c, used in dc.c */
 void tegra_dc_clear_bandwidth(struct tegra_dc *dc);
 void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new);
 int tegra_dc_set_dynamic_emc(struct tegra_dc_win *windows[], int n);
+#ifdef CONFIG_DEBUG_FS
+struct dentry *tegra_dc_bw_create_debugfs(struct tegra_dc *dc,
+	struct dentry *dir);
+#endif
 
 /* defined in mode.c, used in dc.c and window.c */
 int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode);
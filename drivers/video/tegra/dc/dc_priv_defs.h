@@ -60,6 +60,31 @@ struct tegra_dc_blend {
 	unsigned flags[DC_N_WINDOWS];
 };
 
+/* The window attributes last written to a window's assembly registers.
+ * tegra_dc_update_windows() skips register groups whose inputs match. */
+struct tegra_dc_win_shadow {
+	bool		valid;
+	u8		fmt;
+	u8		global_alpha;
+	u32		flags;
+	dma_addr_t	phys_addr;
+	dma_addr_t	phys_addr_u;
+	dma_addr_t	phys_addr_v;
+	unsigned	stride;
+	unsigned	stride_uv;
+	fixed20_12	x;
+	fixed20_12	y;
+	fixed20_12	w;
+	fixed20_12	h;
+	unsigned	out_x;
+	unsigned	out_y;
+	unsigned	out_w;
+	unsigned	out_h;
+	/* blender registers, kept apart as they are written for all windows */
+	bool		blend_valid;
+	u32		blend[5];
+};
+
 struct tegra_dc_out_ops {
 	/* initialize output.  dc clocks are not on at this point */
 	int (*init)(struct tegra_dc *dc);
@@ -75,6 +100,10 @@ struct tegra_dc_out_ops {
 	void (*hold)(struct tegra_dc *dc);
 	/* release output.  dc clocks may turn off after this. */
 	void (*release)(struct tegra_dc *dc);
+	/* limit the next one-shot frame to screen rows [*y, *y + *h),
+	 * growing the band to what the panel can address. rows 0 to
+	 * v_active restore full frames. returns 0 on success. */
+	int (*partial_update)(struct tegra_dc *dc, unsigned *y, unsigned *h);
 	/* idle routine of output.  dc clocks may turn off after this. */
 	void (*idle)(struct tegra_dc *dc);
 	/* suspend output.  dc clocks are on at this point */
@@ -123,6 +152,7 @@ struct tegra_dc {
 
 	struct tegra_dc_win		windows[DC_N_WINDOWS];
 	struct tegra_dc_blend		blend;
+	struct tegra_dc_win_shadow	win_shadow[DC_N_WINDOWS];
 	int				n_windows;
 #ifdef CONFIG_TEGRA_DC_CMU
 	struct tegra_dc_cmu		cmu;
@@ -158,6 +188,16 @@ struct tegra_dc {
 	struct work_struct		vpulse2_work;
 	long				vpulse2_ref_count;
 
+	/* latest cursor position, programmed by whoever next holds the
+	 * dc lock; older positions are simply overwritten */
+	struct {
+		spinlock_t		lock;
+		bool			dirty;
+		bool			visible;
+		u32			position;
+		struct work_struct	work;
+	} cursor;
+
 	struct {
 		u64			underflows;
 		u64			underflows_a;
@@ -176,8 +216,13 @@ struct tegra_dc {
 	struct tegra_dc_lut		fb_lut;
 	struct delayed_work		underflow_work;
 	u32				one_shot_delay_ms;
+	/* rows scanned by the last one-shot frame if it was partial */
+	unsigned			partial_y;
+	unsigned			partial_h;
 	struct delayed_work		one_shot_work;
 	s64				frame_end_timestamp;
+	/* CLOCK_MONOTONIC time the last window update latched */
+	s64				latch_timestamp;
 
 	bool				mode_dirty;
 };
@@ -336,6 +336,7 @@ static ssize_t colorbar_store(struct device *dev,
 
 	tegra_dc_writel(dc, WINDOW_A_SELECT,
 			DC_CMD_DISPLAY_WINDOW_HEADER);
+	dc->win_shadow[0].valid = false;
 
 	val = WIN_ENABLE;
 	tegra_dc_writel(dc, val, DC_WIN_WIN_OPTIONS);
@@ -2935,6 +2935,77 @@ void tegra_dsi_stop_host_cmd_v_blank_dcs(struct tegra_dc_dsi_data * dsi)
 }
 EXPORT_SYMBOL(tegra_dsi_stop_host_cmd_v_blank_dcs);
 
+/* DC needs V_DISP_ACTIVE >= 16, panels commonly address row pairs */
+#define DSI_PARTIAL_MIN_ROWS	16
+#define DSI_PARTIAL_ALIGN	2
+
+/*
+ * Send set_page_address in the init sequence of each DC driven frame so
+ * a command mode panel only takes rows [*y, *y + *h) of the next ones.
+ * Updates always span full rows; set_column_address is never sent.
+ */
+static int tegra_dc_dsi_partial_update(struct tegra_dc *dc,
+					unsigned *y, unsigned *h)
+{
+#define PKT_HEADER_LEN_BYTE	4
+#define CHECKSUM_LEN_BYTE	2
+
+	struct tegra_dc_dsi_data *dsi = tegra_dc_get_outdata(dc);
+	unsigned v_active = dc->mode.v_active;
+	unsigned y0 = round_down(*y, DSI_PARTIAL_ALIGN);
+	unsigned y1 = min(round_up(*y + *h, DSI_PARTIAL_ALIGN), v_active);
+	u8 page[5];
+	struct tegra_dsi_cmd cmd = DSI_CMD_LONG(dsi_command_long_write, page);
+	int err = 0;
+
+	if (dsi->info.video_data_type != TEGRA_DSI_VIDEO_TYPE_COMMAND_MODE ||
+	    !(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) ||
+	    dc->out->dsi->ganged_type ||
+	    v_active < DSI_PARTIAL_MIN_ROWS)
+		return -EINVAL;
+
+	if (y1 - y0 < DSI_PARTIAL_MIN_ROWS) {
+		y1 = min(y0 + DSI_PARTIAL_MIN_ROWS, v_active);
+		y0 = y1 - DSI_PARTIAL_MIN_ROWS;
+	}
+
+	/* the panel addresses full frames until told otherwise */
+	if (!dsi->partial_h && !y0 && y1 == v_active)
+		goto done;
+	if (dsi->partial_y == y0 && dsi->partial_h == y1 - y0)
+		goto done;
+
+	page[0] = DSI_SET_PAGE_ADDRESS;
+	page[1] = y0 >> 8;
+	page[2] = y0 & 0xff;
+	page[3] = (y1 - 1) >> 8;
+	page[4] = (y1 - 1) & 0xff;
+
+	mutex_lock(&dsi->lock);
+	err = tegra_dsi_dcs_pkt_seq_ctrl_init(dsi, &cmd);
+	if (!err) {
+		tegra_dsi_writel(dsi,
+			DSI_INIT_SEQ_CONTROL_DSI_FRAME_INIT_BYTE_COUNT(
+				PKT_HEADER_LEN_BYTE + sizeof(page) +
+				CHECKSUM_LEN_BYTE) |
+			DSI_INIT_SEQ_CONTROL_DSI_SEND_INIT_SEQUENCE(
+				TEGRA_DSI_ENABLE),
+			DSI_INIT_SEQ_CONTROL);
+		dsi->partial_y = y0;
+		dsi->partial_h = y1 - y0;
+	}
+	mutex_unlock(&dsi->lock);
+	if (err)
+		return err;
+done:
+	*y = y0;
+	*h = y1 - y0;
+	return 0;
+
+#undef PKT_HEADER_LEN_BYTE
+#undef CHECKSUM_LEN_BYTE
+}
+
 static int tegra_dsi_bta(struct tegra_dc_dsi_data *dsi)
 {
 	u32 val;
@@ -3376,6 +3447,10 @@ static void _tegra_dc_dsi_enable(struct tegra_dc *dc)
 	mutex_lock(&dsi->lock);
 	tegra_dc_io_start(dc);
 
+	/* panel and init sequence start out addressing full frames */
+	dsi->partial_y = 0;
+	dsi->partial_h = 0;
+
 	/*
 	 * Do not program this panel as the bootloader as has already
 	 * initialized it. This avoids periods of blanking during boot.
@@ -4364,6 +4439,7 @@ struct tegra_dc_out_ops tegra_dc_dsi_ops = {
 	.disable = tegra_dc_dsi_disable,
 	.hold = tegra_dc_dsi_hold_host,
 	.release = tegra_dc_dsi_release_host,
+	.partial_update = tegra_dc_dsi_partial_update,
 #ifdef CONFIG_PM
 	.suspend = tegra_dc_dsi_suspend,
 	.resume = tegra_dc_dsi_resume,
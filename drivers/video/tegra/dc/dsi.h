@@ -110,6 +110,10 @@ struct tegra_dc_dsi_data {
 	struct regulator *avdd_dsi_csi;
 
 	u32 dsi_control_val;
+
+	/* page address sent ahead of each command mode frame */
+	u16 partial_y;
+	u16 partial_h;
 };
 
 #define MAX_DSI_INSTANCE	2
@@ -158,14 +158,18 @@ unlock:
 	return ret;
 }
 
+/*
+ * Cursor moves never wait for flips: moves that arrive within one frame
+ * coalesce into the last one in tegra_dc_cursor_move(), which does not
+ * block, so holding the cursor lock across it only orders the move
+ * against put_cursor and disable.
+ */
 int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 			    struct tegra_dc_ext_cursor *args)
 {
 	struct tegra_dc_ext *ext = user->ext;
-	struct tegra_dc *dc = ext->dc;
-	u32 win_options;
 	bool enable;
-	int ret;
+	int ret = 0;
 
 	mutex_lock(&ext->cursor.lock);
 
@@ -181,34 +185,7 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 
 	enable = !!(args->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE);
 
-	mutex_lock(&dc->lock);
-	tegra_dc_io_start(dc);
-	tegra_dc_hold_dc_out(dc);
-
-	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
-	if (!!(win_options & CURSOR_ENABLE) != enable) {
-		win_options &= ~CURSOR_ENABLE;
-		if (enable)
-			win_options |= CURSOR_ENABLE;
-		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
-	}
-
-	tegra_dc_writel(dc, CURSOR_POSITION(args->x, args->y),
-		DC_DISP_CURSOR_POSITION);
-
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	/* TODO: need to sync here?  hopefully can avoid this, but need to
-	 * figure out interaction w/ rest of GENERAL_ACT_REQ */
-
-	tegra_dc_release_dc_out(dc);
-	tegra_dc_io_end(dc);
-	mutex_unlock(&dc->lock);
-
-	mutex_unlock(&ext->cursor.lock);
-
-	return 0;
+	tegra_dc_cursor_move(ext->dc, args->x, args->y, enable);
 
 unlock:
 	mutex_unlock(&ext->cursor.lock);
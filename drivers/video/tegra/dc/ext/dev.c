@@ -24,6 +24,7 @@
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 #include <linux/export.h>
+#include <linux/sync.h>
 
 #include <video/tegra_dc_ext.h>
 
@@ -51,13 +52,19 @@ struct tegra_dc_ext_flip_win {
 	dma_addr_t				phys_addr_u;
 	dma_addr_t				phys_addr_v;
 	u32					syncpt_max;
+	struct sync_fence			*pre_fence;
 };
 
 struct tegra_dc_ext_flip_data {
 	struct tegra_dc_ext		*ext;
 	struct work_struct		work;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
-	struct list_head		timestamp_node;
+	struct list_head		queue_node;
+	u8				win_mask;
+	bool				mailbox;
+	u32				swap_interval;
+	s64				target_ns;
+	s64				submit_ns;
 };
 
 int tegra_dc_ext_get_num_outputs(void)
@@ -99,10 +106,13 @@ static int tegra_dc_ext_get_window(struct tegra_dc_ext_user *user,
 
 	mutex_lock(&win->lock);
 
-	if (!win->user)
+	if (!win->user) {
 		win->user = user;
-	else if (win->user != user)
+		win->nr_presented = 0;
+		win->nr_dropped = 0;
+	} else if (win->user != user) {
 		ret = -EBUSY;
+	}
 
 	mutex_unlock(&win->lock);
 
@@ -203,19 +213,121 @@ fail:
 	return -EINVAL;
 }
 
+/* Everything about a window but its buffer contents that decides what it
+ * puts on screen. */
+struct tegra_dc_ext_win_geom {
+	u32		flags;
+	unsigned	fmt;
+	unsigned	global_alpha;
+	unsigned	z;
+	fixed20_12	x;
+	fixed20_12	y;
+	fixed20_12	w;
+	fixed20_12	h;
+	unsigned	out_x;
+	unsigned	out_y;
+	unsigned	out_w;
+	unsigned	out_h;
+};
+
+static void tegra_dc_ext_get_geom(const struct tegra_dc_win *win,
+				  struct tegra_dc_ext_win_geom *geom)
+{
+	geom->flags = win->flags & ~TEGRA_WIN_FLAG_DAMAGE;
+	geom->fmt = win->fmt;
+	geom->global_alpha = win->global_alpha;
+	geom->z = win->z;
+	geom->x = win->x;
+	geom->y = win->y;
+	geom->w = win->w;
+	geom->h = win->h;
+	geom->out_x = win->out_x;
+	geom->out_y = win->out_y;
+	geom->out_w = win->out_w;
+	geom->out_h = win->out_h;
+}
+
+/*
+ * Screen rows a flip changes on a window: its damaged source rows mapped
+ * to the output, or where it was and where it is if it moved or changed
+ * format.
+ */
+static void tegra_dc_ext_set_damage(struct tegra_dc_ext_win *ext_win,
+			struct tegra_dc_win *win,
+			const struct tegra_dc_ext_win_geom *old,
+			const struct tegra_dc_ext_flip_windowattr *attr)
+{
+	struct tegra_dc_ext_win_geom cur;
+	unsigned y0 = UINT_MAX;
+	unsigned y1 = 0;
+	bool lost;
+
+	mutex_lock(&ext_win->queue_lock);
+	lost = ext_win->damage_lost;
+	ext_win->damage_lost = false;
+	mutex_unlock(&ext_win->queue_lock);
+
+	if (lost || !(attr->flags & TEGRA_DC_EXT_FLIP_FLAG_DAMAGE))
+		return;
+
+	tegra_dc_ext_get_geom(win, &cur);
+
+	if (memcmp(old, &cur, sizeof(cur))) {
+		if (old->flags & TEGRA_WIN_FLAG_ENABLED) {
+			y0 = old->out_y;
+			y1 = old->out_y + old->out_h;
+		}
+		if (WIN_IS_ENABLED(win)) {
+			y0 = min(y0, win->out_y);
+			y1 = max(y1, win->out_y + win->out_h);
+		}
+	} else if (WIN_IS_ENABLED(win)) {
+		unsigned src_y = dfixed_trunc(win->y);
+		unsigned src_h = dfixed_trunc(win->h);
+		unsigned top = max_t(unsigned, attr->damage_y, src_y);
+		unsigned bottom = min_t(unsigned,
+			attr->damage_y + attr->damage_h, src_y + src_h);
+
+		if (!src_h || win->flags & (TEGRA_WIN_FLAG_INVERT_V |
+					    TEGRA_WIN_FLAG_SCAN_COLUMN)) {
+			y0 = win->out_y;
+			y1 = win->out_y + win->out_h;
+		} else if (top < bottom) {
+			y0 = win->out_y + (top - src_y) * win->out_h / src_h;
+			y1 = win->out_y + DIV_ROUND_UP(
+				(bottom - src_y) * win->out_h, src_h);
+
+			/* the scaling filter reaches one row further */
+			if (src_h != win->out_h) {
+				y0 = max(y0, win->out_y + 1) - 1;
+				y1 = min(y1 + 1, win->out_y + win->out_h);
+			}
+		}
+	}
+
+	win->flags |= TEGRA_WIN_FLAG_DAMAGE;
+	win->damage_y = y0 < y1 ? y0 : 0;
+	win->damage_h = y0 < y1 ? y1 - y0 : 0;
+}
+
 static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 			       struct tegra_dc_win *win,
 			       const struct tegra_dc_ext_flip_win *flip_win)
 {
 	int err = 0;
 	struct tegra_dc_ext_win *ext_win = &ext->win[win->idx];
+	struct tegra_dc_ext_win_geom old_geom;
 #ifndef CONFIG_TEGRA_SIMULATION_PLATFORM
 	s64 timestamp_ns;
 #endif
 
+	tegra_dc_ext_get_geom(win, &old_geom);
+
 	if (flip_win->handle[TEGRA_DC_Y] == NULL) {
 		win->flags = 0;
 		memset(ext_win->cur_handle, 0, sizeof(ext_win->cur_handle));
+		tegra_dc_ext_set_damage(ext_win, win, &old_geom,
+				&flip_win->attr);
 		return 0;
 	}
 
@@ -266,18 +378,14 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 	win->stride = flip_win->attr.stride;
 	win->stride_uv = flip_win->attr.stride_uv;
 
+	tegra_dc_ext_set_damage(ext_win, win, &old_geom,
+				&flip_win->attr);
+
 	err = tegra_dc_ext_check_windowattr(ext, win);
 	if (err < 0)
 		dev_err(&ext->dc->ndev->dev,
 				"Window atrributes are invalid.\n");
 
-	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
-		nvhost_syncpt_wait_timeout_ext(ext->dc->ndev,
-				flip_win->attr.pre_syncpt_id,
-				flip_win->attr.pre_syncpt_val,
-				msecs_to_jiffies(500), NULL);
-	}
-
 #ifndef CONFIG_TEGRA_SIMULATION_PLATFORM
 	timestamp_ns = timespec_to_ns(&flip_win->attr.timestamp);
 
@@ -327,11 +435,241 @@ int tegra_dc_unset_flip_callback()
 }
 EXPORT_SYMBOL(tegra_dc_unset_flip_callback);
 
+/*
+ * Waits for the buffers of every window in the flip to be ready.  A buffer
+ * whose pre-fence never signals must not be scanned out, so such a flip
+ * fails as a whole and none of its windows are programmed.  A pre-syncpt
+ * that times out is only logged, as it always was.
+ */
+static int tegra_dc_ext_wait_pre_fences(struct tegra_dc_ext *ext,
+					struct tegra_dc_ext_flip_data *data)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (flip_win->attr.index < 0)
+			continue;
+
+#ifdef CONFIG_SYNC
+		if (flip_win->pre_fence) {
+			int err = sync_fence_wait(flip_win->pre_fence, 500);
+
+			if (err < 0) {
+				dev_err(&ext->dc->ndev->dev,
+					"window %d pre-fence wait failed (%d)\n",
+					flip_win->attr.index, err);
+				return err;
+			}
+			continue;
+		}
+#endif
+		if ((s32)flip_win->attr.pre_syncpt_id >= 0)
+			nvhost_syncpt_wait_timeout_ext(ext->dc->ndev,
+					flip_win->attr.pre_syncpt_id,
+					flip_win->attr.pre_syncpt_val,
+					msecs_to_jiffies(500), NULL);
+	}
+	return 0;
+}
+
+static void tegra_dc_ext_put_pre_fences(struct tegra_dc_ext_flip_data *data)
+{
+#ifdef CONFIG_SYNC
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		if (data->win[i].pre_fence) {
+			sync_fence_put(data->win[i].pre_fence);
+			data->win[i].pre_fence = NULL;
+		}
+	}
+#endif
+}
+
+/*
+ * Every flip is queued on the window that runs its work, in submission
+ * order.  The worker looks one entry ahead to decide whether the flip at
+ * the head can ever be seen: in mailbox mode a newer flip covering the
+ * same windows always wins, and two flips aimed at the same
+ * vblank collapse into the later one.  A dropped flip never reaches the
+ * window registers.  Called with queue_lock held.
+ */
+static bool tegra_dc_ext_flip_is_stale(struct tegra_dc_ext *ext,
+				       struct tegra_dc_ext_win *queue_win,
+				       struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_flip_data *next;
+
+	if (list_is_last(&data->queue_node, &queue_win->flip_queue))
+		return false;
+
+	next = list_entry(data->queue_node.next,
+			  struct tegra_dc_ext_flip_data, queue_node);
+
+	/* a flip is only superseded if every one of its windows is */
+	if ((next->win_mask & data->win_mask) != data->win_mask)
+		return false;
+
+	if (data->mailbox)
+		return true;
+
+	if (data->target_ns && next->target_ns)
+		return !tegra_dc_does_vsync_separate(ext->dc,
+				next->target_ns, data->target_ns);
+
+	return false;
+}
+
+/*
+ * With a swap interval of N, keep the previous frame on screen for N
+ * vblanks.  The first of them has passed once tegra_dc_sync_windows()
+ * returned for that frame; wait out the rest before programming the next.
+ */
+static void tegra_dc_ext_wait_swap_interval(struct tegra_dc_ext *ext,
+					    struct tegra_dc_ext_win *queue_win,
+					    u32 swap_interval)
+{
+#ifndef CONFIG_TEGRA_SIMULATION_PLATFORM
+	struct tegra_dc *dc = ext->dc;
+	s64 target;
+
+	if (swap_interval < 2 || !queue_win->present_ns || !dc->frametime_ns)
+		return;
+
+	target = queue_win->present_ns +
+		(swap_interval - 1) * dc->frametime_ns - dc->frametime_ns / 2;
+
+	tegra_dc_config_frame_end_intr(dc, true);
+	wait_event_interruptible_timeout(dc->timestamp_wq,
+			dc->frame_end_timestamp >= target,
+			msecs_to_jiffies(500));
+	tegra_dc_config_frame_end_intr(dc, false);
+#endif
+}
+
+/*
+ * Vblank syncpt value of the frame that latched the last update: the
+ * current one, less the vblanks since.
+ */
+static u32 tegra_dc_ext_latch_vblank(struct tegra_dc *dc, s64 latch_ns)
+{
+	u32 vblank = nvhost_syncpt_read_ext(dc->ndev, dc->vblank_syncpt);
+	s64 since = ktime_to_ns(ktime_get()) - latch_ns;
+
+	if (dc->frametime_ns && since > 0)
+		vblank -= div64_s64(since, dc->frametime_ns);
+
+	return vblank;
+}
+
+static void tegra_dc_ext_flip_retire(struct tegra_dc_ext *ext,
+				     struct tegra_dc_ext_flip_data *data,
+				     bool presented)
+{
+	struct timespec tm = CURRENT_TIME;
+	s64 now = timespec_to_ns(&tm);
+	struct tegra_dc_ext_flip_event ev = {
+		.flags = presented ? 0 : TEGRA_DC_EXT_FLIP_EVENT_SKIPPED,
+		.win_mask = data->win_mask,
+		.submit_ns = data->submit_ns,
+	};
+	int i;
+
+	if (presented) {
+		ev.latch_ns = ext->dc->latch_timestamp;
+		ev.latch_vblank = tegra_dc_ext_latch_vblank(ext->dc,
+							    ev.latch_ns);
+		/* present_ns is the latch time, on CLOCK_REALTIME */
+		now += ev.latch_ns - ktime_to_ns(ktime_get());
+	}
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int index = flip_win->attr.index;
+		struct tegra_dc_ext_win *ext_win;
+
+		if (index < 0)
+			continue;
+
+		ext_win = &ext->win[index];
+
+		ev.post_syncpt_id = tegra_dc_get_syncpt_id(ext->dc, index);
+		ev.post_syncpt_val = flip_win->syncpt_max;
+
+		mutex_lock(&ext_win->queue_lock);
+		ext_win->last_syncpt_val = flip_win->syncpt_max;
+		if (presented) {
+			ext_win->present_ns = now;
+			ext_win->nr_presented++;
+		} else {
+			ext_win->nr_dropped++;
+			ext_win->damage_lost = true;
+		}
+		mutex_unlock(&ext_win->queue_lock);
+	}
+
+	tegra_dc_ext_queue_flip_event(ext, &ev);
+}
+
+/*
+ * Pins the buffers of a flip that is about to be programmed.  Flips only
+ * hold a reference to their buffers while queued, so one dropped from the
+ * queue never costs a pin.  On failure nothing is left pinned.
+ */
+static int tegra_dc_ext_pin_flip(struct tegra_dc_ext *ext,
+				 struct tegra_dc_ext_flip_data *data)
+{
+	int i, j = 0;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		dma_addr_t *phys[TEGRA_DC_NUM_PLANES] = {
+			[TEGRA_DC_Y] = &flip_win->phys_addr,
+			[TEGRA_DC_U] = &flip_win->phys_addr_u,
+			[TEGRA_DC_V] = &flip_win->phys_addr_v,
+		};
+
+		if (flip_win->attr.index < 0)
+			continue;
+
+		for (j = 0; j < TEGRA_DC_NUM_PLANES; j++) {
+			dma_addr_t addr;
+
+			if (!flip_win->handle[j]) {
+				*phys[j] = j == TEGRA_DC_Y ? -1 : 0;
+				continue;
+			}
+
+			addr = nvmap_pin(ext->nvmap, flip_win->handle[j]);
+			/* XXX this isn't correct for non-pointers... */
+			if (IS_ERR((void *)addr))
+				goto fail;
+			*phys[j] = addr;
+		}
+	}
+
+	return 0;
+
+fail:
+	dev_err(&ext->dc->ndev->dev, "failed to pin flip buffers\n");
+	for (; i >= 0; i--, j = TEGRA_DC_NUM_PLANES) {
+		while (j--) {
+			if (data->win[i].handle[j])
+				nvmap_unpin(ext->nvmap,
+					    data->win[i].handle[j]);
+		}
+	}
+	return -ENOMEM;
+}
+
 static void tegra_dc_ext_flip_worker(struct work_struct *work)
 {
 	struct tegra_dc_ext_flip_data *data =
 		container_of(work, struct tegra_dc_ext_flip_data, work);
 	struct tegra_dc_ext *ext = data->ext;
+	struct tegra_dc_ext_win *queue_win = NULL;
 	struct tegra_dc_win *wins[DC_N_WINDOWS];
 	struct nvmap_handle_ref *unpin_handles[DC_N_WINDOWS *
 					       TEGRA_DC_NUM_PLANES];
@@ -341,65 +679,72 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
-		int j = 0, index = flip_win->attr.index;
-		struct tegra_dc_win *win;
+		int index = flip_win->attr.index;
 		struct tegra_dc_ext_win *ext_win;
-		struct tegra_dc_ext_flip_data *temp = NULL;
-		s64 head_timestamp = 0;
 
 		if (index < 0)
 			continue;
 
-		win = tegra_dc_get_window(ext->dc, index);
 		ext_win = &ext->win[index];
+		queue_win = ext_win;
 
 		if (!(atomic_dec_and_test(&ext_win->nr_pending_flips)) &&
 			(flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_CURSOR))
 			skip_flip = true;
+	}
 
-		mutex_lock(&ext_win->queue_lock);
-		list_for_each_entry(temp, &ext_win->timestamp_queue,
-				timestamp_node) {
-			if (j == 0) {
-				if (unlikely(temp != data))
-					dev_err(&win->dc->ndev->dev,
-							"work queue did NOT dequeue head!!!");
-				else
-					head_timestamp =
-						timespec_to_ns(&flip_win->attr.timestamp);
-			} else {
-				s64 timestamp =
-					timespec_to_ns(&temp->win[i].attr.timestamp);
-
-				skip_flip = !tegra_dc_does_vsync_separate(ext->dc,
-						timestamp, head_timestamp);
-				/* Look ahead only one flip */
-				break;
-			}
-			j++;
-		}
-		if (!list_empty(&ext_win->timestamp_queue))
-			list_del(&data->timestamp_node);
-		mutex_unlock(&ext_win->queue_lock);
+	/* sanitize_flip_args() refuses these, nothing was pinned or queued */
+	if (WARN_ON(!queue_win)) {
+		tegra_dc_ext_put_pre_fences(data);
+		kfree(data);
+		return;
+	}
 
-		if (skip_flip)
-			old_handle = flip_win->handle[TEGRA_DC_Y];
-		else
-			old_handle = ext_win->cur_handle[TEGRA_DC_Y];
+	/* the last window in the flip is the one it was queued on */
+	mutex_lock(&queue_win->queue_lock);
+	if (unlikely(list_first_entry(&queue_win->flip_queue,
+			struct tegra_dc_ext_flip_data, queue_node) != data))
+		dev_err(&ext->dc->ndev->dev,
+			"work queue did NOT dequeue head!!!");
+	if (!skip_flip)
+		skip_flip = tegra_dc_ext_flip_is_stale(ext, queue_win, data);
+	list_del(&data->queue_node);
+	mutex_unlock(&queue_win->queue_lock);
 
-		if (old_handle) {
-			int j;
-			for (j = 0; j < TEGRA_DC_NUM_PLANES; j++) {
-				if (skip_flip)
-					old_handle = flip_win->handle[j];
-				else
-					old_handle = ext_win->cur_handle[j];
+	if (!skip_flip && tegra_dc_ext_wait_pre_fences(ext, data))
+		skip_flip = true;
 
-				if (!old_handle)
-					continue;
+	if (!skip_flip)
+		tegra_dc_ext_wait_swap_interval(ext, queue_win,
+						data->swap_interval);
 
-				unpin_handles[nr_unpin++] = old_handle;
-			}
+	/* only a flip that is going to be shown gets its buffers pinned */
+	if (!skip_flip && tegra_dc_ext_pin_flip(ext, data))
+		skip_flip = true;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+		int j, index = flip_win->attr.index;
+		struct tegra_dc_win *win;
+		struct tegra_dc_ext_win *ext_win;
+
+		if (index < 0)
+			continue;
+
+		win = tegra_dc_get_window(ext->dc, index);
+		ext_win = &ext->win[index];
+
+		/* a dropped flip releases its own buffers, not the current */
+		for (j = 0; j < TEGRA_DC_NUM_PLANES; j++) {
+			if (skip_flip)
+				old_handle = flip_win->handle[j];
+			else
+				old_handle = ext_win->cur_handle[j];
+
+			if (!old_handle)
+				continue;
+
+			unpin_handles[nr_unpin++] = old_handle;
 		}
 
 		if (!skip_flip)
@@ -410,7 +755,6 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 
 	if (!skip_flip) {
 		tegra_dc_update_windows(wins, nr_win);
-		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
 		if (!tegra_dc_has_multiple_dc()) {
 			spin_lock(&flip_callback_lock);
@@ -431,12 +775,17 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 		}
 	}
 
-	/* unpin and deref previous front buffers */
+	tegra_dc_ext_flip_retire(ext, data, !skip_flip);
+
+	/* unpin and deref previous front buffers, a dropped flip's own
+	 * buffers were never pinned */
 	for (i = 0; i < nr_unpin; i++) {
-		nvmap_unpin(ext->nvmap, unpin_handles[i]);
+		if (!skip_flip)
+			nvmap_unpin(ext->nvmap, unpin_handles[i]);
 		nvmap_free(ext->nvmap, unpin_handles[i]);
 	}
 
+	tegra_dc_ext_put_pre_fences(data);
 	kfree(data);
 }
 
@@ -524,6 +873,11 @@ static int sanitize_flip_args(struct tegra_dc_ext_user *user,
 		if (used_windows & BIT(index))
 			return -EINVAL;
 
+		if (args->win[i].swap_interval >
+				TEGRA_DC_EXT_FLIP_MAX_SWAP_INTERVAL)
+			args->win[i].swap_interval =
+				TEGRA_DC_EXT_FLIP_MAX_SWAP_INTERVAL;
+
 		used_windows |= BIT(index);
 	}
 
@@ -533,14 +887,27 @@ static int sanitize_flip_args(struct tegra_dc_ext_user *user,
 	return 0;
 }
 
+static int tegra_dc_ext_get_pre_fence(struct tegra_dc_ext_flip_win *flip_win)
+{
+	if (!(flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE))
+		return 0;
+
+#ifdef CONFIG_SYNC
+	flip_win->pre_fence = sync_fence_fdget(flip_win->attr.pre_fence_fd);
+	if (flip_win->pre_fence)
+		return 0;
+#endif
+	return -EINVAL;
+}
+
 static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
-			     struct tegra_dc_ext_flip *args)
+			     struct tegra_dc_ext_flip *args,
+			     int *post_fence_fd)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_ext_flip_data *data;
 	int work_index = -1;
 	int i, ret = 0;
-	bool has_timestamp = false;
 
 #ifdef CONFIG_ANDROID
 	int index_check[DC_N_WINDOWS] = {0, };
@@ -560,6 +927,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 
 	INIT_WORK(&data->work, tegra_dc_ext_flip_worker);
 	data->ext = ext;
+	data->mailbox = true;
+	data->submit_ns = ktime_to_ns(ktime_get());
 
 #ifdef CONFIG_ANDROID
 	for (i = 0; i < DC_N_WINDOWS; i++) {
@@ -581,41 +950,38 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		int index = args->win[i].index;
 
 		memcpy(&flip_win->attr, &args->win[i], sizeof(flip_win->attr));
-		if (timespec_to_ns(&flip_win->attr.timestamp))
-			has_timestamp = true;
 
 		if (index < 0)
 			continue;
 
-		ret = tegra_dc_ext_pin_window(user, flip_win->attr.buff_id,
-					      &flip_win->handle[TEGRA_DC_Y],
-					      &flip_win->phys_addr);
+		data->win_mask |= BIT(index);
+		if (!(flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_MAILBOX))
+			data->mailbox = false;
+		data->swap_interval = max(data->swap_interval,
+					  flip_win->attr.swap_interval);
+		data->target_ns = max(data->target_ns,
+				timespec_to_ns(&flip_win->attr.timestamp));
+
+		ret = tegra_dc_ext_get_pre_fence(flip_win);
 		if (ret)
 			goto fail_pin;
 
-		if (flip_win->attr.buff_id_u) {
-			ret = tegra_dc_ext_pin_window(user,
-					      flip_win->attr.buff_id_u,
-					      &flip_win->handle[TEGRA_DC_U],
-					      &flip_win->phys_addr_u);
-			if (ret)
-				goto fail_pin;
-		} else {
-			flip_win->handle[TEGRA_DC_U] = NULL;
-			flip_win->phys_addr_u = 0;
-		}
+		/* buffers are pinned by the worker, see
+		 * tegra_dc_ext_pin_flip() */
+		ret = tegra_dc_ext_dup_window(user, flip_win->attr.buff_id,
+					      &flip_win->handle[TEGRA_DC_Y]);
+		if (ret)
+			goto fail_pin;
 
-		if (flip_win->attr.buff_id_v) {
-			ret = tegra_dc_ext_pin_window(user,
-					      flip_win->attr.buff_id_v,
-					      &flip_win->handle[TEGRA_DC_V],
-					      &flip_win->phys_addr_v);
-			if (ret)
-				goto fail_pin;
-		} else {
-			flip_win->handle[TEGRA_DC_V] = NULL;
-			flip_win->phys_addr_v = 0;
-		}
+		ret = tegra_dc_ext_dup_window(user, flip_win->attr.buff_id_u,
+					      &flip_win->handle[TEGRA_DC_U]);
+		if (ret)
+			goto fail_pin;
+
+		ret = tegra_dc_ext_dup_window(user, flip_win->attr.buff_id_v,
+					      &flip_win->handle[TEGRA_DC_V]);
+		if (ret)
+			goto fail_pin;
 	}
 
 	ret = lock_windows_for_flip(user, args);
@@ -655,15 +1021,19 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		ret = -EINVAL;
 		goto unlock;
 	}
-	if (has_timestamp) {
-		mutex_lock(&ext->win[work_index].queue_lock);
-		list_add_tail(&data->timestamp_node, &ext->win[work_index].timestamp_queue);
-		mutex_unlock(&ext->win[work_index].queue_lock);
-	}
+	mutex_lock(&ext->win[work_index].queue_lock);
+	list_add_tail(&data->queue_node, &ext->win[work_index].flip_queue);
+	mutex_unlock(&ext->win[work_index].queue_lock);
 	queue_work(ext->win[work_index].flip_wq, &data->work);
 
 	unlock_windows_for_flip(user, args);
 
+	/* the flip is queued, a missing fence just falls back to the syncpt */
+	if (post_fence_fd && nvhost_sync_create_fence_ext(ext->dc->ndev,
+			args->post_syncpt_id, args->post_syncpt_val,
+			"tegra_dc_flip", post_fence_fd))
+		*post_fence_fd = -1;
+
 	return 0;
 
 unlock:
@@ -676,15 +1046,35 @@ fail_pin:
 			if (!data->win[i].handle[j])
 				continue;
 
-			nvmap_unpin(ext->nvmap, data->win[i].handle[j]);
 			nvmap_free(ext->nvmap, data->win[i].handle[j]);
 		}
 	}
+	tegra_dc_ext_put_pre_fences(data);
 	kfree(data);
 
 	return ret;
 }
 
+static int tegra_dc_ext_get_flip_feedback(struct tegra_dc_ext_user *user,
+				struct tegra_dc_ext_flip_feedback *args)
+{
+	struct tegra_dc_ext_win *win;
+
+	if (args->win >= DC_N_WINDOWS)
+		return -EINVAL;
+
+	win = &user->ext->win[args->win];
+
+	mutex_lock(&win->queue_lock);
+	args->post_syncpt_val = win->last_syncpt_val;
+	args->present_ns = win->present_ns;
+	args->presented = win->nr_presented;
+	args->dropped = win->nr_dropped;
+	mutex_unlock(&win->queue_lock);
+
+	return 0;
+}
+
 static int tegra_dc_ext_set_csc(struct tegra_dc_ext_user *user,
 				struct tegra_dc_ext_csc *new_csc)
 {
@@ -883,7 +1273,40 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		if (copy_from_user(&args, user_arg, sizeof(args)))
 			return -EFAULT;
 
-		ret = tegra_dc_ext_flip(user, &args);
+		ret = tegra_dc_ext_flip(user, &args, NULL);
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return ret;
+	}
+
+	case TEGRA_DC_EXT_FLIP_FENCE:
+	{
+		struct tegra_dc_ext_flip_fence args;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		args.post_fence_fd = -1;
+		ret = tegra_dc_ext_flip(user, &args.flip, &args.post_fence_fd);
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return ret;
+	}
+
+	case TEGRA_DC_EXT_GET_FLIP_FEEDBACK:
+	{
+		struct tegra_dc_ext_flip_feedback args;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_ext_get_flip_feedback(user, &args);
 
 		if (copy_to_user(user_arg, &args, sizeof(args)))
 			return -EFAULT;
@@ -1021,6 +1444,7 @@ static int tegra_dc_open(struct inode *inode, struct file *filp)
 
 	ext = container_of(inode->i_cdev, struct tegra_dc_ext, cdev);
 	user->ext = ext;
+	tegra_dc_ext_flip_events_open(user);
 
 	filp->private_data = user;
 
@@ -1069,7 +1493,7 @@ static int tegra_dc_ext_setup_windows(struct tegra_dc_ext *ext)
 
 		mutex_init(&win->lock);
 		mutex_init(&win->queue_lock);
-		INIT_LIST_HEAD(&win->timestamp_queue);
+		INIT_LIST_HEAD(&win->flip_queue);
 	}
 
 	return 0;
@@ -1087,6 +1511,8 @@ static const struct file_operations tegra_dc_devops = {
 	.owner =		THIS_MODULE,
 	.open =			tegra_dc_open,
 	.release =		tegra_dc_release,
+	.read =			tegra_dc_ext_flip_event_read,
+	.poll =			tegra_dc_ext_flip_event_poll,
 	.unlocked_ioctl =	tegra_dc_ioctl,
 };
 
@@ -1137,6 +1563,7 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 		goto cleanup_nvmap;
 
 	mutex_init(&ext->cursor.lock);
+	tegra_dc_ext_flip_events_init(ext);
 
 	head_count++;
 
@@ -195,3 +195,107 @@ int tegra_dc_ext_queue_hotplug(struct tegra_dc_ext_control *control, int output)
 
 	return 0;
 }
+
+void tegra_dc_ext_flip_events_init(struct tegra_dc_ext *ext)
+{
+	spin_lock_init(&ext->flip_events.lock);
+	init_waitqueue_head(&ext->flip_events.wq);
+}
+
+/* A new reader sees the flips that retire after it opened the device. */
+void tegra_dc_ext_flip_events_open(struct tegra_dc_ext_user *user)
+{
+	struct tegra_dc_ext *ext = user->ext;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ext->flip_events.lock, flags);
+	user->flip_event_seq = ext->flip_events.seq;
+	spin_unlock_irqrestore(&ext->flip_events.lock, flags);
+}
+
+void tegra_dc_ext_queue_flip_event(struct tegra_dc_ext *ext,
+				   struct tegra_dc_ext_flip_event *ev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ext->flip_events.lock, flags);
+	ev->seq = ext->flip_events.seq++;
+	ext->flip_events.ring[ev->seq % TEGRA_DC_EXT_FLIP_EVENTS] = *ev;
+	spin_unlock_irqrestore(&ext->flip_events.lock, flags);
+
+	wake_up_interruptible(&ext->flip_events.wq);
+}
+
+/*
+ * Take the next event for user, skipping ahead if it was overwritten.
+ * Returns false if there is none yet.
+ */
+static bool get_next_flip_event(struct tegra_dc_ext_user *user,
+				struct tegra_dc_ext_flip_event *ev)
+{
+	struct tegra_dc_ext *ext = user->ext;
+	unsigned long flags;
+	bool ret = false;
+	u32 seq;
+
+	spin_lock_irqsave(&ext->flip_events.lock, flags);
+	seq = ext->flip_events.seq;
+	if (seq - user->flip_event_seq > TEGRA_DC_EXT_FLIP_EVENTS)
+		user->flip_event_seq = seq - TEGRA_DC_EXT_FLIP_EVENTS;
+	if (user->flip_event_seq != seq) {
+		*ev = ext->flip_events.ring[user->flip_event_seq %
+					    TEGRA_DC_EXT_FLIP_EVENTS];
+		user->flip_event_seq++;
+		ret = true;
+	}
+	spin_unlock_irqrestore(&ext->flip_events.lock, flags);
+
+	return ret;
+}
+
+static bool flip_event_pending(struct tegra_dc_ext_user *user)
+{
+	return ACCESS_ONCE(user->ext->flip_events.seq) !=
+		ACCESS_ONCE(user->flip_event_seq);
+}
+
+unsigned int tegra_dc_ext_flip_event_poll(struct file *filp, poll_table *wait)
+{
+	struct tegra_dc_ext_user *user = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &user->ext->flip_events.wq, wait);
+
+	if (flip_event_pending(user))
+		mask |= POLLIN | POLLRDNORM;
+
+	return mask;
+}
+
+/* Only whole events are returned, as many as fit in buf. */
+ssize_t tegra_dc_ext_flip_event_read(struct file *filp, char __user *buf,
+				     size_t size, loff_t *ppos)
+{
+	struct tegra_dc_ext_user *user = filp->private_data;
+	struct tegra_dc_ext_flip_event ev;
+	ssize_t copied = 0;
+	int ret;
+
+	if (size < sizeof(ev))
+		return -EINVAL;
+
+	if (!(filp->f_flags & O_NONBLOCK)) {
+		ret = wait_event_interruptible(user->ext->flip_events.wq,
+					       flip_event_pending(user));
+		if (ret)
+			return ret;
+	}
+
+	while (size - copied >= sizeof(ev) && get_next_flip_event(user, &ev)) {
+		if (copy_to_user(buf + copied, &ev, sizeof(ev)))
+			return copied ? copied : -EFAULT;
+		copied += sizeof(ev);
+	}
+
+	return copied ? copied : -EAGAIN;
+}
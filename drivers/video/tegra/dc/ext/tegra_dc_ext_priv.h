@@ -23,6 +23,8 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include <mach/dc.h>
 #include <linux/nvmap.h>
@@ -34,6 +36,9 @@ struct tegra_dc_ext;
 struct tegra_dc_ext_user {
 	struct tegra_dc_ext	*ext;
 	struct nvmap_client	*nvmap;
+
+	/* seq of the next flip event to read */
+	u32			flip_event_seq;
 };
 
 enum {
@@ -59,11 +64,25 @@ struct tegra_dc_ext_win {
 
 	atomic_t		nr_pending_flips;
 
+	/* Protects flip_queue and the present feedback below */
 	struct mutex		queue_lock;
 
-	struct list_head	timestamp_queue;
+	/* Flips queued on flip_wq, oldest first */
+	struct list_head	flip_queue;
+
+	/* Feedback on the last retired flip */
+	u32			last_syncpt_val;
+	s64			present_ns;
+	u32			nr_presented;
+	u32			nr_dropped;
+
+	/* A flip was dropped, so the next one's damage is not against what
+	 * is on screen */
+	bool			damage_lost;
 };
 
+#define TEGRA_DC_EXT_FLIP_EVENTS	64
+
 struct tegra_dc_ext {
 	struct tegra_dc			*dc;
 
@@ -81,6 +100,15 @@ struct tegra_dc_ext {
 	} cursor;
 
 	bool				enabled;
+
+	/* Last TEGRA_DC_EXT_FLIP_EVENTS flip events; every reader keeps its
+	 * own position, so queuing never waits on them */
+	struct {
+		spinlock_t			lock;
+		wait_queue_head_t		wq;
+		u32				seq;
+		struct tegra_dc_ext_flip_event	ring[TEGRA_DC_EXT_FLIP_EVENTS];
+	} flip_events;
 };
 
 #define TEGRA_DC_EXT_EVENT_MASK_ALL \
@@ -127,6 +155,8 @@ struct tegra_dc_ext_control {
 extern int tegra_dc_ext_devno;
 extern struct class *tegra_dc_ext_class;
 
+extern int tegra_dc_ext_dup_window(struct tegra_dc_ext_user *user, u32 id,
+				   struct nvmap_handle_ref **handle);
 extern int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
 				   struct nvmap_handle_ref **handle,
 				   dma_addr_t *phys_addr);
@@ -148,6 +178,16 @@ extern ssize_t tegra_dc_ext_event_read(struct file *filp, char __user *buf,
 				       size_t size, loff_t *ppos);
 extern unsigned int tegra_dc_ext_event_poll(struct file *, poll_table *);
 
+extern void tegra_dc_ext_flip_events_init(struct tegra_dc_ext *ext);
+extern void tegra_dc_ext_flip_events_open(struct tegra_dc_ext_user *user);
+extern void tegra_dc_ext_queue_flip_event(struct tegra_dc_ext *ext,
+					  struct tegra_dc_ext_flip_event *ev);
+extern ssize_t tegra_dc_ext_flip_event_read(struct file *filp,
+					    char __user *buf,
+					    size_t size, loff_t *ppos);
+extern unsigned int tegra_dc_ext_flip_event_poll(struct file *,
+						 poll_table *);
+
 extern int tegra_dc_ext_get_num_outputs(void);
 
 #endif /* __TEGRA_DC_EXT_PRIV_H */
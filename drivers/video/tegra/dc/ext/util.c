@@ -27,19 +27,19 @@
 
 #include "tegra_dc_ext_priv.h"
 
-int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
-			    struct nvmap_handle_ref **handle,
-			    dma_addr_t *phys_addr)
+/*
+ * Takes a reference to buffer id in the dc_ext driver's nvmap context,
+ * without pinning it.
+ */
+int tegra_dc_ext_dup_window(struct tegra_dc_ext_user *user, u32 id,
+			    struct nvmap_handle_ref **handle)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct nvmap_handle_ref *win_dup;
 	struct nvmap_handle *win_handle;
-	dma_addr_t phys;
 
 	if (!id) {
 		*handle = NULL;
-		*phys_addr = -1;
-
 		return 0;
 	}
 
@@ -64,6 +64,31 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
 	if (IS_ERR(win_dup))
 		return PTR_ERR(win_dup);
 
+	*handle = win_dup;
+
+	return 0;
+}
+
+int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, u32 id,
+			    struct nvmap_handle_ref **handle,
+			    dma_addr_t *phys_addr)
+{
+	struct tegra_dc_ext *ext = user->ext;
+	struct nvmap_handle_ref *win_dup;
+	dma_addr_t phys;
+	int err;
+
+	err = tegra_dc_ext_dup_window(user, id, &win_dup);
+	if (err)
+		return err;
+
+	if (!win_dup) {
+		*handle = NULL;
+		*phys_addr = -1;
+
+		return 0;
+	}
+
 	phys = nvmap_pin(ext->nvmap, win_dup);
 	/* XXX this isn't correct for non-pointers... */
 	if (IS_ERR((void *)phys)) {
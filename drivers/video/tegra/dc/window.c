@@ -118,88 +118,112 @@ static u32 blend_3win(int idx, unsigned long behind_mask,
 		return BLEND(NOKEY, FIX, 0x0, 0x0);
 }
 
-static void tegra_dc_blend_parallel(struct tegra_dc *dc,
-				struct tegra_dc_blend *blend)
+/* Write the blender words of window idx unless its shadow holds them.
+ * Returns the window's update bit if anything was written. */
+static unsigned long tegra_dc_blend_write(struct tegra_dc *dc, int idx,
+	const u32 *words, const u32 *regs, int n, bool valid)
 {
+	struct tegra_dc_win_shadow *s = &dc->win_shadow[idx];
+	int i;
+
+	if (s->blend_valid && !memcmp(s->blend, words, n * sizeof(*words)))
+		return 0;
+
+	tegra_dc_writel(dc, WINDOW_A_SELECT << idx,
+			DC_CMD_DISPLAY_WINDOW_HEADER);
+	for (i = 0; i < n; i++)
+		if (!s->blend_valid || s->blend[i] != words[i])
+			tegra_dc_writel(dc, words[i], regs[i]);
+
+	memset(s->blend, 0, sizeof(s->blend));
+	memcpy(s->blend, words, n * sizeof(*words));
+	s->blend_valid = valid;
+
+	return WIN_A_ACT_REQ << idx;
+}
+
+static unsigned long tegra_dc_blend_parallel(struct tegra_dc *dc,
+				struct tegra_dc_blend *blend, bool valid)
+{
+	static const u32 regs[] = {
+		DC_WIN_BLEND_NOKEY, DC_WIN_BLEND_1WIN, DC_WIN_BLEND_2WIN_X,
+		DC_WIN_BLEND_2WIN_Y, DC_WIN_BLEND_3WIN_XY,
+	};
 	int win_num = dc->gen1_blend_num;
 	unsigned long mask = BIT(win_num) - 1;
+	unsigned long update_mask = 0;
 
 	tegra_dc_io_start(dc);
 	while (mask) {
 		int idx = get_topmost_window(blend->z, &mask, win_num);
+		u32 words[ARRAY_SIZE(regs)];
 
-		tegra_dc_writel(dc, WINDOW_A_SELECT << idx,
-				DC_CMD_DISPLAY_WINDOW_HEADER);
-		tegra_dc_writel(dc, BLEND(NOKEY, FIX, 0xff, 0xff),
-				DC_WIN_BLEND_NOKEY);
-		tegra_dc_writel(dc, BLEND(NOKEY, FIX, 0xff, 0xff),
-				DC_WIN_BLEND_1WIN);
-		tegra_dc_writel(dc, blend_2win(idx, mask, blend->flags, 0,
-				win_num), DC_WIN_BLEND_2WIN_X);
-		tegra_dc_writel(dc, blend_2win(idx, mask, blend->flags, 1,
-				win_num), DC_WIN_BLEND_2WIN_Y);
-		tegra_dc_writel(dc, blend_3win(idx, mask, blend->flags,
-				win_num), DC_WIN_BLEND_3WIN_XY);
+		words[0] = BLEND(NOKEY, FIX, 0xff, 0xff);
+		words[1] = BLEND(NOKEY, FIX, 0xff, 0xff);
+		words[2] = blend_2win(idx, mask, blend->flags, 0, win_num);
+		words[3] = blend_2win(idx, mask, blend->flags, 1, win_num);
+		words[4] = blend_3win(idx, mask, blend->flags, win_num);
+
+		update_mask |= tegra_dc_blend_write(dc, idx, words, regs,
+				ARRAY_SIZE(regs), valid);
 	}
 	tegra_dc_io_end(dc);
+
+	return update_mask;
 }
 
-static void tegra_dc_blend_sequential(struct tegra_dc *dc,
-				struct tegra_dc_blend *blend)
+static unsigned long tegra_dc_blend_sequential(struct tegra_dc *dc,
+				struct tegra_dc_blend *blend, bool valid)
 {
+	static const u32 regs[] = {
+		DC_WINBUF_BLEND_LAYER_CONTROL, DC_WINBUF_BLEND_MATCH_SELECT,
+		DC_WINBUF_BLEND_ALPHA_1BIT,
+	};
+	unsigned long update_mask = 0;
 	int i;
 
 	tegra_dc_io_start(dc);
 	for (i = 0; i < DC_N_WINDOWS; i++) {
+		u32 words[ARRAY_SIZE(regs)];
+		int n = ARRAY_SIZE(regs);
+
 		if (!tegra_dc_feature_is_gen2_blender(dc, i))
 			continue;
 
-		tegra_dc_writel(dc, WINDOW_A_SELECT << i,
-				DC_CMD_DISPLAY_WINDOW_HEADER);
-
 		if (blend->flags[i] & TEGRA_WIN_FLAG_BLEND_COVERAGE) {
-			tegra_dc_writel(dc,
-					WIN_K1(0xff) |
-					WIN_K2(0xff) |
-					WIN_BLEND_ENABLE,
-					DC_WINBUF_BLEND_LAYER_CONTROL);
-
-			tegra_dc_writel(dc,
+			words[0] = WIN_K1(0xff) |
+				WIN_K2(0xff) |
+				WIN_BLEND_ENABLE;
+			words[1] =
 			WIN_BLEND_FACT_SRC_COLOR_MATCH_SEL_K1_TIMES_SRC |
 			WIN_BLEND_FACT_DST_COLOR_MATCH_SEL_NEG_K1_TIMES_SRC |
 			WIN_BLEND_FACT_SRC_ALPHA_MATCH_SEL_K2 |
-			WIN_BLEND_FACT_DST_ALPHA_MATCH_SEL_ZERO,
-			DC_WINBUF_BLEND_MATCH_SELECT);
-
-			tegra_dc_writel(dc,
-					WIN_ALPHA_1BIT_WEIGHT0(0) |
-					WIN_ALPHA_1BIT_WEIGHT1(0xff),
-					DC_WINBUF_BLEND_ALPHA_1BIT);
+			WIN_BLEND_FACT_DST_ALPHA_MATCH_SEL_ZERO;
+			words[2] = WIN_ALPHA_1BIT_WEIGHT0(0) |
+				WIN_ALPHA_1BIT_WEIGHT1(0xff);
 		} else if (blend->flags[i] & TEGRA_WIN_FLAG_BLEND_PREMULT) {
-			tegra_dc_writel(dc,
-					WIN_K1(0xff) |
-					WIN_K2(0xff) |
-					WIN_BLEND_ENABLE,
-					DC_WINBUF_BLEND_LAYER_CONTROL);
-
-			tegra_dc_writel(dc,
+			words[0] = WIN_K1(0xff) |
+				WIN_K2(0xff) |
+				WIN_BLEND_ENABLE;
+			words[1] =
 			WIN_BLEND_FACT_SRC_COLOR_MATCH_SEL_K1 |
 			WIN_BLEND_FACT_DST_COLOR_MATCH_SEL_NEG_K1 |
 			WIN_BLEND_FACT_SRC_ALPHA_MATCH_SEL_K2 |
-			WIN_BLEND_FACT_DST_ALPHA_MATCH_SEL_ZERO,
-			DC_WINBUF_BLEND_MATCH_SELECT);
-
-			tegra_dc_writel(dc,
-					WIN_ALPHA_1BIT_WEIGHT0(0) |
-					WIN_ALPHA_1BIT_WEIGHT1(0xff),
-					DC_WINBUF_BLEND_ALPHA_1BIT);
+			WIN_BLEND_FACT_DST_ALPHA_MATCH_SEL_ZERO;
+			words[2] = WIN_ALPHA_1BIT_WEIGHT0(0) |
+				WIN_ALPHA_1BIT_WEIGHT1(0xff);
 		} else {
-			tegra_dc_writel(dc,
-					WIN_BLEND_BYPASS,
-					DC_WINBUF_BLEND_LAYER_CONTROL);
+			/* the other two are not used in bypass */
+			words[0] = WIN_BLEND_BYPASS;
+			n = 1;
 		}
+
+		update_mask |= tegra_dc_blend_write(dc, i, words, regs, n,
+				valid);
 	}
 	tegra_dc_io_end(dc);
+
+	return update_mask;
 }
 
 /* does not support syncing windows on multiple dcs in one call */
@@ -314,15 +338,210 @@ static inline void tegra_dc_update_scaling(struct tegra_dc *dc,
 		H_DDA_INC(h_dda), DC_WIN_DDA_INCREMENT);
 }
 
+/* Whether the registers computed from these attributes need rewriting. */
+static inline bool win_format_changed(struct tegra_dc_win_shadow *s,
+	struct tegra_dc_win *win)
+{
+	return !s->valid || s->fmt != win->fmt;
+}
+
+static inline bool win_geometry_changed(struct tegra_dc_win_shadow *s,
+	struct tegra_dc_win *win)
+{
+	return win_format_changed(s, win) ||
+		((s->flags ^ win->flags) & TEGRA_WIN_FLAG_SCAN_COLUMN) ||
+		s->x.full != win->x.full || s->y.full != win->y.full ||
+		s->w.full != win->w.full || s->h.full != win->h.full ||
+		s->out_x != win->out_x || s->out_y != win->out_y ||
+		s->out_w != win->out_w || s->out_h != win->out_h;
+}
+
+static inline bool win_layout_changed(struct tegra_dc_win_shadow *s,
+	struct tegra_dc_win *win)
+{
+	return win_format_changed(s, win) ||
+		((s->flags ^ win->flags) & (TEGRA_WIN_FLAG_INVERT_H |
+			TEGRA_WIN_FLAG_INVERT_V | TEGRA_WIN_FLAG_TILED)) ||
+		s->x.full != win->x.full || s->y.full != win->y.full ||
+		s->w.full != win->w.full || s->h.full != win->h.full ||
+		s->stride != win->stride || s->stride_uv != win->stride_uv;
+}
+
+static inline void tegra_dc_win_shadow_save(struct tegra_dc_win_shadow *s,
+	struct tegra_dc_win *win, bool valid)
+{
+	s->valid = valid;
+	s->fmt = win->fmt;
+	s->global_alpha = win->global_alpha;
+	s->flags = win->flags;
+	s->phys_addr = win->phys_addr;
+	s->phys_addr_u = win->phys_addr_u;
+	s->phys_addr_v = win->phys_addr_v;
+	s->stride = win->stride;
+	s->stride_uv = win->stride_uv;
+	s->x = win->x;
+	s->y = win->y;
+	s->w = win->w;
+	s->h = win->h;
+	s->out_x = win->out_x;
+	s->out_y = win->out_y;
+	s->out_w = win->out_w;
+	s->out_h = win->out_h;
+}
+
+/* Screen rows changed by updating windows[], or false if that is unknown
+ * and the whole frame has to be sent. */
+static bool tegra_dc_damage_rows(struct tegra_dc *dc,
+	struct tegra_dc_win *windows[], int n, unsigned *y, unsigned *h)
+{
+	unsigned v_active = dc->mode.v_active;
+	unsigned y0 = v_active;
+	unsigned y1 = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		struct tegra_dc_win *win = windows[i];
+
+		if (!(win->flags & TEGRA_WIN_FLAG_DAMAGE))
+			return false;
+		if (!win->damage_h)
+			continue;
+		y0 = min(y0, win->damage_y);
+		y1 = max(y1, win->damage_y + win->damage_h);
+	}
+	y1 = min(y1, v_active);
+
+	if (y0 >= y1 || (!y0 && y1 == v_active))
+		return false;
+
+	*y = y0;
+	*h = y1 - y0;
+	return true;
+}
+
+/* Windows crossing the edges of the band are clipped by moving their
+ * source offset, which only works if they scan lines one to one. */
+static bool tegra_dc_can_clip_rows(struct tegra_dc *dc, unsigned y,
+	unsigned h)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_win *win = &dc->windows[i];
+
+		if (!WIN_IS_ENABLED(win))
+			continue;
+		if (win->out_y + win->out_h <= y || win->out_y >= y + h)
+			continue;
+		if (win->out_y >= y && win->out_y + win->out_h <= y + h)
+			continue;
+
+		if (win->h.full != dfixed_const(win->out_h) ||
+		    win->flags & (TEGRA_WIN_FLAG_INVERT_V |
+				TEGRA_WIN_FLAG_SCAN_COLUMN))
+			return false;
+	}
+
+	return true;
+}
+
+/* Program every window as seen through rows [y, y + h) of the screen,
+ * and shrink the active area to them. */
+static unsigned long tegra_dc_clip_rows(struct tegra_dc *dc, unsigned y,
+	unsigned h)
+{
+	unsigned long update_mask = 0;
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		struct tegra_dc_win *win = &dc->windows[i];
+		unsigned top = max(win->out_y, y);
+		unsigned bottom = min(win->out_y + win->out_h, y + h);
+		unsigned Bpp = tegra_dc_fmt_bpp(win->fmt) / 8;
+
+		if (!WIN_IS_ENABLED(win))
+			continue;
+
+		tegra_dc_writel(dc, WINDOW_A_SELECT << win->idx,
+				DC_CMD_DISPLAY_WINDOW_HEADER);
+		update_mask |= WIN_A_ACT_REQ << win->idx;
+		win->dirty = 1;
+		dc->win_shadow[win->idx].valid = false;
+
+		if (top >= bottom) {
+			tegra_dc_writel(dc, 0, DC_WIN_WIN_OPTIONS);
+			continue;
+		}
+
+		tegra_dc_writel(dc,
+			V_POSITION(top - y) | H_POSITION(win->out_x),
+			DC_WIN_POSITION);
+		tegra_dc_writel(dc,
+			V_SIZE(bottom - top) | H_SIZE(win->out_w),
+			DC_WIN_SIZE);
+
+		if (top == win->out_y && bottom == win->out_y + win->out_h)
+			continue;
+
+		tegra_dc_writel(dc, dfixed_trunc(win->y) + top - win->out_y,
+				DC_WINBUF_ADDR_V_OFFSET);
+		if (tegra_dc_feature_has_scaling(dc, win->idx))
+			tegra_dc_writel(dc,
+				V_PRESCALED_SIZE(bottom - top) |
+				H_PRESCALED_SIZE(dfixed_trunc(win->w) * Bpp),
+				DC_WIN_PRESCALED_SIZE);
+	}
+
+	tegra_dc_writel(dc, dc->mode.h_active | (h << 16),
+			DC_DISP_DISP_ACTIVE);
+
+	return update_mask;
+}
+
+/* Scan only rows [y, y + h) in the next one-shot frame if the output can
+ * take them, otherwise go back to full frames. A visible cursor moves on
+ * its own frames, which must not be clipped.
+ * Returns the windows reprogrammed for it. */
+static unsigned long tegra_dc_set_partial(struct tegra_dc *dc, bool partial,
+	unsigned y, unsigned h)
+{
+	unsigned full_y = 0;
+	unsigned full_h = dc->mode.v_active;
+
+	if (partial && !ACCESS_ONCE(dc->cursor.visible) &&
+	    !dc->out_ops->partial_update(dc, &y, &h) &&
+	    tegra_dc_can_clip_rows(dc, y, h)) {
+		dc->partial_y = y;
+		dc->partial_h = h;
+		return tegra_dc_clip_rows(dc, y, h);
+	}
+
+	if (dc->out_ops && dc->out_ops->partial_update)
+		dc->out_ops->partial_update(dc, &full_y, &full_h);
+
+	if (dc->partial_h) {
+		tegra_dc_writel(dc,
+			dc->mode.h_active | (dc->mode.v_active << 16),
+			DC_DISP_DISP_ACTIVE);
+		dc->partial_h = 0;
+	}
+
+	return 0;
+}
+
 /* Does not support updating windows on multiple dcs in one call.
  * Requires a matching sync_windows to avoid leaking ref-count on clocks. */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 {
 	struct tegra_dc *dc;
+	struct tegra_dc_win *all_windows[DC_N_WINDOWS];
 	unsigned long update_mask = GENERAL_ACT_REQ;
 	unsigned long win_options;
 	bool update_blend_par = false;
 	bool update_blend_seq = false;
+	unsigned long blend_mask = 0;
+	bool one_shot, partial = false;
+	unsigned partial_y = 0, partial_h = 0;
 	int i;
 
 	dc = windows[0]->dc;
@@ -354,8 +573,22 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		tegra_dc_writel(dc, WRITE_MUX_ASSEMBLY | READ_MUX_ASSEMBLY,
 			DC_CMD_STATE_ACCESS);
 
+	one_shot = (dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) && !no_vsync;
+	if (one_shot && dc->out_ops && dc->out_ops->partial_update)
+		partial = tegra_dc_damage_rows(dc, windows, n,
+				&partial_y, &partial_h);
+
+	/* the last frame was scanned clipped, put every window back */
+	if (one_shot && dc->partial_h) {
+		for (i = 0; i < DC_N_WINDOWS; i++)
+			all_windows[i] = &dc->windows[i];
+		windows = all_windows;
+		n = DC_N_WINDOWS;
+	}
+
 	for (i = 0; i < n; i++) {
 		struct tegra_dc_win *win = windows[i];
+		struct tegra_dc_win_shadow *shadow = &dc->win_shadow[win->idx];
 		bool scan_column = 0;
 		fixed20_12 h_offset, v_offset;
 		bool invert_h = (win->flags & TEGRA_WIN_FLAG_INVERT_H) != 0;
@@ -396,17 +629,28 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 			continue;
 		}
 
-		tegra_dc_writel(dc, win->fmt & 0x1f, DC_WIN_COLOR_DEPTH);
-		tegra_dc_writel(dc, win->fmt >> 6, DC_WIN_BYTE_SWAP);
+		if (win_format_changed(shadow, win)) {
+			tegra_dc_writel(dc, win->fmt & 0x1f,
+				DC_WIN_COLOR_DEPTH);
+			tegra_dc_writel(dc, win->fmt >> 6, DC_WIN_BYTE_SWAP);
+		}
 
-		tegra_dc_writel(dc,
-			V_POSITION(win->out_y) | H_POSITION(win->out_x),
-			DC_WIN_POSITION);
-		tegra_dc_writel(dc,
-			V_SIZE(win->out_h) | H_SIZE(win->out_w),
-			DC_WIN_SIZE);
+		if (win_geometry_changed(shadow, win)) {
+			tegra_dc_writel(dc,
+				V_POSITION(win->out_y) | H_POSITION(win->out_x),
+				DC_WIN_POSITION);
+			tegra_dc_writel(dc,
+				V_SIZE(win->out_h) | H_SIZE(win->out_w),
+				DC_WIN_SIZE);
 
-		/* Check scan_column flag to set window size and scaling. */
+			/* Update scaling registers if window supports
+			 * scaling. */
+			if (likely(tegra_dc_feature_has_scaling(dc, win->idx)))
+				tegra_dc_update_scaling(dc, win, Bpp, Bpp_bw,
+								scan_column);
+		}
+
+		/* Check scan_column flag to set the filters. */
 		win_options = WIN_ENABLE;
 		if (scan_column) {
 			win_options |= WIN_SCAN_COLUMN;
@@ -417,62 +661,64 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 			win_options |= V_FILTER_ENABLE(filter_v);
 		}
 
-		/* Update scaling registers if window supports scaling. */
-		if (likely(tegra_dc_feature_has_scaling(dc, win->idx)))
-			tegra_dc_update_scaling(dc, win, Bpp, Bpp_bw,
-								scan_column);
-
-#if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
-		tegra_dc_writel(dc, 0, DC_WIN_BUF_STRIDE);
-		tegra_dc_writel(dc, 0, DC_WIN_UV_BUF_STRIDE);
-#endif
-		tegra_dc_writel(dc, (unsigned long)win->phys_addr,
-			DC_WINBUF_START_ADDR);
-
-		if (!yuvp) {
-			tegra_dc_writel(dc, win->stride, DC_WIN_LINE_STRIDE);
-		} else {
+		if (!shadow->valid || shadow->phys_addr != win->phys_addr)
+			tegra_dc_writel(dc, (unsigned long)win->phys_addr,
+				DC_WINBUF_START_ADDR);
+		if (yuvp && (!shadow->valid ||
+			     shadow->phys_addr_u != win->phys_addr_u ||
+			     shadow->phys_addr_v != win->phys_addr_v)) {
 			tegra_dc_writel(dc,
 				(unsigned long)win->phys_addr_u,
 				DC_WINBUF_START_ADDR_U);
 			tegra_dc_writel(dc,
 				(unsigned long)win->phys_addr_v,
 				DC_WINBUF_START_ADDR_V);
-			tegra_dc_writel(dc,
-				LINE_STRIDE(win->stride) |
-				UV_LINE_STRIDE(win->stride_uv),
-				DC_WIN_LINE_STRIDE);
-		}
-
-		if (invert_h) {
-			h_offset.full = win->x.full + win->w.full;
-			h_offset.full = dfixed_floor(h_offset) * Bpp;
-			h_offset.full -= dfixed_const(1);
-		} else {
-			h_offset.full = dfixed_floor(win->x) * Bpp;
 		}
 
-		v_offset = win->y;
-		if (invert_v) {
-			v_offset.full += win->h.full - dfixed_const(1);
-		}
-
-		tegra_dc_writel(dc, dfixed_trunc(h_offset),
-				DC_WINBUF_ADDR_H_OFFSET);
-		tegra_dc_writel(dc, dfixed_trunc(v_offset),
-				DC_WINBUF_ADDR_V_OFFSET);
-
-		if (tegra_dc_feature_has_tiling(dc, win->idx)) {
-			if (WIN_IS_TILED(win))
-				tegra_dc_writel(dc,
-					DC_WIN_BUFFER_ADDR_MODE_TILE |
-					DC_WIN_BUFFER_ADDR_MODE_TILE_UV,
-					DC_WIN_BUFFER_ADDR_MODE);
+		if (win_layout_changed(shadow, win)) {
+#if defined(CONFIG_ARCH_TEGRA_2x_SOC) || defined(CONFIG_ARCH_TEGRA_3x_SOC)
+			tegra_dc_writel(dc, 0, DC_WIN_BUF_STRIDE);
+			tegra_dc_writel(dc, 0, DC_WIN_UV_BUF_STRIDE);
+#endif
+			if (!yuvp)
+				tegra_dc_writel(dc, win->stride,
+					DC_WIN_LINE_STRIDE);
 			else
 				tegra_dc_writel(dc,
-					DC_WIN_BUFFER_ADDR_MODE_LINEAR |
-					DC_WIN_BUFFER_ADDR_MODE_LINEAR_UV,
-					DC_WIN_BUFFER_ADDR_MODE);
+					LINE_STRIDE(win->stride) |
+					UV_LINE_STRIDE(win->stride_uv),
+					DC_WIN_LINE_STRIDE);
+
+			if (invert_h) {
+				h_offset.full = win->x.full + win->w.full;
+				h_offset.full = dfixed_floor(h_offset) * Bpp;
+				h_offset.full -= dfixed_const(1);
+			} else {
+				h_offset.full = dfixed_floor(win->x) * Bpp;
+			}
+
+			v_offset = win->y;
+			if (invert_v) {
+				v_offset.full += win->h.full - dfixed_const(1);
+			}
+
+			tegra_dc_writel(dc, dfixed_trunc(h_offset),
+					DC_WINBUF_ADDR_H_OFFSET);
+			tegra_dc_writel(dc, dfixed_trunc(v_offset),
+					DC_WINBUF_ADDR_V_OFFSET);
+
+			if (tegra_dc_feature_has_tiling(dc, win->idx)) {
+				if (WIN_IS_TILED(win))
+					tegra_dc_writel(dc,
+					    DC_WIN_BUFFER_ADDR_MODE_TILE |
+					    DC_WIN_BUFFER_ADDR_MODE_TILE_UV,
+					    DC_WIN_BUFFER_ADDR_MODE);
+				else
+					tegra_dc_writel(dc,
+					    DC_WIN_BUFFER_ADDR_MODE_LINEAR |
+					    DC_WIN_BUFFER_ADDR_MODE_LINEAR_UV,
+					    DC_WIN_BUFFER_ADDR_MODE);
+			}
 		}
 
 		if (yuv)
@@ -481,13 +727,12 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 			win_options |= COLOR_EXPAND;
 
 #if  defined(CONFIG_ARCH_TEGRA_3x_SOC) || defined(CONFIG_ARCH_TEGRA_11x_SOC)
-		if (win->global_alpha == 255) {
-			tegra_dc_writel(dc, 0, DC_WIN_GLOBAL_ALPHA);
-		} else {
-			tegra_dc_writel(dc, GLOBAL_ALPHA_ENABLE |
-				win->global_alpha, DC_WIN_GLOBAL_ALPHA);
+		if (!shadow->valid || shadow->global_alpha != win->global_alpha)
+			tegra_dc_writel(dc, win->global_alpha == 255 ? 0 :
+				GLOBAL_ALPHA_ENABLE | win->global_alpha,
+				DC_WIN_GLOBAL_ALPHA);
+		if (win->global_alpha != 255)
 			win_options |= CP_ENABLE;
-		}
 #endif
 
 		if (win->ppflags & TEGRA_WIN_PPFLAG_CP_ENABLE)
@@ -496,27 +741,43 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		win_options |= H_DIRECTION_DECREMENT(invert_h);
 		win_options |= V_DIRECTION_DECREMENT(invert_v);
 
+		/* always written, the lut code also sets CP_ENABLE here */
 		tegra_dc_writel(dc, win_options, DC_WIN_WIN_OPTIONS);
 
+		/* with no_vsync the active registers were written, and the
+		 * assembly copy no longer matches the shadow */
+		tegra_dc_win_shadow_save(shadow, win, !no_vsync);
+
 		win->dirty = no_vsync ? 0 : 1;
 
 		trace_window_update(dc, win);
 	}
 
-	if (update_blend_par || update_blend_seq) {
-		if (update_blend_par)
-			tegra_dc_blend_parallel(dc, &dc->blend);
-		if (update_blend_seq)
-			tegra_dc_blend_sequential(dc, &dc->blend);
-		for (i = 0; i < DC_N_WINDOWS; i++) {
-			if (!no_vsync)
-				dc->windows[i].dirty = 1;
-			update_mask |= WIN_A_ACT_REQ << i;
-		}
+	/* only windows whose blender words changed need to latch them */
+	if (update_blend_par)
+		blend_mask |= tegra_dc_blend_parallel(dc, &dc->blend,
+				!no_vsync);
+	if (update_blend_seq)
+		blend_mask |= tegra_dc_blend_sequential(dc, &dc->blend,
+				!no_vsync);
+	for (i = 0; i < DC_N_WINDOWS; i++) {
+		if (!(blend_mask & (WIN_A_ACT_REQ << i)))
+			continue;
+		if (!no_vsync)
+			dc->windows[i].dirty = 1;
+		update_mask |= WIN_A_ACT_REQ << i;
 	}
 
+	if (one_shot)
+		update_mask |= tegra_dc_set_partial(dc,
+			partial && !blend_mask,
+			partial_y, partial_h);
+
 	tegra_dc_set_dynamic_emc(windows, n);
 
+	/* a cursor move that found the lock taken goes out with us */
+	tegra_dc_cursor_flush_locked(dc);
+
 	tegra_dc_writel(dc, update_mask << 8, DC_CMD_STATE_CONTROL);
 
 	tegra_dc_writel(dc, FRAME_END_INT | V_BLANK_INT, DC_CMD_INT_STATUS);
@@ -566,16 +827,19 @@ void tegra_dc_trigger_windows(struct tegra_dc *dc)
 	u32 val, i;
 	u32 completed = 0;
 	u32 dirty = 0;
+	u32 latched = 0;
 
 	val = tegra_dc_readl(dc, DC_CMD_STATE_CONTROL);
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 #ifdef CONFIG_TEGRA_SIMULATION_PLATFORM
 		/* FIXME: this is not needed when the simulator
 		   clears WIN_x_UPDATE bits as in HW */
+		latched |= dc->windows[i].dirty;
 		dc->windows[i].dirty = 0;
 		completed = 1;
 #else
 		if (!(val & (WIN_A_ACT_REQ << i))) {
+			latched |= dc->windows[i].dirty;
 			dc->windows[i].dirty = 0;
 			completed = 1;
 		} else {
@@ -590,6 +854,9 @@ void tegra_dc_trigger_windows(struct tegra_dc *dc)
 			tegra_dc_mask_interrupt(dc, FRAME_END_INT);
 	}
 
+	if (latched)
+		dc->latch_timestamp = ktime_to_ns(ktime_get());
+
 	if (completed)
 		wake_up(&dc->wq);
 }
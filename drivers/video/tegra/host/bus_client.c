@@ -52,6 +52,7 @@
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
 #include "nvhost_hwctx.h"
+#include "nvhost_sync.h"
 
 static int validate_reg(struct platform_device *ndev, u32 offset, int count)
 {
@@ -143,6 +144,8 @@ static int nvhost_channelrelease(struct inode *inode, struct file *filp)
 	if (priv->job)
 		nvhost_job_put(priv->job);
 
+	if (priv->memmgr)
+		nvhost_job_reloc_cache_flush(priv->ch, priv->memmgr);
 	mem_op().put_mgr(priv->memmgr);
 	kfree(priv);
 	return 0;
@@ -407,8 +410,12 @@ fail:
 	return err;
 }
 
+/* with fence_fd, the fence is installed in the fd returned in args->fence,
+ * unless out_fence is given: then the fd is only reserved and the fence is
+ * handed back for the caller to install or drop */
 static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
-		struct nvhost_submit_args *args)
+		struct nvhost_submit_args *args, const u32 *cmdbuf_gens,
+		bool fence_fd, struct sync_fence **out_fence)
 {
 	struct nvhost_job *job;
 	int num_cmdbufs = args->num_cmdbufs;
@@ -419,12 +426,17 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 	struct nvhost_reloc_shift __user *reloc_shifts = args->reloc_shifts;
 	struct nvhost_waitchk __user *waitchks = args->waitchks;
 	struct nvhost_syncpt_incr syncpt_incr;
+	struct nvhost_syncpt *sp = &nvhost_get_host(ctx->ch->dev)->syncpt;
+	int fd = -1;
 	int err;
 
 	/* We don't yet support other than one nvhost_syncpt_incrs per submit */
 	if (args->num_syncpt_incrs != 1)
 		return -EINVAL;
 
+	if (fence_fd && !IS_ENABLED(CONFIG_TEGRA_GRHOST_SYNC))
+		return -EINVAL;
+
 	job = nvhost_job_alloc(ctx->ch,
 			ctx->hwctx,
 			args->num_cmdbufs,
@@ -446,6 +458,9 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 			goto fail;
 		nvhost_job_add_gather(job,
 				cmdbuf.mem, cmdbuf.words, cmdbuf.offset);
+		if (cmdbuf_gens)
+			job->gathers[job->num_gathers - 1].gen =
+				*cmdbuf_gens++;
 		num_cmdbufs--;
 		cmdbufs++;
 	}
@@ -476,7 +491,17 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 		job->num_gathers, job->num_relocs, job->num_waitchk,
 		job->syncpt_id, job->syncpt_incrs);
 
-	err = nvhost_job_pin(job, &nvhost_get_host(ctx->ch->dev)->syncpt);
+	/* once the job is queued the call must not fail, so the fd is
+	 * reserved up front */
+	if (fence_fd) {
+		fd = get_unused_fd();
+		if (fd < 0) {
+			err = fd;
+			goto fail;
+		}
+	}
+
+	err = nvhost_job_pin(job, sp);
 	if (err)
 		goto fail;
 
@@ -491,7 +516,31 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 	if (err)
 		goto fail_submit;
 
-	args->fence = job->syncpt_end;
+	if (fence_fd) {
+		struct nvhost_ctrl_sync_fence_info pt = {
+			.id = job->syncpt_id,
+			.thresh = job->syncpt_end,
+		};
+
+		struct sync_fence *fence;
+
+		if (nvhost_sync_fence_create(sp, &pt, 1,
+				ctx->ch->dev->name, &fence)) {
+			/* no fence to hand out: wait for the job instead,
+			 * -1 tells user space there is nothing to wait for */
+			put_unused_fd(fd);
+			nvhost_syncpt_wait(sp, job->syncpt_id,
+					job->syncpt_end);
+			fd = -1;
+		} else if (out_fence) {
+			*out_fence = fence;
+		} else {
+			nvhost_sync_fence_install(fence, fd);
+		}
+		args->fence = fd;
+	} else {
+		args->fence = job->syncpt_end;
+	}
 
 	nvhost_job_put(job);
 
@@ -500,10 +549,79 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 fail_submit:
 	nvhost_job_unpin(job);
 fail:
+	if (fd >= 0)
+		put_unused_fd(fd);
 	nvhost_job_put(job);
 	return err;
 }
 
+static int nvhost_ioctl_channel_submit_batch(
+		struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_batch_args *args)
+{
+	struct nvhost_submit_args __user *submits = args->submits;
+	u32 __user *cmdbuf_gens = args->cmdbuf_gens;
+	u32 *gens = NULL;
+	bool fence_fd = args->flags & NVHOST_SUBMIT_BATCH_FLAG_SYNC_FENCE_FD;
+	int err = 0;
+	u32 i;
+
+	args->num_submitted = 0;
+
+	if ((args->flags & ~NVHOST_SUBMIT_BATCH_FLAG_SYNC_FENCE_FD) ||
+	    !args->num_submits ||
+	    args->num_submits > NVHOST_SUBMIT_BATCH_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < args->num_submits; i++) {
+		struct nvhost_submit_args submit;
+		struct sync_fence *fence = NULL;
+
+		if (copy_from_user(&submit, &submits[i], sizeof(submit))) {
+			err = -EFAULT;
+			break;
+		}
+
+		if (cmdbuf_gens) {
+			kfree(gens);
+			gens = kcalloc(submit.num_cmdbufs, sizeof(*gens),
+					GFP_KERNEL);
+			if (!gens) {
+				err = -ENOMEM;
+				break;
+			}
+			if (copy_from_user(gens, cmdbuf_gens,
+					submit.num_cmdbufs * sizeof(*gens))) {
+				err = -EFAULT;
+				break;
+			}
+			cmdbuf_gens += submit.num_cmdbufs;
+		}
+
+		err = nvhost_ioctl_channel_submit(ctx, &submit, gens,
+				fence_fd, &fence);
+		if (err)
+			break;
+
+		args->num_submitted++;
+		if (put_user(submit.fence, &submits[i].fence)) {
+			/* user space never learns the fd, don't install it */
+			if (fence) {
+				nvhost_sync_fence_put(fence);
+				put_unused_fd(submit.fence);
+			}
+			err = -EFAULT;
+			break;
+		}
+		if (fence)
+			nvhost_sync_fence_install(fence, submit.fence);
+	}
+
+	kfree(gens);
+
+	return args->num_submitted ? 0 : err;
+}
+
 static int nvhost_ioctl_channel_read_3d_reg(struct nvhost_channel_userctx *ctx,
 	struct nvhost_read_3d_reg_args *args)
 {
@@ -704,8 +822,10 @@ static long nvhost_channelctl(struct file *filp,
 			break;
 		}
 
-		if (priv->memmgr)
+		if (priv->memmgr) {
+			nvhost_job_reloc_cache_flush(priv->ch, priv->memmgr);
 			mem_op().put_mgr(priv->memmgr);
+		}
 
 		priv->memmgr = new_client;
 		break;
@@ -749,7 +869,15 @@ static long nvhost_channelctl(struct file *filp,
 		err = nvhost_ioctl_channel_module_regrdwr(priv, (void *)buf);
 		break;
 	case NVHOST_IOCTL_CHANNEL_SUBMIT:
-		err = nvhost_ioctl_channel_submit(priv, (void *)buf);
+		err = nvhost_ioctl_channel_submit(priv, (void *)buf, NULL,
+				false, NULL);
+		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_FENCE_FD:
+		err = nvhost_ioctl_channel_submit(priv, (void *)buf, NULL,
+				true, NULL);
+		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH:
+		err = nvhost_ioctl_channel_submit_batch(priv, (void *)buf);
 		break;
 	case NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX:
 		priv->timeout = (u32)
@@ -20,6 +20,9 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 
 #include <linux/io.h>
 
@@ -27,6 +30,8 @@
 #include "debug.h"
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
+#include "nvhost_job.h"
+#include "nvhost_memmgr.h"
 #include "chip_support.h"
 
 pid_t nvhost_debug_null_kickoff_pid;
@@ -482,6 +487,465 @@ static const struct file_operations xfercount_fops = {
 	.release	= single_release,
 };
 
+/*
+ * Sync point waiter microbenchmark.  Writing "<id> <waiters>" queues that
+ * many wakeup waiters on consecutive thresholds of a client managed sync
+ * point, then increments it from the CPU one step at a time and times how
+ * long each waiter takes to be woken.  Pick a sync point nobody else uses.
+ */
+#define INTR_BENCH_MAX_WAITERS	4096
+
+static struct {
+	u32 id;
+	u32 nr_waiters;
+	u64 setup_ns;
+	u64 wakeup_ns;
+	u64 wakeup_max_ns;
+	u32 timeouts;
+} intr_bench;
+static DEFINE_MUTEX(intr_bench_lock);
+static DECLARE_WAIT_QUEUE_HEAD(intr_bench_wq);
+
+static int intr_bench_run(struct nvhost_master *host, u32 id, u32 nr)
+{
+	struct nvhost_syncpt *sp = &host->syncpt;
+	void **waiters;
+	u32 base, thresh, i;
+	u64 t, lat;
+	int err = 0;
+
+	if (id >= nvhost_syncpt_nb_pts(sp) ||
+	    !nvhost_syncpt_client_managed(sp, id))
+		return -EINVAL;
+	if (!nr || nr > INTR_BENCH_MAX_WAITERS)
+		return -EINVAL;
+
+	waiters = kcalloc(nr, sizeof(*waiters), GFP_KERNEL);
+	if (!waiters)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		waiters[i] = nvhost_intr_alloc_waiter();
+		if (!waiters[i]) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	memset(&intr_bench, 0, sizeof(intr_bench));
+	intr_bench.id = id;
+	intr_bench.nr_waiters = nr;
+
+	nvhost_module_busy(host->dev);
+	base = nvhost_syncpt_update_min(sp, id);
+
+	t = sched_clock();
+	for (i = 0; i < nr; i++) {
+		/* the waiter now belongs to nvhost_intr */
+		nvhost_intr_add_action(&host->intr, id, base + 1 + i,
+				NVHOST_INTR_ACTION_WAKEUP, &intr_bench_wq,
+				waiters[i], NULL);
+		waiters[i] = NULL;
+	}
+	intr_bench.setup_ns = sched_clock() - t;
+
+	for (i = 0; i < nr; i++) {
+		thresh = base + 1 + i;
+		t = sched_clock();
+		nvhost_syncpt_incr(sp, id);
+		if (!wait_event_timeout(intr_bench_wq,
+				nvhost_syncpt_is_expired(sp, id, thresh), HZ))
+			intr_bench.timeouts++;
+		lat = sched_clock() - t;
+		intr_bench.wakeup_ns += lat;
+		intr_bench.wakeup_max_ns = max(intr_bench.wakeup_max_ns, lat);
+	}
+	nvhost_module_idle(host->dev);
+
+out:
+	for (i = 0; i < nr; i++)
+		kfree(waiters[i]);
+	kfree(waiters);
+	return err;
+}
+
+static int intr_bench_show(struct seq_file *s, void *unused)
+{
+	u32 nr;
+
+	mutex_lock(&intr_bench_lock);
+	nr = intr_bench.nr_waiters;
+	if (nr) {
+		seq_printf(s, "syncpt %u, %u waiters\n", intr_bench.id, nr);
+		seq_printf(s, "setup: %llu ns/waiter\n",
+			div_u64(intr_bench.setup_ns, nr));
+		seq_printf(s, "wakeup: avg %llu ns, max %llu ns\n",
+			div_u64(intr_bench.wakeup_ns, nr),
+			intr_bench.wakeup_max_ns);
+		seq_printf(s, "timeouts: %u\n", intr_bench.timeouts);
+	}
+	mutex_unlock(&intr_bench_lock);
+	return 0;
+}
+
+static int intr_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, intr_bench_show, inode->i_private);
+}
+
+static ssize_t intr_bench_write(struct file *file,
+				const char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct nvhost_master *host = s->private;
+	char buffer[40];
+	int buf_size;
+	u32 id, nr;
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+	buf_size = min(count, (sizeof(buffer)-1));
+
+	if (copy_from_user(buffer, user_buf, buf_size))
+		return -EFAULT;
+
+	if (sscanf(buffer, "%u %u", &id, &nr) != 2)
+		return -EINVAL;
+
+	mutex_lock(&intr_bench_lock);
+	err = intr_bench_run(host, id, nr);
+	mutex_unlock(&intr_bench_lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations intr_bench_fops = {
+	.open		= intr_bench_open,
+	.read		= seq_read,
+	.write		= intr_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Submit path microbenchmark.  Writing "<relocs> <iterations>" builds jobs
+ * with one gather carrying that many relocations into a scratch buffer and
+ * times allocating and pinning them, first without and then with a gather
+ * generation so the relocation cache can skip patching.  The jobs belong
+ * to a mock channel and are never kicked off, so no hardware is touched.
+ */
+#define SUBMIT_BENCH_MAX_RELOCS		1024
+#define SUBMIT_BENCH_MAX_ITERS		10000
+#define SUBMIT_BENCH_RELOC_STRIDE	64
+
+static struct {
+	u32 nr_relocs;
+	u32 nr_iters;
+	u64 pin_ns[2];
+	u32 hits;
+	u32 misses;
+} submit_bench;
+static DEFINE_MUTEX(submit_bench_lock);
+static struct nvhost_channel submit_bench_ch;
+
+static int submit_bench_pass(struct nvhost_master *host,
+		u32 cmdbuf_id, u32 target_id, u32 gen, u64 *ns)
+{
+	u32 nr = submit_bench.nr_relocs;
+	struct nvhost_job *job;
+	u32 i, j;
+	u64 t;
+	int err;
+
+	for (i = 0; i < submit_bench.nr_iters; i++) {
+		t = sched_clock();
+		job = nvhost_job_alloc(&submit_bench_ch, NULL, 1, nr, 0,
+				host->memmgr);
+		if (!job)
+			return -ENOMEM;
+
+		nvhost_job_add_gather(job, cmdbuf_id,
+				nr * SUBMIT_BENCH_RELOC_STRIDE / 4, 0);
+		job->gathers[0].gen = gen;
+		job->num_relocs = nr;
+		for (j = 0; j < nr; j++) {
+			job->relocarray[j].cmdbuf_mem = cmdbuf_id;
+			job->relocarray[j].cmdbuf_offset =
+				j * SUBMIT_BENCH_RELOC_STRIDE;
+			job->relocarray[j].target = target_id;
+			job->relocarray[j].target_offset = j * 4;
+		}
+
+		err = nvhost_job_pin(job, &host->syncpt);
+		*ns += sched_clock() - t;
+
+		nvhost_job_unpin(job);
+		nvhost_job_put(job);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+static int submit_bench_run(struct nvhost_master *host, u32 nr, u32 iters)
+{
+	struct mem_handle *cmdbuf, *target;
+	u32 hits, misses;
+	int err;
+
+	if (!nr || nr > SUBMIT_BENCH_MAX_RELOCS)
+		return -EINVAL;
+	if (!iters || iters > SUBMIT_BENCH_MAX_ITERS)
+		return -EINVAL;
+
+	cmdbuf = mem_op().alloc(host->memmgr,
+			nr * SUBMIT_BENCH_RELOC_STRIDE, 32,
+			mem_mgr_flag_write_combine);
+	if (IS_ERR_OR_NULL(cmdbuf))
+		return -ENOMEM;
+
+	target = mem_op().alloc(host->memmgr, nr * 4, 32,
+			mem_mgr_flag_write_combine);
+	if (IS_ERR_OR_NULL(target)) {
+		mem_op().put(host->memmgr, cmdbuf);
+		return -ENOMEM;
+	}
+
+	memset(&submit_bench, 0, sizeof(submit_bench));
+	submit_bench.nr_relocs = nr;
+	submit_bench.nr_iters = iters;
+	submit_bench_ch.dev = host->dev;
+	nvhost_job_reloc_cache_init(&submit_bench_ch.reloc_cache);
+
+	nvhost_job_reloc_cache_stats(&submit_bench_ch, &hits, &misses);
+	err = submit_bench_pass(host, nvhost_memmgr_handle_to_id(cmdbuf),
+			nvhost_memmgr_handle_to_id(target), 0,
+			&submit_bench.pin_ns[0]);
+	if (!err)
+		err = submit_bench_pass(host,
+				nvhost_memmgr_handle_to_id(cmdbuf),
+				nvhost_memmgr_handle_to_id(target), 1,
+				&submit_bench.pin_ns[1]);
+	nvhost_job_reloc_cache_stats(&submit_bench_ch, &submit_bench.hits,
+			&submit_bench.misses);
+	submit_bench.hits -= hits;
+	submit_bench.misses -= misses;
+
+	nvhost_job_reloc_cache_flush(&submit_bench_ch, host->memmgr);
+	mem_op().put(host->memmgr, target);
+	mem_op().put(host->memmgr, cmdbuf);
+
+	return err;
+}
+
+static int submit_bench_show(struct seq_file *s, void *unused)
+{
+	u32 nr;
+
+	mutex_lock(&submit_bench_lock);
+	nr = submit_bench.nr_iters;
+	if (nr) {
+		seq_printf(s, "%u relocs, %u iterations\n",
+			submit_bench.nr_relocs, nr);
+		seq_printf(s, "uncached: %llu ns/submit\n",
+			div_u64(submit_bench.pin_ns[0], nr));
+		seq_printf(s, "cached: %llu ns/submit\n",
+			div_u64(submit_bench.pin_ns[1], nr));
+		seq_printf(s, "reloc cache: %u hits, %u misses\n",
+			submit_bench.hits, submit_bench.misses);
+	}
+	mutex_unlock(&submit_bench_lock);
+	return 0;
+}
+
+static int submit_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, submit_bench_show, inode->i_private);
+}
+
+static ssize_t submit_bench_write(struct file *file,
+				const char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct nvhost_master *host = s->private;
+	char buffer[40];
+	int buf_size;
+	u32 nr, iters;
+	int err;
+
+	memset(buffer, 0, sizeof(buffer));
+	buf_size = min(count, (sizeof(buffer)-1));
+
+	if (copy_from_user(buffer, user_buf, buf_size))
+		return -EFAULT;
+
+	if (sscanf(buffer, "%u %u", &nr, &iters) != 2)
+		return -EINVAL;
+
+	mutex_lock(&submit_bench_lock);
+	err = submit_bench_run(host, nr, iters);
+	mutex_unlock(&submit_bench_lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations submit_bench_fops = {
+	.open		= submit_bench_open,
+	.read		= seq_read,
+	.write		= submit_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const char *const acm_outcome_names[NVHOST_ACM_OUTCOMES] = {
+	[NVHOST_ACM_STAY_ON] = "stay on",
+	[NVHOST_ACM_CLOCKGATE] = "clock gate",
+	[NVHOST_ACM_POWERGATE] = "power gate",
+};
+
+static void acm_idle_stats_print(struct seq_file *s,
+		struct nvhost_acm_idle_stats *st)
+{
+	int i, j;
+
+	seq_printf(s, "adaptive: %d (%s)\n", st->adaptive,
+		st->trained < NVHOST_ACM_TRAIN ? "training" : "trained");
+	seq_printf(s, "delays: clockgate %d ms, powergate %d ms\n",
+		st->clockgate_delay, st->powergate_delay);
+	seq_printf(s, "fixed delays: clockgate %d ms, powergate %d ms\n",
+		st->fixed_clockgate_delay, st->fixed_powergate_delay);
+
+	seq_puts(s, "idle histogram:");
+	for (i = 0; i < NVHOST_ACM_HIST_BUCKETS; i++)
+		seq_printf(s, " %u", st->hist[i]);
+	seq_puts(s, "\n");
+
+	seq_printf(s, "idle periods: %llu\n", st->periods);
+	seq_puts(s, "outcome vs best in hindsight:\n");
+	for (i = 0; i < NVHOST_ACM_OUTCOMES; i++) {
+		seq_printf(s, "  %-10s", acm_outcome_names[i]);
+		for (j = 0; j < NVHOST_ACM_OUTCOMES; j++)
+			seq_printf(s, " %10llu", st->outcome[i][j]);
+		seq_puts(s, "\n");
+	}
+	seq_printf(s, "cost: %llu us, fixed delays %llu us, ideal %llu us\n",
+		st->cost, st->fixed_cost, st->ideal_cost);
+}
+
+static int acm_idle_stats_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+
+	mutex_lock(&pdata->lock);
+	if (pdata->idle_stats)
+		acm_idle_stats_print(s, pdata->idle_stats);
+	mutex_unlock(&pdata->lock);
+	return 0;
+}
+
+static int acm_idle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, acm_idle_stats_show, inode->i_private);
+}
+
+static const struct file_operations acm_idle_stats_fops = {
+	.open		= acm_idle_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Replay of the adaptive gating policy. Writing a list of idle periods in
+ * microseconds runs the policy of the module over them, starting from an
+ * empty histogram, without touching the hardware. Reading shows the result.
+ */
+#define ACM_REPLAY_MAX_GAPS	1024
+
+static struct {
+	struct platform_device *dev;
+	struct nvhost_acm_idle_stats st;
+} acm_replay;
+static DEFINE_MUTEX(acm_replay_lock);
+
+static int acm_replay_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&acm_replay_lock);
+	if (acm_replay.dev == s->private)
+		acm_idle_stats_print(s, &acm_replay.st);
+	mutex_unlock(&acm_replay_lock);
+	return 0;
+}
+
+static int acm_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, acm_replay_show, inode->i_private);
+}
+
+static ssize_t acm_replay_write(struct file *file,
+				const char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct platform_device *dev = s->private;
+	char *buffer, *p;
+	u32 *gaps;
+	int num_gaps = 0;
+	int err;
+
+	if (count >= PAGE_SIZE)
+		return -EINVAL;
+
+	buffer = kzalloc(count + 1, GFP_KERNEL);
+	gaps = kcalloc(ACM_REPLAY_MAX_GAPS, sizeof(*gaps), GFP_KERNEL);
+	if (!buffer || !gaps) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(buffer, user_buf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	p = buffer;
+	while (num_gaps < ACM_REPLAY_MAX_GAPS) {
+		char *end;
+
+		p = skip_spaces(p);
+		if (!*p)
+			break;
+		gaps[num_gaps++] = simple_strtoul(p, &end, 10);
+		if (end == p) {
+			err = -EINVAL;
+			goto out;
+		}
+		p = end;
+	}
+
+	mutex_lock(&acm_replay_lock);
+	acm_replay.dev = dev;
+	err = nvhost_module_replay_idle(dev, gaps, num_gaps, &acm_replay.st);
+	mutex_unlock(&acm_replay_lock);
+
+out:
+	kfree(gaps);
+	kfree(buffer);
+	return err ? err : count;
+}
+
+static const struct file_operations acm_replay_fops = {
+	.open		= acm_replay_open,
+	.read		= seq_read,
+	.write		= acm_replay_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void nvhost_device_debug_init(struct platform_device *dev)
 {
 	struct dentry *de = NULL;
@@ -491,6 +955,18 @@ void nvhost_device_debug_init(struct platform_device *dev)
 	debugfs_create_file("stallcount", S_IRUGO, de, dev, &stallcount_fops);
 	debugfs_create_file("xfercount", S_IRUGO, de, dev, &xfercount_fops);
 	debugfs_create_file("tickcount", S_IRUGO, de, dev, &tickcount_fops);
+	debugfs_create_file("acm_idle_stats", S_IRUGO, de, dev,
+			&acm_idle_stats_fops);
+	debugfs_create_file("acm_replay", S_IRUGO|S_IWUSR, de, dev,
+			&acm_replay_fops);
+	if (pdata->idle_stats) {
+		debugfs_create_u32("acm_clockgate_penalty", S_IRUGO|S_IWUSR,
+			de, &pdata->idle_stats->clockgate_penalty);
+		debugfs_create_u32("acm_powergate_penalty", S_IRUGO|S_IWUSR,
+			de, &pdata->idle_stats->powergate_penalty);
+		debugfs_create_u32("acm_clockgated_power", S_IRUGO|S_IWUSR,
+			de, &pdata->idle_stats->clockgated_power);
+	}
 
 	pdata->debugfs = de;
 }
@@ -517,6 +993,10 @@ void nvhost_debug_init(struct nvhost_master *master)
 			&nvhost_debug_null_kickoff_pid);
 	debugfs_create_u32("trace_cmdbuf", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_trace_cmdbuf);
+	debugfs_create_file("intr_bench", S_IRUGO|S_IWUSR, de,
+			master, &intr_bench_fops);
+	debugfs_create_file("submit_bench", S_IRUGO|S_IWUSR, de,
+			master, &submit_bench_fops);
 
 	if (nvhost_get_chip_ops()->debug.debug_init)
 		nvhost_get_chip_ops()->debug.debug_init(de);
@@ -0,0 +1,129 @@
+/*
+ * drivers/video/tegra/host/gr3d/frame_model.c
+ *
+ * Tegra Graphics Host 3D Frame Deadline Model
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The work of a frame is measured in gpu cycles, busy time times clock,
+ * which stays roughly the same from frame to frame in a steady scene no
+ * matter what the clock was. The next frame is predicted to take the
+ * running average plus a multiple of the running mean deviation, the same
+ * estimator TCP uses for round trip times.
+ *
+ * The deadline is a whole number of display refresh periods, taken from
+ * the flip rate the application achieves. When the gpu was busy for most
+ * of a frame it is what holds the frame rate down, and one refresh period
+ * less is aimed for. Aiming for a slower rate needs p_settle frames in a
+ * row asking for it, so a single hitch does not drop the clock.
+ *
+ * Nothing here depends on anything but the arguments, so recorded frames
+ * can be replayed through the model.
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/time.h>
+
+#include "frame_model.h"
+
+#define DEFAULT_REFRESH_US	16667
+
+void gr3d_frame_model_init(struct gr3d_frame_model *m)
+{
+	m->p_headroom = 850;
+	m->p_bound = 950;
+	m->p_margin = 20;
+	m->p_settle = 8;
+
+	m->work_avg = 0;
+	m->work_dev = 0;
+	m->frames = 0;
+	m->vsyncs = 1;
+	m->slower = 0;
+	m->deadline_us = DEFAULT_REFRESH_US;
+}
+
+static u32 frame_vsyncs(struct gr3d_frame_model *m,
+	const struct gr3d_frame *f, u32 refresh_us)
+{
+	u32 vsyncs = max_t(u32, 1, DIV_ROUND_CLOSEST(f->frame_us, refresh_us));
+
+	/* the gpu held this frame up, try to make it one refresh sooner */
+	if (vsyncs > 1 &&
+	    (u64)f->busy_us * 1000 >= (u64)f->frame_us * m->p_bound)
+		vsyncs--;
+
+	if (vsyncs <= m->vsyncs) {
+		m->slower = 0;
+		return vsyncs;
+	}
+
+	if (++m->slower < m->p_settle)
+		return m->vsyncs;
+
+	m->slower = 0;
+	return vsyncs;
+}
+
+u32 gr3d_frame_model_update(struct gr3d_frame_model *m,
+	const struct gr3d_frame *f)
+{
+	u32 refresh_us = f->refresh_us ? f->refresh_us : DEFAULT_REFRESH_US;
+	u64 work = div_u64((u64)f->busy_us * f->freq, USEC_PER_SEC);
+	u64 diff;
+
+	if (!m->frames) {
+		m->work_avg = work;
+		m->work_dev = work / 2;
+	} else {
+		diff = work > m->work_avg ?
+			work - m->work_avg : m->work_avg - work;
+		/* gains of 1/8 and 1/4 */
+		m->work_avg = m->work_avg - (m->work_avg >> 3) + (work >> 3);
+		m->work_dev = m->work_dev - (m->work_dev >> 2) + (diff >> 2);
+	}
+	m->frames++;
+
+	m->vsyncs = frame_vsyncs(m, f, refresh_us);
+	m->deadline_us = m->vsyncs * refresh_us;
+
+	return m->deadline_us;
+}
+
+u32 gr3d_frame_model_freq(const struct gr3d_frame_model *m,
+	const u32 *freqs, int n)
+{
+	u64 work, budget, need;
+	int i;
+
+	if (!n)
+		return 0;
+	if (!m->frames || !m->p_headroom)
+		return freqs[n - 1];
+
+	work = m->work_avg + div_u64(m->work_dev * m->p_margin, 10);
+	budget = (u64)m->deadline_us * m->p_headroom;
+	/* cycles / (deadline_us * headroom / 1000) * USEC_PER_SEC */
+	need = div64_u64(work * 1000 * USEC_PER_SEC, budget);
+
+	for (i = 0; i < n - 1; i++)
+		if (freqs[i] >= need)
+			break;
+
+	return freqs[i];
+}
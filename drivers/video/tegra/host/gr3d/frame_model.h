@@ -0,0 +1,67 @@
+/*
+ * drivers/video/tegra/host/gr3d/frame_model.h
+ *
+ * Tegra Graphics Host 3D Frame Deadline Model
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GR3D_FRAME_MODEL_H
+#define GR3D_FRAME_MODEL_H
+
+#include <linux/types.h>
+
+/* One displayed frame, as recorded by the frame governor */
+struct gr3d_frame {
+	u32		busy_us;	/* gr3d busy time between the flips */
+	u32		freq;		/* gr3d clock during the frame, Hz */
+	u32		frame_us;	/* time from the previous flip */
+	u32		refresh_us;	/* display refresh period */
+};
+
+/*
+ * Per-frame work prediction. The parameters are per mille unless noted
+ * and may be changed at any time; the rest is state.
+ */
+struct gr3d_frame_model {
+	u32		p_headroom;	/* share of the deadline to fill */
+	u32		p_bound;	/* busy share of a frame that means the
+					 * gpu is what limits the frame rate */
+	u32		p_margin;	/* deviations to add, in tenths */
+	u32		p_settle;	/* frames before aiming for a slower
+					 * frame rate */
+
+	u64		work_avg;	/* gpu cycles per frame */
+	u64		work_dev;	/* mean deviation of the above */
+	u32		frames;
+	u32		vsyncs;		/* refresh periods per frame aimed for */
+	u32		slower;		/* frames that wanted more vsyncs */
+	u32		deadline_us;
+};
+
+void gr3d_frame_model_init(struct gr3d_frame_model *m);
+
+/* Account a finished frame. Returns the deadline for the next frame. */
+u32 gr3d_frame_model_update(struct gr3d_frame_model *m,
+	const struct gr3d_frame *f);
+
+/*
+ * Lowest of the ascending freqs[0..n-1] predicted to finish the next frame
+ * within the current deadline, or the highest one if none does.
+ */
+u32 gr3d_frame_model_freq(const struct gr3d_frame_model *m,
+	const u32 *freqs, int n);
+
+#endif
@@ -0,0 +1,664 @@
+/*
+ * drivers/video/tegra/host/gr3d/frame_scaling.c
+ *
+ * Tegra Graphics Host 3D Frame Deadline Scaling
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Frame deadline clock scaling for gr3d
+ *
+ * The device is busy from a submit until the sync point of the last job
+ * outstanding completes, as told by the busy and idle notifications that
+ * reach the governor through get_dev_status(). That busy time is summed up
+ * between display flips, which tegra-throughput reports one by one, with
+ * the time of each flip, through nvhost_scale3d_set_frame_time(). At each
+ * flip the finished frame is fed to the frame model (frame_model.c), and
+ * the clock is set to the lowest rate predicted to render the next frame
+ * within its deadline. Busy periods that end between a flip and the report
+ * of it are counted in that frame.
+ *
+ * When nothing has been flipped for a while the governor falls back to
+ * keeping the device busy p_headroom per mille of the time. The flip that
+ * ends such a pause only starts a new frame; it is not fed to the model.
+ *
+ * Enabled with nvhost_gr3d.frame_governor=1; pod stays the default.
+ */
+
+#include <linux/devfreq.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+#include <linux/clk.h>
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+
+#include <mach/dc.h>
+
+#include <governor.h>
+
+#include "pod_scaling.h"
+#include "frame_scaling.h"
+#include "frame_model.h"
+#include "scale3d.h"
+#include "dev.h"
+
+/* without flips for this long, scale by utilisation instead */
+#define FRAMEGOV_TIMEFRAME	1000000 /* 1 sec */
+
+#define FRAMEGOV_LOG_SIZE	64
+
+static bool frame_governor;
+module_param(frame_governor, bool, S_IRUGO);
+MODULE_PARM_DESC(frame_governor, "scale gr3d by frame deadlines");
+
+/*******************************************************************************
+ * framegov_info_rec - frame governor specific parameters
+ ******************************************************************************/
+
+struct framegov_info_rec {
+
+	int			enable;
+
+	struct devfreq		*power_manager;
+	struct dentry		*debugdir;
+
+	struct gr3d_frame_model	model;
+
+	u32			*freqlist;
+	int			freq_count;
+
+	/* the clock the device is actually running at */
+	unsigned long		cur_freq;
+	unsigned long		target_freq;
+
+	/* busy since busy_start, per the last notification seen, and
+	 * counted up to busy_since */
+	bool			busy;
+	ktime_t			busy_start;
+	ktime_t			busy_since;
+
+	/* busy time since the last flip */
+	unsigned long		frame_busy;
+	ktime_t			last_frame;
+
+	/* utilisation window used while nothing is flipped */
+	unsigned int		p_window;
+	unsigned long		window_busy;
+	unsigned long		window_total;
+
+	/* the last frames, oldest at log_pos */
+	struct gr3d_frame	log[FRAMEGOV_LOG_SIZE];
+	unsigned int		log_pos;
+
+	/* frames last written to debugfs replay, with what the model did */
+	struct gr3d_frame	replay[FRAMEGOV_LOG_SIZE];
+	u32			replay_deadline[FRAMEGOV_LOG_SIZE];
+	u32			replay_freq[FRAMEGOV_LOG_SIZE];
+	int			replay_count;
+};
+
+static struct framegov_info_rec *local_framegov;
+
+/*******************************************************************************
+ * framegov_lowest_freq(framegov, freq)
+ *
+ * Lowest supported frequency at or above freq
+ ******************************************************************************/
+
+static unsigned long framegov_lowest_freq(struct framegov_info_rec *framegov,
+					  u64 freq)
+{
+	int i;
+
+	for (i = 0; i < framegov->freq_count - 1; i++)
+		if (framegov->freqlist[i] >= freq)
+			break;
+
+	return framegov->freqlist[i];
+}
+
+/*******************************************************************************
+ * framegov_busy_until(framegov, t)
+ *
+ * Count the time the device has been busy up to t
+ ******************************************************************************/
+
+static void framegov_busy_until(struct framegov_info_rec *framegov,
+				ktime_t t)
+{
+	s64 dt;
+
+	if (!framegov->busy)
+		return;
+
+	dt = ktime_us_delta(t, framegov->busy_since);
+	if (dt <= 0)
+		return;
+
+	framegov->frame_busy += dt;
+	framegov->window_busy += dt;
+	framegov->busy_since = t;
+}
+
+/*******************************************************************************
+ * framegov_account(df, framegov)
+ *
+ * Collect the busy time since the last call, and follow the busy and idle
+ * notifications of the device
+ ******************************************************************************/
+
+static int framegov_account(struct devfreq *df,
+			    struct framegov_info_rec *framegov)
+{
+	struct devfreq_dev_status dev_stat;
+	struct nvhost_devfreq_ext_stat *ext_stat;
+	ktime_t now;
+	int stat;
+
+	stat = df->profile->get_dev_status(df->dev.parent, &dev_stat);
+	if (stat < 0)
+		return stat;
+
+	ext_stat = dev_stat.private_data;
+	if (!ext_stat)
+		return -EINVAL;
+
+	df->min_freq = ext_stat->min_freq;
+	df->max_freq = ext_stat->max_freq;
+
+	now = ktime_get();
+	framegov_busy_until(framegov, now);
+	if (ext_stat->busy == DEVICE_BUSY && !framegov->busy) {
+		framegov->busy = true;
+		framegov->busy_start = now;
+		framegov->busy_since = now;
+	} else if (ext_stat->busy == DEVICE_IDLE) {
+		framegov->busy = false;
+	}
+
+	framegov->cur_freq = dev_stat.current_frequency;
+	framegov->window_total += dev_stat.total_time;
+
+	return 0;
+}
+
+/*******************************************************************************
+ * nvhost_scale3d_set_frame_time(flip, frame_us)
+ *
+ * Called for each frame flipped at flip, frame_us after the previous one.
+ ******************************************************************************/
+
+void nvhost_scale3d_set_frame_time(ktime_t flip, unsigned int frame_us)
+{
+	struct framegov_info_rec *framegov = local_framegov;
+	struct devfreq *df;
+	struct gr3d_frame *f;
+	unsigned long carry = 0;
+	int sync_rate;
+
+	if (!framegov)
+		return;
+	df = framegov->power_manager;
+	if (!df)
+		return;
+
+	mutex_lock(&df->lock);
+
+	if (!framegov->enable || framegov_account(df, framegov)) {
+		mutex_unlock(&df->lock);
+		return;
+	}
+
+	/* what the running busy period did after the flip is the next
+	 * frame's */
+	if (framegov->busy) {
+		ktime_t from = ktime_us_delta(flip, framegov->busy_start) > 0 ?
+			flip : framegov->busy_start;
+		s64 dt = ktime_us_delta(framegov->busy_since, from);
+
+		if (dt > 0)
+			carry = min_t(unsigned long, dt, framegov->frame_busy);
+	}
+
+	sync_rate = tegra_dc_get_panel_sync_rate();
+
+	f = &framegov->log[framegov->log_pos];
+	framegov->log_pos = (framegov->log_pos + 1) % FRAMEGOV_LOG_SIZE;
+
+	f->busy_us = min_t(unsigned long, framegov->frame_busy - carry,
+			frame_us);
+	f->freq = framegov->cur_freq;
+	f->frame_us = frame_us;
+	f->refresh_us = sync_rate > 0 ? 1000000000 / sync_rate : 0;
+
+	if (frame_us <= FRAMEGOV_TIMEFRAME) {
+		gr3d_frame_model_update(&framegov->model, f);
+		framegov->target_freq = gr3d_frame_model_freq(
+			&framegov->model, framegov->freqlist,
+			framegov->freq_count);
+	}
+
+	framegov->frame_busy = carry;
+	framegov->window_busy = 0;
+	framegov->window_total = 0;
+	framegov->last_frame = flip;
+
+	if (framegov->target_freq != df->previous_freq)
+		update_devfreq(df);
+
+	mutex_unlock(&df->lock);
+}
+EXPORT_SYMBOL(nvhost_scale3d_set_frame_time);
+
+/*******************************************************************************
+ * nvhost_frame_estimate_freq(df, freq)
+ *
+ * Called on device busy and idle events. Between flips this only collects
+ * the busy time; the frequency is chosen when the frame ends.
+ ******************************************************************************/
+
+static int nvhost_frame_estimate_freq(struct devfreq *df,
+				      unsigned long *freq)
+{
+	struct framegov_info_rec *framegov = df->data;
+	ktime_t now = ktime_get();
+	int stat;
+
+	/* Ensure maximal clock when scaling is disabled */
+	if (!framegov->enable) {
+		*freq = df->max_freq;
+		return 0;
+	}
+
+	stat = framegov_account(df, framegov);
+	if (stat)
+		return stat;
+
+	if (ktime_us_delta(now, framegov->last_frame) > FRAMEGOV_TIMEFRAME &&
+	    framegov->window_total >= framegov->p_window) {
+		u64 busy = (u64)framegov->cur_freq * framegov->window_busy;
+		u64 total = (u64)framegov->window_total *
+			framegov->model.p_headroom;
+
+		framegov->target_freq = framegov_lowest_freq(framegov,
+			total ? div64_u64(busy * 1000, total) : 0);
+		framegov->window_busy = 0;
+		framegov->window_total = 0;
+	}
+
+	*freq = framegov->target_freq;
+	if (!(*freq) || (*freq == df->previous_freq))
+		return GET_TARGET_FREQ_DONTSCALE;
+
+	return 0;
+}
+
+/*******************************************************************************
+ * sysfs interface for enabling/disabling 3d scaling
+ ******************************************************************************/
+
+static ssize_t enable_3d_scaling_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct nvhost_device_data *pdata =
+		platform_get_drvdata(to_platform_device(dev));
+	struct devfreq *df = pdata->power_manager;
+	struct framegov_info_rec *framegov;
+	int enable = 0;
+
+	if (df) {
+		mutex_lock(&df->lock);
+		framegov = df->data;
+		enable = framegov->enable;
+		mutex_unlock(&df->lock);
+	}
+
+	return sprintf(buf, "%d\n", enable);
+}
+
+static ssize_t enable_3d_scaling_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct nvhost_device_data *pdata =
+		platform_get_drvdata(to_platform_device(dev));
+	struct devfreq *df = pdata->power_manager;
+	struct framegov_info_rec *framegov;
+	unsigned long val = 0;
+
+	if (kstrtoul(buf, 10, &val) < 0)
+		return -EINVAL;
+	if (!df)
+		return count;
+
+	mutex_lock(&df->lock);
+	framegov = df->data;
+	if (val && df->min_freq != df->max_freq) {
+		framegov->enable = 1;
+	} else {
+		framegov->enable = 0;
+		update_devfreq(df);
+	}
+	mutex_unlock(&df->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(enable_3d_scaling, S_IRUGO | S_IWUSR,
+	enable_3d_scaling_show, enable_3d_scaling_store);
+
+/*******************************************************************************
+ * debugfs interface for tuning and for recording frame traces
+ ******************************************************************************/
+
+#ifdef CONFIG_DEBUG_FS
+
+static int framegov_frames_show(struct seq_file *s, void *unused)
+{
+	struct devfreq *df = s->private;
+	struct framegov_info_rec *framegov = df->data;
+	int i;
+
+	seq_printf(s, "busy_us freq frame_us refresh_us\n");
+
+	mutex_lock(&df->lock);
+	for (i = 0; i < FRAMEGOV_LOG_SIZE; i++) {
+		struct gr3d_frame *f = &framegov->log[
+			(framegov->log_pos + i) % FRAMEGOV_LOG_SIZE];
+
+		if (!f->frame_us)
+			continue;
+		seq_printf(s, "%u %u %u %u\n", f->busy_us, f->freq,
+			f->frame_us, f->refresh_us);
+	}
+	mutex_unlock(&df->lock);
+
+	return 0;
+}
+
+static int framegov_frames_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, framegov_frames_show, inode->i_private);
+}
+
+static const struct file_operations framegov_frames_fops = {
+	.open		= framegov_frames_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * replay: write frames in the format "frames" prints them, and they are
+ * run through a fresh model with the current tunables and frequencies.
+ * Reading shows each frame with the deadline and clock the model chose
+ * after it.
+ */
+static int framegov_replay_show(struct seq_file *s, void *unused)
+{
+	struct devfreq *df = s->private;
+	struct framegov_info_rec *framegov = df->data;
+	int i;
+
+	seq_printf(s, "busy_us freq frame_us refresh_us deadline_us "
+		"target_freq\n");
+
+	mutex_lock(&df->lock);
+	for (i = 0; i < framegov->replay_count; i++) {
+		struct gr3d_frame *f = &framegov->replay[i];
+
+		seq_printf(s, "%u %u %u %u %u %u\n", f->busy_us, f->freq,
+			f->frame_us, f->refresh_us,
+			framegov->replay_deadline[i],
+			framegov->replay_freq[i]);
+	}
+	mutex_unlock(&df->lock);
+
+	return 0;
+}
+
+static int framegov_replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, framegov_replay_show, inode->i_private);
+}
+
+static ssize_t framegov_replay_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct devfreq *df = s->private;
+	struct framegov_info_rec *framegov = df->data;
+	struct gr3d_frame_model model;
+	char *kbuf, *p, *line;
+	int n = 0;
+
+	if (count >= PAGE_SIZE)
+		return -EINVAL;
+
+	kbuf = kzalloc(count + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	if (copy_from_user(kbuf, buf, count)) {
+		kfree(kbuf);
+		return -EFAULT;
+	}
+
+	mutex_lock(&df->lock);
+
+	gr3d_frame_model_init(&model);
+	model.p_headroom = framegov->model.p_headroom;
+	model.p_bound = framegov->model.p_bound;
+	model.p_margin = framegov->model.p_margin;
+	model.p_settle = framegov->model.p_settle;
+
+	p = kbuf;
+	while ((line = strsep(&p, "\n")) != NULL && n < FRAMEGOV_LOG_SIZE) {
+		struct gr3d_frame *f = &framegov->replay[n];
+
+		/* skips the header and blank lines */
+		if (sscanf(line, "%u %u %u %u", &f->busy_us, &f->freq,
+			   &f->frame_us, &f->refresh_us) != 4)
+			continue;
+
+		framegov->replay_deadline[n] =
+			gr3d_frame_model_update(&model, f);
+		framegov->replay_freq[n] = gr3d_frame_model_freq(&model,
+			framegov->freqlist, framegov->freq_count);
+		n++;
+	}
+	framegov->replay_count = n;
+
+	mutex_unlock(&df->lock);
+	kfree(kbuf);
+
+	return count;
+}
+
+static const struct file_operations framegov_replay_fops = {
+	.open		= framegov_replay_open,
+	.read		= seq_read,
+	.write		= framegov_replay_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nvhost_framegov_debug_init(struct devfreq *df)
+{
+	struct framegov_info_rec *framegov = df->data;
+	struct platform_device *dev = to_platform_device(df->dev.parent);
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct dentry *f;
+
+	framegov->debugdir = debugfs_create_dir("frame_scaling",
+		pdata->debugfs);
+	if (!framegov->debugdir) {
+		pr_err("framegov: can\'t create debugfs directory\n");
+		return;
+	}
+
+#define CREATE_FRAMEGOV_FILE(fname, field) \
+	do {\
+		f = debugfs_create_u32(#fname, S_IRUGO | S_IWUSR, \
+			framegov->debugdir, &framegov->field); \
+		if (NULL == f) { \
+			pr_err("framegov: can\'t create file " #fname "\n"); \
+			return; \
+		} \
+	} while (0)
+
+	CREATE_FRAMEGOV_FILE(headroom, model.p_headroom);
+	CREATE_FRAMEGOV_FILE(bound, model.p_bound);
+	CREATE_FRAMEGOV_FILE(margin, model.p_margin);
+	CREATE_FRAMEGOV_FILE(settle, model.p_settle);
+	CREATE_FRAMEGOV_FILE(window, p_window);
+#undef CREATE_FRAMEGOV_FILE
+
+	debugfs_create_file("frames", S_IRUGO, framegov->debugdir, df,
+		&framegov_frames_fops);
+	debugfs_create_file("replay", S_IRUGO | S_IWUSR, framegov->debugdir,
+		df, &framegov_replay_fops);
+}
+
+static void nvhost_framegov_debug_deinit(struct devfreq *df)
+{
+	struct framegov_info_rec *framegov = df->data;
+
+	debugfs_remove_recursive(framegov->debugdir);
+}
+
+#else
+static void nvhost_framegov_debug_init(struct devfreq *df)
+{
+	(void)df;
+}
+
+static void nvhost_framegov_debug_deinit(struct devfreq *df)
+{
+	(void)df;
+}
+#endif
+
+/*******************************************************************************
+ * nvhost_frame_init(struct devfreq *df)
+ *
+ * Governor initialisation.
+ ******************************************************************************/
+
+#define MAX_FREQ_COUNT 0x40
+
+static int nvhost_frame_init(struct devfreq *df)
+{
+	struct framegov_info_rec *framegov;
+	struct platform_device *d = to_platform_device(df->dev.parent);
+	struct nvhost_device_data *pdata = platform_get_drvdata(d);
+	u32 freqs[MAX_FREQ_COUNT];
+	long rate;
+	int error;
+
+	framegov = kzalloc(sizeof(struct framegov_info_rec), GFP_KERNEL);
+	if (!framegov)
+		return -ENOMEM;
+	df->data = (void *)framegov;
+
+	framegov->power_manager = df;
+	framegov->enable = 1;
+	framegov->p_window = 100000;
+	framegov->last_frame = ktime_get();
+	gr3d_frame_model_init(&framegov->model);
+
+	error = framegov_account(df, framegov);
+	if (error) {
+		pr_err("framegov: device does not support ext_stat.\n");
+		goto err_get_current_status;
+	}
+	df->previous_freq = framegov->cur_freq;
+	framegov->target_freq = df->max_freq;
+
+	rate = 0;
+	while (rate <= df->max_freq) {
+		long rounded_rate;
+		if (unlikely(framegov->freq_count == MAX_FREQ_COUNT)) {
+			pr_err("%s: too many frequencies\n", __func__);
+			break;
+		}
+		rounded_rate =
+			clk_round_rate(clk_get_parent(pdata->clk[0]), rate);
+		freqs[framegov->freq_count++] = rounded_rate;
+		rate = rounded_rate + 2000;
+	}
+
+	framegov->freqlist =
+		kmemdup(freqs, framegov->freq_count * sizeof(u32), GFP_KERNEL);
+	if (!framegov->freqlist) {
+		error = -ENOMEM;
+		goto err_get_current_status;
+	}
+
+	error = device_create_file(&d->dev, &dev_attr_enable_3d_scaling);
+	if (error) {
+		dev_err(&d->dev, "failed to create sysfs attributes");
+		goto err_create_sysfs_entry;
+	}
+
+	nvhost_framegov_debug_init(df);
+
+	local_framegov = framegov;
+
+	return 0;
+
+err_create_sysfs_entry:
+	kfree(framegov->freqlist);
+err_get_current_status:
+	kfree(framegov);
+	return error;
+}
+
+/*******************************************************************************
+ * nvhost_frame_exit(struct devfreq *df)
+ *
+ * Clean up governor data structures
+ ******************************************************************************/
+
+static void nvhost_frame_exit(struct devfreq *df)
+{
+	struct framegov_info_rec *framegov = df->data;
+	struct platform_device *d = to_platform_device(df->dev.parent);
+
+	local_framegov = NULL;
+
+	device_remove_file(&d->dev, &dev_attr_enable_3d_scaling);
+
+	nvhost_framegov_debug_deinit(df);
+
+	kfree(framegov->freqlist);
+	kfree(framegov);
+}
+
+const struct devfreq_governor nvhost_framegov = {
+	.name = "frame",
+	.init = nvhost_frame_init,
+	.exit = nvhost_frame_exit,
+	.get_target_freq = nvhost_frame_estimate_freq,
+	.no_central_polling = true,
+};
+
+const struct devfreq_governor *nvhost_scale3d_governor(void)
+{
+	return frame_governor ? &nvhost_framegov : &nvhost_podgov;
+}
@@ -0,0 +1,32 @@
+/*
+ * drivers/video/tegra/host/gr3d/frame_scaling.h
+ *
+ * Tegra Graphics Host 3D Frame Deadline Scaling
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCALING_H
+#define FRAME_SCALING_H
+
+struct devfreq_governor;
+
+extern const struct devfreq_governor nvhost_framegov;
+
+/* The governor gr3d scaling is set up with, see the frame_governor
+ * module parameter */
+const struct devfreq_governor *nvhost_scale3d_governor(void);
+
+#endif
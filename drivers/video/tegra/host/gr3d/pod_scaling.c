@@ -213,6 +213,10 @@ void nvhost_scale3d_suspend(struct platform_device *dev)
 	if (!df)
 		return;
 
+	/* the frame governor has no timers to stop */
+	if (df->governor != &nvhost_podgov)
+		return;
+
 	mutex_lock(&df->lock);
 	podgov = df->data;
 	if (!podgov->enable) {
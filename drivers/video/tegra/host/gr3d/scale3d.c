@@ -42,6 +42,7 @@
 #include <governor.h>
 
 #include "pod_scaling.h"
+#include "frame_scaling.h"
 #include "scale3d.h"
 #include "dev.h"
 #include "nvhost_acm.h"
@@ -391,7 +392,7 @@ void nvhost_scale3d_init(struct platform_device *dev)
 	/* Start using devfreq */
 	pdata->power_manager = devfreq_add_device(&dev->dev,
 				&nvhost_scale3d_devfreq_profile,
-				&nvhost_podgov,
+				nvhost_scale3d_governor(),
 				NULL);
 
 	return;
@@ -39,6 +39,7 @@
 #include "nvhost_channel.h"
 #include "nvhost_job.h"
 #include "chip_support.h"
+#include "nvhost_sync.h"
 
 #define DRIVER_NAME		"host1x"
 
@@ -231,6 +232,43 @@ static int nvhost_ioctl_ctrl_syncpt_read_max(struct nvhost_ctrl_userctx *ctx,
 	return 0;
 }
 
+static int nvhost_ioctl_ctrl_sync_fence_create(struct nvhost_ctrl_userctx *ctx,
+	struct nvhost_ctrl_sync_fence_create_args *args)
+{
+	struct nvhost_ctrl_sync_fence_info *pts;
+	char name[32];
+	int err;
+
+	if (!args->num_pts ||
+	    args->num_pts > nvhost_syncpt_nb_pts(&ctx->dev->syncpt))
+		return -EINVAL;
+
+	if (args->name) {
+		if (strncpy_from_user(name, (const char __user *)args->name,
+				      sizeof(name)) < 0)
+			return -EFAULT;
+		name[sizeof(name) - 1] = '\0';
+	} else {
+		strcpy(name, "nvhost");
+	}
+
+	pts = kmalloc(sizeof(*pts) * args->num_pts, GFP_KERNEL);
+	if (!pts)
+		return -ENOMEM;
+
+	if (copy_from_user(pts, (void __user *)args->pts,
+			   sizeof(*pts) * args->num_pts)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	err = nvhost_sync_create_fence(&ctx->dev->syncpt, pts, args->num_pts,
+				       name, &args->fence_fd);
+out:
+	kfree(pts);
+	return err;
+}
+
 static long nvhost_ctrlctl(struct file *filp,
 	unsigned int cmd, unsigned long arg)
 {
@@ -274,6 +312,9 @@ static long nvhost_ctrlctl(struct file *filp,
 	case NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX:
 		err = nvhost_ioctl_ctrl_syncpt_read_max(priv, (void *)buf);
 		break;
+	case NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE:
+		err = nvhost_ioctl_ctrl_sync_fence_create(priv, (void *)buf);
+		break;
 	default:
 		err = -ENOTTY;
 		break;
@@ -23,6 +23,7 @@
 #include "nvhost_acm.h"
 #include "nvhost_job.h"
 #include "nvhost_hwctx.h"
+#include "debug.h"
 #include <trace/events/nvhost.h>
 #include <linux/slab.h>
 
@@ -218,14 +219,29 @@ static void submit_gathers(struct nvhost_job *job)
 		else
 			op1 = nvhost_opcode_gather(g->words);
 		op2 = job->gathers[i].mem_base + g->offset;
-		nvhost_cdma_push_gather(&job->ch->cdma,
+		__nvhost_cdma_push_gather(&job->ch->cdma,
 				job->memmgr,
 				g->ref,
-				g->offset,
 				op1, op2);
 	}
 }
 
+/* Tracing maps each gather, so it is done before taking any locks */
+static void trace_gathers(struct nvhost_job *job)
+{
+	int i;
+
+	if (!nvhost_debug_trace_cmdbuf || job->null_kickoff)
+		return;
+
+	for (i = 0; i < job->num_gathers; i++) {
+		struct nvhost_job_gather *g = &job->gathers[i];
+
+		nvhost_cdma_trace_gather(&job->ch->cdma, g->ref, g->offset,
+				gather_count(g->words));
+	}
+}
+
 static int host1x_channel_submit(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
@@ -248,6 +264,8 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	prev_max = job->syncpt_end =
 		nvhost_syncpt_read_max(sp, job->syncpt_id);
 
+	trace_gathers(job);
+
 	/* get submit lock */
 	err = mutex_lock_interruptible(&ch->submitlock);
 	if (err) {
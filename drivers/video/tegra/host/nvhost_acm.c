@@ -25,6 +25,7 @@
 #include <linux/err.h>
 #include <linux/device.h>
 #include <linux/delay.h>
+#include <linux/math64.h>
 #include <linux/platform_device.h>
 #include <trace/events/nvhost.h>
 
@@ -226,19 +227,301 @@ static int to_state_powergated_locked(struct platform_device *dev)
 	return 0;
 }
 
+/*
+ * Adaptive gate delays
+ *
+ * Each idle period of a module, from going idle to the next busy, is added
+ * to a histogram of power-of-two millisecond buckets. Once enough periods
+ * have been seen, the clock and power gate delays are the pair with the
+ * lowest expected cost over the histogram: staying on costs the idle time
+ * at running power, clock gating costs a penalty for ungating plus the
+ * time at clock gated power, and power gating costs another penalty. The
+ * histogram is halved every NVHOST_ACM_DECAY periods so the delays follow
+ * the workload.
+ *
+ * Each period is also scored against the fixed delays and against the best
+ * outcome in hindsight, so the policy can be judged, also on a replayed
+ * trace of idle periods. The fixed delays stay in use unless the policy is
+ * turned on through acm/adaptive_delay.
+ */
+#define NVHOST_ACM_DECAY		64
+#define NVHOST_ACM_REPICK		8
+
+#define NVHOST_ACM_CLOCKGATE_PENALTY	2000
+#define NVHOST_ACM_POWERGATE_PENALTY	20000
+#define NVHOST_ACM_CLOCKGATED_POWER	256
+
+static int hist_bucket(u64 gap_us)
+{
+	u32 ms = (u32)min_t(u64, div_u64(gap_us, 1000), UINT_MAX);
+
+	return min(fls(ms), NVHOST_ACM_HIST_BUCKETS - 1);
+}
+
+/* shortest gap in a bucket, in ms; the candidate delays */
+static int bucket_floor_ms(int i)
+{
+	return i ? 1 << (i - 1) : 0;
+}
+
+/* gap standing for a whole bucket, in us */
+static u64 bucket_gap_us(int i)
+{
+	return i ? 750ULL << i : 500;
+}
+
+static u64 gap_cost(struct nvhost_acm_idle_stats *st, u64 gap_us,
+		int clockgate_delay, int powergate_delay,
+		enum nvhost_acm_outcome *outcome)
+{
+	u64 cg = clockgate_delay * 1000ULL;
+	u64 pg = powergate_delay * 1000ULL;
+	u64 cost;
+
+	if (gap_us <= cg) {
+		*outcome = NVHOST_ACM_STAY_ON;
+		return gap_us;
+	}
+
+	cost = cg + st->clockgate_penalty;
+	if (!st->can_powergate || gap_us <= cg + pg) {
+		*outcome = NVHOST_ACM_CLOCKGATE;
+		return cost + ((gap_us - cg) * st->clockgated_power >> 10);
+	}
+
+	*outcome = NVHOST_ACM_POWERGATE;
+	return cost + (pg * st->clockgated_power >> 10) +
+		st->powergate_penalty;
+}
+
+static u64 ideal_cost(struct nvhost_acm_idle_stats *st, u64 gap_us,
+		enum nvhost_acm_outcome *outcome)
+{
+	u64 cost = gap_us;
+	u64 c;
+
+	*outcome = NVHOST_ACM_STAY_ON;
+
+	c = st->clockgate_penalty + (gap_us * st->clockgated_power >> 10);
+	if (c < cost) {
+		cost = c;
+		*outcome = NVHOST_ACM_CLOCKGATE;
+	}
+
+	c = st->clockgate_penalty + st->powergate_penalty;
+	if (st->can_powergate && c < cost) {
+		cost = c;
+		*outcome = NVHOST_ACM_POWERGATE;
+	}
+
+	return cost;
+}
+
+/*
+ * Search for the cheapest pair of delays over hist. This evaluates every
+ * bucket for every pair, so it runs from pick_work for live modules rather
+ * than from nvhost_module_busy().
+ */
+static void pick_delays(struct nvhost_acm_idle_stats *st, const u32 *hist,
+		int *clockgate_delay, int *powergate_delay)
+{
+	int num_pg = st->can_powergate ? NVHOST_ACM_HIST_BUCKETS : 1;
+	u64 best = ULLONG_MAX;
+	int best_cg = 0, best_pg = 0;
+	int cg, pg, i;
+
+	for (cg = 0; cg < NVHOST_ACM_HIST_BUCKETS; cg++) {
+		for (pg = 0; pg < num_pg; pg++) {
+			enum nvhost_acm_outcome outcome;
+			u64 cost = 0;
+
+			for (i = 0; i < NVHOST_ACM_HIST_BUCKETS; i++)
+				if (hist[i])
+					cost += hist[i] * gap_cost(st,
+						bucket_gap_us(i),
+						bucket_floor_ms(cg),
+						bucket_floor_ms(pg),
+						&outcome);
+
+			if (cost < best) {
+				best = cost;
+				best_cg = cg;
+				best_pg = pg;
+			}
+		}
+	}
+
+	*clockgate_delay = bucket_floor_ms(best_cg);
+	*powergate_delay = st->can_powergate ?
+		bucket_floor_ms(best_pg) : st->fixed_powergate_delay;
+}
+
+static void idle_pick_handler(struct work_struct *work)
+{
+	struct nvhost_acm_idle_stats *st = container_of(work,
+			struct nvhost_acm_idle_stats, pick_work);
+	struct nvhost_device_data *pdata = st->pdata;
+	u32 hist[NVHOST_ACM_HIST_BUCKETS];
+	int cg, pg;
+
+	mutex_lock(&pdata->lock);
+	memcpy(hist, st->hist, sizeof(hist));
+	st->repick = false;
+	mutex_unlock(&pdata->lock);
+
+	pick_delays(st, hist, &cg, &pg);
+
+	mutex_lock(&pdata->lock);
+	st->clockgate_delay = cg;
+	st->powergate_delay = pg;
+	mutex_unlock(&pdata->lock);
+}
+
+/* Choose the delays for an idle period that is starting */
+static void idle_stats_begin(struct nvhost_acm_idle_stats *st)
+{
+	if (st->adaptive && st->trained == NVHOST_ACM_TRAIN) {
+		st->idle_clockgate_delay = st->clockgate_delay;
+		st->idle_powergate_delay = st->powergate_delay;
+	} else {
+		st->idle_clockgate_delay = st->fixed_clockgate_delay;
+		st->idle_powergate_delay = st->fixed_powergate_delay;
+	}
+}
+
+void nvhost_acm_idle_stats_init(struct nvhost_acm_idle_stats *st,
+		struct nvhost_device_data *pdata)
+{
+	memset(st, 0, sizeof(*st));
+	st->pdata = pdata;
+	st->can_powergate = pdata->can_powergate;
+	st->clockgate_penalty = NVHOST_ACM_CLOCKGATE_PENALTY;
+	st->powergate_penalty = NVHOST_ACM_POWERGATE_PENALTY;
+	st->clockgated_power = NVHOST_ACM_CLOCKGATED_POWER;
+	st->fixed_clockgate_delay = pdata->clockgate_delay;
+	st->fixed_powergate_delay = pdata->powergate_delay;
+	st->clockgate_delay = pdata->clockgate_delay;
+	st->powergate_delay = pdata->powergate_delay;
+}
+
+/* Account for an idle period that lasted gap_us */
+void nvhost_acm_idle_record(struct nvhost_acm_idle_stats *st, u64 gap_us)
+{
+	enum nvhost_acm_outcome done, ideal, fixed;
+	int i;
+
+	st->cost += gap_cost(st, gap_us, st->idle_clockgate_delay,
+			st->idle_powergate_delay, &done);
+	st->fixed_cost += gap_cost(st, gap_us, st->fixed_clockgate_delay,
+			st->fixed_powergate_delay, &fixed);
+	st->ideal_cost += ideal_cost(st, gap_us, &ideal);
+	st->outcome[done][ideal]++;
+	st->periods++;
+
+	st->hist[hist_bucket(gap_us)]++;
+	if (++st->samples == NVHOST_ACM_DECAY) {
+		for (i = 0; i < NVHOST_ACM_HIST_BUCKETS; i++)
+			st->hist[i] >>= 1;
+		st->samples = 0;
+	}
+
+	if (st->trained < NVHOST_ACM_TRAIN)
+		st->trained++;
+	if (st->trained == NVHOST_ACM_TRAIN &&
+	    !(st->periods % NVHOST_ACM_REPICK))
+		st->repick = true;
+}
+
+static void idle_period_start_locked(struct nvhost_device_data *pdata)
+{
+	struct nvhost_acm_idle_stats *st = pdata->idle_stats;
+
+	if (!st)
+		return;
+
+	st->fixed_clockgate_delay = pdata->clockgate_delay;
+	st->fixed_powergate_delay = pdata->powergate_delay;
+	idle_stats_begin(st);
+	st->idle_start = ktime_get();
+	st->idle = true;
+}
+
+static void idle_period_end_locked(struct nvhost_device_data *pdata)
+{
+	struct nvhost_acm_idle_stats *st = pdata->idle_stats;
+
+	if (!st || !st->idle)
+		return;
+
+	st->idle = false;
+	nvhost_acm_idle_record(st,
+		ktime_us_delta(ktime_get(), st->idle_start));
+	if (st->repick && st->adaptive)
+		schedule_work(&st->pick_work);
+}
+
+int nvhost_module_replay_idle(struct platform_device *dev,
+		const u32 *gaps_us, int num_gaps,
+		struct nvhost_acm_idle_stats *result)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	int i;
+
+	mutex_lock(&pdata->lock);
+	nvhost_acm_idle_stats_init(result, pdata);
+	/* replay the policy even where it is off, to judge it */
+	result->adaptive = true;
+	if (pdata->idle_stats) {
+		result->clockgate_penalty =
+			pdata->idle_stats->clockgate_penalty;
+		result->powergate_penalty =
+			pdata->idle_stats->powergate_penalty;
+		result->clockgated_power =
+			pdata->idle_stats->clockgated_power;
+	}
+	mutex_unlock(&pdata->lock);
+
+	for (i = 0; i < num_gaps; i++) {
+		idle_stats_begin(result);
+		nvhost_acm_idle_record(result, gaps_us[i]);
+		if (result->repick) {
+			pick_delays(result, result->hist,
+				&result->clockgate_delay,
+				&result->powergate_delay);
+			result->repick = false;
+		}
+	}
+
+	return 0;
+}
+
+static int powergate_delay_locked(struct nvhost_device_data *pdata)
+{
+	if (pdata->idle_stats && pdata->idle_stats->idle)
+		return pdata->idle_stats->idle_powergate_delay;
+	return pdata->powergate_delay;
+}
+
+static int clockgate_delay_locked(struct nvhost_device_data *pdata)
+{
+	if (pdata->idle_stats && pdata->idle_stats->idle)
+		return pdata->idle_stats->idle_clockgate_delay;
+	return pdata->clockgate_delay;
+}
+
 static void schedule_powergating_locked(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
 	if (pdata->can_powergate)
 		schedule_delayed_work(&pdata->powerstate_down,
-				msecs_to_jiffies(pdata->powergate_delay));
+			msecs_to_jiffies(powergate_delay_locked(pdata)));
 }
 
 static void schedule_clockgating_locked(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
 	schedule_delayed_work(&pdata->powerstate_down,
-			msecs_to_jiffies(pdata->clockgate_delay));
+			msecs_to_jiffies(clockgate_delay_locked(pdata)));
 }
 
 void nvhost_module_busy(struct platform_device *dev)
@@ -252,6 +535,8 @@ void nvhost_module_busy(struct platform_device *dev)
 	cancel_delayed_work(&pdata->powerstate_down);
 
 	pdata->refcount++;
+	if (pdata->refcount == 1)
+		idle_period_end_locked(pdata);
 	if (pdata->refcount > 0 && !nvhost_module_powered(dev))
 		to_state_running_locked(dev);
 	mutex_unlock(&pdata->lock);
@@ -315,6 +600,7 @@ void nvhost_module_idle_mult(struct platform_device *dev, int refs)
 
 	/* no new submits. just schedule clock gating */
 	kick = true;
+	idle_period_start_locked(pdata);
 	if (nvhost_module_powered(dev))
 		schedule_clockgating_locked(dev);
 
@@ -552,6 +838,49 @@ static ssize_t clockgate_delay_show(struct kobject *kobj,
 	return ret;
 }
 
+static ssize_t adaptive_delay_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int adaptive = 0, ret = 0;
+	struct nvhost_device_power_attr *power_attribute =
+		container_of(attr, struct nvhost_device_power_attr, \
+			power_attr[NVHOST_POWER_SYSFS_ATTRIB_ADAPTIVE_DELAY]);
+	struct platform_device *dev = power_attribute->ndev;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+
+	mutex_lock(&pdata->lock);
+	ret = sscanf(buf, "%d", &adaptive);
+	if (ret == 1 && pdata->idle_stats) {
+		pdata->idle_stats->adaptive = !!adaptive;
+		/* the delays were not kept up while off */
+		if (adaptive &&
+		    pdata->idle_stats->trained == NVHOST_ACM_TRAIN)
+			pdata->idle_stats->repick = true;
+	} else
+		dev_err(&dev->dev, "Invalid adaptive delay setting\n");
+	mutex_unlock(&pdata->lock);
+
+	return count;
+}
+
+static ssize_t adaptive_delay_show(struct kobject *kobj,
+	struct kobj_attribute *attr, char *buf)
+{
+	int ret;
+	struct nvhost_device_power_attr *power_attribute =
+		container_of(attr, struct nvhost_device_power_attr, \
+			power_attr[NVHOST_POWER_SYSFS_ATTRIB_ADAPTIVE_DELAY]);
+	struct platform_device *dev = power_attribute->ndev;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+
+	mutex_lock(&pdata->lock);
+	ret = sprintf(buf, "%d\n",
+		pdata->idle_stats ? pdata->idle_stats->adaptive : 0);
+	mutex_unlock(&pdata->lock);
+
+	return ret;
+}
+
 int nvhost_module_set_devfreq_rate(struct platform_device *dev, int index,
 		unsigned long rate)
 {
@@ -615,6 +944,12 @@ int nvhost_module_init(struct platform_device *dev)
 		pdata->powerstate = NVHOST_POWER_STATE_CLOCKGATED;
 	}
 
+	pdata->idle_stats = kzalloc(sizeof(*pdata->idle_stats), GFP_KERNEL);
+	if (pdata->idle_stats) {
+		nvhost_acm_idle_stats_init(pdata->idle_stats, pdata);
+		INIT_WORK(&pdata->idle_stats->pick_work, idle_pick_handler);
+	}
+
 	/* Init the power sysfs attributes for this device */
 	pdata->power_attrib = kzalloc(sizeof(struct nvhost_device_power_attr),
 		GFP_KERNEL);
@@ -672,8 +1007,26 @@ int nvhost_module_init(struct platform_device *dev)
 		goto fail_refcount;
 	}
 
+	attr = &pdata->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_ADAPTIVE_DELAY];
+	attr->attr.name = "adaptive_delay";
+	attr->attr.mode = S_IWUSR | S_IRUGO;
+	attr->show = adaptive_delay_show;
+	attr->store = adaptive_delay_store;
+#ifdef CONFIG_DEBUG_LOCK_ALLOC
+	sysfs_attr_init(&attr->attr);
+#endif
+	if (sysfs_create_file(pdata->power_kobj, &attr->attr)) {
+		dev_err(&dev->dev, "Could not create sysfs attribute adaptive_delay\n");
+		err = -EIO;
+		goto fail_adaptive;
+	}
+
 	return 0;
 
+fail_adaptive:
+	attr = &pdata->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_REFCOUNT];
+	sysfs_remove_file(pdata->power_kobj, &attr->attr);
+
 fail_refcount:
 	attr = &pdata->power_attrib->power_attr[NVHOST_POWER_SYSFS_ATTRIB_POWERGATE_DELAY];
 	sysfs_remove_file(pdata->power_kobj, &attr->attr);
@@ -687,6 +1040,8 @@ fail_clockdelay:
 
 fail_attrib_alloc:
 	kfree(pdata->power_attrib);
+	kfree(pdata->idle_stats);
+	pdata->idle_stats = NULL;
 
 	return err;
 }
@@ -719,6 +1074,9 @@ int nvhost_module_suspend(struct platform_device *dev)
 	mutex_lock(&pdata->lock);
 	cancel_delayed_work(&pdata->powerstate_down);
 	to_state_powergated_locked(dev);
+	/* time spent suspended says nothing about the workload */
+	if (pdata->idle_stats)
+		pdata->idle_stats->idle = false;
 	mutex_unlock(&pdata->lock);
 
 	if (pdata->suspend_ndev)
@@ -735,6 +1093,11 @@ void nvhost_module_deinit(struct platform_device *dev)
 	nvhost_module_suspend(dev);
 	for (i = 0; i < pdata->num_clks; i++)
 		clk_put(pdata->clk[i]);
+	if (pdata->idle_stats) {
+		cancel_work_sync(&pdata->idle_stats->pick_work);
+		kfree(pdata->idle_stats);
+		pdata->idle_stats = NULL;
+	}
 	pdata->powerstate = NVHOST_POWER_STATE_DEINIT;
 }
 
@@ -25,8 +25,67 @@
 #include <linux/wait.h>
 #include <linux/mutex.h>
 #include <linux/clk.h>
+#include <linux/ktime.h>
 #include <linux/nvhost.h>
 
+/*
+ * Idle period histogram buckets. Bucket 0 holds gaps below 1 ms, bucket i
+ * gaps of [2^(i-1), 2^i) ms, and the last one everything longer.
+ */
+#define NVHOST_ACM_HIST_BUCKETS		12
+
+/* idle periods seen before delays are picked from the histogram */
+#define NVHOST_ACM_TRAIN		16
+
+enum nvhost_acm_outcome {
+	NVHOST_ACM_STAY_ON = 0,
+	NVHOST_ACM_CLOCKGATE,
+	NVHOST_ACM_POWERGATE,
+	NVHOST_ACM_OUTCOMES
+};
+
+/*
+ * Adaptive gate delay state of a module. Costs are in microseconds of
+ * running idle power.
+ */
+struct nvhost_acm_idle_stats {
+	/* policy parameters */
+	bool adaptive;			/* pick delays from the histogram */
+	bool can_powergate;
+	u32 clockgate_penalty;		/* cost of ungating clocks */
+	u32 powergate_penalty;		/* extra cost of ungating power */
+	u32 clockgated_power;		/* clock gated idle power, 1/1024 */
+	int fixed_clockgate_delay;	/* ms, used until trained */
+	int fixed_powergate_delay;	/* ms */
+
+	/* delays currently picked, ms */
+	int clockgate_delay;
+	int powergate_delay;
+
+	/* idle period histogram, halved every NVHOST_ACM_DECAY samples */
+	u32 hist[NVHOST_ACM_HIST_BUCKETS];
+	u32 samples;
+	u32 trained;
+	bool repick;			/* delays due to be picked again */
+
+	/* picks the delays of a live module off the submit path */
+	struct nvhost_device_data *pdata;
+	struct work_struct pick_work;
+
+	/* idle period in progress */
+	bool idle;
+	ktime_t idle_start;
+	int idle_clockgate_delay;
+	int idle_powergate_delay;
+
+	/* outcome of each idle period versus the best one in hindsight */
+	u64 periods;
+	u64 outcome[NVHOST_ACM_OUTCOMES][NVHOST_ACM_OUTCOMES];
+	u64 cost;			/* with the delays used */
+	u64 fixed_cost;			/* had the fixed delays been used */
+	u64 ideal_cost;			/* with perfect knowledge */
+};
+
 /* Sets clocks and powergating state for a module */
 int nvhost_module_init(struct platform_device *ndev);
 void nvhost_module_deinit(struct platform_device *dev);
@@ -47,6 +106,13 @@ int nvhost_module_set_rate(struct platform_device *dev, void *priv,
 int nvhost_module_set_devfreq_rate(struct platform_device *dev, int index,
 		unsigned long rate);
 
+void nvhost_acm_idle_stats_init(struct nvhost_acm_idle_stats *st,
+		struct nvhost_device_data *pdata);
+void nvhost_acm_idle_record(struct nvhost_acm_idle_stats *st, u64 gap_us);
+int nvhost_module_replay_idle(struct platform_device *dev,
+		const u32 *gaps_us, int num_gaps,
+		struct nvhost_acm_idle_stats *result);
+
 static inline bool nvhost_module_powered(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
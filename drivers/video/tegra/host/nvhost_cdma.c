@@ -404,7 +404,12 @@ int nvhost_cdma_begin(struct nvhost_cdma *cdma, struct nvhost_job *job)
 	return 0;
 }
 
-static void trace_write_gather(struct nvhost_cdma *cdma,
+/**
+ * Trace the contents of a gather when command buffer tracing is on
+ * Maps the buffer, so callers submitting many gathers should do this
+ * before nvhost_cdma_begin() and push them with __nvhost_cdma_push_gather().
+ */
+void nvhost_cdma_trace_gather(struct nvhost_cdma *cdma,
 		struct mem_handle *ref,
 		u32 offset, u32 words)
 {
@@ -454,15 +459,26 @@ void nvhost_cdma_push(struct nvhost_cdma *cdma, u32 op1, u32 op2)
 void nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		struct mem_mgr *client, struct mem_handle *handle,
 		u32 offset, u32 op1, u32 op2)
+{
+	if (handle)
+		nvhost_cdma_trace_gather(cdma, handle, offset, op1 & 0xffff);
+
+	__nvhost_cdma_push_gather(cdma, client, handle, op1, op2);
+}
+
+/**
+ * Push two words into a push buffer slot without tracing the gather
+ * Blocks as necessary if the push buffer is full.
+ */
+void __nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
+		struct mem_mgr *client, struct mem_handle *handle,
+		u32 op1, u32 op2)
 {
 	u32 slots_free = cdma->slots_free;
 	struct push_buffer *pb = &cdma->push_buffer;
 	BUG_ON(!cdma_pb_op().push_to);
 	BUG_ON(!cdma_op().kick);
 
-	if (handle)
-		trace_write_gather(cdma, handle, offset, op1 & 0xffff);
-
 	if (slots_free == 0) {
 		cdma_op().kick(cdma);
 		slots_free = nvhost_cdma_wait_locked(cdma,
@@ -111,6 +111,11 @@ void	nvhost_cdma_push(struct nvhost_cdma *cdma, u32 op1, u32 op2);
 void	nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		struct mem_mgr *client,
 		struct mem_handle *handle, u32 offset, u32 op1, u32 op2);
+void	__nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
+		struct mem_mgr *client,
+		struct mem_handle *handle, u32 op1, u32 op2);
+void	nvhost_cdma_trace_gather(struct nvhost_cdma *cdma,
+		struct mem_handle *ref, u32 offset, u32 words);
 void	nvhost_cdma_end(struct nvhost_cdma *cdma,
 		struct nvhost_job *job);
 void	nvhost_cdma_update(struct nvhost_cdma *cdma);
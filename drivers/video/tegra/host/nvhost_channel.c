@@ -44,6 +44,7 @@ int nvhost_channel_init(struct nvhost_channel *ch,
 		return err;
 	}
 	pdata->channel = ch;
+	nvhost_job_reloc_cache_init(&ch->reloc_cache);
 
 	return 0;
 }
@@ -24,6 +24,7 @@
 #include <linux/cdev.h>
 #include <linux/io.h>
 #include "nvhost_cdma.h"
+#include "nvhost_job.h"
 
 #define NVHOST_MAX_WAIT_CHECKS		256
 #define NVHOST_MAX_GATHERS		512
@@ -48,6 +49,7 @@ struct nvhost_channel {
 	struct cdev cdev;
 	struct nvhost_hwctx_handler *ctxhandler;
 	struct nvhost_cdma cdma;
+	struct nvhost_reloc_cache reloc_cache;
 };
 
 int nvhost_channel_init(struct nvhost_channel *ch,
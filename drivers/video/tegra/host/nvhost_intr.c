@@ -28,11 +28,13 @@
 #include "nvhost_channel.h"
 #include "nvhost_hwctx.h"
 #include "chip_support.h"
+#include "nvhost_sync.h"
 
 /*** Wait list management ***/
 
 struct nvhost_waitlist {
 	struct list_head list;
+	struct llist_node pending;
 	struct kref refcount;
 	u32 thresh;
 	enum nvhost_intr_action action;
@@ -53,44 +55,146 @@ static void waiter_release(struct kref *kref)
 	kfree(container_of(kref, struct nvhost_waitlist, refcount));
 }
 
+/*
+ * Waiters live in a small timer wheel per sync point.  Slot
+ * (thresh & WHEEL_MASK) holds the waiters for exactly one threshold of
+ * the window [wheel_base, wheel_base + NVHOST_INTR_WHEEL_SIZE).  Waiters
+ * further out are hashed, unsorted, into overflow buckets that each hold
+ * one wheel-sized block of thresholds, and the few beyond the last bucket
+ * sit on the far list.  A bucket is cascaded into the wheel once the base
+ * reaches its block, so inserting is O(1) at every level.  Every
+ * comparison is made on the signed difference, so the window is valid
+ * across sync point wraparound.
+ *
+ * Submitters never wait for the wheel lock: they push onto the lock-free
+ * pending list and fold it into the wheel only if the lock is free.
+ * Whoever holds the lock rechecks the pending list before letting go.
+ */
+#define WHEEL_MASK (NVHOST_INTR_WHEEL_SIZE - 1)
+#define OVF_MASK (NVHOST_INTR_OVF_SIZE - 1)
+
+/* first threshold of the block holding thresh */
+static inline u32 wheel_block(u32 thresh)
+{
+	return thresh & ~WHEEL_MASK;
+}
+
+static inline unsigned int ovf_bucket(u32 block)
+{
+	return (block >> NVHOST_INTR_WHEEL_BITS) & OVF_MASK;
+}
+
+static bool wheel_empty(struct nvhost_intr_syncpt *syncpt)
+{
+	return bitmap_empty(syncpt->wheel_map, NVHOST_INTR_WHEEL_SIZE) &&
+		bitmap_empty(syncpt->ovf_map, NVHOST_INTR_OVF_SIZE) &&
+		list_empty(&syncpt->far);
+}
+
 /**
- * add a waiter to a waiter queue, sorted by threshold
- * returns true if it was added at the head of the queue
+ * place a waiter in its wheel slot, its overflow bucket, on the far list,
+ * or on the expired list if its threshold is already behind the wheel
  */
-static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+static void wheel_insert(struct nvhost_intr_syncpt *syncpt,
+			 struct nvhost_waitlist *waiter)
 {
-	struct nvhost_waitlist *pos;
-	u32 thresh = waiter->thresh;
+	s32 delta = waiter->thresh - syncpt->wheel_base;
+	u32 block = wheel_block(waiter->thresh);
+	s32 blocks;
+	unsigned int slot;
+
+	if (delta < 0) {
+		list_add_tail(&waiter->list, &syncpt->expired);
+		return;
+	}
 
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
-		}
+	if (delta < NVHOST_INTR_WHEEL_SIZE) {
+		slot = waiter->thresh & WHEEL_MASK;
+		list_add_tail(&waiter->list, &syncpt->wheel[slot]);
+		__set_bit(slot, syncpt->wheel_map);
+		return;
+	}
+
+	blocks = (s32)(block - wheel_block(syncpt->wheel_base)) >>
+		NVHOST_INTR_WHEEL_BITS;
+	if (blocks < NVHOST_INTR_OVF_SIZE) {
+		slot = ovf_bucket(block);
+		list_add_tail(&waiter->list, &syncpt->ovf[slot]);
+		__set_bit(slot, syncpt->ovf_map);
+		return;
+	}
+
+	/* rescan once the waiter's block comes within the buckets' reach */
+	block -= (NVHOST_INTR_OVF_SIZE - 1) << NVHOST_INTR_WHEEL_BITS;
+	if (list_empty(&syncpt->far) ||
+	    (s32)(block - syncpt->far_due) < 0)
+		syncpt->far_due = block;
+	list_add_tail(&waiter->list, &syncpt->far);
+}
+
+/* reinsert all waiters of a list relative to the current wheel base */
+static void wheel_reinsert(struct nvhost_intr_syncpt *syncpt,
+			   struct list_head *head)
+{
+	struct nvhost_waitlist *waiter, *next;
+	LIST_HEAD(moved);
+
+	list_splice_init(head, &moved);
+	list_for_each_entry_safe(waiter, next, &moved, list) {
+		list_del(&waiter->list);
+		wheel_insert(syncpt, waiter);
+	}
+}
+
+/**
+ * move waiters queued by nvhost_intr_add_action() into the wheel
+ * returns true if there are waiters whose threshold has already passed
+ */
+static bool wheel_drain_pending(struct nvhost_intr *intr,
+				struct nvhost_intr_syncpt *syncpt)
+{
+	struct llist_node *node = llist_del_all(&syncpt->pending);
+	struct llist_node *fifo = NULL, *next;
+	struct nvhost_waitlist *waiter;
+
+	if (node && wheel_empty(syncpt)) {
+		/* idle wheel: rebase on the cached value, a safe lower bound */
+		syncpt->wheel_base = nvhost_syncpt_read_min(
+				&intr_to_dev(intr)->syncpt, syncpt->id) + 1;
+	}
+
+	/* llist is LIFO, restore submission order */
+	while (node) {
+		next = node->next;
+		node->next = fifo;
+		fifo = node;
+		node = next;
+	}
+
+	while (fifo) {
+		waiter = llist_entry(fifo, struct nvhost_waitlist, pending);
+		fifo = fifo->next;
+		wheel_insert(syncpt, waiter);
+	}
 
-	list_add(&waiter->list, queue);
-	return true;
+	return !list_empty(&syncpt->expired);
 }
 
 /**
- * run through a waiter queue for a single sync point ID
- * and gather all completed waiters into lists by actions
+ * gather all waiters on a list into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
+static void remove_completed_waiters(struct list_head *head,
 			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
 	struct nvhost_waitlist *waiter, *next, *prev;
 
 	list_for_each_entry_safe(waiter, next, head, list) {
-		if ((s32)(waiter->thresh - sync) > 0)
-			break;
-
 		dest = completed + waiter->action;
 
-		/* consolidate submit cleanups */
-		if (waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE
+		/* consolidate submit cleanups and timeline signals */
+		if ((waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE ||
+		     waiter->action == NVHOST_INTR_ACTION_SIGNAL_SYNC_PT)
 			&& !list_empty(dest)) {
 			prev = list_entry(dest->prev,
 					struct nvhost_waitlist, list);
@@ -110,19 +214,99 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 	}
 }
 
-void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
-			       unsigned int id)
+/**
+ * advance the wheel up to sync and gather all completed waiters
+ */
+static void wheel_advance(struct nvhost_intr_syncpt *syncpt, u32 sync,
+			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
-	BUG_ON(!(intr_op().set_syncpt_threshold &&
-		 intr_op().enable_syncpt_intr));
+	u32 base = syncpt->wheel_base;
+	unsigned int i, nr_slots, nr_blocks;
+
+	if ((s32)(sync - base) >= 0) {
+		nr_slots = min_t(u32, sync - base + 1, NVHOST_INTR_WHEEL_SIZE);
+		for (i = 0; i < nr_slots; i++) {
+			unsigned int slot = (base + i) & WHEEL_MASK;
 
-	intr_op().set_syncpt_threshold(intr, id, thresh);
-	intr_op().enable_syncpt_intr(intr, id);
+			if (__test_and_clear_bit(slot, syncpt->wheel_map))
+				remove_completed_waiters(&syncpt->wheel[slot],
+							 completed);
+		}
+		syncpt->wheel_base = sync + 1;
+
+		/* cascade the buckets of every block the base entered */
+		nr_blocks = (wheel_block(syncpt->wheel_base) -
+			     wheel_block(base)) >> NVHOST_INTR_WHEEL_BITS;
+		nr_blocks = min_t(unsigned int, nr_blocks,
+				  NVHOST_INTR_OVF_SIZE);
+		for (i = 1; i <= nr_blocks; i++) {
+			unsigned int slot = ovf_bucket(wheel_block(base) +
+					(i << NVHOST_INTR_WHEEL_BITS));
+
+			if (__test_and_clear_bit(slot, syncpt->ovf_map))
+				wheel_reinsert(syncpt, &syncpt->ovf[slot]);
+		}
+
+		if (!list_empty(&syncpt->far) &&
+		    (s32)(wheel_block(syncpt->wheel_base) -
+			  syncpt->far_due) >= 0)
+			wheel_reinsert(syncpt, &syncpt->far);
+	}
+
+	remove_completed_waiters(&syncpt->expired, completed);
 }
 
+/**
+ * program the threshold interrupt for the earliest waiter in the wheel,
+ * or turn it off if there is nothing to wait for. a waiter in a bucket
+ * or on the far list is not looked at one by one: the interrupt is set
+ * for the start of its block, where it gets cascaded towards the wheel.
+ */
+static void wheel_arm(struct nvhost_intr *intr,
+		      struct nvhost_intr_syncpt *syncpt)
+{
+	u32 base = syncpt->wheel_base;
+	unsigned int start = base & WHEEL_MASK;
+	unsigned int slot;
+	u32 thresh, block;
+	bool armed = false;
+
+	if (!bitmap_empty(syncpt->wheel_map, NVHOST_INTR_WHEEL_SIZE)) {
+		slot = find_next_bit(syncpt->wheel_map,
+				     NVHOST_INTR_WHEEL_SIZE, start);
+		if (slot >= NVHOST_INTR_WHEEL_SIZE)
+			slot = find_first_bit(syncpt->wheel_map,
+					      NVHOST_INTR_WHEEL_SIZE);
+		thresh = base + ((slot - start) & WHEEL_MASK);
+		armed = true;
+	}
+
+	if (!bitmap_empty(syncpt->ovf_map, NVHOST_INTR_OVF_SIZE)) {
+		start = ovf_bucket(wheel_block(base));
+		slot = find_next_bit(syncpt->ovf_map,
+				     NVHOST_INTR_OVF_SIZE, start);
+		if (slot >= NVHOST_INTR_OVF_SIZE)
+			slot = find_first_bit(syncpt->ovf_map,
+					      NVHOST_INTR_OVF_SIZE);
+		block = wheel_block(base) +
+			(((slot - start) & OVF_MASK) << NVHOST_INTR_WHEEL_BITS);
+		if (!armed || (s32)(block - thresh) < 0)
+			thresh = block;
+		armed = true;
+	} else if (!list_empty(&syncpt->far)) {
+		if (!armed || (s32)(syncpt->far_due - thresh) < 0)
+			thresh = syncpt->far_due;
+		armed = true;
+	}
+
+	if (!armed) {
+		intr_op().disable_syncpt_intr(intr, syncpt->id);
+		return;
+	}
+
+	intr_op().set_syncpt_threshold(intr, syncpt->id, thresh);
+	intr_op().enable_syncpt_intr(intr, syncpt->id);
+}
 
 static void action_submit_complete(struct nvhost_waitlist *waiter)
 {
@@ -164,6 +348,13 @@ static void action_wakeup_interruptible(struct nvhost_waitlist *waiter)
 	wake_up_interruptible(wq);
 }
 
+static void action_signal_sync_pt(struct nvhost_waitlist *waiter)
+{
+	struct nvhost_sync_timeline *obj = waiter->data;
+
+	nvhost_sync_timeline_signal(obj);
+}
+
 typedef void (*action_handler)(struct nvhost_waitlist *waiter);
 
 static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
@@ -171,6 +362,7 @@ static action_handler action_handlers[NVHOST_INTR_ACTION_COUNT] = {
 	action_ctxsave,
 	action_wakeup,
 	action_wakeup_interruptible,
+	action_signal_sync_pt,
 };
 
 static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
@@ -194,33 +386,30 @@ static void run_handlers(struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 /**
  * Remove & handle all waiters that have completed for the given syncpt
  */
-static int process_wait_list(struct nvhost_intr *intr,
-			     struct nvhost_intr_syncpt *syncpt,
-			     u32 threshold)
+static void process_wait_list(struct nvhost_intr *intr,
+			      struct nvhost_intr_syncpt *syncpt,
+			      u32 threshold)
 {
 	struct list_head completed[NVHOST_INTR_ACTION_COUNT];
 	unsigned int i;
-	int empty;
 
-	for (i = 0; i < NVHOST_INTR_ACTION_COUNT; ++i)
-		INIT_LIST_HEAD(completed + i);
+	do {
+		for (i = 0; i < NVHOST_INTR_ACTION_COUNT; ++i)
+			INIT_LIST_HEAD(completed + i);
 
-	spin_lock(&syncpt->lock);
+		spin_lock(&syncpt->lock);
 
-	remove_completed_waiters(&syncpt->wait_head, threshold, completed);
+		wheel_drain_pending(intr, syncpt);
+		wheel_advance(syncpt, threshold, completed);
+		wheel_arm(intr, syncpt);
 
-	empty = list_empty(&syncpt->wait_head);
-	if (empty)
-		intr_op().disable_syncpt_intr(intr, syncpt->id);
-	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
-
-	spin_unlock(&syncpt->lock);
+		spin_unlock(&syncpt->lock);
 
-	run_handlers(completed);
+		run_handlers(completed);
 
-	return empty;
+		/* pick up waiters that were queued while we held the lock */
+		smp_mb();
+	} while (!llist_empty(&syncpt->pending));
 }
 
 /*** host syncpt interrupt service functions ***/
@@ -235,8 +424,8 @@ irqreturn_t nvhost_syncpt_thresh_fn(int irq, void *dev_id)
 	struct nvhost_intr *intr = intr_syncpt_to_intr(syncpt);
 	struct nvhost_master *dev = intr_to_dev(intr);
 
-	(void)process_wait_list(intr, syncpt,
-				nvhost_syncpt_update_min(&dev->syncpt, id));
+	process_wait_list(intr, syncpt,
+			  nvhost_syncpt_update_min(&dev->syncpt, id));
 
 	return IRQ_HANDLED;
 }
@@ -267,7 +456,7 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 {
 	struct nvhost_waitlist *waiter = _waiter;
 	struct nvhost_intr_syncpt *syncpt;
-	int queue_was_empty;
+	bool expired;
 
 	BUG_ON(waiter == NULL);
 
@@ -287,21 +476,27 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 
 	syncpt = intr->syncpt + id;
 
-	spin_lock(&syncpt->lock);
+	llist_add(&waiter->pending, &syncpt->pending);
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	/*
+	 * Only fold the pending list in if nobody else is working on the
+	 * wheel; the current owner picks our waiter up before it unlocks.
+	 * Handlers are never run from here, callers may hold locks the
+	 * handlers take, so expired waiters are left to the syncpt work.
+	 */
+	while (spin_trylock(&syncpt->lock)) {
+		expired = wheel_drain_pending(intr, syncpt);
+		wheel_arm(intr, syncpt);
+		spin_unlock(&syncpt->lock);
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
-		/* added at head of list - new threshold value */
-		intr_op().set_syncpt_threshold(intr, id, thresh);
+		if (expired)
+			queue_work(intr->wq, &syncpt->work);
 
-		/* added as first waiter - enable interrupt */
-		if (queue_was_empty)
-			intr_op().enable_syncpt_intr(intr, id);
+		smp_mb();
+		if (llist_empty(&syncpt->pending))
+			break;
 	}
 
-	spin_unlock(&syncpt->lock);
-
 	if (ref)
 		*ref = waiter;
 	return 0;
@@ -324,8 +519,8 @@ void nvhost_intr_put_ref(struct nvhost_intr *intr, u32 id, void *ref)
 		schedule();
 
 	syncpt = intr->syncpt + id;
-	(void)process_wait_list(intr, syncpt,
-				nvhost_syncpt_update_min(&host->syncpt, id));
+	process_wait_list(intr, syncpt,
+			  nvhost_syncpt_update_min(&host->syncpt, id));
 
 	kref_put(&waiter->refcount, waiter_release);
 }
@@ -335,7 +530,7 @@ void nvhost_intr_put_ref(struct nvhost_intr *intr, u32 id, void *ref)
 
 int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 {
-	unsigned int id;
+	unsigned int id, i;
 	struct nvhost_intr_syncpt *syncpt;
 	struct nvhost_master *host = intr_to_dev(intr);
 	u32 nb_pts = nvhost_syncpt_nb_pts(&host->syncpt);
@@ -354,7 +549,15 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->id = id;
 		syncpt->irq = irq_sync + id;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		init_llist_head(&syncpt->pending);
+		for (i = 0; i < NVHOST_INTR_WHEEL_SIZE; i++)
+			INIT_LIST_HEAD(&syncpt->wheel[i]);
+		bitmap_zero(syncpt->wheel_map, NVHOST_INTR_WHEEL_SIZE);
+		for (i = 0; i < NVHOST_INTR_OVF_SIZE; i++)
+			INIT_LIST_HEAD(&syncpt->ovf[i]);
+		bitmap_zero(syncpt->ovf_map, NVHOST_INTR_OVF_SIZE);
+		INIT_LIST_HEAD(&syncpt->far);
+		INIT_LIST_HEAD(&syncpt->expired);
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -388,7 +591,7 @@ void nvhost_intr_start(struct nvhost_intr *intr, u32 hz)
 
 void nvhost_intr_stop(struct nvhost_intr *intr)
 {
-	unsigned int id;
+	unsigned int id, i;
 	struct nvhost_intr_syncpt *syncpt;
 	u32 nb_pts = nvhost_syncpt_nb_pts(&intr_to_dev(intr)->syncpt);
 
@@ -404,15 +607,29 @@ void nvhost_intr_stop(struct nvhost_intr *intr)
 	     id < nb_pts;
 	     ++id, ++syncpt) {
 		struct nvhost_waitlist *waiter, *next;
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		LIST_HEAD(waiters);
+
+		spin_lock(&syncpt->lock);
+		wheel_drain_pending(intr, syncpt);
+		for (i = 0; i < NVHOST_INTR_WHEEL_SIZE; i++)
+			list_splice_tail_init(&syncpt->wheel[i], &waiters);
+		bitmap_zero(syncpt->wheel_map, NVHOST_INTR_WHEEL_SIZE);
+		for (i = 0; i < NVHOST_INTR_OVF_SIZE; i++)
+			list_splice_tail_init(&syncpt->ovf[i], &waiters);
+		bitmap_zero(syncpt->ovf_map, NVHOST_INTR_OVF_SIZE);
+		list_splice_tail_init(&syncpt->far, &waiters);
+		list_splice_tail_init(&syncpt->expired, &waiters);
+
+		list_for_each_entry_safe(waiter, next, &waiters, list) {
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
 				list_del(&waiter->list);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
+		spin_unlock(&syncpt->lock);
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (!list_empty(&waiters)) {  /* output diagnostics */
 			printk(KERN_DEBUG "%s id=%d\n", __func__, id);
 			BUG_ON(1);
 		}
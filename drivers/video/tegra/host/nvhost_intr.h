@@ -25,6 +25,7 @@
 #include <linux/semaphore.h>
 #include <linux/interrupt.h>
 #include <linux/workqueue.h>
+#include <linux/llist.h>
 
 struct nvhost_channel;
 
@@ -53,17 +54,38 @@ enum nvhost_intr_action {
 	 */
 	NVHOST_INTR_ACTION_WAKEUP_INTERRUPTIBLE,
 
+	/**
+	 * Signal the sync timeline of the sync point.
+	 * 'data' points to a nvhost_sync_timeline
+	 */
+	NVHOST_INTR_ACTION_SIGNAL_SYNC_PT,
+
 	NVHOST_INTR_ACTION_COUNT
 };
 
 struct nvhost_intr;
 
+/* waiters within this many increments of the sync point sit in the wheel */
+#define NVHOST_INTR_WHEEL_BITS	6
+#define NVHOST_INTR_WHEEL_SIZE	(1 << NVHOST_INTR_WHEEL_BITS)
+/* further out, waiters are kept in buckets of one wheel's worth each */
+#define NVHOST_INTR_OVF_BITS	5
+#define NVHOST_INTR_OVF_SIZE	(1 << NVHOST_INTR_OVF_BITS)
+
 struct nvhost_intr_syncpt {
 	struct nvhost_intr *intr;
 	u8 id;
 	u16 irq;
-	spinlock_t lock;
-	struct list_head wait_head;
+	spinlock_t lock;		/* protects the wheel */
+	struct llist_head pending;	/* waiters not yet in the wheel */
+	u32 wheel_base;
+	DECLARE_BITMAP(wheel_map, NVHOST_INTR_WHEEL_SIZE);
+	struct list_head wheel[NVHOST_INTR_WHEEL_SIZE];
+	DECLARE_BITMAP(ovf_map, NVHOST_INTR_OVF_SIZE);
+	struct list_head ovf[NVHOST_INTR_OVF_SIZE]; /* beyond the wheel */
+	struct list_head far;		/* beyond the buckets, unsorted */
+	u32 far_due;			/* when far needs a rescan */
+	struct list_head expired;	/* behind the wheel, not yet handled */
 	char thresh_irq_name[12];
 	struct work_struct work;
 };
@@ -21,6 +21,9 @@
 #include <linux/slab.h>
 #include <linux/kref.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
 #include <linux/vmalloc.h>
 #include <linux/scatterlist.h>
 #include <trace/events/nvhost.h>
@@ -321,6 +324,268 @@ static int do_relocs(struct nvhost_job *job,
 }
 
 
+/*
+ * Relocation cache
+ *
+ * Remembers, per gather buffer, the relocations last patched into it and
+ * the addresses they resolved to. When user space resubmits a buffer with
+ * the same non-zero generation, the same relocations, and every target is
+ * still pinned at the same address, the buffer already holds the right
+ * words and do_relocs() is skipped together with its kmaps.
+ *
+ * Each channel has its own cache and lock, so submits on different
+ * channels do not contend. A buffer may still be patched through any
+ * channel: every patch stamps the buffer's slot in reloc_patch_stamp, and
+ * an entry is only used while the slot still holds the stamp of the patch
+ * that created it. Buffers sharing a slot only cost each other a miss.
+ * Every pin of a cached buffer on its channel goes through here, so a
+ * patch with other relocations or without a generation drops the entry.
+ * An entry holds a reference to its buffer so the id cannot be reused
+ * while cached.
+ */
+#define RELOC_CACHE_SIZE	16
+#define RELOC_STAMP_BITS	8
+
+struct nvhost_reloc_cache_entry {
+	struct list_head list;
+	struct mem_mgr *memmgr;
+	struct mem_handle *ref;
+	u32 mem_id;
+	u32 gen;
+	u32 stamp;
+	int num_relocs;
+	struct nvhost_reloc *relocs;
+	u32 *shifts;
+	dma_addr_t *addrs;
+};
+
+static atomic_t reloc_patch_stamp[1 << RELOC_STAMP_BITS];
+static atomic_t reloc_patch_seq;
+
+static atomic_t *reloc_stamp_slot(u32 mem_id)
+{
+	return &reloc_patch_stamp[hash_32(mem_id, RELOC_STAMP_BITS)];
+}
+
+/* called before a buffer is patched; returns the stamp of this patch */
+static u32 reloc_stamp_patch(u32 mem_id)
+{
+	u32 stamp = atomic_inc_return(&reloc_patch_seq);
+
+	atomic_set(reloc_stamp_slot(mem_id), stamp);
+	return stamp;
+}
+
+void nvhost_job_reloc_cache_init(struct nvhost_reloc_cache *cache)
+{
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+	cache->len = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+static struct nvhost_reloc_cache_entry *reloc_cache_find(
+		struct nvhost_reloc_cache *cache, u32 mem_id)
+{
+	struct nvhost_reloc_cache_entry *e;
+
+	list_for_each_entry(e, &cache->lru, list)
+		if (e->mem_id == mem_id)
+			return e;
+
+	return NULL;
+}
+
+static void reloc_cache_free(struct nvhost_reloc_cache_entry *e)
+{
+	if (e->ref)
+		mem_op().put(e->memmgr, e->ref);
+	if (e->memmgr)
+		mem_op().put_mgr(e->memmgr);
+	kfree(e);
+}
+
+static bool reloc_cache_match(struct nvhost_job *job,
+		struct nvhost_job_gather *g, struct nvhost_reloc_cache_entry *e)
+{
+	int i, n = 0;
+
+	if (e->gen != g->gen)
+		return false;
+
+	/* patched through another channel since */
+	if ((u32)atomic_read(reloc_stamp_slot(e->mem_id)) != e->stamp)
+		return false;
+
+	for (i = 0; i < job->num_relocs; i++) {
+		struct nvhost_reloc *reloc = &job->relocarray[i];
+
+		if (reloc->cmdbuf_mem != g->mem_id)
+			continue;
+
+		if (n == e->num_relocs ||
+		    reloc->cmdbuf_offset != e->relocs[n].cmdbuf_offset ||
+		    reloc->target != e->relocs[n].target ||
+		    reloc->target_offset != e->relocs[n].target_offset ||
+		    job->relocshiftarray[i].shift != e->shifts[n] ||
+		    job->reloc_addr_phys[i] != e->addrs[n])
+			return false;
+		n++;
+	}
+
+	return n == e->num_relocs;
+}
+
+static struct nvhost_reloc_cache_entry *reloc_cache_build(
+		struct nvhost_job *job, struct nvhost_job_gather *g)
+{
+	struct nvhost_reloc_cache_entry *e;
+	int i, n = 0;
+
+	for (i = 0; i < job->num_relocs; i++)
+		if (job->relocarray[i].cmdbuf_mem == g->mem_id)
+			n++;
+
+	e = kzalloc(sizeof(*e) + n * (sizeof(*e->relocs) +
+			sizeof(*e->addrs) + sizeof(*e->shifts)), GFP_KERNEL);
+	if (!e)
+		return NULL;
+
+	e->relocs = (struct nvhost_reloc *)&e[1];
+	e->addrs = (dma_addr_t *)&e->relocs[n];
+	e->shifts = (u32 *)&e->addrs[n];
+	e->mem_id = g->mem_id;
+	e->gen = g->gen;
+
+	for (i = 0; i < job->num_relocs; i++) {
+		if (job->relocarray[i].cmdbuf_mem != g->mem_id)
+			continue;
+		e->relocs[e->num_relocs] = job->relocarray[i];
+		e->shifts[e->num_relocs] = job->relocshiftarray[i].shift;
+		e->addrs[e->num_relocs] = job->reloc_addr_phys[i];
+		e->num_relocs++;
+	}
+
+	return e;
+}
+
+/*
+ * Decide for each gather buffer of a pinned job whether its relocations
+ * are still in place. This has to look at the relocations before
+ * do_relocs() starts consuming and reordering them.
+ */
+static void reloc_cache_prepare(struct nvhost_job *job)
+{
+	struct nvhost_reloc_cache *cache = &job->ch->reloc_cache;
+	struct nvhost_reloc_cache_entry *stale;
+	int i, j;
+
+	for (i = 0; i < job->num_gathers; i++) {
+		struct nvhost_job_gather *g = &job->gathers[i];
+		struct nvhost_reloc_cache_entry *e;
+		bool first = true;
+
+		g->relocs_cached = false;
+		g->reloc_entry = NULL;
+
+		for (j = 0; j < i; j++)
+			if (job->gathers[j].mem_id == g->mem_id)
+				first = false;
+		if (!first)
+			continue;
+
+		stale = NULL;
+		mutex_lock(&cache->lock);
+		e = reloc_cache_find(cache, g->mem_id);
+		if (e && g->gen && reloc_cache_match(job, g, e)) {
+			list_move(&e->list, &cache->lru);
+			g->relocs_cached = true;
+			cache->hits++;
+		} else if (e) {
+			/* about to be patched over */
+			list_del(&e->list);
+			cache->len--;
+			stale = e;
+		}
+		if (!g->relocs_cached && g->gen)
+			cache->misses++;
+		mutex_unlock(&cache->lock);
+
+		if (stale)
+			reloc_cache_free(stale);
+
+		if (!g->relocs_cached && g->gen &&
+		    nvhost_memmgr_type(g->mem_id) == mem_mgr_type_nvmap)
+			g->reloc_entry = reloc_cache_build(job, g);
+	}
+}
+
+/*
+ * Remember the relocations just patched into g. The entry takes over the
+ * reference to the buffer held by the gather.
+ */
+static void reloc_cache_commit(struct nvhost_job *job,
+		struct nvhost_job_gather *g)
+{
+	struct nvhost_reloc_cache *cache = &job->ch->reloc_cache;
+	struct nvhost_reloc_cache_entry *e = g->reloc_entry;
+	struct nvhost_reloc_cache_entry *stale = NULL;
+
+	g->reloc_entry = NULL;
+	e->memmgr = mem_op().get_mgr(job->memmgr);
+	e->ref = g->ref;
+
+	mutex_lock(&cache->lock);
+	stale = reloc_cache_find(cache, e->mem_id);
+	if (stale) {
+		list_del(&stale->list);
+		cache->len--;
+	} else if (cache->len == RELOC_CACHE_SIZE) {
+		stale = list_entry(cache->lru.prev,
+				struct nvhost_reloc_cache_entry, list);
+		list_del(&stale->list);
+		cache->len--;
+	}
+	list_add(&e->list, &cache->lru);
+	cache->len++;
+	mutex_unlock(&cache->lock);
+
+	if (stale)
+		reloc_cache_free(stale);
+}
+
+void nvhost_job_reloc_cache_flush(struct nvhost_channel *ch,
+		struct mem_mgr *memmgr)
+{
+	struct nvhost_reloc_cache *cache = &ch->reloc_cache;
+	struct nvhost_reloc_cache_entry *e, *tmp;
+	LIST_HEAD(stale);
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(e, tmp, &cache->lru, list) {
+		if (e->memmgr == memmgr) {
+			list_move(&e->list, &stale);
+			cache->len--;
+		}
+	}
+	mutex_unlock(&cache->lock);
+
+	list_for_each_entry_safe(e, tmp, &stale, list)
+		reloc_cache_free(e);
+}
+
+void nvhost_job_reloc_cache_stats(struct nvhost_channel *ch,
+		u32 *hits, u32 *misses)
+{
+	struct nvhost_reloc_cache *cache = &ch->reloc_cache;
+
+	mutex_lock(&cache->lock);
+	*hits = cache->hits;
+	*misses = cache->misses;
+	mutex_unlock(&cache->lock);
+}
+
 int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 {
 	int err = 0, i = 0, j = 0;
@@ -344,6 +609,7 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 		goto fail;
 
 	/* patch gathers */
+	reloc_cache_prepare(job);
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
 
@@ -367,15 +633,30 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 					tmp->mem_base = g->mem_base;
 				}
 			}
-			err = do_relocs(job, g->mem_id,  g->ref);
+			if (!g->relocs_cached) {
+				u32 stamp = reloc_stamp_patch(g->mem_id);
+
+				if (g->reloc_entry)
+					g->reloc_entry->stamp = stamp;
+				err = do_relocs(job, g->mem_id,  g->ref);
+			}
 			if (!err)
 				err = do_waitchks(job, sp,
 						g->mem_id, g->ref);
-			mem_op().put(job->memmgr, g->ref);
+			if (!err && g->reloc_entry)
+				reloc_cache_commit(job, g);
+			else
+				mem_op().put(job->memmgr, g->ref);
 			if (err)
 				break;
 		}
 	}
+
+	/* entries of gathers not reached because of an error */
+	for (i = 0; i < job->num_gathers; i++) {
+		kfree(job->gathers[i].reloc_entry);
+		job->gathers[i].reloc_entry = NULL;
+	}
 fail:
 	wmb();
 
@@ -23,12 +23,25 @@
 
 #include <linux/nvhost_ioctl.h>
 #include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
 
 struct nvhost_channel;
 struct nvhost_hwctx;
 struct nvhost_waitchk;
 struct nvhost_syncpt;
 struct sg_table;
+struct mem_mgr;
+struct nvhost_reloc_cache_entry;
+
+/* per-channel relocation cache, see nvhost_job.c */
+struct nvhost_reloc_cache {
+	struct mutex lock;
+	struct list_head lru;		/* most recently used first */
+	int len;
+	u32 hits;
+	u32 misses;
+};
 
 struct nvhost_job_gather {
 	u32 words;
@@ -37,6 +50,12 @@ struct nvhost_job_gather {
 	u32 mem_id;
 	int offset;
 	struct mem_handle *ref;
+
+	/* User space generation of the gather contents, 0 if unknown */
+	u32 gen;
+	/* Relocation cache state, valid while the job is being pinned */
+	bool relocs_cached;
+	struct nvhost_reloc_cache_entry *reloc_entry;
 };
 
 /*
@@ -148,6 +167,26 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp);
  */
 void nvhost_job_unpin(struct nvhost_job *job);
 
+/*
+ * Initialize the relocation cache of a channel.
+ */
+void nvhost_job_reloc_cache_init(struct nvhost_reloc_cache *cache);
+
+/*
+ * Drop all entries of the channel's relocation cache created through
+ * memmgr. Must be called before the last reference to a memory manager
+ * that has submitted gathers with a generation goes away, as the cache
+ * holds handles from it.
+ */
+void nvhost_job_reloc_cache_flush(struct nvhost_channel *ch,
+		struct mem_mgr *memmgr);
+
+/*
+ * Read the relocation cache hit and miss counters of a channel.
+ */
+void nvhost_job_reloc_cache_stats(struct nvhost_channel *ch,
+		u32 *hits, u32 *misses);
+
 /*
  * Dump contents of job to debug output.
  */
@@ -253,6 +253,20 @@ void nvhost_memmgr_kunmap(struct mem_handle *handle, unsigned int pagenum,
 	}
 }
 
+u32 nvhost_memmgr_handle_to_id(struct mem_handle *handle)
+{
+	switch (nvhost_memmgr_type((u32)handle)) {
+#ifdef CONFIG_TEGRA_GRHOST_USE_NVMAP
+	case mem_mgr_type_nvmap:
+		return nvhost_nvmap_handle_to_id(handle);
+		break;
+#endif
+	default:
+		return 0;
+		break;
+	}
+}
+
 int nvhost_memmgr_pin_array_ids(struct mem_mgr *mgr,
 		struct platform_device *dev,
 		long unsigned *ids,
@@ -54,6 +54,8 @@ struct mem_handle *nvhost_memmgr_alloc(struct mem_mgr *,
 		int flags);
 struct mem_handle *nvhost_memmgr_get(struct mem_mgr *,
 		u32 id, struct platform_device *dev);
+/* id to refer to an allocated handle with, 0 if there is none */
+u32 nvhost_memmgr_handle_to_id(struct mem_handle *handle);
 static inline int nvhost_memmgr_type(u32 id) { return id & MEMMGR_TYPE_MASK; }
 static inline int nvhost_memmgr_id(u32 id) { return id & MEMMGR_ID_MASK; }
 
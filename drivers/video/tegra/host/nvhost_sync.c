@@ -0,0 +1,341 @@
+/*
+ * drivers/video/tegra/host/nvhost_sync.c
+ *
+ * Tegra Graphics Host Syncpoint Integration to linux/sync Framework
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sync.h>
+#include <linux/nvhost_ioctl.h>
+
+#include "nvhost_sync.h"
+#include "nvhost_syncpt.h"
+#include "nvhost_intr.h"
+#include "chip_support.h"
+#include "dev.h"
+
+/*
+ * One timeline per sync point, created with the sync point and alive as
+ * long as it is.  A sync_pt is a threshold on that timeline.  Each
+ * unexpired sync_pt queues a SIGNAL_SYNC_PT action on the sync point and
+ * keeps a ref to it, dropped when the sync_pt is freed;
+ * nvhost_intr collapses all of them that complete in one pass into a
+ * single sync_timeline_signal() for the timeline.
+ */
+struct nvhost_sync_timeline {
+	struct sync_timeline		obj;
+	struct nvhost_syncpt		*sp;
+	u32				id;
+};
+
+struct nvhost_sync_pt {
+	struct sync_pt			pt;
+	u32				thresh;
+	void				*waiter_ref;
+};
+
+struct nvhost_sync_pt_info {
+	u32				id;
+	u32				thresh;
+};
+
+static struct nvhost_sync_timeline *to_nvhost_sync_timeline(
+		struct sync_timeline *obj)
+{
+	return (struct nvhost_sync_timeline *)obj;
+}
+
+static struct nvhost_sync_pt *to_nvhost_sync_pt(struct sync_pt *pt)
+{
+	return (struct nvhost_sync_pt *)pt;
+}
+
+static struct sync_pt *nvhost_sync_pt_create(
+		struct nvhost_sync_timeline *obj, u32 thresh)
+{
+	struct nvhost_master *host = syncpt_to_dev(obj->sp);
+	struct nvhost_sync_pt *pt;
+	void *waiter;
+
+	pt = (struct nvhost_sync_pt *)
+		sync_pt_create(&obj->obj, sizeof(*pt));
+	if (!pt)
+		return NULL;
+
+	pt->thresh = thresh;
+
+	/* nothing to wait for, sync_pt_activate() sees it as signaled */
+	if (nvhost_syncpt_is_expired(obj->sp, obj->id, thresh))
+		return &pt->pt;
+
+	waiter = nvhost_intr_alloc_waiter();
+	if (!waiter) {
+		sync_pt_free(&pt->pt);
+		return NULL;
+	}
+
+	nvhost_intr_add_action(&host->intr, obj->id, thresh,
+			NVHOST_INTR_ACTION_SIGNAL_SYNC_PT, obj,
+			waiter, &pt->waiter_ref);
+
+	return &pt->pt;
+}
+
+static void nvhost_sync_pt_free(struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_pt *pt = to_nvhost_sync_pt(sync_pt);
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	/* cancels the action if the threshold has not been reached */
+	if (pt->waiter_ref)
+		nvhost_intr_put_ref(&syncpt_to_dev(obj->sp)->intr, obj->id,
+				pt->waiter_ref);
+}
+
+static struct sync_pt *nvhost_sync_pt_dup(struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_pt *pt = to_nvhost_sync_pt(sync_pt);
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	return nvhost_sync_pt_create(obj, pt->thresh);
+}
+
+static int nvhost_sync_pt_has_signaled(struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_pt *pt = to_nvhost_sync_pt(sync_pt);
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	return nvhost_syncpt_is_expired(obj->sp, obj->id, pt->thresh);
+}
+
+static int nvhost_sync_pt_compare(struct sync_pt *a, struct sync_pt *b)
+{
+	u32 ta = to_nvhost_sync_pt(a)->thresh;
+	u32 tb = to_nvhost_sync_pt(b)->thresh;
+
+	if (ta == tb)
+		return 0;
+
+	return (s32)(ta - tb) < 0 ? -1 : 1;
+}
+
+static void nvhost_sync_print_obj(struct seq_file *s,
+		struct sync_timeline *sync_timeline)
+{
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_timeline);
+
+	seq_printf(s, "id %d, min %d, max %d", obj->id,
+		nvhost_syncpt_read_min(obj->sp, obj->id),
+		nvhost_syncpt_read_max(obj->sp, obj->id));
+}
+
+static void nvhost_sync_print_pt(struct seq_file *s, struct sync_pt *sync_pt)
+{
+	struct nvhost_sync_pt *pt = to_nvhost_sync_pt(sync_pt);
+	struct nvhost_sync_timeline *obj =
+		to_nvhost_sync_timeline(sync_pt->parent);
+
+	seq_printf(s, "%d / %d", pt->thresh,
+		nvhost_syncpt_read_min(obj->sp, obj->id));
+}
+
+static int nvhost_sync_fill_driver_data(struct sync_pt *sync_pt,
+		void *data, int size)
+{
+	struct nvhost_sync_pt_info info;
+
+	if (size < sizeof(info))
+		return -ENOMEM;
+
+	info.id = to_nvhost_sync_timeline(sync_pt->parent)->id;
+	info.thresh = to_nvhost_sync_pt(sync_pt)->thresh;
+	memcpy(data, &info, sizeof(info));
+
+	return sizeof(info);
+}
+
+static const struct sync_timeline_ops nvhost_sync_timeline_ops = {
+	.driver_name = "nvhost_sync",
+	.dup = nvhost_sync_pt_dup,
+	.has_signaled = nvhost_sync_pt_has_signaled,
+	.compare = nvhost_sync_pt_compare,
+	.free_pt = nvhost_sync_pt_free,
+	.print_obj = nvhost_sync_print_obj,
+	.print_pt = nvhost_sync_print_pt,
+	.fill_driver_data = nvhost_sync_fill_driver_data,
+};
+
+struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, int id)
+{
+	struct nvhost_sync_timeline *obj;
+	char name[30];
+	const char *syncpt_name = NULL;
+
+	if (syncpt_op().name)
+		syncpt_name = syncpt_op().name(sp, id);
+
+	if (syncpt_name && strlen(syncpt_name))
+		snprintf(name, sizeof(name), "%d_%s", id, syncpt_name);
+	else
+		snprintf(name, sizeof(name), "%d", id);
+
+	obj = (struct nvhost_sync_timeline *)
+		sync_timeline_create(&nvhost_sync_timeline_ops,
+				sizeof(struct nvhost_sync_timeline), name);
+	if (!obj)
+		return NULL;
+
+	obj->sp = sp;
+	obj->id = id;
+
+	return obj;
+}
+
+void nvhost_sync_timeline_destroy(struct nvhost_sync_timeline *obj)
+{
+	sync_timeline_destroy(&obj->obj);
+}
+
+void nvhost_sync_timeline_signal(struct nvhost_sync_timeline *obj)
+{
+	sync_timeline_signal(&obj->obj);
+}
+
+int nvhost_sync_fence_create(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, struct sync_fence **out)
+{
+	struct sync_fence *fence = NULL;
+	int err;
+	u32 i;
+
+	for (i = 0; i < num_pts; i++) {
+		struct nvhost_sync_timeline *obj;
+		struct sync_fence *f, *merged;
+		struct sync_pt *pt;
+
+		if (pts[i].id >= nvhost_syncpt_nb_pts(sp)) {
+			err = -EINVAL;
+			goto err;
+		}
+
+		/* a threshold no submit has reserved would never signal */
+		if (!nvhost_syncpt_check_max(sp, pts[i].id, pts[i].thresh)) {
+			err = -EINVAL;
+			goto err;
+		}
+
+		obj = sp->timeline[pts[i].id];
+		pt = nvhost_sync_pt_create(obj, pts[i].thresh);
+		if (!pt) {
+			err = -ENOMEM;
+			goto err;
+		}
+
+		f = sync_fence_create(name, pt);
+		if (!f) {
+			sync_pt_free(pt);
+			err = -ENOMEM;
+			goto err;
+		}
+
+		if (!fence) {
+			fence = f;
+			continue;
+		}
+
+		merged = sync_fence_merge(name, fence, f);
+		sync_fence_put(fence);
+		sync_fence_put(f);
+		fence = merged;
+		if (!fence) {
+			err = -ENOMEM;
+			goto err;
+		}
+	}
+
+	if (!fence)
+		return -EINVAL;
+
+	*out = fence;
+	return 0;
+
+err:
+	if (fence)
+		sync_fence_put(fence);
+	return err;
+}
+
+int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, int *fence_fd)
+{
+	struct sync_fence *fence;
+	int fd, err;
+
+	fd = get_unused_fd();
+	if (fd < 0)
+		return fd;
+
+	err = nvhost_sync_fence_create(sp, pts, num_pts, name, &fence);
+	if (err) {
+		put_unused_fd(fd);
+		return err;
+	}
+
+	sync_fence_install(fence, fd);
+	*fence_fd = fd;
+	return 0;
+}
+
+void nvhost_sync_fence_install(struct sync_fence *fence, int fd)
+{
+	sync_fence_install(fence, fd);
+}
+
+void nvhost_sync_fence_put(struct sync_fence *fence)
+{
+	sync_fence_put(fence);
+}
+
+/* public sync fence API */
+int nvhost_sync_create_fence_ext(struct platform_device *dev, u32 id,
+		u32 thresh, const char *name, int *fence_fd)
+{
+	struct platform_device *pdev;
+	struct nvhost_syncpt *sp;
+	struct nvhost_ctrl_sync_fence_info pt = {
+		.id = id,
+		.thresh = thresh,
+	};
+
+	BUG_ON(!dev->dev.parent);
+
+	/* get the parent */
+	pdev = to_platform_device(dev->dev.parent);
+	sp = &(nvhost_get_host(pdev)->syncpt);
+
+	return nvhost_sync_create_fence(sp, &pt, 1, name, fence_fd);
+}
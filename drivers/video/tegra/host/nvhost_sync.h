@@ -0,0 +1,96 @@
+/*
+ * drivers/video/tegra/host/nvhost_sync.h
+ *
+ * Tegra Graphics Host Syncpoint Integration to linux/sync Framework
+ *
+ * Copyright (c) 2013, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NVHOST_SYNC_H
+#define __NVHOST_SYNC_H
+
+#include <linux/types.h>
+
+struct nvhost_syncpt;
+struct nvhost_sync_timeline;
+struct nvhost_ctrl_sync_fence_info;
+struct sync_fence;
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, int id);
+void nvhost_sync_timeline_destroy(struct nvhost_sync_timeline *obj);
+void nvhost_sync_timeline_signal(struct nvhost_sync_timeline *obj);
+
+/**
+ * Create a sync fence signalling once every (id, thresh) pair in pts has
+ * been reached, and install it in a new fd.
+ */
+int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, int *fence_fd);
+
+/**
+ * Like nvhost_sync_create_fence(), but hands back the fence without an fd,
+ * so the caller can install it with nvhost_sync_fence_install() once it
+ * can no longer fail, or drop it with nvhost_sync_fence_put().
+ */
+int nvhost_sync_fence_create(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, struct sync_fence **fence);
+void nvhost_sync_fence_install(struct sync_fence *fence, int fd);
+void nvhost_sync_fence_put(struct sync_fence *fence);
+#else
+static inline struct nvhost_sync_timeline *nvhost_sync_timeline_create(
+		struct nvhost_syncpt *sp, int id)
+{
+	return NULL;
+}
+
+static inline void nvhost_sync_timeline_destroy(
+		struct nvhost_sync_timeline *obj)
+{
+}
+
+static inline void nvhost_sync_timeline_signal(
+		struct nvhost_sync_timeline *obj)
+{
+}
+
+static inline int nvhost_sync_create_fence(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, int *fence_fd)
+{
+	return -ENOSYS;
+}
+
+static inline int nvhost_sync_fence_create(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts,
+		u32 num_pts, const char *name, struct sync_fence **fence)
+{
+	return -ENOSYS;
+}
+
+static inline void nvhost_sync_fence_install(struct sync_fence *fence,
+		int fd)
+{
+}
+
+static inline void nvhost_sync_fence_put(struct sync_fence *fence)
+{
+}
+#endif
+
+#endif
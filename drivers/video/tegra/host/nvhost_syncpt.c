@@ -27,6 +27,7 @@
 #include "nvhost_acm.h"
 #include "dev.h"
 #include "chip_support.h"
+#include "nvhost_sync.h"
 
 #define MAX_SYNCPT_LENGTH	5
 
@@ -406,6 +407,15 @@ int nvhost_syncpt_init(struct platform_device *dev,
 		goto fail;
 	}
 
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	sp->timeline = kzalloc(sizeof(*sp->timeline) *
+			nvhost_syncpt_nb_pts(sp), GFP_KERNEL);
+	if (!sp->timeline) {
+		err = -ENOMEM;
+		goto fail;
+	}
+#endif
+
 	sp->kobj = kobject_create_and_add("syncpt", &dev->dev.kobj);
 	if (!sp->kobj) {
 		err = -EIO;
@@ -458,6 +468,14 @@ int nvhost_syncpt_init(struct platform_device *dev,
 			err = -EIO;
 			goto fail;
 		}
+
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+		sp->timeline[i] = nvhost_sync_timeline_create(sp, i);
+		if (!sp->timeline[i]) {
+			err = -ENOMEM;
+			goto fail;
+		}
+#endif
 	}
 
 	return err;
@@ -469,6 +487,16 @@ fail:
 
 void nvhost_syncpt_deinit(struct nvhost_syncpt *sp)
 {
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	int i;
+
+	for (i = 0; sp->timeline && i < nvhost_syncpt_nb_pts(sp); i++)
+		if (sp->timeline[i])
+			nvhost_sync_timeline_destroy(sp->timeline[i]);
+	kfree(sp->timeline);
+	sp->timeline = NULL;
+#endif
+
 	kobject_put(sp->kobj);
 
 	kfree(sp->min_val);
@@ -44,6 +44,9 @@ struct nvhost_syncpt {
 	atomic_t *lock_counts;
 	const char **syncpt_names;
 	struct nvhost_syncpt_attr *syncpt_attrs;
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+	struct nvhost_sync_timeline **timeline;
+#endif
 };
 
 int nvhost_syncpt_init(struct platform_device *, struct nvhost_syncpt *);
@@ -165,6 +165,11 @@ fail:
 	return result;
 }
 
+u32 nvhost_nvmap_handle_to_id(struct mem_handle *handle)
+{
+	return (u32)((struct nvmap_handle_ref *)handle)->handle;
+}
+
 struct mem_handle *nvhost_nvmap_get(struct mem_mgr *mgr,
 		u32 id, struct platform_device *dev)
 {
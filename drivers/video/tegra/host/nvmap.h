@@ -47,6 +47,7 @@ struct mem_handle *nvhost_nvmap_get(struct mem_mgr *mgr,
 		u32 id, struct platform_device *dev);
 
 phys_addr_t nvhost_nvmap_get_addr_from_id(u32 id);
+u32 nvhost_nvmap_handle_to_id(struct mem_handle *handle);
 
 int nvhost_nvmap_pin_array_ids(struct mem_mgr *mgr,
 		long unsigned *ids,
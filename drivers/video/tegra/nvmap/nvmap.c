@@ -42,35 +42,36 @@
 /* private nvmap_handle flag for pinning duplicate detection */
 #define NVMAP_HANDLE_VISITED (0x1ul << 31)
 
-/* map the backing pages for a heap_pgalloc handle into its IOVMM area */
-static void map_iovmm_area(struct nvmap_handle *h)
+/* map the backing pages for a heap_pgalloc handle into its IOVMM area;
+ * on failure nothing is left mapped. called with only h->lock held, on
+ * an area reserved by pin_locked */
+static int map_iovmm_area(struct nvmap_handle *h)
 {
-	tegra_iovmm_addr_t va;
-	unsigned long i;
+	int err;
 
 	BUG_ON(!h->heap_pgalloc || !h->pgalloc.area);
 	BUG_ON(h->size & ~PAGE_MASK);
 	WARN_ON(!h->pgalloc.dirty);
 
-	for (va = h->pgalloc.area->iovm_start, i = 0;
-	     va < (h->pgalloc.area->iovm_start + h->size);
-	     i++, va += PAGE_SIZE) {
-		unsigned long pfn;
-
-		pfn = page_to_pfn(h->pgalloc.pages[i]);
-		BUG_ON(!pfn_valid(pfn));
-		tegra_iovmm_vm_insert_pfn(h->pgalloc.area, va, pfn);
+	err = tegra_iovmm_vm_map_pages(h->pgalloc.area,
+			h->pgalloc.area->iovm_start, h->pgalloc.pages,
+			h->size >> PAGE_SHIFT);
+	if (err) {
+		pr_err("%s: failed to map handle %p (%d)\n", __func__, h, err);
+		return -EIO;
 	}
-	h->pgalloc.dirty = false;
+	return 0;
 }
 
 /* must be called inside nvmap_pin_lock, to ensure that an entire stream
  * of pins will complete without racing with a second stream. handle should
  * have nvmap_handle_get (or nvmap_validate_get) called before calling
- * this function. */
+ * this function. only the IOVMM area is reserved here; a dirty area is
+ * mapped by map_pinned_array once the pin locks are dropped. */
 static int pin_locked(struct nvmap_client *client, struct nvmap_handle *h)
 {
 	struct tegra_iovmm_area *area;
+
 	BUG_ON(!h->alloc);
 	if (atomic_inc_return(&h->pin) == 1) {
 		if (h->heap_pgalloc && !h->pgalloc.contig) {
@@ -138,10 +139,8 @@ static int pin_array_locked(struct nvmap_client *client,
 	int i;
 	int err = 0;
 
-	/* Flush deferred cache maintenance if needed */
-	for (pinned = 0; pinned < count; pinned++)
-		if (nvmap_find_cache_maint_op(client->dev, h[pinned]))
-			nvmap_cache_maint_ops_flush(client->dev, h[pinned]);
+	/* Flush deferred cache maintenance of all handles as one batch */
+	nvmap_cache_maint_ops_flush_array(client->dev, h, count);
 
 	nvmap_mru_lock(client->share);
 	for (pinned = 0; pinned < count; pinned++) {
@@ -162,7 +161,7 @@ static int pin_array_locked(struct nvmap_client *client,
 		}
 	}
 
-	if (err && tegra_iovmm_get_max_free(client->share->iovmm) >=
+	if (err == -ENOMEM && tegra_iovmm_get_max_free(client->share->iovmm) >=
 							client->iovm_limit) {
 		/* First attempt to pin in empty iovmm
 		 * may still fail because of fragmentation caused by
@@ -188,18 +187,60 @@ static int pin_array_locked(struct nvmap_client *client,
 	return err;
 }
 
+/* waits for IOVM space (-ENOMEM from pin_locked) only; a failure to map
+ * the pages is returned right away */
 static int wait_pin_array_locked(struct nvmap_client *client,
 		struct nvmap_handle **h, int count)
 {
 	int ret = 0;
+	int err;
 
-	ret = pin_array_locked(client, h, count);
+	err = pin_array_locked(client, h, count);
 
-	if (ret) {
+	if (err == -ENOMEM) {
 		ret = wait_event_interruptible(client->share->pin_wait,
-				!pin_array_locked(client, h, count));
+				(err = pin_array_locked(client, h, count)) !=
+				-ENOMEM);
 	}
-	return ret ? -EINTR : 0;
+	return ret ? -EINTR : err;
+}
+
+/* maps the dirty IOVMM areas of a freshly pinned array. runs after the
+ * pin and MRU locks are dropped, so large maps no longer serialize every
+ * other pinner; the pin count held on each handle keeps its area from
+ * being reclaimed or zapped meanwhile. h->lock orders pinners of the same
+ * handle, so only the first one maps and the rest see it clean. on failure
+ * the whole array is unpinned, leaving the areas in the MRU for the next
+ * try. */
+static int map_pinned_array(struct nvmap_client *client,
+		struct nvmap_handle **h, int count)
+{
+	int err = 0;
+	int i;
+
+	for (i = 0; i < count && !err; i++) {
+		if (!h[i]->heap_pgalloc || h[i]->pgalloc.contig)
+			continue;
+
+		mutex_lock(&h[i]->lock);
+		if (h[i]->pgalloc.dirty) {
+			err = map_iovmm_area(h[i]);
+			if (!err)
+				h[i]->pgalloc.dirty = false;
+		}
+		mutex_unlock(&h[i]->lock);
+	}
+
+	if (err) {
+		for (i = 0; i < count; i++) {
+			/* inc ref counter, because
+			 * handle_unpin decrements it */
+			nvmap_handle_get(h[i]);
+			handle_unpin(client, h[i], false);
+		}
+		wake_up(&client->share->pin_wait);
+	}
+	return err;
 }
 
 static int handle_unpin_noref(struct nvmap_client *client, unsigned long id)
@@ -324,14 +365,8 @@ int nvmap_pin_ids(struct nvmap_client *client,
 
 	mutex_unlock(&client->share->pin_lock);
 
-	if (ret) {
-		ret = -EINTR;
-	} else {
-		for (i = 0; i < nr; i++) {
-			if (h[i]->heap_pgalloc && h[i]->pgalloc.dirty)
-				map_iovmm_area(h[i]);
-		}
-	}
+	if (!ret)
+		ret = map_pinned_array(client, h, nr);
 
 out:
 	if (ret) {
@@ -488,6 +523,9 @@ int nvmap_pin_array(struct nvmap_client *client,
 
 	mutex_unlock(&client->share->pin_lock);
 
+	if (!ret)
+		ret = map_pinned_array(client, unique_arr, count);
+
 	if (WARN_ON(ret)) {
 		for (i = 0; i < count; i++) {
 			/* pin ref */
@@ -498,13 +536,8 @@ int nvmap_pin_array(struct nvmap_client *client,
 		}
 		return ret;
 	} else {
-		for (i = 0; i < count; i++) {
-			if (unique_arr[i]->heap_pgalloc &&
-			    unique_arr[i]->pgalloc.dirty)
-				map_iovmm_area(unique_arr[i]);
-
+		for (i = 0; i < count; i++)
 			atomic_inc(&unique_arr_refs[i]->pin);
-		}
 	}
 	return count;
 }
@@ -562,14 +595,14 @@ phys_addr_t _nvmap_pin(struct nvmap_client *client,
 	} else {
 		ret = wait_pin_array_locked(client, &h, 1);
 		mutex_unlock(&client->share->pin_lock);
+		if (!ret)
+			ret = map_pinned_array(client, &h, 1);
 	}
 
 	if (ret) {
 		atomic_dec(&ref->pin);
 		nvmap_handle_put(h);
 	} else {
-		if (h->heap_pgalloc && h->pgalloc.dirty)
-			map_iovmm_area(h);
 		phys = handle_phys(h);
 	}
 
@@ -875,6 +908,8 @@ struct nvmap_handle_ref *nvmap_alloc_iovm(struct nvmap_client *client,
 	nvmap_mru_unlock(client->share);
 
 	mutex_unlock(&client->share->pin_lock);
+	if (!err)
+		err = map_pinned_array(client, &h, 1);
 	if (err)
 		goto fail;
 	return r;
@@ -23,6 +23,7 @@
 #ifndef __VIDEO_TEGRA_NVMAP_NVMAP_H
 #define __VIDEO_TEGRA_NVMAP_NVMAP_H
 
+#include <linux/jump_label.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
@@ -67,6 +68,8 @@ struct nvmap_deferred_ops {
 	u64 deferred_maint_inner_flushed;
 	u64 deferred_maint_outer_requested;
 	u64 deferred_maint_outer_flushed;
+	u64 deferred_maint_merged;
+	u64 deferred_maint_batched_by_ways;
 };
 
 /* handles allocated using shared system memory (either IOVMM- or high-order
@@ -74,7 +77,8 @@ struct nvmap_deferred_ops {
 struct nvmap_pgalloc {
 	struct page **pages;
 	struct tegra_iovmm_area *area;
-	struct list_head mru_list;	/* MRU entry for IOVMM reclamation */
+	struct list_head mru_list;	/* LRU entry for IOVMM reclamation */
+	struct rb_node mru_node;	/* reuse cache entry, keyed by size */
 	bool contig;			/* contiguous system memory */
 	bool dirty;			/* area is invalid and needs mapping */
 	u32 iovm_addr;	/* is non-zero, if client need specific iova mapping */
@@ -82,6 +86,8 @@ struct nvmap_pgalloc {
 
 struct nvmap_handle {
 	struct rb_node node;	/* entry on global handle tree */
+	struct hlist_node hash_node;	/* RCU lookup entry on global hash */
+	struct rcu_head rcu;
 	atomic_t ref;		/* reference count (i.e., # of duplications) */
 	atomic_t pin;		/* pin count */
 #ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
@@ -120,6 +126,20 @@ struct nvmap_handle {
 #define NVMAP_WB_POOL NVMAP_HANDLE_CACHEABLE
 #define NVMAP_NUM_POOLS (NVMAP_HANDLE_CACHEABLE + 1)
 
+/* per-CPU front cache ("magazine") of pool pages. magazines are only
+ * touched by their own CPU with local interrupts disabled, and are
+ * refilled from / drained to the shared pool NVMAP_PP_MAG_BATCH pages
+ * at a time so the pool mutex is taken once per batch, not per page. */
+#define NVMAP_PP_MAG_SIZE	64
+#define NVMAP_PP_MAG_BATCH	(NVMAP_PP_MAG_SIZE / 2)
+
+struct nvmap_page_pool_mag {
+	int npages;
+	struct page *pages[NVMAP_PP_MAG_SIZE];
+	u32 hits;		/* allocations served from the magazine */
+	u32 misses;		/* allocations that had to refill */
+};
+
 struct nvmap_page_pool {
 	struct mutex lock;
 	int npages;
@@ -127,11 +147,22 @@ struct nvmap_page_pool {
 	struct page **shrink_array;
 	int max_pages;
 	int flags;
+	struct nvmap_page_pool_mag __percpu *mags;
+	spinlock_t spill_lock;
+	struct list_head spill;		/* magazine pages handed back by IPI */
+	struct list_head zero_list;	/* pre-zeroed pages, kept in pool state */
+	int nzero;
+	u32 zeroed_hits;	/* zeroed-alloc pages served from zero_list */
+	u32 zeroed_misses;	/* zeroed-alloc pages cleared in caller context */
 };
 
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags);
 #endif
 
+/* the MRU reuse cache keeps one length-ordered tree per IOVMM start
+ * alignment, from PAGE_SIZE up; the last bucket takes everything coarser */
+#define NVMAP_MRU_ALIGN_BUCKETS	8
+
 struct nvmap_share {
 	struct tegra_iovmm_client *iovmm;
 	wait_queue_head_t pin_wait;
@@ -149,24 +180,41 @@ struct nvmap_share {
 #endif
 #ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 	struct mutex mru_lock;
-	struct list_head *mru_lists;
-	int nr_mru;
+	/* unpinned areas, bucketed by start alignment, indexed by length */
+	struct rb_root mru_tree[NVMAP_MRU_ALIGN_BUCKETS];
+	struct list_head mru_lru;	/* unpinned areas, LRU last */
+	u32 mru_nr_cached;
+	u32 mru_hits;		/* pin reused the handle's own area */
+	u32 mru_reuses;		/* pin took another handle's cached area */
+	u32 mru_misses;		/* pin needed a new area */
+	u32 mru_evictions;	/* cached areas freed to make room */
 #endif
 };
 
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+void nvmap_page_pool_start_zeroer(struct nvmap_share *share);
+void nvmap_page_pool_stop_zeroer(void);
+#endif
+
 struct nvmap_carveout_commit {
 	size_t commit;
 	struct list_head list;
 };
 
+#define NVMAP_REF_HASH_BITS	6
+
+/* handle_refs is ordered for iteration; ref_hash holds the same refs for
+ * lock-free (RCU) lookup. both are only modified under ref_lock. */
 struct nvmap_client {
 	const char			*name;
 	struct nvmap_device		*dev;
 	struct nvmap_share		*share;
 	struct rb_root			handle_refs;
+	struct hlist_head		ref_hash[1 << NVMAP_REF_HASH_BITS];
 	atomic_t			iovm_commit;
 	size_t				iovm_limit;
 	struct mutex			ref_lock;
+	u64				ref_lock_stamp;
 	bool				super;
 	atomic_t			count;
 	struct task_struct		*task;
@@ -180,14 +228,33 @@ struct nvmap_vma_priv {
 	atomic_t	count;	/* number of processes cloning the VMA */
 };
 
+/* handle lookup and ref_lock hold time statistics are only gathered
+ * while enabled through debugfs (handle_lookup_stats) */
+extern struct static_key nvmap_lookup_stats_key;
+
+void nvmap_stat_ref_lock_held(u64 ns);
+
 static inline void nvmap_ref_lock(struct nvmap_client *priv)
 {
 	mutex_lock(&priv->ref_lock);
+	if (static_key_false(&nvmap_lookup_stats_key))
+		priv->ref_lock_stamp = sched_clock();
 }
 
 static inline void nvmap_ref_unlock(struct nvmap_client *priv)
 {
+	u64 held = 0;
+
+	/* a zero stamp means the stats were enabled while it was held */
+	if (static_key_false(&nvmap_lookup_stats_key) &&
+	    priv->ref_lock_stamp) {
+		held = sched_clock() - priv->ref_lock_stamp;
+		priv->ref_lock_stamp = 0;
+	}
+
 	mutex_unlock(&priv->ref_lock);
+	if (held)
+		nvmap_stat_ref_lock_held(held);
 }
 
 static inline struct nvmap_handle *nvmap_handle_get(struct nvmap_handle *h)
@@ -266,6 +333,9 @@ struct nvmap_share *nvmap_get_share_from_dev(struct nvmap_device *dev);
 void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 		struct nvmap_handle *h);
 
+void nvmap_cache_maint_ops_flush_array(struct nvmap_device *dev,
+		struct nvmap_handle **h, int count);
+
 struct nvmap_deferred_ops *nvmap_get_deferred_ops_from_dev(
 		struct nvmap_device *dev);
 
@@ -24,12 +24,15 @@
 #include <linux/bitmap.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/hash.h>
 #include <linux/kernel.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/oom.h>
+#include <linux/percpu.h>
 #include <linux/platform_device.h>
+#include <linux/rculist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -51,6 +54,7 @@
 #include "nvmap_common.h"
 
 #define NVMAP_NUM_PTES		64
+#define NVMAP_HANDLE_HASH_BITS	8
 #define NVMAP_CARVEOUT_KILLER_RETRY_TIME 100 /* msecs */
 
 #ifdef CONFIG_NVMAP_CARVEOUT_KILLER
@@ -83,6 +87,7 @@ struct nvmap_device {
 	spinlock_t	ptelock;
 
 	struct rb_root	handles;
+	struct hlist_head handle_hash[1 << NVMAP_HANDLE_HASH_BITS];
 	spinlock_t	handle_lock;
 	wait_queue_head_t pte_wait;
 	struct miscdevice dev_super;
@@ -98,6 +103,19 @@ struct nvmap_device {
 struct nvmap_device *nvmap_dev;
 EXPORT_SYMBOL(nvmap_dev);
 
+struct nvmap_lookup_stat {
+	u64 lookups;
+	u64 lookup_ns;
+	u64 lookup_max_ns;
+	u64 lock_holds;
+	u64 lock_hold_ns;
+	u64 lock_hold_max_ns;
+};
+
+static DEFINE_PER_CPU(struct nvmap_lookup_stat, nvmap_lookup_stats);
+struct static_key nvmap_lookup_stats_key = STATIC_KEY_INIT_FALSE;
+static DEFINE_MUTEX(nvmap_lookup_stats_lock);
+
 static struct backing_dev_info nvmap_bdi = {
 	.ra_pages	= 0,
 	.capabilities	= (BDI_CAP_NO_ACCT_AND_WRITEBACK |
@@ -231,40 +249,85 @@ pte_t **nvmap_vaddr_to_pte(struct nvmap_device *dev, unsigned long vaddr)
 	return &(dev->ptes[bit]);
 }
 
-/* verifies that the handle ref value "ref" is a valid handle ref for the
- * file. caller must hold the file's ref_lock prior to calling this function */
-struct nvmap_handle_ref *_nvmap_validate_id_locked(struct nvmap_client *c,
-						   unsigned long id)
+void nvmap_stat_ref_lock_held(u64 ns)
 {
-	struct rb_node *n = c->handle_refs.rb_node;
+	struct nvmap_lookup_stat *stat = &get_cpu_var(nvmap_lookup_stats);
 
-	while (n) {
-		struct nvmap_handle_ref *ref;
-		ref = rb_entry(n, struct nvmap_handle_ref, node);
+	stat->lock_holds++;
+	stat->lock_hold_ns += ns;
+	stat->lock_hold_max_ns = max(stat->lock_hold_max_ns, ns);
+	put_cpu_var(nvmap_lookup_stats);
+}
+
+/* returns the start stamp of a lookup, or 0 if the stats are off */
+static inline u64 nvmap_stat_lookup_start(void)
+{
+	if (static_key_false(&nvmap_lookup_stats_key))
+		return sched_clock();
+	return 0;
+}
+
+static inline void nvmap_stat_lookup(u64 start)
+{
+	struct nvmap_lookup_stat *stat;
+	u64 ns;
+
+	if (!start)
+		return;
+
+	ns = sched_clock() - start;
+	stat = &get_cpu_var(nvmap_lookup_stats);
+	stat->lookups++;
+	stat->lookup_ns += ns;
+	stat->lookup_max_ns = max(stat->lookup_max_ns, ns);
+	put_cpu_var(nvmap_lookup_stats);
+}
+
+/* looks up the handle ref for id in the client's hash; the caller must
+ * either hold the client's ref_lock or be inside an RCU read-side
+ * critical section */
+static struct nvmap_handle_ref *__nvmap_validate_id(struct nvmap_client *c,
+						    unsigned long id)
+{
+	struct nvmap_handle_ref *ref;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(ref, pos,
+			&c->ref_hash[hash_long(id, NVMAP_REF_HASH_BITS)],
+			hash_node) {
 		if ((unsigned long)ref->handle == id)
 			return ref;
-		else if (id > (unsigned long)ref->handle)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
 	}
 
 	return NULL;
 }
 
+/* verifies that the handle ref value "ref" is a valid handle ref for the
+ * file. caller must hold the file's ref_lock prior to calling this function */
+struct nvmap_handle_ref *_nvmap_validate_id_locked(struct nvmap_client *c,
+						   unsigned long id)
+{
+	return __nvmap_validate_id(c, id);
+}
+
+/* returns the client's handle for id with its reference count incremented,
+ * without taking the client's ref_lock. refs and handles are freed after
+ * an RCU grace period, and a handle whose count already dropped to zero
+ * is being destroyed and is treated as not found. */
 struct nvmap_handle *nvmap_get_handle_id(struct nvmap_client *client,
 					 unsigned long id)
 {
 	struct nvmap_handle_ref *ref;
 	struct nvmap_handle *h = NULL;
+	u64 t = nvmap_stat_lookup_start();
 
-	nvmap_ref_lock(client);
-	ref = _nvmap_validate_id_locked(client, id);
-	if (ref)
+	rcu_read_lock();
+	ref = __nvmap_validate_id(client, id);
+	if (ref && atomic_inc_not_zero(&ref->handle->ref))
 		h = ref->handle;
-	if (h)
-		h = nvmap_handle_get(h);
-	nvmap_ref_unlock(client);
+	rcu_read_unlock();
+
+	nvmap_stat_lookup(t);
 	return h;
 }
 
@@ -580,6 +643,7 @@ int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h)
 	BUG_ON(atomic_read(&h->pin) != 0);
 
 	rb_erase(&h->node, &dev->handles);
+	hlist_del_rcu(&h->hash_node);
 
 	spin_unlock(&dev->handle_lock);
 	return 0;
@@ -605,6 +669,8 @@ void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h)
 	}
 	rb_link_node(&h->node, parent, p);
 	rb_insert_color(&h->node, &dev->handles);
+	hlist_add_head_rcu(&h->hash_node, &dev->handle_hash[
+		hash_long((unsigned long)h, NVMAP_HANDLE_HASH_BITS)]);
 	spin_unlock(&dev->handle_lock);
 }
 
@@ -613,30 +679,26 @@ void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h)
 struct nvmap_handle *nvmap_validate_get(struct nvmap_client *client,
 					unsigned long id)
 {
-	struct nvmap_handle *h = NULL;
-	struct rb_node *n;
-
-	spin_lock(&client->dev->handle_lock);
-
-	n = client->dev->handles.rb_node;
-
-	while (n) {
-		h = rb_entry(n, struct nvmap_handle, node);
-		if ((unsigned long)h == id) {
-			if (client->super || h->global || (h->owner == client))
-				h = nvmap_handle_get(h);
-			else
-				h = NULL;
-			spin_unlock(&client->dev->handle_lock);
-			return h;
-		}
-		if (id > (unsigned long)h)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
+	struct nvmap_device *dev = client->dev;
+	struct nvmap_handle *h, *found = NULL;
+	struct hlist_node *pos;
+	u64 t = nvmap_stat_lookup_start();
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(h, pos,
+			&dev->handle_hash[hash_long(id, NVMAP_HANDLE_HASH_BITS)],
+			hash_node) {
+		if ((unsigned long)h != id)
+			continue;
+		if ((client->super || h->global || (h->owner == client)) &&
+		    atomic_inc_not_zero(&h->ref))
+			found = h;
+		break;
 	}
-	spin_unlock(&client->dev->handle_lock);
-	return NULL;
+	rcu_read_unlock();
+
+	nvmap_stat_lookup(t);
+	return found;
 }
 
 struct nvmap_client *nvmap_create_client(struct nvmap_device *dev,
@@ -660,6 +722,8 @@ struct nvmap_client *nvmap_create_client(struct nvmap_device *dev,
 	/* TODO: allocate unique IOVMM client for each nvmap client */
 	client->share = &dev->iovmm_master;
 	client->handle_refs = RB_ROOT;
+	for (i = 0; i < ARRAY_SIZE(client->ref_hash); i++)
+		INIT_HLIST_HEAD(&client->ref_hash[i]);
 
 	atomic_set(&client->iovm_commit, 0);
 
@@ -708,6 +772,7 @@ static void destroy_client(struct nvmap_client *client)
 
 		ref = rb_entry(n, struct nvmap_handle_ref, node);
 		rb_erase(&ref->node, &client->handle_refs);
+		hlist_del_rcu(&ref->hash_node);
 
 		smp_rmb();
 		pins = atomic_read(&ref->pin);
@@ -724,7 +789,8 @@ static void destroy_client(struct nvmap_client *client)
 		while (dupes--)
 			nvmap_handle_put(ref->handle);
 
-		kfree(ref);
+		/* lock-free lookups may still be walking this ref */
+		kfree_rcu(ref, rcu);
 	}
 
 	if (carveout_killer) {
@@ -903,6 +969,10 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		err = nvmap_ioctl_cache_maint(filp, uarg);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST:
+		err = nvmap_ioctl_cache_maint_list(filp, uarg);
+		break;
+
 	case NVMAP_IOC_SHARE:
 		err = nvmap_ioctl_share_dmabuf(filp, uarg);
 		break;
@@ -1145,6 +1215,77 @@ static const struct file_operations debug_iovmm_clients_fops = {
 	.release = single_release,
 };
 
+static int nvmap_debug_lookup_stats_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_lookup_stat sum;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct nvmap_lookup_stat *stat =
+			&per_cpu(nvmap_lookup_stats, cpu);
+
+		sum.lookups += stat->lookups;
+		sum.lookup_ns += stat->lookup_ns;
+		sum.lookup_max_ns = max(sum.lookup_max_ns,
+					stat->lookup_max_ns);
+		sum.lock_holds += stat->lock_holds;
+		sum.lock_hold_ns += stat->lock_hold_ns;
+		sum.lock_hold_max_ns = max(sum.lock_hold_max_ns,
+					   stat->lock_hold_max_ns);
+	}
+
+	seq_printf(s, "enabled: %d\n",
+		   static_key_enabled(&nvmap_lookup_stats_key));
+	seq_printf(s, "%-10s %12s %12s %12s\n", "", "COUNT", "AVG(ns)",
+		   "MAX(ns)");
+	seq_printf(s, "%-10s %12llu %12llu %12llu\n", "lookup",
+		   sum.lookups, sum.lookups ?
+		   div64_u64(sum.lookup_ns, sum.lookups) : 0,
+		   sum.lookup_max_ns);
+	seq_printf(s, "%-10s %12llu %12llu %12llu\n", "ref_lock",
+		   sum.lock_holds, sum.lock_holds ?
+		   div64_u64(sum.lock_hold_ns, sum.lock_holds) : 0,
+		   sum.lock_hold_max_ns);
+	return 0;
+}
+
+static int nvmap_debug_lookup_stats_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, nvmap_debug_lookup_stats_show,
+			    inode->i_private);
+}
+
+/* writing 1 turns the lookup stats on, 0 turns them off */
+static ssize_t nvmap_debug_lookup_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long val;
+	int err;
+
+	err = kstrtoul_from_user(buf, count, 0, &val);
+	if (err)
+		return err;
+
+	mutex_lock(&nvmap_lookup_stats_lock);
+	if (val && !static_key_enabled(&nvmap_lookup_stats_key))
+		static_key_slow_inc(&nvmap_lookup_stats_key);
+	else if (!val && static_key_enabled(&nvmap_lookup_stats_key))
+		static_key_slow_dec(&nvmap_lookup_stats_key);
+	mutex_unlock(&nvmap_lookup_stats_lock);
+
+	return count;
+}
+
+static const struct file_operations debug_lookup_stats_fops = {
+	.open = nvmap_debug_lookup_stats_open,
+	.read = seq_read,
+	.write = nvmap_debug_lookup_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int nvmap_debug_iovmm_allocations_show(struct seq_file *s, void *unused)
 {
 	unsigned long flags;
@@ -1185,6 +1326,53 @@ static const struct file_operations debug_iovmm_allocations_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+static int nvmap_debug_page_pool_mags_show(struct seq_file *s, void *unused)
+{
+	unsigned int i;
+	int cpu;
+	char *memtype_string[] = {"uc", "wc", "iwb", "wb"};
+	struct nvmap_share *share = s->private;
+
+	seq_printf(s, "%-6s %4s %8s %12s %12s\n",
+		"POOL", "CPU", "PAGES", "HITS", "MISSES");
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		u32 hits = 0, misses = 0;
+
+		if (!share->pools[i].mags)
+			continue;
+		for_each_possible_cpu(cpu) {
+			struct nvmap_page_pool_mag *mag =
+				per_cpu_ptr(share->pools[i].mags, cpu);
+
+			seq_printf(s, "%-6s %4d %8d %12u %12u\n",
+				memtype_string[i], cpu, mag->npages,
+				mag->hits, mag->misses);
+			hits += mag->hits;
+			misses += mag->misses;
+		}
+		seq_printf(s, "%-6s %4s %8d %12u %12u\n",
+			memtype_string[i], "pool", share->pools[i].npages,
+			hits, misses);
+	}
+	return 0;
+}
+
+static int nvmap_debug_page_pool_mags_open(struct inode *inode,
+					    struct file *file)
+{
+	return single_open(file, nvmap_debug_page_pool_mags_show,
+			    inode->i_private);
+}
+
+static const struct file_operations debug_page_pool_mags_fops = {
+	.open = nvmap_debug_page_pool_mags_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static void nvmap_deferred_ops_init(struct nvmap_deferred_ops *deferred_ops)
 {
 	INIT_LIST_HEAD(&deferred_ops->ops_list);
@@ -1200,6 +1388,8 @@ static void nvmap_deferred_ops_init(struct nvmap_deferred_ops *deferred_ops)
 	deferred_ops->deferred_maint_inner_flushed = 0;
 	deferred_ops->deferred_maint_outer_requested = 0;
 	deferred_ops->deferred_maint_outer_flushed = 0;
+	deferred_ops->deferred_maint_merged = 0;
+	deferred_ops->deferred_maint_batched_by_ways = 0;
 }
 
 static int nvmap_probe(struct platform_device *pdev)
@@ -1237,6 +1427,8 @@ static int nvmap_probe(struct platform_device *pdev)
 	dev->dev_super.parent = &pdev->dev;
 
 	dev->handles = RB_ROOT;
+	for (i = 0; i < ARRAY_SIZE(dev->handle_hash); i++)
+		INIT_HLIST_HEAD(&dev->handle_hash[i]);
 
 	init_waitqueue_head(&dev->pte_wait);
 
@@ -1332,6 +1524,9 @@ static int nvmap_probe(struct platform_device *pdev)
 	if (IS_ERR_OR_NULL(nvmap_debug_root))
 		dev_err(&pdev->dev, "couldn't create debug files\n");
 
+	debugfs_create_file("handle_lookup_stats", S_IRUGO | S_IWUSR,
+			    nvmap_debug_root, dev, &debug_lookup_stats_fops);
+
 	debugfs_create_bool("enable_deferred_cache_maintenance",
 		S_IRUGO|S_IWUSR, nvmap_debug_root,
 		(u32 *)&dev->deferred_ops.enable_deferred_cache_maintenance);
@@ -1352,6 +1547,14 @@ static int nvmap_probe(struct platform_device *pdev)
 			nvmap_debug_root,
 			&dev->deferred_ops.deferred_maint_outer_flushed);
 #endif /* CONFIG_OUTER_CACHE */
+
+	debugfs_create_u64("deferred_maint_merged", S_IRUGO|S_IWUSR,
+			nvmap_debug_root,
+			&dev->deferred_ops.deferred_maint_merged);
+
+	debugfs_create_u64("deferred_maint_batched_by_ways", S_IRUGO|S_IWUSR,
+			nvmap_debug_root,
+			&dev->deferred_ops.deferred_maint_batched_by_ways);
 	for (i = 0; i < plat->nr_carveouts; i++) {
 		struct nvmap_carveout_node *node = &dev->heaps[dev->nr_carveouts];
 		const struct nvmap_platform_carveout *co = &plat->carveouts[i];
@@ -1406,7 +1609,37 @@ static int nvmap_probe(struct platform_device *pdev)
 				debugfs_create_u32(name, S_IRUGO,
 					iovmm_root,
 					&dev->iovmm_master.pools[i].npages);
+				sprintf(name, "%s_page_pool_zeroed_pages",
+					memtype_string[i]);
+				debugfs_create_u32(name, S_IRUGO,
+					iovmm_root,
+					&dev->iovmm_master.pools[i].nzero);
+				sprintf(name, "%s_page_pool_zeroed_hits",
+					memtype_string[i]);
+				debugfs_create_u32(name, S_IRUGO,
+					iovmm_root,
+					&dev->iovmm_master.pools[i].zeroed_hits);
+				sprintf(name, "%s_page_pool_zeroed_misses",
+					memtype_string[i]);
+				debugfs_create_u32(name, S_IRUGO,
+					iovmm_root,
+					&dev->iovmm_master.pools[i].zeroed_misses);
 			}
+			debugfs_create_file("page_pool_magazines", S_IRUGO,
+				iovmm_root, &dev->iovmm_master,
+				&debug_page_pool_mags_fops);
+#endif
+#ifdef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
+			debugfs_create_u32("reuse_cache_entries", S_IRUGO,
+				iovmm_root, &dev->iovmm_master.mru_nr_cached);
+			debugfs_create_u32("reuse_cache_hits", S_IRUGO,
+				iovmm_root, &dev->iovmm_master.mru_hits);
+			debugfs_create_u32("reuse_cache_reuses", S_IRUGO,
+				iovmm_root, &dev->iovmm_master.mru_reuses);
+			debugfs_create_u32("reuse_cache_misses", S_IRUGO,
+				iovmm_root, &dev->iovmm_master.mru_misses);
+			debugfs_create_u32("reuse_cache_evictions", S_IRUGO,
+				iovmm_root, &dev->iovmm_master.mru_evictions);
 #endif
 		}
 #ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
@@ -1425,6 +1658,9 @@ static int nvmap_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, dev);
 	nvmap_dev = dev;
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+	nvmap_page_pool_start_zeroer(&dev->iovmm_master);
+#endif
 
 	return 0;
 fail_heaps:
@@ -1458,6 +1694,9 @@ static int nvmap_remove(struct platform_device *pdev)
 
 	misc_deregister(&dev->dev_super);
 	misc_deregister(&dev->dev_user);
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+	nvmap_page_pool_stop_zeroer();
+#endif
 
 	while ((n = rb_first(&dev->handles))) {
 		h = rb_entry(n, struct nvmap_handle, node);
@@ -23,16 +23,22 @@
 #define pr_fmt(fmt)	"%s: " fmt, __func__
 
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/rbtree.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/fs.h>
 #include <linux/shrinker.h>
 #include <linux/moduleparam.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <linux/nvmap.h>
 
 #include <asm/cacheflush.h>
@@ -60,11 +66,41 @@
  * the array is allocated using vmalloc. */
 #define PAGELIST_VMALLOC_MIN	(PAGE_SIZE)
 
+/* non-contiguous handles of at least this many pages are first backed by
+ * opportunistic high-order allocations (see nvmap_alloc_pages_highorder) */
+#define NVMAP_HIGHORDER_MIN_PAGES	(1 << 4)
+
+static bool highorder_alloc = 1;
+module_param(highorder_alloc, bool, 0644);
+
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 
+/* Clear @page through its kernel mapping. Low mem pages will for sure have
+ * a virtual address; highmem pages are temporarily mapped at @kaddr using
+ * @pte with the same attributes as the page's other mappings. */
+static void nvmap_zero_page(struct page *page, pgprot_t prot,
+			    unsigned long kaddr, pte_t **pte)
+{
+	phys_addr_t paddr;
+
+	if (!PageHighMem(page)) {
+		memset(page_address(page), 0, PAGE_SIZE);
+	} else {
+		paddr = page_to_phys(page);
+		set_pte_at(&init_mm, kaddr, *pte,
+			   pfn_pte(__phys_to_pfn(paddr), prot));
+		flush_tlb_kernel_page(kaddr);
+		memset((char *)kaddr, 0, PAGE_SIZE);
+	}
+}
+
 #define NVMAP_TEST_PAGE_POOL_SHRINKER 1
+/* part of each pool (1/4th) the background thread keeps pre-zeroed */
+#define NVMAP_PP_ZERO_RESERVE_SHIFT 2
 static bool enable_pp = 1;
 static int pool_size[NVMAP_NUM_POOLS];
+static struct task_struct *nvmap_pp_zero_thread;
+static DEFINE_SPINLOCK(nvmap_pp_zero_lock);
 
 static char *s_memtype_str[] = {
 	"uc",
@@ -96,24 +132,12 @@ static struct page *nvmap_page_pool_alloc_locked(struct nvmap_page_pool *pool)
 	return page;
 }
 
-static struct page *nvmap_page_pool_alloc(struct nvmap_page_pool *pool)
-{
-	struct page *page = NULL;
-
-	if (pool) {
-		nvmap_page_pool_lock(pool);
-		page = nvmap_page_pool_alloc_locked(pool);
-		nvmap_page_pool_unlock(pool);
-	}
-	return page;
-}
-
 static bool nvmap_page_pool_release_locked(struct nvmap_page_pool *pool,
 					    struct page *page)
 {
 	int ret = false;
 
-	if (enable_pp && pool->npages < pool->max_pages) {
+	if (enable_pp && pool->npages + pool->nzero < pool->max_pages) {
 		atomic_inc(&page->_count);
 		BUG_ON(atomic_read(&page->_count) != 2);
 		BUG_ON(pool->page_array[pool->npages] != NULL);
@@ -123,22 +147,333 @@ static bool nvmap_page_pool_release_locked(struct nvmap_page_pool *pool,
 	return ret;
 }
 
+/* Give pages that are still in pool state (extra reference held) back to
+ * the system. */
+static void nvmap_page_pool_free_pages(struct page **pages, int nr)
+{
+	int err;
+	int i;
+
+	if (!nr)
+		return;
+
+	for (i = 0; i < nr; i++) {
+		atomic_dec(&pages[i]->_count);
+		BUG_ON(atomic_read(&pages[i]->_count) != 1);
+	}
+
+	/* This op should never fail. */
+	err = set_pages_array_wb(pages, nr);
+	BUG_ON(err);
+
+	for (i = 0; i < nr; i++)
+		__free_page(pages[i]);
+}
+
+/* Take a pre-zeroed page off the reserve, still in pool state. */
+static struct page *nvmap_page_pool_get_zeroed_locked(
+					struct nvmap_page_pool *pool)
+{
+	struct page *page;
+
+	if (list_empty(&pool->zero_list))
+		return NULL;
+
+	page = list_first_entry(&pool->zero_list, struct page, lru);
+	list_del(&page->lru);
+	pool->nzero--;
+	return page;
+}
+
+/* Move up to @nr pool-state pages from the shared pool into @pages. */
+static int nvmap_page_pool_get_batch(struct nvmap_page_pool *pool,
+				     struct page **pages, int nr)
+{
+	int n = 0;
+
+	nvmap_page_pool_lock(pool);
+	while (n < nr && pool->npages > 0) {
+		pages[n++] = pool->page_array[--pool->npages];
+		pool->page_array[pool->npages] = NULL;
+	}
+	/* out of plain pages: a pre-zeroed one still beats alloc_page()
+	 * and the CPA that comes with it */
+	if (!n) {
+		pages[0] = nvmap_page_pool_get_zeroed_locked(pool);
+		if (pages[0])
+			n = 1;
+	}
+	nvmap_page_pool_unlock(pool);
+	return n;
+}
+
+static int nvmap_page_pool_zero_reserve(struct nvmap_page_pool *pool)
+{
+	return pool->max_pages >> NVMAP_PP_ZERO_RESERVE_SHIFT;
+}
+
+static bool nvmap_page_pool_zero_needed(struct nvmap_page_pool *pool)
+{
+	return enable_pp && pool->npages &&
+		pool->nzero < nvmap_page_pool_zero_reserve(pool);
+}
+
+/* Unlocked peek; a stale answer only delays or repeats a wakeup. */
+static void nvmap_page_pool_wake_zeroer(struct nvmap_page_pool *pool)
+{
+	unsigned long flags;
+
+	if (!nvmap_page_pool_zero_needed(pool))
+		return;
+
+	spin_lock_irqsave(&nvmap_pp_zero_lock, flags);
+	if (nvmap_pp_zero_thread)
+		wake_up_process(nvmap_pp_zero_thread);
+	spin_unlock_irqrestore(&nvmap_pp_zero_lock, flags);
+}
+
+/* Return @nr pool-state pages to the shared pool; whatever no longer fits
+ * (the pool was shrunk or disabled meanwhile) is freed. */
+static void nvmap_page_pool_put_batch(struct nvmap_page_pool *pool,
+				      struct page **pages, int nr)
+{
+	if (!nr)
+		return;
+
+	nvmap_page_pool_lock(pool);
+	while (nr && enable_pp &&
+	       pool->npages + pool->nzero < pool->max_pages) {
+		BUG_ON(pool->page_array[pool->npages] != NULL);
+		pool->page_array[pool->npages++] = pages[--nr];
+	}
+	nvmap_page_pool_unlock(pool);
+
+	nvmap_page_pool_free_pages(pages, nr);
+	nvmap_page_pool_wake_zeroer(pool);
+}
+
+/* Take up to @nr already zeroed pages from the pool's reserve. Returns the
+ * number of pages stored in @pages. */
+static int nvmap_page_pool_alloc_zeroed(struct nvmap_page_pool *pool,
+					struct page **pages, int nr)
+{
+	struct page *page;
+	int n = 0;
+
+	if (!pool)
+		return 0;
+
+	nvmap_page_pool_lock(pool);
+	while (n < nr) {
+		page = nvmap_page_pool_get_zeroed_locked(pool);
+		if (!page)
+			break;
+		atomic_dec(&page->_count);
+		BUG_ON(atomic_read(&page->_count) != 1);
+		pages[n++] = page;
+	}
+	pool->zeroed_hits += n;
+	pool->zeroed_misses += nr - n;
+	nvmap_page_pool_unlock(pool);
+
+	nvmap_page_pool_wake_zeroer(pool);
+	return n;
+}
+
+static struct page *nvmap_page_pool_alloc(struct nvmap_page_pool *pool)
+{
+	struct nvmap_page_pool_mag *mag;
+	struct page *batch[NVMAP_PP_MAG_BATCH];
+	struct page *page = NULL;
+	unsigned long flags;
+	int n;
+
+	if (!pool || !pool->mags)
+		return NULL;
+
+	local_irq_save(flags);
+	mag = this_cpu_ptr(pool->mags);
+	if (mag->npages) {
+		page = mag->pages[--mag->npages];
+		mag->hits++;
+	} else {
+		mag->misses++;
+	}
+	local_irq_restore(flags);
+
+	if (!page) {
+		n = nvmap_page_pool_get_batch(pool, batch, NVMAP_PP_MAG_BATCH);
+		if (!n)
+			return NULL;
+		page = batch[--n];
+
+		/* we may have migrated while the pool lock was held, so
+		 * stash the rest of the batch in whichever magazine we are
+		 * on now. */
+		local_irq_save(flags);
+		mag = this_cpu_ptr(pool->mags);
+		while (n && mag->npages < NVMAP_PP_MAG_SIZE)
+			mag->pages[mag->npages++] = batch[--n];
+		local_irq_restore(flags);
+
+		nvmap_page_pool_put_batch(pool, batch, n);
+	}
+
+	atomic_dec(&page->_count);
+	BUG_ON(atomic_read(&page->_count) != 1);
+	return page;
+}
+
 static bool nvmap_page_pool_release(struct nvmap_page_pool *pool,
 					  struct page *page)
 {
-	int ret = false;
+	struct nvmap_page_pool_mag *mag;
+	struct page *batch[NVMAP_PP_MAG_BATCH];
+	unsigned long flags;
+	int n = 0;
+
+	if (!pool || !pool->mags || !enable_pp || !pool->max_pages)
+		return false;
+
+	atomic_inc(&page->_count);
+	BUG_ON(atomic_read(&page->_count) != 2);
+
+	local_irq_save(flags);
+	mag = this_cpu_ptr(pool->mags);
+	if (mag->npages == NVMAP_PP_MAG_SIZE) {
+		while (n < NVMAP_PP_MAG_BATCH)
+			batch[n++] = mag->pages[--mag->npages];
+	}
+	mag->pages[mag->npages++] = page;
+	local_irq_restore(flags);
 
-	if (pool) {
-		nvmap_page_pool_lock(pool);
-		ret = nvmap_page_pool_release_locked(pool, page);
-		nvmap_page_pool_unlock(pool);
+	nvmap_page_pool_put_batch(pool, batch, n);
+	return true;
+}
+
+/* Flush @cpu's magazine back to the shared pool. Must run either on @cpu
+ * or after @cpu has gone offline. */
+static void nvmap_page_pool_mag_drain(struct nvmap_page_pool *pool, int cpu)
+{
+	struct nvmap_page_pool_mag *mag;
+	struct page *batch[NVMAP_PP_MAG_SIZE];
+	unsigned long flags;
+	int n;
+
+	if (!pool->mags)
+		return;
+
+	local_irq_save(flags);
+	mag = per_cpu_ptr(pool->mags, cpu);
+	n = mag->npages;
+	memcpy(batch, mag->pages, n * sizeof(*batch));
+	mag->npages = 0;
+	local_irq_restore(flags);
+
+	nvmap_page_pool_put_batch(pool, batch, n);
+}
+
+/* Runs on each CPU with interrupts off: parks the pages of the local
+ * magazines on the pools' spill lists, as the pool mutex can't be taken
+ * here. */
+static void nvmap_page_pool_mag_spill_local(void *info)
+{
+	struct nvmap_share *share = info;
+	struct nvmap_page_pool_mag *mag;
+	struct nvmap_page_pool *pool;
+	unsigned int i;
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		pool = &share->pools[i];
+		if (!pool->mags)
+			continue;
+
+		mag = this_cpu_ptr(pool->mags);
+		spin_lock(&pool->spill_lock);
+		while (mag->npages)
+			list_add(&mag->pages[--mag->npages]->lru, &pool->spill);
+		spin_unlock(&pool->spill_lock);
+	}
+}
+
+/* Empty the magazines of all online CPUs back into the pools, for when
+ * pool pages must really be released (shrinker, resize, disable). */
+static void nvmap_page_pool_mag_drain_all(void)
+{
+	struct nvmap_share *share;
+	struct page *batch[NVMAP_PP_MAG_BATCH];
+	unsigned long flags;
+	unsigned int i;
+	LIST_HEAD(pages);
+	int n;
+
+	if (!nvmap_dev)
+		return;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	on_each_cpu(nvmap_page_pool_mag_spill_local, share, 1);
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+		struct nvmap_page_pool *pool = &share->pools[i];
+
+		spin_lock_irqsave(&pool->spill_lock, flags);
+		list_splice_init(&pool->spill, &pages);
+		spin_unlock_irqrestore(&pool->spill_lock, flags);
+
+		while (!list_empty(&pages)) {
+			for (n = 0; n < NVMAP_PP_MAG_BATCH &&
+				    !list_empty(&pages); n++) {
+				batch[n] = list_first_entry(&pages,
+						struct page, lru);
+				list_del(&batch[n]->lru);
+			}
+			nvmap_page_pool_put_batch(pool, batch, n);
+		}
 	}
-	return ret;
 }
 
+/* Pages held in the magazines of online CPUs; a racy estimate. */
+static int nvmap_page_pool_get_mag_count(struct nvmap_page_pool *pool)
+{
+	int cpu, total = 0;
+
+	if (!pool->mags)
+		return 0;
+
+	for_each_online_cpu(cpu)
+		total += ACCESS_ONCE(per_cpu_ptr(pool->mags, cpu)->npages);
+
+	return total;
+}
+
+static int nvmap_page_pool_cpu_notify(struct notifier_block *nb,
+				      unsigned long action, void *hcpu)
+{
+	unsigned int i;
+	int cpu = (long)hcpu;
+	struct nvmap_share *share;
+
+	if (!nvmap_dev)
+		return NOTIFY_OK;
+
+	share = nvmap_get_share_from_dev(nvmap_dev);
+	switch (action) {
+	case CPU_DEAD:
+	case CPU_DEAD_FROZEN:
+		for (i = 0; i < NVMAP_NUM_POOLS; i++)
+			nvmap_page_pool_mag_drain(&share->pools[i], cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block nvmap_page_pool_cpu_nb = {
+	.notifier_call = nvmap_page_pool_cpu_notify,
+};
+
 static int nvmap_page_pool_get_available_count(struct nvmap_page_pool *pool)
 {
-	return pool->npages;
+	return pool->npages + pool->nzero;
 }
 
 static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
@@ -158,6 +493,16 @@ static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
 		pool->shrink_array[idx++] = page;
 		i--;
 	}
+	/* pre-zeroed pages go last, they are the most valuable ones */
+	while (i) {
+		page = nvmap_page_pool_get_zeroed_locked(pool);
+		if (!page)
+			break;
+		atomic_dec(&page->_count);
+		BUG_ON(atomic_read(&page->_count) != 1);
+		pool->shrink_array[idx++] = page;
+		i--;
+	}
 
 	if (idx) {
 		/* This op should never fail. */
@@ -178,7 +523,8 @@ static int nvmap_page_pool_get_unused_pages(void)
 	struct nvmap_share *share = nvmap_get_share_from_dev(nvmap_dev);
 
 	for (i = 0; i < NVMAP_NUM_POOLS; i++)
-		total += nvmap_page_pool_get_available_count(&share->pools[i]);
+		total += nvmap_page_pool_get_available_count(&share->pools[i]) +
+			nvmap_page_pool_get_mag_count(&share->pools[i]);
 
 	return total;
 }
@@ -192,6 +538,8 @@ static void nvmap_page_pool_resize(struct nvmap_page_pool *pool, int size)
 
 	if (size == pool->max_pages)
 		return;
+	if (size < pool->max_pages)
+		nvmap_page_pool_mag_drain_all();
 repeat:
 	nvmap_page_pool_free(pool, pages_to_release);
 	nvmap_page_pool_lock(pool);
@@ -254,6 +602,17 @@ static int nvmap_page_pool_shrink(struct shrinker *shrinker,
 		pool = &share->pools[pool_offset];
 		shrink_pages = nvmap_page_pool_free(pool, shrink_pages);
 	}
+
+	/* the pools ran dry, take back what the magazines hold too */
+	for (i = 0; i < NVMAP_NUM_POOLS && shrink_pages; i++)
+		if (nvmap_page_pool_get_mag_count(&share->pools[i]))
+			break;
+	if (shrink_pages && i < NVMAP_NUM_POOLS) {
+		nvmap_page_pool_mag_drain_all();
+		for (i = 0; i < NVMAP_NUM_POOLS && shrink_pages; i++)
+			shrink_pages = nvmap_page_pool_free(&share->pools[i],
+							    shrink_pages);
+	}
 out:
 	return nvmap_page_pool_get_unused_pages();
 }
@@ -314,7 +673,13 @@ static int enable_pp_set(const char *arg, const struct kernel_param *kp)
 
 	param_set_bool(arg, kp);
 
+	if (enable_pp && nvmap_dev)
+		nvmap_page_pool_start_zeroer(
+			nvmap_get_share_from_dev(nvmap_dev));
+
 	if (!enable_pp) {
+		nvmap_page_pool_stop_zeroer();
+		nvmap_page_pool_mag_drain_all();
 		shrink_page_pools(&total_pages, &available_pages);
 		pr_info("disabled page pools and released pages, "
 			"total_pages_released=%d, free_pages_available=%d",
@@ -379,6 +744,153 @@ POOL_SIZE_GET(wb);
 POOL_SIZE_OPS(wb);
 POOL_SIZE_MOUDLE_PARAM_CB(wb, NVMAP_HANDLE_CACHEABLE);
 
+static pgprot_t nvmap_page_pool_pgprot(struct nvmap_page_pool *pool)
+{
+	if (pool->flags == NVMAP_HANDLE_UNCACHEABLE)
+		return pgprot_noncached(pgprot_kernel);
+	else if (pool->flags == NVMAP_HANDLE_WRITE_COMBINE)
+		return pgprot_writecombine(pgprot_kernel);
+#ifndef CONFIG_ARM_LPAE /* !!!FIXME!!! BUG 892578 */
+	else if (pool->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+		return pgprot_inner_writeback(pgprot_kernel);
+#endif
+	return pgprot_kernel;
+}
+
+/* Pages zeroed per nvmap pte, so other nvmap_alloc_pte() users only
+ * ever wait for one batch. */
+#define NVMAP_PP_ZERO_BATCH	16
+
+/* Zero up to NVMAP_PP_ZERO_BATCH pages into the pool's reserve. Returns
+ * false if no pte could be had. */
+static bool nvmap_page_pool_fill_zeroed(struct nvmap_page_pool *pool)
+{
+	struct page *page;
+	pgprot_t prot = nvmap_page_pool_pgprot(pool);
+	unsigned long kaddr;
+	pte_t **pte;
+	int n;
+
+	pte = nvmap_alloc_pte(nvmap_dev, (void **)&kaddr);
+	if (IS_ERR(pte))
+		return false;
+
+	for (n = 0; n < NVMAP_PP_ZERO_BATCH && !kthread_should_stop(); n++) {
+		nvmap_page_pool_lock(pool);
+		if (!nvmap_page_pool_zero_needed(pool)) {
+			nvmap_page_pool_unlock(pool);
+			break;
+		}
+		page = pool->page_array[--pool->npages];
+		pool->page_array[pool->npages] = NULL;
+		nvmap_page_pool_unlock(pool);
+
+		nvmap_zero_page(page, prot, kaddr, pte);
+
+		nvmap_page_pool_lock(pool);
+		if (enable_pp && pool->npages + pool->nzero < pool->max_pages) {
+			list_add_tail(&page->lru, &pool->zero_list);
+			pool->nzero++;
+			page = NULL;
+		}
+		nvmap_page_pool_unlock(pool);
+
+		if (page)
+			nvmap_page_pool_free_pages(&page, 1);
+	}
+
+	nvmap_free_pte(nvmap_dev, pte);
+	return true;
+}
+
+static bool nvmap_page_pool_zero_pending(struct nvmap_share *share)
+{
+	unsigned int i;
+
+	for (i = 0; i < NVMAP_NUM_POOLS; i++)
+		if (nvmap_page_pool_zero_needed(&share->pools[i]))
+			return true;
+	return false;
+}
+
+/* Low priority thread that keeps a reserve of pre-zeroed pages in every
+ * pool so NVMAP_HANDLE_ZEROED_PAGES allocations don't pay for the memset
+ * (and the temporary highmem mapping) in the caller's context. */
+static int nvmap_page_pool_zero_thread(void *data)
+{
+	struct nvmap_share *share = data;
+	struct nvmap_page_pool *pool;
+	unsigned int i;
+
+	set_freezable();
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!nvmap_page_pool_zero_pending(share)) {
+			schedule();
+			try_to_freeze();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		for (i = 0; i < NVMAP_NUM_POOLS; i++) {
+			pool = &share->pools[i];
+			while (nvmap_page_pool_zero_needed(pool) &&
+			       !kthread_should_stop()) {
+				if (!nvmap_page_pool_fill_zeroed(pool)) {
+					schedule_timeout_interruptible(HZ);
+					break;
+				}
+				cond_resched();
+			}
+		}
+		try_to_freeze();
+	}
+	return 0;
+}
+
+static DEFINE_MUTEX(nvmap_pp_zero_thread_lock);
+
+/* needs nvmap_dev, so it is started once the device is fully probed */
+void nvmap_page_pool_start_zeroer(struct nvmap_share *share)
+{
+	struct task_struct *task;
+
+	mutex_lock(&nvmap_pp_zero_thread_lock);
+	if (nvmap_pp_zero_thread)
+		goto out;
+
+	task = kthread_run(nvmap_page_pool_zero_thread, share,
+			   "nvmap_pp_zero");
+	if (IS_ERR(task)) {
+		pr_err("failed to start page pool zeroing thread\n");
+		goto out;
+	}
+	spin_lock_irq(&nvmap_pp_zero_lock);
+	nvmap_pp_zero_thread = task;
+	spin_unlock_irq(&nvmap_pp_zero_lock);
+out:
+	mutex_unlock(&nvmap_pp_zero_thread_lock);
+}
+
+/* Pool teardown and disabling the pools; the thread would only refill
+ * zero_list behind the shrinker's back. */
+void nvmap_page_pool_stop_zeroer(void)
+{
+	struct task_struct *task;
+
+	mutex_lock(&nvmap_pp_zero_thread_lock);
+	spin_lock_irq(&nvmap_pp_zero_lock);
+	task = nvmap_pp_zero_thread;
+	nvmap_pp_zero_thread = NULL;
+	spin_unlock_irq(&nvmap_pp_zero_lock);
+
+	if (task)
+		kthread_stop(task);
+	mutex_unlock(&nvmap_pp_zero_thread_lock);
+}
+
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 {
 	static int reg = 1;
@@ -400,7 +912,13 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	BUG_ON(flags >= NVMAP_NUM_POOLS);
 	memset(pool, 0x0, sizeof(*pool));
 	mutex_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->zero_list);
+	spin_lock_init(&pool->spill_lock);
+	INIT_LIST_HEAD(&pool->spill);
 	pool->flags = flags;
+	pool->mags = alloc_percpu(struct nvmap_page_pool_mag);
+	if (!pool->mags)
+		return -ENOMEM;
 
 	/* No default pool for cached memory. */
 	if (flags == NVMAP_HANDLE_CACHEABLE)
@@ -428,6 +946,7 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	if (reg) {
 		reg = 0;
 		register_shrinker(&nvmap_page_pool_shrinker);
+		register_hotcpu_notifier(&nvmap_page_pool_cpu_nb);
 	}
 
 #ifdef CONFIG_NVMAP_PAGE_POOLS_INIT_FILLUP
@@ -458,6 +977,8 @@ fail:
 	pool->max_pages = 0;
 	vfree(pool->shrink_array);
 	vfree(pool->page_array);
+	free_percpu(pool->mags);
+	pool->mags = NULL;
 	return -ENOMEM;
 }
 #endif
@@ -544,7 +1065,8 @@ skip_attr_restore:
 	altfree(h->pgalloc.pages, nr_page * sizeof(struct page *));
 
 out:
-	kfree(h);
+	/* lock-free lookups may still be walking this handle */
+	kfree_rcu(h, rcu);
 }
 
 static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
@@ -567,6 +1089,66 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+/*
+ * Fills pages with up to nr pages taken from naturally aligned high-order
+ * chunks, each split into single pages. Orders are tried largest first:
+ * the IOVMM large page order (so the chunk can be mapped with one PDE),
+ * then 1MB and 64KB chunks. The attempts never retry or wake kswapd; an
+ * order that fails once is not tried again for this handle. Returns the
+ * number of pages allocated, a multiple of the smallest order tried.
+ */
+static unsigned int nvmap_alloc_pages_highorder(gfp_t gfp,
+		struct page **pages, unsigned int nr, size_t large_size,
+		bool *got_large)
+{
+	unsigned int orders[] = { 0, 8, 4 };
+	unsigned int n = 0, o = 0, j;
+	struct page *page;
+
+	gfp |= __GFP_NORETRY | __GFP_NO_KSWAPD | __GFP_NOWARN;
+	orders[0] = large_size ? get_order(large_size) : 0;
+	if (orders[0] <= orders[1])
+		o = 1;
+	*got_large = false;
+
+	while (o < ARRAY_SIZE(orders)) {
+		unsigned int order = orders[o];
+
+		if (nr - n < (1 << order) || order >= MAX_ORDER) {
+			o++;
+			continue;
+		}
+
+		page = alloc_pages(gfp, order);
+		if (!page) {
+			o++;
+			continue;
+		}
+
+		split_page(page, order);
+		for (j = 0; j < (1 << order); j++)
+			pages[n++] = nth_page(page, j);
+		if (o == 0)
+			*got_large = true;
+	}
+	return n;
+}
+
+static int nvmap_set_pages_array_attr(struct nvmap_handle *h,
+				      struct page **pages, unsigned int nr)
+{
+	if (!nr)
+		return 0;
+
+	if (h->flags == NVMAP_HANDLE_WRITE_COMBINE)
+		return set_pages_array_wc(pages, nr);
+	else if (h->flags == NVMAP_HANDLE_UNCACHEABLE)
+		return set_pages_array_uc(pages, nr);
+	else if (h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
+		return set_pages_array_iwb(pages, nr);
+	return 0;
+}
+
 static int handle_page_alloc(struct nvmap_client *client,
 			     struct nvmap_handle *h, bool contiguous)
 {
@@ -574,15 +1156,15 @@ static int handle_page_alloc(struct nvmap_client *client,
 	size_t size = PAGE_ALIGN(h->size);
 	unsigned int nr_page = size >> PAGE_SHIFT;
 	pgprot_t prot;
-	unsigned int i = 0, page_index = 0;
+	unsigned int i = 0, nr_pool = 0;
 	struct page **pages;
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 	struct nvmap_page_pool *pool = NULL;
 	struct nvmap_share *share = nvmap_get_share_from_dev(h->dev);
+	unsigned int n;
 #endif
 	gfp_t gfp = GFP_NVMAP;
 	unsigned long kaddr;
-	phys_addr_t paddr;
 	pte_t **pte = NULL;
 
 	if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
@@ -610,37 +1192,47 @@ static int handle_page_alloc(struct nvmap_client *client,
 			pages[i] = nth_page(page, i);
 
 	} else {
+		/* Pool pages already have the right attributes, so they are
+		 * used first. They fill pages[] from the end, which keeps
+		 * the start of the handle, where the IOVM area is large page
+		 * aligned, for the high-order chunks below. */
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 		if (h->flags < NVMAP_NUM_POOLS)
 			pool = &share->pools[h->flags];
 
-		for (i = 0; i < nr_page; i++) {
+		/* Pre-zeroed pages from the pool reserve first. */
+		if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
+			n = nvmap_page_pool_alloc_zeroed(pool, pages, nr_page);
+			while (n--)
+				pages[nr_page - ++nr_pool] = pages[n];
+		}
+
+		while (nr_pool < nr_page) {
 			/* Get pages from pool, if available. */
-			pages[i] = nvmap_page_pool_alloc(pool);
-			if (!pages[i])
+			struct page *page = nvmap_page_pool_alloc(pool);
+
+			if (!page)
 				break;
-			if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES) {
-				/*
-				 * Just memset low mem pages; they will for
-				 * sure have a virtual address. Otherwise, build
-				 * a mapping for the page in the kernel.
-				 */
-				if (!PageHighMem(pages[i])) {
-					memset(page_address(pages[i]), 0,
-					       PAGE_SIZE);
-				} else {
-					paddr = page_to_phys(pages[i]);
-					set_pte_at(&init_mm, kaddr, *pte,
-						   pfn_pte(__phys_to_pfn(paddr),
-							   prot));
-					flush_tlb_kernel_page(kaddr);
-					memset((char *)kaddr, 0, PAGE_SIZE);
-				}
-			}
-			page_index++;
+			if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES)
+				nvmap_zero_page(page, prot, kaddr, pte);
+			pages[nr_page - ++nr_pool] = page;
 		}
 #endif
-		for (; i < nr_page; i++) {
+		/* The rest: physically contiguous runs first. */
+		if (highorder_alloc &&
+		    nr_page - nr_pool >= NVMAP_HIGHORDER_MIN_PAGES) {
+			size_t large = tegra_iovmm_get_large_page_size(
+						client->share->iovmm);
+			bool got_large;
+
+			i = nvmap_alloc_pages_highorder(gfp, pages,
+					nr_page - nr_pool, large, &got_large);
+			/* let the IOVM area line up with the large pages */
+			if (got_large && !h->pgalloc.iovm_addr)
+				h->align = max_t(size_t, h->align, large);
+		}
+
+		for (; i < nr_page - nr_pool; i++) {
 			pages[i] = nvmap_alloc_pages_exact(gfp,	PAGE_SIZE);
 			if (!pages[i])
 				goto fail;
@@ -657,24 +1249,12 @@ static int handle_page_alloc(struct nvmap_client *client,
 #endif
 	}
 
-	if (nr_page == page_index)
-		goto skip_attr_change;
-
-	/* Update the pages mapping in kernel page table. */
-	if (h->flags == NVMAP_HANDLE_WRITE_COMBINE)
-		err = set_pages_array_wc(&pages[page_index],
-					nr_page - page_index);
-	else if (h->flags == NVMAP_HANDLE_UNCACHEABLE)
-		err = set_pages_array_uc(&pages[page_index],
-					nr_page - page_index);
-	else if (h->flags == NVMAP_HANDLE_INNER_CACHEABLE)
-		err = set_pages_array_iwb(&pages[page_index],
-					nr_page - page_index);
-
+	/* Update the pages mapping in kernel page table; the pool pages at
+	 * the end already have it. */
+	err = nvmap_set_pages_array_attr(h, pages, nr_page - nr_pool);
 	if (err)
 		goto fail;
 
-skip_attr_change:
 	if (h->userflags & NVMAP_HANDLE_ZEROED_PAGES)
 		nvmap_free_pte(client->dev, pte);
 	h->size = size;
@@ -690,6 +1270,10 @@ fail:
 	BUG_ON(err);
 	while (i--)
 		__free_page(pages[i]);
+	err = set_pages_array_wb(&pages[nr_page - nr_pool], nr_pool);
+	BUG_ON(err);
+	while (nr_pool)
+		__free_page(pages[nr_page - nr_pool--]);
 	altfree(pages, nr_page * sizeof(*pages));
 	wmb();
 	return -ENOMEM;
@@ -921,6 +1505,7 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 	smp_rmb();
 	pins = atomic_read(&ref->pin);
 	rb_erase(&ref->node, &client->handle_refs);
+	hlist_del_rcu(&ref->hash_node);
 
 	if (h->alloc && h->heap_pgalloc && !h->pgalloc.contig)
 		atomic_sub(h->size, &client->iovm_commit);
@@ -947,7 +1532,8 @@ void nvmap_free_handle_id(struct nvmap_client *client, unsigned long id)
 		h->owner_ref = NULL;
 	}
 
-	kfree(ref);
+	/* lock-free lookups may still be walking this ref */
+	kfree_rcu(ref, rcu);
 
 out:
 	BUG_ON(!atomic_read(&h->ref));
@@ -976,6 +1562,8 @@ static void add_handle_ref(struct nvmap_client *client,
 	}
 	rb_link_node(&ref->node, parent, p);
 	rb_insert_color(&ref->node, &client->handle_refs);
+	hlist_add_head_rcu(&ref->hash_node, &client->ref_hash[
+		hash_long((unsigned long)ref->handle, NVMAP_REF_HASH_BITS)]);
 	nvmap_ref_unlock(client);
 }
 
@@ -20,14 +20,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/bitops.h>
 #include <linux/device.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
 
 #include <linux/nvmap.h>
 #include "nvmap.h"
@@ -69,10 +72,36 @@
  * and to ensure that the minimum free block size in the carveout (i.e., the
  * "small" threshold) is still a meaningful size.
  *
+ * free blocks are kept on an address-ordered free list (used for merging
+ * and compaction) and are also indexed by size class: class n holds the
+ * free blocks of [2^n, 2^(n+1)) bytes, in address order, and a bitmap
+ * tracks which classes are non-empty. a fitting block is found by scanning
+ * the non-empty classes upwards from the request's own class; once the
+ * class is above the request's size plus alignment slack, the first (or,
+ * for TOP_DOWN, the last) block of the class always fits.
+ *
+ * if the compactor is enabled, fragmented heaps are also compacted in the
+ * background: once a heap has been idle for compact_idle_ms, a few unpinned,
+ * unmapped blocks per pass are relocated towards the bottom of the heap.
  */
 
 #define MAX_BUDDY_NR	128	/* maximum buddies in a buddy allocator */
 
+#define NR_FREE_CLASSES	BITS_PER_LONG
+
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+/* bytes relocated by one background compaction pass */
+#define COMPACT_PASS_BYTES	SZ_1M
+
+static unsigned int compact_idle_ms = 200;
+module_param(compact_idle_ms, uint, 0644);
+
+/* fragmentation (percentage of free space not in the largest free block)
+ * above which idle heaps are compacted; values above 100 disable it */
+static unsigned int compact_frag_threshold = 25;
+module_param(compact_frag_threshold, uint, 0644);
+#endif
+
 enum direction {
 	TOP_DOWN,
 	BOTTOM_UP
@@ -95,6 +124,8 @@ struct heap_stat {
 	unsigned int compaction_count_fast;
 	/* full compaction attempt counter */
 	unsigned int compaction_count_full;
+	/* percentage of free space outside the largest free block */
+	unsigned int fragmentation;
 };
 
 struct buddy_heap;
@@ -113,6 +144,7 @@ struct list_block {
 	size_t align;
 	struct nvmap_heap *heap;
 	struct list_head free_list;
+	struct list_head class_list;	/* entry in the size class index */
 };
 
 struct combo_block {
@@ -137,6 +169,8 @@ struct buddy_heap {
 struct nvmap_heap {
 	struct list_head all_list;
 	struct list_head free_list;
+	struct list_head free_class[NR_FREE_CLASSES];
+	DECLARE_BITMAP(free_class_map, NR_FREE_CLASSES);
 	struct mutex lock;
 	struct list_head buddy_list;
 	unsigned int min_buddy_shift;
@@ -145,6 +179,15 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+	size_t free_size;		/* bytes in the free size classes */
+	size_t free_count;		/* blocks in the free size classes */
+	unsigned int fragmentation_peak;
+	unsigned int compact_relocations;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+	unsigned long last_activity;
+	unsigned int activity;		/* bumped by every alloc and free */
+#endif
 };
 
 static struct kmem_cache *buddy_heap_cache;
@@ -161,6 +204,57 @@ static inline unsigned int order_of(size_t len, size_t min_shift)
 	return fls(len)-1;
 }
 
+static inline unsigned int free_class_of(size_t len)
+{
+	return len ? fls(len) - 1 : 0;
+}
+
+/* adds a free block to the size class index, keeping the class in
+ * address order; must be called while holding the heap's lock. */
+static void free_index_add(struct nvmap_heap *heap, struct list_block *b)
+{
+	unsigned int class = free_class_of(b->size);
+	struct list_block *i;
+
+	list_for_each_entry(i, &heap->free_class[class], class_list) {
+		if (i->block.base > b->block.base)
+			break;
+	}
+	list_add_tail(&b->class_list, &i->class_list);
+	__set_bit(class, heap->free_class_map);
+	heap->free_size += b->size;
+	heap->free_count++;
+}
+
+static void free_index_del(struct nvmap_heap *heap, struct list_block *b)
+{
+	unsigned int class = free_class_of(b->size);
+
+	list_del(&b->class_list);
+	if (list_empty(&heap->free_class[class]))
+		__clear_bit(class, heap->free_class_map);
+	heap->free_size -= b->size;
+	heap->free_count--;
+}
+
+/* returns the size of the largest free list block; only the highest
+ * populated size class has to be looked at. must be called while holding
+ * the heap's lock. */
+static size_t free_index_largest(struct nvmap_heap *heap)
+{
+	unsigned int class;
+	struct list_block *l;
+	size_t largest = 0;
+
+	class = find_last_bit(heap->free_class_map, NR_FREE_CLASSES);
+	if (class >= NR_FREE_CLASSES)
+		return 0;
+
+	list_for_each_entry(l, &heap->free_class[class], class_list)
+		largest = max(largest, l->size);
+	return largest;
+}
+
 /* returns the free size in bytes of the buddy heap; must be called while
  * holding the parent heap's lock. */
 static void buddy_stat(struct buddy_heap *heap, struct heap_stat *stat)
@@ -184,17 +278,32 @@ static void buddy_stat(struct buddy_heap *heap, struct heap_stat *stat)
 	}
 }
 
+/* adds the free list blocks to stat and updates the fragmentation and
+ * its peak; must be called while holding the heap's lock. */
+static void __heap_free_stat(struct nvmap_heap *heap, struct heap_stat *stat)
+{
+	stat->free += heap->free_size;
+	stat->free_count += heap->free_count;
+	stat->free_largest = max(free_index_largest(heap), stat->free_largest);
+
+	if (stat->free)
+		stat->fragmentation = div64_u64(
+			(u64)(stat->free - stat->free_largest) * 100,
+			stat->free);
+	heap->fragmentation_peak = max(heap->fragmentation_peak,
+				       stat->fragmentation);
+}
+
 /* returns the free size of the heap (including any free blocks in any
  * buddy-heap suballocators; must be called while holding the parent
  * heap's lock. */
-static phys_addr_t heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
+static phys_addr_t __heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 {
 	struct buddy_heap *bh;
 	struct list_block *l = NULL;
 	phys_addr_t base = -1ul;
 
 	memset(stat, 0, sizeof(*stat));
-	mutex_lock(&heap->lock);
 	list_for_each_entry(l, &heap->all_list, all_list) {
 		stat->total += l->size;
 		stat->largest = max(l->size, stat->largest);
@@ -211,11 +320,31 @@ static phys_addr_t heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 		stat->count--;
 	}
 
-	list_for_each_entry(l, &heap->free_list, free_list) {
-		stat->free += l->size;
-		stat->free_count++;
-		stat->free_largest = max(l->size, stat->free_largest);
-	}
+	__heap_free_stat(heap, stat);
+
+	return base;
+}
+
+/* called wherever the free space changes, so that fragmentation_peak
+ * also catches peaks between two reads of the stats. works from the
+ * running free totals kept by free_index_add/del, so it does not walk the
+ * block lists; free space inside buddy sub-heaps only shows up in the
+ * peak when the stats are read. must be called while holding the heap's
+ * lock. */
+static void heap_frag_update(struct nvmap_heap *heap)
+{
+	struct heap_stat stat;
+
+	memset(&stat, 0, sizeof(stat));
+	__heap_free_stat(heap, &stat);
+}
+
+static phys_addr_t heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
+{
+	phys_addr_t base;
+
+	mutex_lock(&heap->lock);
+	base = __heap_stat(heap, stat);
 	mutex_unlock(&heap->lock);
 
 	return base;
@@ -248,6 +377,15 @@ static struct device_attribute heap_stat_free_size =
 static struct device_attribute heap_stat_base =
 	__ATTR(base, S_IRUGO, heap_stat_show, NULL);
 
+static struct device_attribute heap_stat_fragmentation =
+	__ATTR(fragmentation, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_fragmentation_peak =
+	__ATTR(fragmentation_peak, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_relocations =
+	__ATTR(compact_relocations, S_IRUGO, heap_stat_show, NULL);
+
 static struct device_attribute heap_attr_name =
 	__ATTR(name, S_IRUGO, heap_name_show, NULL);
 
@@ -259,6 +397,9 @@ static struct attribute *heap_stat_attrs[] = {
 	&heap_stat_free_count.attr,
 	&heap_stat_free_size.attr,
 	&heap_stat_base.attr,
+	&heap_stat_fragmentation.attr,
+	&heap_stat_fragmentation_peak.attr,
+	&heap_stat_compact_relocations.attr,
 	&heap_attr_name.attr,
 	NULL,
 };
@@ -298,6 +439,12 @@ static ssize_t heap_stat_show(struct device *dev,
 		return sprintf(buf, "%u\n", stat.free);
 	else if (attr == &heap_stat_base)
 		return sprintf(buf, "%08llx\n", (unsigned long long)base);
+	else if (attr == &heap_stat_fragmentation)
+		return sprintf(buf, "%u\n", stat.fragmentation);
+	else if (attr == &heap_stat_fragmentation_peak)
+		return sprintf(buf, "%u\n", heap->fragmentation_peak);
+	else if (attr == &heap_stat_compact_relocations)
+		return sprintf(buf, "%u\n", heap->compact_relocations);
 	else
 		return -EINVAL;
 }
@@ -417,7 +564,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 	dir = (len <= heap->small_alloc) ? BOTTOM_UP : TOP_DOWN;
 #endif
 
-	if (dir == BOTTOM_UP) {
+	if (dir == BOTTOM_UP && base_max) {
 		list_for_each_entry(i, &heap->free_list, free_list) {
 			size_t fix_size;
 			fix_base = ALIGN(i->block.base, align);
@@ -428,7 +575,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 
 			/* needed for compaction. relocated chunk
 			 * should never go up */
-			if (base_max && fix_base > base_max)
+			if (fix_base > base_max)
 				break;
 
 			if (fix_size >= len) {
@@ -436,9 +583,34 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 				break;
 			}
 		}
+	} else if (dir == BOTTOM_UP) {
+		unsigned int class = free_class_of(len);
+
+		for_each_set_bit_from(class, heap->free_class_map,
+				      NR_FREE_CLASSES) {
+			list_for_each_entry(i, &heap->free_class[class],
+					    class_list) {
+				fix_base = ALIGN(i->block.base, align);
+				if (!fix_base ||
+				    fix_base >= i->block.base + i->size)
+					continue;
+				if (i->size - (fix_base - i->block.base) >= len) {
+					b = i;
+					break;
+				}
+			}
+			if (b)
+				break;
+		}
 	} else {
-		list_for_each_entry_reverse(i, &heap->free_list, free_list) {
-			if (i->size >= len) {
+		unsigned int class = free_class_of(len);
+
+		for_each_set_bit_from(class, heap->free_class_map,
+				      NR_FREE_CLASSES) {
+			list_for_each_entry_reverse(i, &heap->free_class[class],
+						    class_list) {
+				if (i->size < len)
+					continue;
 				fix_base = i->block.base + i->size - len;
 				fix_base &= ~(align-1);
 				if (fix_base >= i->block.base) {
@@ -446,12 +618,16 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 					break;
 				}
 			}
+			if (b)
+				break;
 		}
 	}
 
 	if (!b)
 		return NULL;
 
+	free_index_del(heap, b);
+
 	if (dir == BOTTOM_UP)
 		b->block.type = BLOCK_FIRST_FIT;
 
@@ -475,6 +651,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		b->size -= rem->size;
 		list_add_tail(&rem->all_list,  &b->all_list);
 		list_add_tail(&rem->free_list, &b->free_list);
+		free_index_add(heap, rem);
 	}
 
 	b->orig_addr = b->block.base;
@@ -493,6 +670,7 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		b->size = len;
 		list_add(&rem->all_list,  &b->all_list);
 		list_add(&rem->free_list, &b->free_list);
+		free_index_add(heap, rem);
 	}
 
 out:
@@ -554,6 +732,7 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 		if (n->block.base == b->block.base + b->size) {
 			list_del(&n->all_list);
 			list_del(&n->free_list);
+			free_index_del(heap, n);
 			BUG_ON(b->orig_addr >= n->orig_addr);
 			b->size += n->size;
 			kmem_cache_free(block_cache, n);
@@ -565,6 +744,7 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 	if (b->free_list.prev != &heap->free_list) {
 		n = list_entry(b->free_list.prev, struct list_block, free_list);
 		if (n->block.base + n->size == b->block.base) {
+			free_index_del(heap, n);
 			list_del(&b->all_list);
 			list_del(&b->free_list);
 			BUG_ON(n->orig_addr >= b->orig_addr);
@@ -575,6 +755,7 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 	}
 
 	freelist_debug(heap, "free list after", b);
+	free_index_add(heap, b);
 	b->block.type = BLOCK_EMPTY;
 	return b;
 }
@@ -836,8 +1017,108 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 		}
 		ptr = ptr_next;
 	}
+	heap->compact_relocations += relocation_count;
 	pr_err("Relocated %d chunks\n", relocation_count);
 }
+
+/* relocates blocks which directly follow a free block, lowest address
+ * first, until budget bytes have been moved or no block can be moved.
+ * must be called while holding the heap's lock, which is dropped between
+ * two relocations; the step ends early if the heap was allocated from or
+ * freed to meanwhile. */
+static size_t nvmap_heap_compact_step(struct nvmap_heap *heap, size_t budget)
+{
+	struct list_head *pos = heap->all_list.next;
+	size_t moved = 0;
+
+	while (pos != &heap->all_list) {
+		struct list_block *b = list_entry(pos, struct list_block,
+						  all_list);
+		struct list_block *next;
+		struct list_head *resume;
+		struct nvmap_heap_block *block_new;
+		phys_addr_t old_base;
+		unsigned int activity;
+		size_t size;
+
+		pos = pos->next;
+		if (b->block.type != BLOCK_EMPTY || pos == &heap->all_list)
+			continue;
+
+		next = list_entry(pos, struct list_block, all_list);
+		if (next->block.type != BLOCK_FIRST_FIT)
+			continue;
+
+		/* a free block after next gets merged into the space next
+		 * leaves behind, so resume from the allocated block after
+		 * it; allocated blocks above next are never touched */
+		resume = next->all_list.next;
+		if (resume != &heap->all_list &&
+		    list_entry(resume, struct list_block,
+			       all_list)->block.type == BLOCK_EMPTY)
+			resume = resume->next;
+
+		old_base = next->block.base;
+		size = next->size;
+		block_new = do_heap_relocate_listblock(next, true);
+		if (!block_new || block_new->base == old_base)
+			continue;
+
+		heap->compact_relocations++;
+		moved += size;
+		if (moved >= budget)
+			break;
+
+		/* resume->prev is the free block at next's old place */
+		pos = resume->prev;
+
+		activity = heap->activity;
+		mutex_unlock(&heap->lock);
+		cond_resched();
+		mutex_lock(&heap->lock);
+		if (heap->activity != activity)
+			break;
+	}
+	return moved;
+}
+
+static void nvmap_heap_compact_work(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					       struct nvmap_heap, compact_work);
+	unsigned long idle = msecs_to_jiffies(compact_idle_ms);
+	struct heap_stat stat;
+	size_t moved = 0;
+
+	mutex_lock(&heap->lock);
+	/* only compact once the heap has been idle for a while */
+	if (time_before(jiffies, heap->last_activity + idle)) {
+		unsigned long delay = heap->last_activity + idle - jiffies;
+
+		mutex_unlock(&heap->lock);
+		schedule_delayed_work(&heap->compact_work, delay);
+		return;
+	}
+
+	__heap_stat(heap, &stat);
+	if (stat.fragmentation >= compact_frag_threshold)
+		moved = nvmap_heap_compact_step(heap, COMPACT_PASS_BYTES);
+	mutex_unlock(&heap->lock);
+
+	if (moved)
+		schedule_delayed_work(&heap->compact_work, idle);
+}
+
+/* must be called while holding the heap's lock */
+static void nvmap_heap_compact_schedule(struct nvmap_heap *heap)
+{
+	heap->last_activity = jiffies;
+	heap->activity++;
+	if (compact_frag_threshold <= 100 &&
+	    !delayed_work_pending(&heap->compact_work))
+		schedule_delayed_work(&heap->compact_work,
+				      msecs_to_jiffies(compact_idle_ms));
+}
 #endif
 
 void nvmap_usecount_inc(struct nvmap_handle *h)
@@ -889,6 +1170,8 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 			b = do_heap_alloc(h, len, align, prot, 0);
 		}
 	}
+	h->last_activity = jiffies;
+	h->activity++;
 #else
 	if (len <= h->buddy_heap_size / 2) {
 		b = do_buddy_alloc(h, len, align, prot);
@@ -903,6 +1186,7 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	if (b) {
 		b->handle = handle;
 		handle->carveout = b;
+		heap_frag_update(h);
 	}
 	mutex_unlock(&h->lock);
 	return b;
@@ -935,6 +1219,9 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		lb = container_of(b, struct list_block, block);
 		nvmap_flush_heap_block(NULL, b, lb->size, lb->mem_prot);
 		do_heap_free(b);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+		nvmap_heap_compact_schedule(h);
+#endif
 	}
 
 	if (bh) {
@@ -942,8 +1229,10 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		mutex_unlock(&h->lock);
 		nvmap_heap_free(&bh->heap_base->block);
 		kmem_cache_free(buddy_heap_cache, bh);
-	} else
+	} else {
+		heap_frag_update(h);
 		mutex_unlock(&h->lock);
+	}
 }
 
 
@@ -965,6 +1254,7 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 {
 	struct nvmap_heap *h = NULL;
 	struct list_block *l = NULL;
+	int i;
 
 	if (WARN_ON(buddy_size && buddy_size < NVMAP_HEAP_MIN_BUDDY_SIZE)) {
 		dev_warn(parent, "%s: buddy_size %u too small\n", __func__,
@@ -1028,13 +1318,19 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	INIT_LIST_HEAD(&h->free_list);
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
+	for (i = 0; i < NR_FREE_CLASSES; i++)
+		INIT_LIST_HEAD(&h->free_class[i]);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK(&h->compact_work, nvmap_heap_compact_work);
+#endif
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
 	l->orig_addr = base;
 	list_add_tail(&l->free_list, &h->free_list);
 	list_add_tail(&l->all_list, &h->all_list);
+	free_index_add(h, l);
 
 	inner_flush_cache_all();
 	outer_flush_range(base, base + len);
@@ -1066,6 +1362,10 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 {
 	WARN_ON(!list_empty(&heap->buddy_list));
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
+
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
@@ -23,7 +23,9 @@
 #include <linux/dma-mapping.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
+#include <linux/list_sort.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/uaccess.h>
 #include <linux/nvmap.h>
 
@@ -586,6 +588,20 @@ static inline bool fast_cache_maint_outer(unsigned long start,
 #endif
 
 #if defined(CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS)
+static void outer_range_cache_maint(struct nvmap_handle *h,
+	unsigned long start, unsigned long end, unsigned int op)
+{
+	if (h->heap_pgalloc) {
+		heap_page_cache_maint(h, start,
+			end, op, false, true, NULL, 0, 0);
+	} else  {
+		phys_addr_t pstart;
+
+		pstart = start + h->carveout->base;
+		outer_cache_maint(op, pstart, end - start);
+	}
+}
+
 static bool fast_cache_maint(struct nvmap_handle *h,
 	unsigned long start,
 	unsigned long end, unsigned int op)
@@ -601,18 +617,8 @@ static bool fast_cache_maint(struct nvmap_handle *h,
 
 	/* outer maintenance */
 	if (h->flags != NVMAP_HANDLE_INNER_CACHEABLE) {
-		if(!fast_cache_maint_outer(start, end, op))
-		{
-			if (h->heap_pgalloc) {
-				heap_page_cache_maint(h, start,
-					end, op, false, true, NULL, 0, 0);
-			} else  {
-				phys_addr_t pstart;
-
-				pstart = start + h->carveout->base;
-				outer_cache_maint(op, pstart, end - start);
-			}
-		}
+		if (!fast_cache_maint_outer(start, end, op))
+			outer_range_cache_maint(h, start, end, op);
 	}
 	return true;
 }
@@ -805,9 +811,137 @@ int nvmap_find_cache_maint_op(struct nvmap_device *dev,
 	return false;
 }
 
-void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
-		struct nvmap_handle *h) {
+static bool cache_op_selected(struct cache_maint_op *cache_op,
+		struct nvmap_handle **handles, int count)
+{
+	int i;
+
+	if (!handles)
+		return true;
+	for (i = 0; i < count; i++)
+		if (cache_op->h == handles[i])
+			return true;
+	return false;
+}
+
+static int cache_op_cmp(void *priv, struct list_head *a, struct list_head *b)
+{
+	struct cache_maint_op *x = list_entry(a, struct cache_maint_op,
+					      list_data);
+	struct cache_maint_op *y = list_entry(b, struct cache_maint_op,
+					      list_data);
+
+	if (x->h != y->h)
+		return x->h < y->h ? -1 : 1;
+	if (x->op != y->op)
+		return x->op < y->op ? -1 : 1;
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return 0;
+}
+
+/* merge overlapping and adjacent ranges queued for the same handle, so
+ * that every byte is maintained at most once per flush */
+static void cache_ops_merge(struct nvmap_deferred_ops *deferred_ops,
+		struct list_head *ops)
+{
+	struct cache_maint_op *cache_op, *temp, *prev = NULL;
+	unsigned int merged = 0;
+
+	list_sort(NULL, ops, cache_op_cmp);
+
+	list_for_each_entry_safe(cache_op, temp, ops, list_data) {
+		if (prev && prev->h == cache_op->h &&
+		    prev->op == cache_op->op &&
+		    cache_op->start <= prev->end) {
+			prev->end = max(prev->end, cache_op->end);
+			list_del(&cache_op->list_data);
+			nvmap_handle_put(cache_op->h);
+			kfree(cache_op);
+			merged++;
+			continue;
+		}
+		prev = cache_op;
+	}
+
+	if (merged) {
+		spin_lock(&deferred_ops->deferred_ops_lock);
+		deferred_ops->deferred_maint_merged += merged;
+		spin_unlock(&deferred_ops->deferred_ops_lock);
+	}
+}
+
+#ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
+/* if the merged ranges of a batch add up to more than the inner threshold,
+ * a single set/way flush is cheaper than walking every range; the outer
+ * cache is then flushed by ways or by range depending on its own threshold.
+ * returns true if the batch was completed */
+static bool cache_ops_flush_by_ways(struct nvmap_deferred_ops *deferred_ops,
+		struct list_head *ops)
+{
+	struct cache_maint_op *cache_op, *temp;
+	size_t inner_size = 0;
+	size_t outer_size = 0;
+	bool outer_all = false;
+
+	list_for_each_entry(cache_op, ops, list_data) {
+		if (cache_op->op != NVMAP_CACHE_OP_WB_INV)
+			return false;
+		if (cache_op->inner)
+			inner_size += cache_op->end - cache_op->start;
+		if (cache_op->outer)
+			outer_size += cache_op->end - cache_op->start;
+	}
 
+	if (inner_size < cache_maint_inner_threshold)
+		return false;
+
+	inner_flush_cache_all();
+#ifdef CONFIG_NVMAP_OUTER_CACHE_MAINT_BY_SET_WAYS
+	if (cache_maint_outer_threshold > cache_maint_inner_threshold &&
+	    outer_size >= cache_maint_outer_threshold) {
+		outer_flush_all();
+		outer_all = true;
+	}
+#endif
+
+	list_for_each_entry_safe(cache_op, temp, ops, list_data) {
+		struct nvmap_handle *h = cache_op->h;
+
+		if (cache_op->outer && !outer_all && h->alloc) {
+			/* lock carveout from relocation by mapcount */
+			if (!h->heap_pgalloc)
+				nvmap_usecount_inc(h);
+			outer_range_cache_maint(h, cache_op->start,
+					cache_op->end, cache_op->op);
+			if (!h->heap_pgalloc)
+				nvmap_usecount_dec(h);
+		}
+
+		spin_lock(&deferred_ops->deferred_ops_lock);
+		debug_count_flushed_op(deferred_ops,
+			cache_op->end - cache_op->start, h->flags);
+		spin_unlock(&deferred_ops->deferred_ops_lock);
+
+		list_del(&cache_op->list_data);
+		nvmap_handle_put(h);
+		kfree(cache_op);
+	}
+
+	spin_lock(&deferred_ops->deferred_ops_lock);
+	deferred_ops->deferred_maint_batched_by_ways++;
+	spin_unlock(&deferred_ops->deferred_ops_lock);
+	return true;
+}
+#endif
+
+/* flushes the deferred operations queued for the handles in the handles
+ * array (or every queued operation, if handles is NULL). all selected
+ * operations are flushed as one batch: their ranges are merged and the
+ * batch is completed by set/way operations if that is cheaper. */
+static void cache_maint_ops_flush(struct nvmap_device *dev,
+		struct nvmap_handle **handles, int count)
+{
 	struct nvmap_deferred_ops *deferred_ops =
 		nvmap_get_deferred_ops_from_dev(dev);
 
@@ -910,11 +1044,21 @@ void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 	spin_lock(&deferred_ops->deferred_ops_lock);
 	list_for_each_entry_safe(cache_op, temp,
 			&deferred_ops->ops_list, list_data) {
-		if (!h || cache_op->h == h)
+		if (cache_op_selected(cache_op, handles, count))
 			list_move(&cache_op->list_data, &flushed_ops);
 	}
 	spin_unlock(&deferred_ops->deferred_ops_lock);
 
+	if (list_empty(&flushed_ops))
+		return;
+
+	cache_ops_merge(deferred_ops, &flushed_ops);
+
+#ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
+	if (cache_ops_flush_by_ways(deferred_ops, &flushed_ops))
+		return;
+#endif
+
 	list_for_each_entry_safe(cache_op, temp,
 			&flushed_ops, list_data) {
 
@@ -931,6 +1075,23 @@ void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
 	}
 }
 
+void nvmap_cache_maint_ops_flush(struct nvmap_device *dev,
+		struct nvmap_handle *h)
+{
+	if (h)
+		cache_maint_ops_flush(dev, &h, 1);
+	else
+		cache_maint_ops_flush(dev, NULL, 0);
+}
+
+/* flushes the deferred operations of all handles referenced by one pin
+ * (e.g., submit) request as a single batch */
+void nvmap_cache_maint_ops_flush_array(struct nvmap_device *dev,
+		struct nvmap_handle **h, int count)
+{
+	cache_maint_ops_flush(dev, h, count);
+}
+
 static int cache_maint(struct nvmap_client *client,
 			struct nvmap_handle *h,
 			unsigned long start, unsigned long end,
@@ -939,6 +1100,7 @@ static int cache_maint(struct nvmap_client *client,
 	int err = 0;
 	struct nvmap_deferred_ops *deferred_ops =
 		nvmap_get_deferred_ops_from_dev(client->dev);
+	struct cache_maint_op *deferred = NULL;
 	bool inner_maint = false;
 	bool outer_maint = false;
 
@@ -974,24 +1136,46 @@ static int cache_maint(struct nvmap_client *client,
 			(inner_maint || outer_maint) &&
 			allow_deferred == CACHE_MAINT_ALLOW_DEFERRED &&
 			atomic_read(&h->pin) == 0 &&
-			deferred_ops->enable_deferred_cache_maintenance) {
+			deferred_ops->enable_deferred_cache_maintenance)
+		deferred = kmalloc(sizeof(struct cache_maint_op), GFP_KERNEL);
 
+	if (deferred) {
 		struct cache_maint_op *cache_op;
-
-		cache_op = (struct cache_maint_op *)
-				kmalloc(sizeof(struct cache_maint_op),
-					GFP_KERNEL);
-		cache_op->h = h;
-		cache_op->start = start;
-		cache_op->end = end;
-		cache_op->op = op;
-		cache_op->inner = inner_maint;
-		cache_op->outer = outer_maint;
-
+		bool merged = false;
+
+		deferred->h = h;
+		deferred->start = start;
+		deferred->end = end;
+		deferred->op = op;
+		deferred->inner = inner_maint;
+		deferred->outer = outer_maint;
+
+		/* extend an operation already queued for an overlapping or
+		 * adjacent range of the same handle instead of queueing
+		 * another one */
 		spin_lock(&deferred_ops->deferred_ops_lock);
-			list_add_tail(&cache_op->list_data,
+		list_for_each_entry(cache_op, &deferred_ops->ops_list,
+				    list_data) {
+			if (cache_op->h == h && cache_op->op == op &&
+			    start <= cache_op->end && end >= cache_op->start) {
+				cache_op->start = min_t(phys_addr_t,
+						cache_op->start, start);
+				cache_op->end = max_t(phys_addr_t,
+						cache_op->end, end);
+				deferred_ops->deferred_maint_merged++;
+				merged = true;
+				break;
+			}
+		}
+		if (!merged)
+			list_add_tail(&deferred->list_data,
 				&deferred_ops->ops_list);
 		spin_unlock(&deferred_ops->deferred_ops_lock);
+
+		if (merged) {
+			kfree(deferred);
+			nvmap_handle_put(h);
+		}
 	} else {
 		struct cache_maint_op cache_op;
 
@@ -1017,6 +1201,183 @@ static int cache_maint(struct nvmap_client *client,
 	return 0;
 }
 
+#define NVMAP_CACHE_LIST_MAX_OPS	512
+
+struct cache_list_op {
+	struct nvmap_handle *h;
+	phys_addr_t paddr;	/* sort key */
+	unsigned long start;
+	unsigned long end;
+	unsigned int op;
+	bool done;
+};
+
+static int cache_list_op_cmp(const void *a, const void *b)
+{
+	const struct cache_list_op *x = a;
+	const struct cache_list_op *y = b;
+
+	if (x->paddr != y->paddr)
+		return x->paddr < y->paddr ? -1 : 1;
+	return 0;
+}
+
+#ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
+/* if the write-back ranges of the list add up to more than the inner
+ * threshold, complete all of them with one set/way operation on the inner
+ * cache and a single pass over the outer cache */
+static void cache_list_maint_by_ways(struct nvmap_client *client,
+		struct cache_list_op *ops, int count)
+{
+	struct nvmap_deferred_ops *deferred_ops =
+		nvmap_get_deferred_ops_from_dev(client->dev);
+	size_t inner_size = 0;
+	size_t outer_size = 0;
+	unsigned int op = NVMAP_CACHE_OP_WB;
+	bool outer_all;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct nvmap_handle *h = ops[i].h;
+
+		if (ops[i].op == NVMAP_CACHE_OP_INV ||
+		    (h->flags != NVMAP_HANDLE_CACHEABLE &&
+		     h->flags != NVMAP_HANDLE_INNER_CACHEABLE))
+			continue;
+		inner_size += ops[i].end - ops[i].start;
+		if (h->flags == NVMAP_HANDLE_CACHEABLE)
+			outer_size += ops[i].end - ops[i].start;
+		if (ops[i].op == NVMAP_CACHE_OP_WB_INV)
+			op = NVMAP_CACHE_OP_WB_INV;
+	}
+
+	if (inner_size < cache_maint_inner_threshold)
+		return;
+
+	if (op == NVMAP_CACHE_OP_WB_INV)
+		inner_flush_cache_all();
+	else
+		inner_clean_cache_all();
+
+	outer_all = fast_cache_maint_outer(0, outer_size, op);
+
+	for (i = 0; i < count; i++) {
+		struct nvmap_handle *h = ops[i].h;
+
+		if (ops[i].op == NVMAP_CACHE_OP_INV ||
+		    (h->flags != NVMAP_HANDLE_CACHEABLE &&
+		     h->flags != NVMAP_HANDLE_INNER_CACHEABLE))
+			continue;
+
+		trace_cache_maint(client, h, ops[i].start, ops[i].end,
+				  ops[i].op);
+		if (h->flags == NVMAP_HANDLE_CACHEABLE && !outer_all) {
+			/* lock carveout from relocation by mapcount */
+			if (!h->heap_pgalloc)
+				nvmap_usecount_inc(h);
+			outer_range_cache_maint(h, ops[i].start, ops[i].end,
+						ops[i].op);
+			if (!h->heap_pgalloc)
+				nvmap_usecount_dec(h);
+		}
+
+		if (ops[i].op == NVMAP_CACHE_OP_WB_INV) {
+			spin_lock(&deferred_ops->deferred_ops_lock);
+			debug_count_requested_op(deferred_ops,
+				ops[i].end - ops[i].start, h->flags);
+			debug_count_flushed_op(deferred_ops,
+				ops[i].end - ops[i].start, h->flags);
+			spin_unlock(&deferred_ops->deferred_ops_lock);
+		}
+		ops[i].done = true;
+	}
+}
+#endif
+
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_cache_op_list op;
+	struct nvmap_cache_op_entry *entries;
+	struct cache_list_op *ops;
+	int i, count = 0;
+	int err = 0;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.count || op.count > NVMAP_CACHE_LIST_MAX_OPS)
+		return -EINVAL;
+
+	entries = kcalloc(op.count, sizeof(*entries), GFP_KERNEL);
+	ops = kcalloc(op.count, sizeof(*ops), GFP_KERNEL);
+	if (!entries || !ops) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(entries, (void __user *)op.ops,
+			   op.count * sizeof(*entries))) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	/* validate the whole list before doing any maintenance */
+	for (count = 0; count < op.count; count++) {
+		struct nvmap_cache_op_entry *e = &entries[count];
+		struct nvmap_handle *h;
+
+		if (e->op < NVMAP_CACHE_OP_WB || e->op > NVMAP_CACHE_OP_WB_INV) {
+			err = -EINVAL;
+			goto out;
+		}
+
+		h = nvmap_get_handle_id(client, e->handle);
+		if (!h) {
+			err = -EPERM;
+			goto out;
+		}
+
+		if (!h->alloc || e->offset >= h->size ||
+		    e->len > h->size - e->offset) {
+			nvmap_handle_put(h);
+			err = -EINVAL;
+			goto out;
+		}
+
+		ops[count].h = h;
+		ops[count].start = e->offset;
+		ops[count].end = e->offset + e->len;
+		ops[count].op = e->op;
+		if (h->heap_pgalloc)
+			ops[count].paddr = page_to_phys(
+				h->pgalloc.pages[e->offset >> PAGE_SHIFT]) +
+				(e->offset & ~PAGE_MASK);
+		else
+			ops[count].paddr = h->carveout->base + e->offset;
+	}
+
+	sort(ops, count, sizeof(*ops), cache_list_op_cmp, NULL);
+
+#ifdef CONFIG_NVMAP_CACHE_MAINT_BY_SET_WAYS
+	cache_list_maint_by_ways(client, ops, count);
+#endif
+
+	for (i = 0; i < count && !err; i++) {
+		if (ops[i].done)
+			continue;
+		err = cache_maint(client, ops[i].h, ops[i].start, ops[i].end,
+				  ops[i].op, CACHE_MAINT_ALLOW_DEFERRED);
+	}
+
+out:
+	for (i = 0; i < count; i++)
+		nvmap_handle_put(ops[i].h);
+	kfree(ops);
+	kfree(entries);
+	return err;
+}
+
 static int rw_handle_page(struct nvmap_handle *h, int is_read,
 			  unsigned long start, unsigned long rw_addr,
 			  unsigned long bytes, unsigned long kaddr, pte_t *pte)
@@ -98,6 +98,18 @@ struct nvmap_cache_op {
 	__s32 op;
 };
 
+struct nvmap_cache_op_entry {
+	__u32 handle;
+	__u32 offset;		/* offset into hmem */
+	__u32 len;		/* number of bytes to maintain */
+	__s32 op;
+};
+
+struct nvmap_cache_op_list {
+	unsigned long ops;	/* array of struct nvmap_cache_op_entry */
+	__u32 count;		/* number of entries in ops */
+};
+
 #define NVMAP_IOC_MAGIC 'N'
 
 /* Creates a new memory handle. On input, the argument is the size of the new
@@ -141,7 +153,12 @@ struct nvmap_cache_op {
  * reference to the same handle */
 #define NVMAP_IOC_SHARE  _IOWR(NVMAP_IOC_MAGIC, 14, struct nvmap_create_handle)
 
-#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_SHARE))
+/* Performs cache maintenance on a list of handle ranges in one call. Entries
+ * are executed in physical address order, so the order of operations on
+ * overlapping ranges within one list is not defined */
+#define NVMAP_IOC_CACHE_LIST _IOW(NVMAP_IOC_MAGIC, 15, struct nvmap_cache_op_list)
+
+#define NVMAP_IOC_MAXNR (_IOC_NR(NVMAP_IOC_CACHE_LIST))
 
 #ifdef  __KERNEL__
 int nvmap_ioctl_pinop(struct file *filp, bool is_pin, void __user *arg);
@@ -160,6 +177,8 @@ int nvmap_map_into_caller_ptr(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_cache_maint(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_rw_handle(struct file *filp, int is_read, void __user* arg);
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
@@ -20,8 +20,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/kernel.h>
 #include <linux/list.h>
-#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/rbtree.h>
 
 #include <asm/pgtable.h>
 
@@ -31,29 +33,125 @@
 #include "nvmap_mru.h"
 
 /* if IOVMM reclamation is enabled (CONFIG_NVMAP_RECLAIM_UNPINNED_VM),
- * unpinned handles are placed onto a most-recently-used eviction list;
- * multiple lists are maintained, segmented by size (sizes were chosen to
- * roughly correspond with common sizes for graphics surfaces).
+ * unpinned handles are placed into a reuse cache. every cached handle is
+ * linked on an LRU list (most recently unpinned first) and indexed in an
+ * rbtree keyed by the length of its IOVMM area, one tree per start
+ * alignment, so that a pin which cannot get fresh IOVMM space can take the
+ * best-fitting suitably aligned cached area in O(log n),
+ * and eviction always starts with the least recently unpinned handle.
  *
- * if a handle is located on the MRU list, then the code below may
+ * if a handle is in the reuse cache, then the code below may
  * steal its IOVMM area at any time to satisfy a pin operation if no
  * free IOVMM space is available
  */
 
-static const size_t mru_cutoff[] = {
-	262144, 393216, 786432, 1048576, 1572864
-};
+/* bucket of the mru_tree holding an area starting at iovm_start */
+static unsigned int mru_bucket(unsigned long iovm_start)
+{
+	unsigned int order;
+
+	if (!iovm_start)
+		return NVMAP_MRU_ALIGN_BUCKETS - 1;
+	order = __ffs(iovm_start);
+	if (order <= PAGE_SHIFT)
+		return 0;
+	return min_t(unsigned int, order - PAGE_SHIFT,
+		     NVMAP_MRU_ALIGN_BUCKETS - 1);
+}
+
+static struct rb_root *mru_tree_root(struct nvmap_share *share,
+				     struct nvmap_handle *h)
+{
+	return &share->mru_tree[mru_bucket(h->pgalloc.area->iovm_start)];
+}
+
+static void mru_tree_insert(struct nvmap_share *share, struct nvmap_handle *h)
+{
+	struct rb_root *root = mru_tree_root(share, h);
+	struct rb_node **p = &root->rb_node;
+	struct rb_node *parent = NULL;
+	size_t len = h->pgalloc.area->iovm_length;
+
+	while (*p) {
+		struct nvmap_handle *e;
+
+		parent = *p;
+		e = rb_entry(parent, struct nvmap_handle, pgalloc.mru_node);
+		/* equal lengths are ordered by handle address, so that
+		 * every node has a unique key */
+		if (len < e->pgalloc.area->iovm_length ||
+		    (len == e->pgalloc.area->iovm_length && h < e))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&h->pgalloc.mru_node, parent, p);
+	rb_insert_color(&h->pgalloc.mru_node, root);
+}
+
+/* nvmap_mru_lock should be acquired by the caller */
+static void mru_del_locked(struct nvmap_share *share, struct nvmap_handle *h)
+{
+	list_del_init(&h->pgalloc.mru_list);
+	rb_erase(&h->pgalloc.mru_node, mru_tree_root(share, h));
+	share->mru_nr_cached--;
+}
+
+/* returns the first node of root whose area is at least size bytes long */
+static struct rb_node *mru_lower_bound(struct rb_root *root, size_t size)
+{
+	struct rb_node *n = root->rb_node;
+	struct rb_node *best = NULL;
+
+	while (n) {
+		struct nvmap_handle *e;
 
-static inline struct list_head *mru_list(struct nvmap_share *share, size_t size)
+		e = rb_entry(n, struct nvmap_handle, pgalloc.mru_node);
+		if (e->pgalloc.area->iovm_length >= size) {
+			best = n;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	return best;
+}
+
+/* returns the cached handle with the smallest IOVMM area which is at least
+ * size bytes long and satisfies align, or NULL. every bucket from the one
+ * matching align up satisfies it by construction, so this is one lower
+ * bound lookup per bucket; only an alignment coarser than the last bucket
+ * has to check the areas in it one by one. */
+static struct nvmap_handle *mru_best_fit(struct nvmap_share *share,
+					 size_t size, size_t align)
 {
-	unsigned int i;
+	struct nvmap_handle *best = NULL;
+	unsigned int first = 0;
+	unsigned int b;
+
+	if (align > PAGE_SIZE)
+		first = min_t(unsigned int,
+			      order_base_2(align) - PAGE_SHIFT,
+			      NVMAP_MRU_ALIGN_BUCKETS - 1);
 
-	BUG_ON(!share->mru_lists);
-	for (i = 0; i < ARRAY_SIZE(mru_cutoff); i++)
-		if (size <= mru_cutoff[i])
-			break;
+	for (b = first; b < NVMAP_MRU_ALIGN_BUCKETS; b++) {
+		struct rb_node *n = mru_lower_bound(&share->mru_tree[b], size);
 
-	return &share->mru_lists[i];
+		for (; n; n = rb_next(n)) {
+			struct nvmap_handle *e;
+
+			e = rb_entry(n, struct nvmap_handle, pgalloc.mru_node);
+			if (best && e->pgalloc.area->iovm_length >=
+				    best->pgalloc.area->iovm_length)
+				break;
+			if (!align ||
+			    IS_ALIGNED(e->pgalloc.area->iovm_start, align)) {
+				best = e;
+				break;
+			}
+		}
+	}
+	return best;
 }
 
 size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
@@ -62,102 +160,92 @@ size_t nvmap_mru_vm_size(struct tegra_iovmm_client *iovmm)
 	return (vm_size >> 2) * 3;
 }
 
-/*  nvmap_mru_vma_lock should be acquired by the caller before calling this */
+/* nvmap_mru_lock should be acquired by the caller before calling this */
 void nvmap_mru_insert_locked(struct nvmap_share *share, struct nvmap_handle *h)
 {
-	size_t len = h->pgalloc.area->iovm_length;
-	list_add(&h->pgalloc.mru_list, mru_list(share, len));
+	BUG_ON(!h->pgalloc.area);
+	list_add(&h->pgalloc.mru_list, &share->mru_lru);
+	mru_tree_insert(share, h);
+	share->mru_nr_cached++;
 }
 
 void nvmap_mru_remove(struct nvmap_share *s, struct nvmap_handle *h)
 {
 	nvmap_mru_lock(s);
 	if (!list_empty(&h->pgalloc.mru_list))
-		list_del(&h->pgalloc.mru_list);
+		mru_del_locked(s, h);
 	nvmap_mru_unlock(s);
-	INIT_LIST_HEAD(&h->pgalloc.mru_list);
 }
 
 /* returns a tegra_iovmm_area for a handle. if the handle already has
- * an iovmm_area allocated, the handle is simply removed from its MRU list
- * and the existing iovmm_area is returned.
+ * an iovmm_area allocated, the handle is simply removed from the reuse
+ * cache and the existing iovmm_area is returned.
  *
  * if no existing allocation exists, try to allocate a new IOVMM area.
  *
- * if a new area can not be allocated, try to re-use the most-recently-unpinned
- * handle's allocation.
+ * if a new area can not be allocated, try to re-use the smallest cached
+ * area which is large enough for the handle.
  *
- * and if that fails, iteratively evict handles from the MRU lists and free
- * their allocations, until the new allocation succeeds.
+ * and if that fails, evict handles from the reuse cache in LRU order and
+ * free their allocations, until the new allocation succeeds.
  */
 struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 					    struct nvmap_handle *h)
 {
-	struct list_head *mru;
-	struct nvmap_handle *evict = NULL;
+	struct nvmap_share *share;
+	struct nvmap_handle *evict;
 	struct tegra_iovmm_area *vm = NULL;
-	unsigned int i, idx;
 	pgprot_t prot;
 
 	BUG_ON(!h || !c || !c->share);
 
+	share = c->share;
 	prot = nvmap_pgprot(h, pgprot_kernel);
 
 	if (h->pgalloc.area) {
 		BUG_ON(list_empty(&h->pgalloc.mru_list));
-		list_del(&h->pgalloc.mru_list);
-		INIT_LIST_HEAD(&h->pgalloc.mru_list);
+		mru_del_locked(share, h);
+		share->mru_hits++;
 		return h->pgalloc.area;
 	}
 
-	vm = tegra_iovmm_create_vm(c->share->iovmm, NULL,
+	vm = tegra_iovmm_create_vm(share->iovmm, NULL,
 			h->size, h->align, prot,
 			h->pgalloc.iovm_addr);
 
 	if (vm) {
 		INIT_LIST_HEAD(&h->pgalloc.mru_list);
+		share->mru_misses++;
 		return vm;
 	}
 	/* if client is looking for specific iovm address, return from here. */
 	if ((vm == NULL) && (h->pgalloc.iovm_addr != 0))
 		return NULL;
-	/* attempt to re-use the most recently unpinned IOVMM area in the
-	 * same size bin as the current handle. If that fails, iteratively
-	 * evict handles (starting from the current bin) until an allocation
-	 * succeeds or no more areas can be evicted */
-	mru = mru_list(c->share, h->size);
-	if (!list_empty(mru))
-		evict = list_first_entry(mru, struct nvmap_handle,
-					 pgalloc.mru_list);
-
-	if (evict && evict->pgalloc.area->iovm_length >= h->size) {
-		list_del(&evict->pgalloc.mru_list);
+
+	evict = mru_best_fit(share, h->size, h->align);
+	if (evict) {
+		BUG_ON(atomic_read(&evict->pin) != 0);
+		mru_del_locked(share, evict);
 		vm = evict->pgalloc.area;
 		evict->pgalloc.area = NULL;
-		INIT_LIST_HEAD(&evict->pgalloc.mru_list);
+		share->mru_reuses++;
 		return vm;
 	}
 
-	idx = mru - c->share->mru_lists;
-
-	for (i = 0; i < c->share->nr_mru && !vm; i++, idx++) {
-		if (idx >= c->share->nr_mru)
-			idx = 0;
-		mru = &c->share->mru_lists[idx];
-		while (!list_empty(mru) && !vm) {
-			evict = list_first_entry(mru, struct nvmap_handle,
-						 pgalloc.mru_list);
-
-			BUG_ON(atomic_read(&evict->pin) != 0);
-			BUG_ON(!evict->pgalloc.area);
-			list_del(&evict->pgalloc.mru_list);
-			INIT_LIST_HEAD(&evict->pgalloc.mru_list);
-			tegra_iovmm_free_vm(evict->pgalloc.area);
-			evict->pgalloc.area = NULL;
-			vm = tegra_iovmm_create_vm(c->share->iovmm,
-					NULL, h->size, h->align,
-					prot, h->pgalloc.iovm_addr);
-		}
+	share->mru_misses++;
+	while (!list_empty(&share->mru_lru) && !vm) {
+		evict = list_entry(share->mru_lru.prev, struct nvmap_handle,
+				   pgalloc.mru_list);
+
+		BUG_ON(atomic_read(&evict->pin) != 0);
+		BUG_ON(!evict->pgalloc.area);
+		mru_del_locked(share, evict);
+		tegra_iovmm_free_vm(evict->pgalloc.area);
+		evict->pgalloc.area = NULL;
+		share->mru_evictions++;
+		vm = tegra_iovmm_create_vm(share->iovmm,
+				NULL, h->size, h->align,
+				prot, h->pgalloc.iovm_addr);
 	}
 	return vm;
 }
@@ -165,23 +253,15 @@ struct tegra_iovmm_area *nvmap_handle_iovmm_locked(struct nvmap_client *c,
 int nvmap_mru_init(struct nvmap_share *share)
 {
 	int i;
-	mutex_init(&share->mru_lock);
-	share->nr_mru = ARRAY_SIZE(mru_cutoff) + 1;
-
-	share->mru_lists = kzalloc(sizeof(struct list_head) * share->nr_mru,
-				   GFP_KERNEL);
-
-	if (!share->mru_lists)
-		return -ENOMEM;
-
-	for (i = 0; i < share->nr_mru; i++)
-		INIT_LIST_HEAD(&share->mru_lists[i]);
 
+	mutex_init(&share->mru_lock);
+	for (i = 0; i < NVMAP_MRU_ALIGN_BUCKETS; i++)
+		share->mru_tree[i] = RB_ROOT;
+	INIT_LIST_HEAD(&share->mru_lru);
 	return 0;
 }
 
 void nvmap_mru_destroy(struct nvmap_share *share)
 {
-	kfree(share->mru_lists);
-	share->mru_lists = NULL;
+	WARN_ON(!list_empty(&share->mru_lru));
 }
@@ -25,12 +25,14 @@
 
 #include <linux/device.h>
 #include <linux/types.h>
+#include <linux/ktime.h>
 #include <linux/devfreq.h>
 #include <linux/platform_device.h>
 
 struct nvhost_master;
 struct nvhost_hwctx;
 struct nvhost_device_power_attr;
+struct nvhost_acm_idle_stats;
 
 #define NVHOST_MODULE_MAX_CLOCKS		3
 #define NVHOST_MODULE_MAX_POWERGATE_IDS 	2
@@ -64,6 +66,7 @@ enum nvhost_power_sysfs_attributes {
 	NVHOST_POWER_SYSFS_ATTRIB_CLOCKGATE_DELAY = 0,
 	NVHOST_POWER_SYSFS_ATTRIB_POWERGATE_DELAY,
 	NVHOST_POWER_SYSFS_ATTRIB_REFCOUNT,
+	NVHOST_POWER_SYSFS_ATTRIB_ADAPTIVE_DELAY,
 	NVHOST_POWER_SYSFS_ATTRIB_MAX
 };
 
@@ -119,6 +122,7 @@ struct nvhost_device_data {
 	struct nvhost_channel *channel;	/* Channel assigned for the module */
 	struct kobject *power_kobj;	/* kobject to hold power sysfs entries */
 	struct nvhost_device_power_attr *power_attrib;	/* sysfs attributes */
+	struct nvhost_acm_idle_stats *idle_stats; /* Adaptive gate delays */
 	struct devfreq	*power_manager;	/* Device power management */
 	struct dentry *debugfs;		/* debugfs directory */
 
@@ -194,6 +198,19 @@ u32 nvhost_syncpt_read_ext(struct platform_device *dev, u32 id);
 int nvhost_syncpt_wait_timeout_ext(struct platform_device *dev, u32 id, u32 thresh,
 	u32 timeout, u32 *value);
 
+/* public host1x sync fence APIs */
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+int nvhost_sync_create_fence_ext(struct platform_device *dev, u32 id,
+	u32 thresh, const char *name, int *fence_fd);
+#else
+static inline int nvhost_sync_create_fence_ext(struct platform_device *dev,
+	u32 id, u32 thresh, const char *name, int *fence_fd)
+{
+	return -ENOSYS;
+}
+#endif
+
 void nvhost_scale3d_set_throughput_hint(int hint);
+void nvhost_scale3d_set_frame_time(ktime_t flip, unsigned int frame_us);
 
 #endif
@@ -164,6 +164,33 @@ struct nvhost_submit_args {
 	__u32 fence;		/* Return value */
 };
 
+/*
+ * Submit several jobs with one call. Each entry of submits is handled as
+ * by NVHOST_IOCTL_CHANNEL_SUBMIT and gets its fence written back.
+ *
+ * cmdbuf_gens is optional and holds one generation per cmdbuf, for all
+ * submits back to back. A non-zero generation promises that the contents
+ * of the cmdbuf's memory have not been written by user space since it was
+ * last submitted with that generation; relocations are then only patched
+ * again if a target has moved.
+ *
+ * Submitting stops at the first failing job. The call fails only if no job
+ * was submitted, otherwise num_submitted tells how many were.
+ */
+struct nvhost_submit_batch_args {
+	__u32 num_submits;
+	__u32 flags;
+	struct nvhost_submit_args *submits;
+	__u32 *cmdbuf_gens;
+	__u32 pad[4];		/* future expansion */
+	__u32 num_submitted;	/* Return value */
+};
+
+#define NVHOST_SUBMIT_BATCH_MAX			64
+
+/* return sync fence fds in nvhost_submit_args.fence, not thresholds */
+#define NVHOST_SUBMIT_BATCH_FLAG_SYNC_FENCE_FD	(1 << 0)
+
 #define NVHOST_IOCTL_CHANNEL_FLUSH		\
 	_IOR(NVHOST_IOCTL_MAGIC, 1, struct nvhost_get_param_args)
 #define NVHOST_IOCTL_CHANNEL_GET_SYNCPOINTS	\
@@ -196,8 +223,13 @@ struct nvhost_submit_args {
 	_IOWR(NVHOST_IOCTL_MAGIC, 15, struct nvhost_submit_args)
 #define NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX	\
 	_IOWR(NVHOST_IOCTL_MAGIC, 18, struct nvhost_set_timeout_ex_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 19, struct nvhost_submit_batch_args)
+/* as SUBMIT, but returns a sync fence fd in fence; -1 if already done */
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_FENCE_FD	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 20, struct nvhost_submit_args)
 #define NVHOST_IOCTL_CHANNEL_LAST		\
-	_IOC_NR(NVHOST_IOCTL_CHANNEL_SET_TIMEOUT_EX)
+	_IOC_NR(NVHOST_IOCTL_CHANNEL_SUBMIT_FENCE_FD)
 #define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_args)
 
 struct nvhost_ctrl_syncpt_read_args {
@@ -227,6 +259,18 @@ struct nvhost_ctrl_module_mutex_args {
 	__u32 lock;
 };
 
+struct nvhost_ctrl_sync_fence_info {
+	__u32 id;
+	__u32 thresh;
+};
+
+struct nvhost_ctrl_sync_fence_create_args {
+	__u32 num_pts;
+	__s32 fence_fd;		/* Return value */
+	struct nvhost_ctrl_sync_fence_info *pts;
+	const char *name;
+};
+
 enum nvhost_module_id {
 	NVHOST_MODULE_NONE = -1,
 	NVHOST_MODULE_DISPLAY_A = 0,
@@ -259,8 +303,11 @@ enum nvhost_module_id {
 #define NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX	\
 	_IOWR(NVHOST_IOCTL_MAGIC, 8, struct nvhost_ctrl_syncpt_read_args)
 
+#define NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 9, struct nvhost_ctrl_sync_fence_create_args)
+
 #define NVHOST_IOCTL_CTRL_LAST			\
-	_IOC_NR(NVHOST_IOCTL_CTRL_SYNCPT_READ_MAX)
+	_IOC_NR(NVHOST_IOCTL_CTRL_SYNC_FENCE_CREATE)
 #define NVHOST_IOCTL_CTRL_MAX_ARG_SIZE	\
 	sizeof(struct nvhost_ctrl_module_regrdwr_args)
 
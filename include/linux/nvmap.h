@@ -71,6 +71,8 @@ struct nvmap_device;
 struct nvmap_handle_ref {
 	struct nvmap_handle *handle;
 	struct rb_node	node;
+	struct hlist_node hash_node;	/* RCU lookup entry in the client */
+	struct rcu_head	rcu;
 	atomic_t	dupes;	/* number of times to free on file close */
 	atomic_t	pin;	/* number of times to unpin on free */
 };
@@ -124,4 +124,11 @@
 #define PR_SET_CHILD_SUBREAPER 36
 #define PR_GET_CHILD_SUBREAPER 37
 
+/*
+ * Frequency in kHz the CPU is raised to when the thread wakes up, 0 for
+ * none. arg3 (set) or arg2 (get) is a thread id, 0 for the caller.
+ */
+#define PR_SET_CPUFREQ_HINT 0x43464801
+#define PR_GET_CPUFREQ_HINT 0x43464802
+
 #endif /* _LINUX_PRCTL_H */
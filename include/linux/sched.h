@@ -140,6 +140,11 @@ extern unsigned long nr_running(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern u64 nr_running_integral(unsigned int cpu);
+#ifdef CONFIG_CPUQUIET_GOVERNOR_RUNQUEUE
+struct static_key;
+extern struct static_key cpuquiet_runqueue_enabled;
+extern void cpuquiet_runqueue_tick(unsigned int cpu, unsigned int nr_queued);
+#endif
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
@@ -1585,6 +1590,11 @@ struct task_struct {
 	unsigned long timer_slack_ns;
 	unsigned long default_timer_slack_ns;
 
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+	/* cpu frequency in kHz to raise to when woken, set by prctl */
+	unsigned int cpufreq_hint;
+#endif
+
 	struct list_head	*scm_work_list;
 #ifdef CONFIG_FUNCTION_GRAPH_TRACER
 	/* Index of current stored address in ret_stack */
@@ -2204,6 +2214,10 @@ extern void xtime_update(unsigned long ticks);
 
 extern int wake_up_state(struct task_struct *tsk, unsigned int state);
 extern int wake_up_process(struct task_struct *tsk);
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+extern void cpufreq_interactive_task_wakeup(struct task_struct *p, int cpu);
+extern int cpufreq_interactive_check_hint(unsigned long khz);
+#endif
 extern void wake_up_new_task(struct task_struct *tsk);
 #ifdef CONFIG_SMP
  extern void kick_process(struct task_struct *tsk);
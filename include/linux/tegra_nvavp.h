@@ -15,6 +15,7 @@
 #include <linux/types.h>
 
 #define NVAVP_MAX_RELOCATION_COUNT 64
+#define NVAVP_MAX_SUBMIT_COUNT 16
 
 /* avp submit flags */
 #define NVAVP_FLAG_NONE		0x00000000
@@ -55,6 +56,17 @@ struct nvavp_pushbuffer_submit_hdr {
 	__u32			flags;
 };
 
+/*
+ * Submits num_hdrs command buffers in one go. The per-buffer syncpt
+ * pointers are ignored: when syncpt is set, a single increment follows the
+ * last buffer and its fence is returned there.
+ */
+struct nvavp_pushbuffer_submit_multi_hdr {
+	struct nvavp_pushbuffer_submit_hdr	*hdrs;
+	__u32					num_hdrs;
+	struct nvavp_syncpt			*syncpt;
+};
+
 struct nvavp_set_nvmap_fd_args {
 	__u32 fd;
 };
@@ -93,8 +105,11 @@ struct nvavp_clock_stay_on_state_args {
 					struct nvavp_clock_args)
 #define NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS _IOWR(NVAVP_IOCTL_MAGIC, 0x69, \
 					struct nvavp_clock_args)
+#define NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI \
+					_IOWR(NVAVP_IOCTL_MAGIC, 0x6a, \
+					struct nvavp_pushbuffer_submit_multi_hdr)
 
 #define NVAVP_IOCTL_MIN_NR		_IOC_NR(NVAVP_IOCTL_SET_NVMAP_FD)
-#define NVAVP_IOCTL_MAX_NR		_IOC_NR(NVAVP_IOCTL_DISABLE_AUDIO_CLOCKS)
+#define NVAVP_IOCTL_MAX_NR		_IOC_NR(NVAVP_IOCTL_PUSH_BUFFER_SUBMIT_MULTI)
 
 #endif /* __LINUX_TEGRA_NVAVP_H */
@@ -100,6 +100,54 @@ TRACE_EVENT(cpufreq_interactive_unboost,
 	    TP_printk("%s", __get_str(s))
 );
 
+TRACE_EVENT(cpufreq_interactive_hint,
+	    TP_PROTO(u32 cpu_id, pid_t pid, unsigned long curfreq,
+		     unsigned long hintfreq),
+	    TP_ARGS(cpu_id, pid, curfreq, hintfreq),
+
+	    TP_STRUCT__entry(
+		    __field(          u32, cpu_id    )
+		    __field(        pid_t, pid       )
+		    __field(unsigned long, curfreq   )
+		    __field(unsigned long, hintfreq  )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->pid = pid;
+		    __entry->curfreq = curfreq;
+		    __entry->hintfreq = hintfreq;
+	    ),
+
+	    TP_printk("cpu=%u pid=%d cur=%lu hint=%lu",
+		      __entry->cpu_id, __entry->pid, __entry->curfreq,
+		      __entry->hintfreq)
+);
+
+TRACE_EVENT(cpufreq_interactive_hint_done,
+	    TP_PROTO(u32 cpu_id, unsigned long targfreq,
+		     unsigned long actualfreq, u64 latency_us),
+	    TP_ARGS(cpu_id, targfreq, actualfreq, latency_us),
+
+	    TP_STRUCT__entry(
+		    __field(          u32, cpu_id     )
+		    __field(unsigned long, targfreq   )
+		    __field(unsigned long, actualfreq )
+		    __field(          u64, latency_us )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->targfreq = targfreq;
+		    __entry->actualfreq = actualfreq;
+		    __entry->latency_us = latency_us;
+	    ),
+
+	    TP_printk("cpu=%u targ=%lu actual=%lu latency_us=%llu",
+		      __entry->cpu_id, __entry->targfreq,
+		      __entry->actualfreq, __entry->latency_us)
+);
+
 #endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
 
 /* This part must be outside protection */
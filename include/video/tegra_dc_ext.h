@@ -61,6 +61,9 @@
 #define TEGRA_DC_EXT_FLIP_FLAG_CURSOR	(1 << 3)
 #define TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA	(1 << 4)
 #define TEGRA_DC_EXT_FLIP_FLAG_SCAN_COLUMN	(1 << 6)
+#define TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE	(1 << 7)
+#define TEGRA_DC_EXT_FLIP_FLAG_DAMAGE	(1 << 8)
+#define TEGRA_DC_EXT_FLIP_FLAG_MAILBOX	(1 << 9)
 
 struct tegra_dc_ext_flip_windowattr {
 	__s32	index;
@@ -96,17 +99,86 @@ struct tegra_dc_ext_flip_windowattr {
 	__u8	global_alpha; /* requires TEGRA_DC_EXT_FLIP_FLAG_GLOBAL_ALPHA */
 	/* Leave some wiggle room for future expansion */
 	__u8	pad1[3];
-	__u32   pad2[4];
+	__s32	pre_fence_fd; /* requires TEGRA_DC_EXT_FLIP_FLAG_PRE_FENCE */
+	/*
+	 * Part of the buffer that changed since the window's last flip, in
+	 * integer source pixels; requires TEGRA_DC_EXT_FLIP_FLAG_DAMAGE.
+	 * Command mode panels are then only sent the rows it covers.
+	 */
+	__u16	damage_x;
+	__u16	damage_y;
+	__u16	damage_w;
+	__u16	damage_h;
+	__u32   pad2[1];
 };
 
 #define TEGRA_DC_EXT_FLIP_N_WINDOWS	3
 
+/*
+ * swap_interval in tegra_dc_ext_flip_windowattr:
+ *   0, 1 - every flip is shown, at most one per vblank (the default)
+ *   N    - every flip is shown for at least N vblanks, values above
+ *          TEGRA_DC_EXT_FLIP_MAX_SWAP_INTERVAL are clamped to it
+ * A flip uses the largest swap_interval of its windows.  A non-zero
+ * timestamp holds the flip until the vblank it names.
+ *
+ * If every window of a flip sets TEGRA_DC_EXT_FLIP_FLAG_MAILBOX, the flip
+ * is dropped without being scanned out when a newer flip for the same
+ * windows is queued behind it.
+ */
+#define TEGRA_DC_EXT_FLIP_MAX_SWAP_INTERVAL	4
+
 struct tegra_dc_ext_flip {
 	struct tegra_dc_ext_flip_windowattr win[TEGRA_DC_EXT_FLIP_N_WINDOWS];
 	__u32	post_syncpt_id;
 	__u32	post_syncpt_val;
 };
 
+/*
+ * Same as tegra_dc_ext_flip, but also returns a sync fence fd that signals
+ * along with post_syncpt_id/post_syncpt_val.  post_fence_fd is -1 if no
+ * fence could be created; the flip is queued regardless.
+ */
+struct tegra_dc_ext_flip_fence {
+	struct tegra_dc_ext_flip flip;
+	__s32	post_fence_fd;
+	__u32	reserved[3];
+};
+
+/*
+ * Present feedback for a window: the post syncpt value of the last flip
+ * retired on it and when it was latched (CLOCK_REALTIME), plus counts of
+ * flips shown and dropped since the window was claimed.
+ */
+struct tegra_dc_ext_flip_feedback {
+	__u32	win;			/* in */
+	__u32	post_syncpt_val;
+	__s64	present_ns;
+	__u32	presented;
+	__u32	dropped;
+};
+
+/*
+ * Flip completion events, read() from the tegra_dc_ext device: one per
+ * flip in the order they retire, from the time the fd was opened.
+ * seq counts every flip on the head, so a gap means the reader fell
+ * behind and the kernel overwrote events.  Times are CLOCK_MONOTONIC;
+ * latch_vblank is the vblank syncpt value of the frame that showed the
+ * flip.  Skipped flips were superseded and never reached the screen.
+ */
+#define TEGRA_DC_EXT_FLIP_EVENT_SKIPPED	(1 << 0)
+
+struct tegra_dc_ext_flip_event {
+	__u32	seq;
+	__u32	flags;
+	__u32	win_mask;
+	__u32	post_syncpt_id;
+	__u32	post_syncpt_val;
+	__u32	latch_vblank;
+	__s64	submit_ns;
+	__s64	latch_ns;
+};
+
 /*
  * Cursor image format:
  * - Tegra hardware supports two colors: foreground and background, specified
@@ -269,6 +341,12 @@ struct tegra_dc_ext_feature {
 #define TEGRA_DC_EXT_SET_CMU \
 	_IOW('D', 0x0D, struct tegra_dc_ext_cmu)
 
+#define TEGRA_DC_EXT_FLIP_FENCE \
+	_IOWR('D', 0x0E, struct tegra_dc_ext_flip_fence)
+
+#define TEGRA_DC_EXT_GET_FLIP_FEEDBACK \
+	_IOWR('D', 0x0F, struct tegra_dc_ext_flip_feedback)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
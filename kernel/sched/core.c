@@ -1639,6 +1639,12 @@ stat:
 out:
 	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
 
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+	/* outside of pi_lock, the governor wakes its own thread */
+	if (success && unlikely(p->cpufreq_hint))
+		cpufreq_interactive_task_wakeup(p, cpu);
+#endif
+
 	return success;
 }
 
@@ -1725,6 +1731,10 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
+
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+	p->cpufreq_hint = 0;
+#endif
 }
 
 /*
@@ -3193,6 +3203,13 @@ void scheduler_tick(void)
 
 	perf_event_task_tick();
 
+#ifdef CONFIG_CPUQUIET_GOVERNOR_RUNQUEUE
+	/* a thread is left waiting on this cpu, which keeps its tick */
+	if (static_key_false(&cpuquiet_runqueue_enabled) &&
+	    rq->nr_running > 1)
+		cpuquiet_runqueue_tick(cpu, rq->nr_running);
+#endif
+
 #ifdef CONFIG_SMP
 	rq->idle_balance = idle_cpu(cpu);
 	trigger_load_balance(rq, cpu);
@@ -1979,6 +1979,40 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			error = put_user(me->signal->is_child_subreaper,
 					 (int __user *) arg2);
 			break;
+#ifdef CONFIG_CPU_FREQ_GOV_INTERACTIVE_TASK_HINTS
+		case PR_SET_CPUFREQ_HINT:
+		case PR_GET_CPUFREQ_HINT: {
+			pid_t pid = option == PR_SET_CPUFREQ_HINT ? arg3 : arg2;
+			struct task_struct *p = me;
+
+			if (option == PR_SET_CPUFREQ_HINT) {
+				if (arg4 || arg5 || arg2 > UINT_MAX ||
+				    cpufreq_interactive_check_hint(arg2))
+					return -EINVAL;
+				/* a boost needs CAP_SYS_NICE, clearing does not */
+				if (arg2 && !capable(CAP_SYS_NICE))
+					return -EPERM;
+			} else if (arg3 || arg4 || arg5)
+				return -EINVAL;
+
+			rcu_read_lock();
+			if (pid)
+				p = find_task_by_vpid(pid);
+			if (!p)
+				error = -ESRCH;
+			else if (option == PR_GET_CPUFREQ_HINT)
+				error = p->cpufreq_hint;
+			else if (!same_thread_group(p, me) &&
+				 !capable(CAP_SYS_NICE))
+				error = -EPERM;
+			else {
+				p->cpufreq_hint = arg2;
+				error = 0;
+			}
+			rcu_read_unlock();
+			break;
+		}
+#endif
 		default:
 			error = -EINVAL;
 			break;